@@ -282,6 +282,16 @@ load_log_configuration (gchar *config_file)
   return log_domain_list;
 }
 
+/**
+ * @brief Configuration passed to setup_log_handlers.
+ */
+static GSList *log_handlers_config = NULL;
+
+/**
+ * @brief Whether setup_log_handlers was called.
+ */
+static gboolean log_handlers_set_up = FALSE;
+
 /**
  * @brief Frees all resources loaded by the config loader.
  *
@@ -326,6 +336,12 @@ free_log_configuration (GSList *log_domain_list)
     }
   /* Free the link list. */
   g_slist_free (log_domain_list);
+
+  if (log_domain_list == log_handlers_config)
+    {
+      log_handlers_config = NULL;
+      log_handlers_set_up = FALSE;
+    }
 }
 
 /**
@@ -898,5 +914,55 @@ setup_log_handlers (GSList *gvm_log_config_list)
                       | G_LOG_FLAG_RECURSION),
     (GLogFunc) gvm_log_func, gvm_log_config_list);
 
+  log_handlers_config = gvm_log_config_list;
+  log_handlers_set_up = TRUE;
+
   return ret;
 }
+
+/**
+ * @brief Check whether debug messages of a log domain are logged.
+ *
+ * Useful to skip formatting debug messages that are expensive to build.
+ *
+ * @param log_domain  Log domain.
+ *
+ * @return TRUE if debug messages are logged, else FALSE.
+ */
+gboolean
+gvm_log_debug_enabled (const char *log_domain)
+{
+  gvm_logging_t *default_entry, *domain_entry;
+  const gchar *debug_domains;
+
+  default_entry = domain_entry = NULL;
+  if (log_handlers_set_up)
+    for (GSList *list = log_handlers_config; list; list = g_slist_next (list))
+      {
+        gvm_logging_t *entry = list->data;
+
+        if (g_ascii_strcasecmp (entry->log_domain, "*") == 0)
+          default_entry = entry;
+        else if (log_domain
+                 && g_ascii_strcasecmp (entry->log_domain, log_domain) == 0)
+          domain_entry = entry;
+      }
+
+  /* Same levels as gvm_log_func. */
+  if (domain_entry || default_entry)
+    {
+      GLogLevelFlags level = G_LOG_LEVEL_DEBUG;
+
+      if (default_entry && default_entry->default_level)
+        level = *default_entry->default_level;
+      if (domain_entry && domain_entry->default_level)
+        level = *domain_entry->default_level;
+      return level >= G_LOG_LEVEL_DEBUG;
+    }
+
+  /* The default handler of GLib. */
+  debug_domains = g_getenv ("G_MESSAGES_DEBUG");
+  return debug_domains
+         && (strcmp (debug_domains, "all") == 0
+             || (log_domain && strstr (debug_domains, log_domain)));
+}
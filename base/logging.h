@@ -47,6 +47,9 @@ log_func_for_gnutls (int, const char *);
 int
 setup_log_handlers (GSList *);
 
+gboolean
+gvm_log_debug_enabled (const char *);
+
 void
 gvm_log_lock (void);
 
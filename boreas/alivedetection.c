@@ -43,6 +43,7 @@
 #include <pcap.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/param.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -56,6 +57,91 @@
 
 scanner_t scanner;
 
+/**
+ * @brief State of the dead hosts sent to ospd in batches while the probes are
+ * sent.
+ */
+struct dead_hosts_batches
+{
+  int number_of_targets;
+  /* Number of hosts of a batch. */
+  int batch;
+  /* Number of batches sent so far. */
+  int batches_sent;
+  /* Number of hosts in last batch. Depending on the total number of hosts the
+   * last batch size maybe be double the normal size. Info about the last batch
+   * is send after all hosts were checked and we waited for last packets to
+   * arrive.*/
+  int remaining_batch;
+  /* Number of alive hosts when the last batch was sent. */
+  int prev_alive;
+  gboolean limit_reached_handled; /* Scan restrictions related. */
+};
+
+/**
+ * @brief Send the dead hosts of all batches completed since the last call to
+ * ospd.
+ *
+ * A batch is complete once batch hosts were probed and more than batch hosts
+ * remain. All batches completed since the last call are sent as one update.
+ *
+ * @param hosts_done  Number of hosts probed so far.
+ * @param batches_p   Pointer to struct dead_hosts_batches.
+ */
+static void
+send_dead_hosts_batches (int hosts_done, gpointer batches_p)
+{
+  struct dead_hosts_batches *batches = batches_p;
+  int n, size, curr_alive, number_of_dead_hosts;
+
+  n = 0;
+  while ((batches->batches_sent + n + 1) * batches->batch <= hosts_done
+         && batches->number_of_targets
+                - (batches->batches_sent + n + 1) * batches->batch
+              > batches->batch)
+    n++;
+  if (n == 0)
+    return;
+  size = n * batches->batch;
+
+  /* The number of dead hosts we have to send to ospd is the size of the
+   * batches minus the newly found alive hosts. The newly found alive hosts is
+   * the diff between the current total of alive hosts and the total of the
+   * last batch. */
+  curr_alive = g_hash_table_size (scanner.hosts_data->alivehosts);
+  number_of_dead_hosts = size - (curr_alive - batches->prev_alive);
+
+  /* If the max_scan_hosts limit was reached we can not tell ospd the true
+   * number of dead hosts. The number of alive hosts which are above the
+   * max_scan_hosts limit are not to be subtracted form the dead hosts to send.
+   * They are considered as dead hosts for the progress bar.*/
+  if (scanner.scan_restrictions->max_scan_hosts_reached)
+    {
+      /* Handle the case where we reach the max_scan_hosts for the first time.
+       * We may have to consider some of the new alive hosts as dead because of
+       * the restriction. E.g curr_alive=110 prev_alive=90 max_scan_hosts=100
+       * batch=100. Normally we would send 80 as dead in this batch (20 new
+       * alive hosts) but because of the restriction we send 90 as dead. The 10
+       * hosts which are over the limit are considered as dead.
+       * After this limit case was handled we just always send the complete
+       * batch as dead hosts.*/
+      if (!batches->limit_reached_handled)
+        {
+          /* Number of alive hosts until limit was reached. */
+          int last_hosts_considered_as_alive =
+            scanner.scan_restrictions->max_scan_hosts - batches->prev_alive;
+          number_of_dead_hosts = size - last_hosts_considered_as_alive;
+          batches->limit_reached_handled = TRUE;
+        }
+      else
+        number_of_dead_hosts = size;
+    }
+  send_dead_hosts_to_ospd_openvas (number_of_dead_hosts);
+  batches->remaining_batch -= size;
+  batches->batches_sent += n;
+  batches->prev_alive = curr_alive;
+}
+
 /**
  * @brief Scan function starts a sniffing thread which waits for packets to
  * arrive and sends pings to hosts we want to test. Blocks until Scan is
@@ -77,19 +163,29 @@ scan (alive_test_t alive_test)
   struct timeval start_time, end_time;
   int scandb_id;
   gchar *scan_id;
-  /* Following variables are only relevant if only ICMP was chosen. */
-  int remaining_batch;
-  int prev_alive;
-  gboolean limit_reached_handled = FALSE; /* Scan restrictions related. */
+  int sender_threads;
+  /* Dead hosts are sent in batches if only ICMP was chosen. */
+  gboolean batched_dead_hosts;
+  struct dead_hosts_batches batches;
 
   gettimeofday (&start_time, NULL);
   number_of_targets = g_hash_table_size (scanner.hosts_data->targethosts);
+  sender_threads = get_alive_test_sender_threads ();
+  batched_dead_hosts = alive_test == ALIVE_TEST_ICMP;
+  memset (&batches, 0, sizeof (batches));
+  batches.number_of_targets = number_of_targets;
+  batches.batch = 1000;
+  batches.remaining_batch = number_of_targets;
 
   scandb_id = atoi (prefs_get ("ov_maindbid"));
   scan_id = get_openvas_scan_id (prefs_get ("db_address"), scandb_id);
   g_message ("Alive scan %s started: Target has %d hosts", scan_id,
              number_of_targets);
 
+  /* Alive hosts are put on the queue in batches by a separate thread so that
+   * the sniffer thread never waits for redis. */
+  start_host_publisher (&scanner);
+
   /* Sniffer thread needed if any alive test besides ALIVE_TEST_CONSIDER_ALIVE
    * was chosen. */
   if (alive_test != ALIVE_TEST_CONSIDER_ALIVE)
@@ -101,115 +197,49 @@ scan (alive_test_t alive_test)
   /* Continuously send dead hosts to ospd if only ICMP was chosen instead of
    * sending all at once at the end. This is done for displaying a progressbar
    * that increases gradually. */
-  if (alive_test == ALIVE_TEST_ICMP)
+  if (batched_dead_hosts && sender_threads == 1)
     {
       g_hash_table_iter_init (&target_hosts_iter,
                               scanner.hosts_data->targethosts);
-      int batch = 1000;
-      int curr_alive = 0;
-      prev_alive = 0;
-      /* Number of hosts in last batch. Depending on the total number of hosts
-       * the last batch size maybe be double the normal size. Info about the
-       * last batch is send after all hosts were checked and we waited for last
-       * packets to arrive.*/
-      remaining_batch = number_of_targets;
       for (int packets_send = 0;
            g_hash_table_iter_next (&target_hosts_iter, &key, &value);)
         {
           send_icmp (key, value, &scanner);
           packets_send++;
-          /* Send dead hosts update after batch number of packets were send and
-           * we still have more than batch size packets remaining. */
-          if (packets_send % batch == 0
-              && (number_of_targets - packets_send) > batch)
-            {
-              /* The number of dead hosts we have to send to ospd is the batch
-               * size minus the newly found alive hosts. The newly found alive
-               * hosts is the diff between the current total of alive hosts and
-               * the total of the last batch. */
-              curr_alive = g_hash_table_size (scanner.hosts_data->alivehosts);
-              number_of_dead_hosts = batch - (curr_alive - prev_alive);
-
-              /* If the max_scan_hosts limit was reached we can not tell ospd
-               * the true number of dead hosts. The number of alive hosts which
-               * are above the max_scan_hosts limit are not to be subtracted
-               * form the dead hosts to send. They are considered as dead hosts
-               * for the progress bar.*/
-              if (scanner.scan_restrictions->max_scan_hosts_reached)
-                {
-                  /* Handle the case where we reach the max_scan_hosts for the
-                   * first time. We may have to consider some of the new alive
-                   * hosts as dead because of the restriction. E.g
-                   * curr_alive=110 prev_alive=90 max_scan_hosts=100 batch=100.
-                   * Normally we would send 80 as dead in this batch (20 new
-                   * alive hosts) but because of the restriction we send 90 as
-                   * dead. The 10 hosts which are over the limit are considered
-                   * as dead.
-                   * After this limit case was handled we just always send the
-                   * complete batch as dead hosts.*/
-                  if (!limit_reached_handled)
-                    {
-                      /* Number of alive hosts until limit was reached. */
-                      int last_hosts_considered_as_alive =
-                        scanner.scan_restrictions->max_scan_hosts - prev_alive;
-                      number_of_dead_hosts =
-                        batch - last_hosts_considered_as_alive;
-                      send_dead_hosts_to_ospd_openvas (number_of_dead_hosts);
-                      remaining_batch -= batch;
-                      limit_reached_handled = TRUE;
-                    }
-                  else
-                    {
-                      send_dead_hosts_to_ospd_openvas (batch);
-                      remaining_batch -= batch;
-                    }
-                }
-              else
-                {
-                  send_dead_hosts_to_ospd_openvas (number_of_dead_hosts);
-                  remaining_batch -= batch;
-                }
-              prev_alive = curr_alive;
-            }
+          send_dead_hosts_batches (packets_send, &batches);
         }
     }
-  else if (alive_test & ALIVE_TEST_ICMP)
+  else if (alive_test
+           & (ALIVE_TEST_ICMP | ALIVE_TEST_TCP_SYN_SERVICE
+              | ALIVE_TEST_TCP_ACK_SERVICE | ALIVE_TEST_ARP))
     {
-      g_debug ("%s: ICMP Ping", __func__);
-      g_hash_table_foreach (scanner.hosts_data->targethosts, send_icmp,
-                            &scanner);
-      wait_until_so_sndbuf_empty (scanner.icmpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner.icmpv6soc, 10);
-      usleep (500000);
-    }
-  if (alive_test & ALIVE_TEST_TCP_SYN_SERVICE)
-    {
-      g_debug ("%s: TCP-SYN Service Ping", __func__);
-      scanner.tcp_flag = TH_SYN; /* SYN */
-      g_hash_table_foreach (scanner.hosts_data->targethosts, send_tcp,
-                            &scanner);
-      wait_until_so_sndbuf_empty (scanner.tcpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner.tcpv6soc, 10);
-      usleep (500000);
-    }
-  if (alive_test & ALIVE_TEST_TCP_ACK_SERVICE)
-    {
-      g_debug ("%s: TCP-ACK Service Ping", __func__);
-      scanner.tcp_flag = TH_ACK; /* ACK */
-      g_hash_table_foreach (scanner.hosts_data->targethosts, send_tcp,
-                            &scanner);
-      wait_until_so_sndbuf_empty (scanner.tcpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner.tcpv6soc, 10);
+      /* Send the probes of all chosen methods in a single pipelined pass
+       * over the target hosts. Hosts found alive by a reply to an earlier
+       * probe are skipped. */
+      g_debug ("%s: Interleaved ICMP/TCP-SYN/TCP-ACK/ARP Ping", __func__);
+      scanner.alive_test = alive_test;
+      if (sender_threads > 1)
+        {
+          g_debug ("%s: Shard target hosts across %d sender threads",
+                   __func__, sender_threads);
+          /* The sender threads report their progress, so that dead hosts of
+           * an ICMP only scan are still sent in batches. */
+          if (send_probes_sharded (&scanner, sender_threads,
+                                   batched_dead_hosts ? send_dead_hosts_batches
+                                                      : NULL,
+                                   &batches)
+              != 0)
+            g_warning ("%s: Not all sender threads could be started. Some "
+                       "hosts may not have been probed.",
+                       __func__);
+        }
+      else
+        {
+          send_probes (&scanner);
+          wait_until_all_so_sndbuf_empty (&scanner, alive_test, 10);
+        }
       usleep (500000);
     }
-  if (alive_test & ALIVE_TEST_ARP)
-    {
-      g_debug ("%s: ARP Ping", __func__);
-      g_hash_table_foreach (scanner.hosts_data->targethosts, send_arp,
-                            &scanner);
-      wait_until_so_sndbuf_empty (scanner.arpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner.arpv6soc, 10);
-    }
   if (alive_test & ALIVE_TEST_CONSIDER_ALIVE)
     {
       g_debug ("%s: Consider Alive", __func__);
@@ -239,36 +269,41 @@ scan (alive_test_t alive_test)
       stop_sniffer_thread (&scanner, sniffer_thread_id);
     }
 
+  /* Make sure all alive hosts are on the queue before the dead hosts are sent
+   * and the finish signal is put on the queue. */
+  stop_host_publisher (&scanner);
+
   /* If only ICMP was specified we continuously send updates about dead hosts to
    * ospd while checking the hosts. We now only have to send the dead hosts of
    * the last batch. This is done here to catch the last alive hosts which may
    * have arrived after all packets were already sent.
    * Else send total number of dead host at once.*/
-  if (alive_test == ALIVE_TEST_ICMP)
+  if (batched_dead_hosts)
     {
       if (scanner.scan_restrictions->max_scan_hosts_reached)
         {
           /* We reached the max_scan_host limit in the last batch. For detailed
            * description look at the first time where limit_reached_handled is
            * used.*/
-          if (!limit_reached_handled)
+          if (!batches.limit_reached_handled)
             {
               /* Number of alive hosts until limit was reached. */
               int last_hosts_considered_as_alive =
-                scanner.scan_restrictions->max_scan_hosts - prev_alive;
+                scanner.scan_restrictions->max_scan_hosts - batches.prev_alive;
               number_of_dead_hosts =
-                remaining_batch - last_hosts_considered_as_alive;
+                batches.remaining_batch - last_hosts_considered_as_alive;
               send_dead_hosts_to_ospd_openvas (number_of_dead_hosts);
             }
           else
             {
-              send_dead_hosts_to_ospd_openvas (remaining_batch);
+              send_dead_hosts_to_ospd_openvas (batches.remaining_batch);
             }
         }
       else
         {
           int curr_alive = g_hash_table_size (scanner.hosts_data->alivehosts);
-          number_of_dead_hosts = remaining_batch - (curr_alive - prev_alive);
+          number_of_dead_hosts =
+            batches.remaining_batch - (curr_alive - batches.prev_alive);
           send_dead_hosts_to_ospd_openvas (number_of_dead_hosts);
         }
     }
@@ -352,6 +387,8 @@ alive_detection_init (gvm_hosts_t *hosts, alive_test_t alive_test)
     }
   /* reset hosts iter */
   hosts->current = 0;
+  scanner.hosts_data->alive_set =
+    alive_set_new (g_hash_table_size (scanner.hosts_data->targethosts));
 
   /* Init ports used for scanning. */
   scanner.ports = NULL;
@@ -448,6 +485,7 @@ alive_detection_free (void *error)
   /* targethosts: (ipstr, gvm_host_t *)
    * gvm_host_t are freed by caller of start_alive_detection()! */
   g_hash_table_destroy (scanner.hosts_data->targethosts);
+  alive_set_free (scanner.hosts_data->alive_set);
   g_free (scanner.hosts_data);
 
   /* Set error. */
@@ -32,6 +32,8 @@
 #define BURST_TIMEOUT 100000
 /* how tong (in sec) to wait for replies after last packet was sent */
 #define WAIT_FOR_REPLIES_TIMEOUT 1
+/* Upper limit of sender threads the target hosts may be sharded across. */
+#define MAX_SENDER_THREADS 64
 /* Src port of outgoing TCP pings. Used for filtering incoming packets. */
 #define FILTER_PORT 9910
 
@@ -41,13 +43,49 @@
 #define ALIVE_DETECTION_QUEUE "alive_detection"
 /* Signal to put on ALIVE_DETECTION_QUEUE if alive detection finished. */
 #define ALIVE_DETECTION_FINISHED "alive_detection_finished"
+/* Maximum number of alive hosts put on ALIVE_DETECTION_QUEUE at once. */
+#define PUBLISH_BATCH_SIZE 256
+/* How long (in microseconds) an alive host may wait for its batch to fill. */
+#define PUBLISH_BATCH_TIMEOUT 5000
 
 void *
 start_alive_detection (void *);
 
+/**
+ * @brief Alive tests.
+ *
+ * These numbers are used in the database by gvmd, so if the number associated
+ * with any symbol changes in gvmd we need to change them here too.
+ */
+typedef enum
+{
+  ALIVE_TEST_TCP_ACK_SERVICE = 1,
+  ALIVE_TEST_ICMP = 2,
+  ALIVE_TEST_ARP = 4,
+  ALIVE_TEST_CONSIDER_ALIVE = 8,
+  ALIVE_TEST_TCP_SYN_SERVICE = 16
+} alive_test_t;
+
 typedef struct hosts_data hosts_data_t;
+typedef struct alive_set alive_set_t;
+typedef struct host_publisher host_publisher_t;
 typedef struct scan_restrictions scan_restrictions_t;
 
+/**
+ * @brief Rate limiting state of a single probe method.
+ *
+ * At most BURST probes of a method are sent per BURST_TIMEOUT window.
+ */
+struct probe_rate_limit
+{
+  /* Number of probes sent in the current window. */
+  int sent;
+  /* Start of the current window in monotonic microseconds. */
+  gint64 window_start;
+};
+
+typedef struct probe_rate_limit probe_rate_limit_t;
+
 /**
  * @brief The scanner struct holds data which is used frequently by the alive
  * detection thread.
@@ -66,10 +104,20 @@ struct scanner
   int udpv6soc;
   /* TH_SYN or TH_ACK */
   uint8_t tcp_flag;
+  /* Methods used by the interleaved probe scheduler. */
+  alive_test_t alive_test;
+  /* Per method rate limits of the interleaved probe scheduler. */
+  probe_rate_limit_t icmp_rate_limit;
+  probe_rate_limit_t tcp_syn_rate_limit;
+  probe_rate_limit_t tcp_ack_rate_limit;
+  probe_rate_limit_t arp_rate_limit;
   /* ports used for TCP ACK/SYN */
   GArray *ports;
   /* redis connection */
   kb_t main_kb;
+  /* Puts alive hosts on the queue in batches. NULL if hosts are put on the
+   * queue directly. */
+  host_publisher_t *host_publisher;
   /* pcap handle */
   pcap_t *pcap_handle;
   hosts_data_t *hosts_data;
@@ -92,6 +140,10 @@ struct hosts_data
   /* Hashtable of the form (ip_str, gvm_host_t *). The gvm_host_t pointers point
    * to hosts which are to be freed by the caller of start_alive_detection(). */
   GHashTable *targethosts;
+  /* Lock-free set of the target hosts which were detected as alive. Unlike
+   * alivehosts it may be queried by the sender threads while the sniffer
+   * thread adds hosts. */
+  alive_set_t *alive_set;
 };
 
 /* Max_scan_hosts related struct. */
@@ -107,21 +159,6 @@ struct scan_restrictions
   gboolean max_scan_hosts_reached;
 };
 
-/**
- * @brief Alive tests.
- *
- * These numbers are used in the database by gvmd, so if the number associated
- * with any symbol changes in gvmd we need to change them here too.
- */
-typedef enum
-{
-  ALIVE_TEST_TCP_ACK_SERVICE = 1,
-  ALIVE_TEST_ICMP = 2,
-  ALIVE_TEST_ARP = 4,
-  ALIVE_TEST_CONSIDER_ALIVE = 8,
-  ALIVE_TEST_TCP_SYN_SERVICE = 16
-} alive_test_t;
-
 /**
  * @brief Type of socket.
  */
@@ -0,0 +1,520 @@
+/* Copyright (C) 2021 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * @brief Stand-alone benchmark of the Boreas alive detection.
+ *
+ * A TUN device is created and the target network is routed over it. A
+ * responder thread reads the probes from the TUN device and answers ICMP echo
+ * requests and TCP-SYN/TCP-ACK pings for a configurable share of the target
+ * hosts, dropping a configurable share of the replies. ARP can not be
+ * simulated on a TUN device.
+ *
+ * The reply processing rate is the number of detected hosts per time from the
+ * first reply to the last detection.
+ *
+ * Needs CAP_NET_ADMIN and CAP_NET_RAW, e.g.:
+ *
+ *   sudo ./boreas-bench --network 10.250.0.0/16 --alive 0.3 --loss 0.01
+ */
+
+/* Included for the static init_cli(), run_cli_scan() and free_cli(). */
+#include "cli.c"
+
+#include "../base/hosts.h"
+#include "boreas_io.h"
+#include "util.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/if_tun.h>
+#include <net/if.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Name of the TUN device the target network is routed over. */
+#define BENCH_IFNAME "boreasbench0"
+
+/* Time of the last detection of an alive host. Only written by the sniffer
+ * thread and only read after it was stopped. */
+static gint64 last_detection;
+
+void
+__real_handle_scan_restrictions (scanner_t *, gchar *);
+
+/**
+ * @brief Record the time of a detection of an alive host.
+ *
+ * The benchmark is linked with -Wl,-wrap,handle_scan_restrictions, which the
+ * sniffer calls for every newly detected alive host.
+ *
+ * @param scanner   Pointer to scanner struct.
+ * @param addr_str  Ip string of the alive host.
+ */
+void
+__wrap_handle_scan_restrictions (scanner_t *scanner, gchar *addr_str)
+{
+  last_detection = g_get_monotonic_time ();
+  __real_handle_scan_restrictions (scanner, addr_str);
+}
+
+/**
+ * @brief Simulated network behind the TUN device.
+ */
+struct responder
+{
+  int tun_fd;
+  /* Share of alive hosts in 1/1000. */
+  guint32 alive_permille;
+  /* Share of replies to drop. */
+  gdouble loss;
+  gint stop;
+  /* Statistics. Only read after the responder thread was joined. */
+  guint64 probes;
+  guint64 replies;
+  guint64 lost;
+  gint64 first_probe;
+  gint64 last_probe;
+  gint64 first_reply;
+  /* Set of hosts (in_addr_t) which sent at least one reply. */
+  GHashTable *answered;
+};
+
+/**
+ * @brief Decide whether a simulated host is alive.
+ *
+ * @param responder Simulated network.
+ * @param addr      Address of the host.
+ *
+ * @return TRUE if the host is alive, else FALSE.
+ */
+static gboolean
+simulated_host_alive (struct responder *responder, struct in_addr addr)
+{
+  /* Knuth's multiplicative hash spreads alive hosts evenly over the range. */
+  return (ntohl (addr.s_addr) * 2654435761u) % 1000
+         < responder->alive_permille;
+}
+
+/**
+ * @brief Turn an ICMP echo request into an echo reply in place.
+ *
+ * @param packet  IPv4 packet.
+ * @param hl      Length of the IPv4 header.
+ * @param len     Length of the packet.
+ *
+ * @return Length of the reply, 0 if the packet is no echo request.
+ */
+static ssize_t
+icmp_reply (u_char *packet, int hl, ssize_t len)
+{
+  struct icmphdr *icmp = (struct icmphdr *) (packet + hl);
+
+  if (len < hl + (ssize_t) sizeof (struct icmphdr) || icmp->type != ICMP_ECHO)
+    return 0;
+
+  icmp->type = ICMP_ECHOREPLY;
+  icmp->checksum = 0;
+  icmp->checksum = in_cksum ((uint16_t *) icmp, len - hl);
+  return len;
+}
+
+/**
+ * @brief Turn a TCP-SYN ping into a SYN-ACK and a TCP-ACK ping into a RST in
+ * place.
+ *
+ * @param packet  IPv4 packet.
+ * @param hl      Length of the IPv4 header.
+ * @param len     Length of the packet.
+ *
+ * @return Length of the reply, 0 if the packet is no Boreas TCP ping.
+ */
+static ssize_t
+tcp_reply (u_char *packet, int hl, ssize_t len)
+{
+  struct ip *ip = (struct ip *) packet;
+  struct tcphdr *tcp = (struct tcphdr *) (packet + hl);
+  u_char pseudo[12 + sizeof (struct tcphdr)];
+  uint16_t port;
+
+  if (len < hl + (ssize_t) sizeof (struct tcphdr)
+      || ntohs (tcp->th_sport) != FILTER_PORT)
+    return 0;
+
+  if (tcp->th_flags == TH_SYN)
+    {
+      tcp->th_flags = TH_SYN | TH_ACK;
+      tcp->th_ack = htonl (ntohl (tcp->th_seq) + 1);
+      tcp->th_seq = htonl (g_random_int ());
+    }
+  else if (tcp->th_flags == TH_ACK)
+    {
+      tcp->th_flags = TH_RST;
+      tcp->th_seq = tcp->th_ack;
+      tcp->th_ack = 0;
+    }
+  else
+    return 0;
+
+  port = tcp->th_sport;
+  tcp->th_sport = tcp->th_dport;
+  tcp->th_dport = port;
+  tcp->th_off = 5;
+  tcp->th_sum = 0;
+
+  /* The addresses are swapped by the caller afterwards. */
+  memset (pseudo, 0, sizeof (pseudo));
+  memcpy (pseudo, &ip->ip_dst, 4);
+  memcpy (pseudo + 4, &ip->ip_src, 4);
+  pseudo[9] = IPPROTO_TCP;
+  pseudo[11] = sizeof (struct tcphdr);
+  memcpy (pseudo + 12, tcp, sizeof (struct tcphdr));
+  tcp->th_sum = in_cksum ((uint16_t *) pseudo, sizeof (pseudo));
+
+  return hl + sizeof (struct tcphdr);
+}
+
+/**
+ * @brief Answer a single probe read from the TUN device.
+ *
+ * @param responder Simulated network.
+ * @param packet    IPv4 packet.
+ * @param len       Length of the packet.
+ */
+static void
+handle_probe (struct responder *responder, u_char *packet, ssize_t len)
+{
+  struct ip *ip = (struct ip *) packet;
+  struct in_addr addr;
+  ssize_t reply_len;
+  int hl;
+
+  if (ip->ip_v != 4)
+    return;
+  hl = ip->ip_hl * 4;
+
+  if (ip->ip_p == IPPROTO_ICMP)
+    reply_len = icmp_reply (packet, hl, len);
+  else if (ip->ip_p == IPPROTO_TCP)
+    reply_len = tcp_reply (packet, hl, len);
+  else
+    return;
+  if (reply_len == 0)
+    return;
+
+  responder->probes++;
+  responder->last_probe = g_get_monotonic_time ();
+  if (responder->first_probe == 0)
+    responder->first_probe = responder->last_probe;
+
+  if (!simulated_host_alive (responder, ip->ip_dst))
+    return;
+  if (g_random_double () < responder->loss)
+    {
+      responder->lost++;
+      return;
+    }
+
+  addr = ip->ip_dst;
+  ip->ip_dst = ip->ip_src;
+  ip->ip_src = addr;
+  ip->ip_ttl = 64;
+  ip->ip_len = htons (reply_len);
+  ip->ip_sum = 0;
+  ip->ip_sum = in_cksum ((uint16_t *) ip, hl);
+
+  if (write (responder->tun_fd, packet, reply_len) != reply_len)
+    {
+      g_warning ("%s: write(): %s", __func__, strerror (errno));
+      return;
+    }
+  responder->replies++;
+  if (responder->first_reply == 0)
+    responder->first_reply = g_get_monotonic_time ();
+  g_hash_table_add (responder->answered, GUINT_TO_POINTER (addr.s_addr));
+}
+
+/**
+ * @brief Answer probes until the stop flag is set.
+ *
+ * @param responder_p Pointer to responder struct.
+ */
+static void *
+responder_thread (void *responder_p)
+{
+  struct responder *responder = (struct responder *) responder_p;
+  struct pollfd pfd;
+  u_char packet[1500];
+
+  pfd.fd = responder->tun_fd;
+  pfd.events = POLLIN;
+  while (!g_atomic_int_get (&responder->stop))
+    {
+      ssize_t len;
+
+      if (poll (&pfd, 1, 100) <= 0)
+        continue;
+      len = read (responder->tun_fd, packet, sizeof (packet));
+      if (len < (ssize_t) sizeof (struct ip))
+        continue;
+      handle_probe (responder, packet, len);
+    }
+
+  return NULL;
+}
+
+/**
+ * @brief Create the TUN device and route the target network over it.
+ *
+ * The first address of the network is assigned to the device.
+ *
+ * @param[in]  network   Target network in CIDR notation.
+ * @param[out] tun_addr  Address assigned to the device.
+ *
+ * @return File descriptor of the TUN device, -1 on error.
+ */
+static int
+open_tun (const char *network, struct in_addr *tun_addr)
+{
+  struct ifreq ifr;
+  struct sockaddr_in *sin;
+  struct in_addr base;
+  gchar **parts;
+  int prefix, fd, soc;
+
+  parts = g_strsplit (network, "/", 2);
+  if (parts[0] == NULL || parts[1] == NULL
+      || inet_pton (AF_INET, parts[0], &base) != 1)
+    {
+      g_strfreev (parts);
+      fprintf (stderr, "Invalid network %s.\n", network);
+      return -1;
+    }
+  prefix = atoi (parts[1]);
+  g_strfreev (parts);
+  if (prefix < 8 || prefix > 30)
+    {
+      fprintf (stderr, "Prefix length must be between 8 and 30.\n");
+      return -1;
+    }
+  tun_addr->s_addr =
+    htonl ((ntohl (base.s_addr) & (0xffffffffu << (32 - prefix))) + 1);
+
+  if ((fd = open ("/dev/net/tun", O_RDWR)) < 0)
+    {
+      fprintf (stderr, "open(/dev/net/tun): %s\n", strerror (errno));
+      return -1;
+    }
+  memset (&ifr, 0, sizeof (ifr));
+  ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+  g_strlcpy (ifr.ifr_name, BENCH_IFNAME, IFNAMSIZ);
+  if (ioctl (fd, TUNSETIFF, &ifr) < 0)
+    {
+      fprintf (stderr, "ioctl(TUNSETIFF): %s\n", strerror (errno));
+      close (fd);
+      return -1;
+    }
+
+  if ((soc = socket (AF_INET, SOCK_DGRAM, 0)) < 0)
+    {
+      fprintf (stderr, "socket(): %s\n", strerror (errno));
+      close (fd);
+      return -1;
+    }
+  sin = (struct sockaddr_in *) &ifr.ifr_addr;
+  sin->sin_family = AF_INET;
+  sin->sin_addr = *tun_addr;
+  if (ioctl (soc, SIOCSIFADDR, &ifr) < 0)
+    goto error;
+  sin->sin_addr.s_addr = htonl (0xffffffffu << (32 - prefix));
+  if (ioctl (soc, SIOCSIFNETMASK, &ifr) < 0)
+    goto error;
+  if (ioctl (soc, SIOCGIFFLAGS, &ifr) < 0)
+    goto error;
+  ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+  if (ioctl (soc, SIOCSIFFLAGS, &ifr) < 0)
+    goto error;
+  close (soc);
+
+  return fd;
+
+error:
+  fprintf (stderr, "Could not configure %s: %s\n", BENCH_IFNAME,
+           strerror (errno));
+  close (soc);
+  close (fd);
+  return -1;
+}
+
+int
+main (int argc, char **argv)
+{
+  static gchar *network = "10.250.0.0/24";
+  static gdouble alive = 0.5;
+  static gdouble loss = 0.0;
+  static gint methods = ALIVE_TEST_ICMP;
+  static gchar *ports = "80";
+  static GOptionEntry entries[] = {
+    {"network", 'n', 0, G_OPTION_ARG_STRING, &network,
+     "Target network in CIDR notation (default 10.250.0.0/24)", "<CIDR>"},
+    {"alive", 'a', 0, G_OPTION_ARG_DOUBLE, &alive,
+     "Share of alive hosts between 0 and 1 (default 0.5)", "<RATIO>"},
+    {"loss", 'l', 0, G_OPTION_ARG_DOUBLE, &loss,
+     "Share of dropped replies between 0 and 1 (default 0)", "<RATIO>"},
+    {"methods", 'm', 0, G_OPTION_ARG_INT, &methods,
+     "Alive test methods as bitflag like the ALIVE_TEST preference "
+     "(default 2, ICMP)",
+     "<FLAGS>"},
+    {"ports", 'p', 0, G_OPTION_ARG_STRING, &ports,
+     "Ports for TCP-SYN/TCP-ACK pings (default 80)", "<PORTS>"},
+    {NULL, 0, 0, 0, NULL, NULL, NULL}};
+  GOptionContext *option_context;
+  GError *error = NULL;
+  struct responder responder;
+  struct in_addr tun_addr;
+  char tun_addr_str[INET_ADDRSTRLEN];
+  pthread_t responder_thread_id;
+  scanner_t scanner = {0};
+  gvm_hosts_t *hosts;
+  gvm_host_t *host;
+  gint64 start, end;
+  guint simulated_alive, detected;
+  double probe_window, reply_window;
+
+  option_context =
+    g_option_context_new ("- benchmark Boreas against a simulated network");
+  g_option_context_add_main_entries (option_context, entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (option_context);
+
+  if (methods & ALIVE_TEST_ARP)
+    {
+      fprintf (stderr, "ARP can not be simulated on a TUN device.\n");
+      return 1;
+    }
+  if (!(methods
+        & (ALIVE_TEST_ICMP | ALIVE_TEST_TCP_SYN_SERVICE
+           | ALIVE_TEST_TCP_ACK_SERVICE)))
+    {
+      fprintf (stderr, "No alive test method to benchmark chosen.\n");
+      return 1;
+    }
+
+  memset (&responder, 0, sizeof (responder));
+  responder.alive_permille = CLAMP (alive, 0.0, 1.0) * 1000;
+  responder.loss = CLAMP (loss, 0.0, 1.0);
+  responder.answered = g_hash_table_new (g_direct_hash, g_direct_equal);
+  if ((responder.tun_fd = open_tun (network, &tun_addr)) < 0)
+    return 1;
+
+  /* Do not probe the address of the TUN device itself. */
+  inet_ntop (AF_INET, &tun_addr, tun_addr_str, sizeof (tun_addr_str));
+  hosts = gvm_hosts_new (network);
+  if (hosts == NULL)
+    {
+      fprintf (stderr, "Invalid network %s.\n", network);
+      return 1;
+    }
+  gvm_hosts_exclude (hosts, tun_addr_str);
+
+  simulated_alive = 0;
+  for (host = gvm_hosts_next (hosts); host; host = gvm_hosts_next (hosts))
+    {
+      struct in6_addr addr6;
+      struct in_addr addr;
+
+      if (gvm_host_get_addr6 (host, &addr6) < 0
+          || !IN6_IS_ADDR_V4MAPPED (&addr6))
+        continue;
+      addr.s_addr = addr6.s6_addr32[3];
+      if (simulated_host_alive (&responder, addr))
+        simulated_alive++;
+    }
+  hosts->current = 0;
+
+  if (pthread_create (&responder_thread_id, NULL, responder_thread,
+                      &responder)
+      != 0)
+    {
+      fprintf (stderr, "Could not start responder thread.\n");
+      return 1;
+    }
+
+  if (init_cli (&scanner, hosts, methods, ports, 0) != NO_ERROR)
+    {
+      fprintf (stderr, "Error initializing scanner.\n");
+      return 1;
+    }
+
+  start = g_get_monotonic_time ();
+  if (run_cli_scan (&scanner, methods) != NO_ERROR)
+    fprintf (stderr, "Error while running the scan.\n");
+  end = g_get_monotonic_time ();
+  detected = g_hash_table_size (scanner.hosts_data->alivehosts);
+
+  g_atomic_int_set (&responder.stop, 1);
+  pthread_join (responder_thread_id, NULL);
+
+  probe_window = (responder.last_probe - responder.first_probe) / 1000000.0;
+  if (probe_window <= 0)
+    probe_window = 1e-6;
+  /* From the first reply on the wire to the last host detected. */
+  reply_window = (last_detection - responder.first_reply) / 1000000.0;
+  if (responder.first_reply == 0 || reply_window <= 0)
+    reply_window = 1e-6;
+
+  printf ("Target:                  %s (%d hosts)\n", network,
+          g_hash_table_size (scanner.hosts_data->targethosts));
+  printf ("Alive test methods:      %d\n", methods);
+  printf ("Simulated alive hosts:   %u\n", simulated_alive);
+  printf ("Probes received:         %" G_GUINT64_FORMAT "\n", responder.probes);
+  printf ("Probe rate:              %.0f probes/s\n",
+          responder.probes / probe_window);
+  printf ("Replies sent:            %" G_GUINT64_FORMAT "\n", responder.replies);
+  printf ("Replies dropped (loss):  %" G_GUINT64_FORMAT "\n", responder.lost);
+  printf ("Hosts answered:          %u\n",
+          g_hash_table_size (responder.answered));
+  printf ("Alive hosts detected:    %u\n", detected);
+  printf ("Answered but missed:     %d\n",
+          (int) g_hash_table_size (responder.answered) - (int) detected);
+  printf ("Reply processing rate:   %.0f hosts/s\n", detected / reply_window);
+  printf ("End-to-end time:         %.3f s\n", (end - start) / 1000000.0);
+
+  free_cli (&scanner, methods);
+  gvm_hosts_free (hosts);
+  g_hash_table_destroy (responder.answered);
+  close (responder.tun_fd);
+
+  return 0;
+}
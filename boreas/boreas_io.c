@@ -24,6 +24,7 @@
 #include "util.h"
 
 #include <glib/gprintf.h>
+#include <pthread.h>
 #include <stdlib.h>
 
 #undef G_LOG_DOMAIN
@@ -34,6 +35,22 @@
 
 scan_restrictions_t scan_restrictions;
 
+/**
+ * @brief Publisher thread which puts alive hosts on the alive detection queue
+ * in batches.
+ */
+struct host_publisher
+{
+  /* Host address strings to put on the queue. */
+  GAsyncQueue *queue;
+  /* Own kb connection of the publisher thread. */
+  kb_t kb;
+  pthread_t thread_id;
+};
+
+/* Pushed on the publisher queue to stop the publisher thread. */
+static int host_publisher_stop_signal;
+
 /**
  * @brief Check if max_scan_hosts alive hosts reached.
  *
@@ -231,6 +248,154 @@ put_host_on_queue (kb_t kb, char *addr_str)
              __func__, addr_str);
 }
 
+/**
+ * @brief Put a batch of host value strings on the queue of hosts to be
+ * considered as alive and empty the batch.
+ *
+ * @param kb KB to use.
+ * @param batch Array of IP addrs in str representation.
+ */
+static void
+put_hosts_on_queue (kb_t kb, GPtrArray *batch)
+{
+  if (batch->len == 0)
+    return;
+
+  if (kb_item_push_strs (kb, ALIVE_DETECTION_QUEUE,
+                         (const char **) batch->pdata, batch->len)
+      != 0)
+    g_debug ("%s: kb_item_push_strs() failed. Could not push %u hosts on "
+             "queue of hosts to be considered as alive.",
+             __func__, batch->len);
+  g_ptr_array_set_size (batch, 0);
+}
+
+/**
+ * @brief Collect alive hosts from the publisher queue and put them on the
+ * alive detection queue in batches.
+ *
+ * A batch is put on the queue as soon as it holds PUBLISH_BATCH_SIZE hosts or
+ * PUBLISH_BATCH_TIMEOUT passed since its first host arrived.
+ *
+ * @param publisher_p Pointer to host_publisher struct.
+ */
+static void *
+host_publisher_thread (void *publisher_p)
+{
+  host_publisher_t *publisher = (host_publisher_t *) publisher_p;
+  GPtrArray *batch;
+  gboolean stop = FALSE;
+
+  batch = g_ptr_array_new_with_free_func (g_free);
+  while (!stop)
+    {
+      gpointer item;
+      gint64 deadline;
+
+      /* Wait for the first host of the next batch. */
+      item = g_async_queue_pop (publisher->queue);
+      deadline = g_get_monotonic_time () + PUBLISH_BATCH_TIMEOUT;
+      while (item != NULL)
+        {
+          gint64 remaining;
+
+          if (item == &host_publisher_stop_signal)
+            {
+              stop = TRUE;
+              break;
+            }
+          g_ptr_array_add (batch, item);
+          if (batch->len >= PUBLISH_BATCH_SIZE)
+            break;
+
+          remaining = deadline - g_get_monotonic_time ();
+          if (remaining > 0)
+            item = g_async_queue_timeout_pop (publisher->queue, remaining);
+          else
+            item = g_async_queue_try_pop (publisher->queue);
+        }
+      put_hosts_on_queue (publisher->kb, batch);
+    }
+  g_ptr_array_free (batch, TRUE);
+
+  return NULL;
+}
+
+/**
+ * @brief Start the publisher thread which puts alive hosts on the alive
+ * detection queue in batches.
+ *
+ * Until the publisher is stopped handle_scan_restrictions() hands alive hosts
+ * over to the publisher instead of putting them on the queue itself. The
+ * publisher uses its own kb connection.
+ *
+ * @param scanner Pointer to scanner struct.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+start_host_publisher (scanner_t *scanner)
+{
+  host_publisher_t *publisher;
+  int scandb_id;
+
+  publisher = g_malloc0 (sizeof (host_publisher_t));
+  scandb_id = atoi (prefs_get ("ov_maindbid"));
+  if ((publisher->kb = kb_direct_conn (prefs_get ("db_address"), scandb_id))
+      == NULL)
+    {
+      g_warning ("%s: Could not connect to main_kb. Alive hosts are put on "
+                 "the queue one by one.",
+                 __func__);
+      g_free (publisher);
+      return -1;
+    }
+  publisher->queue = g_async_queue_new_full (g_free);
+
+  if (pthread_create (&publisher->thread_id, NULL, host_publisher_thread,
+                      publisher)
+      != 0)
+    {
+      g_warning ("%s: pthread_create() failed. Alive hosts are put on the "
+                 "queue one by one.",
+                 __func__);
+      kb_lnk_reset (publisher->kb);
+      g_async_queue_unref (publisher->queue);
+      g_free (publisher);
+      return -1;
+    }
+
+  scanner->host_publisher = publisher;
+  return 0;
+}
+
+/**
+ * @brief Stop the publisher thread after all alive hosts handed over to it
+ * were put on the alive detection queue.
+ *
+ * @param scanner Pointer to scanner struct.
+ */
+void
+stop_host_publisher (scanner_t *scanner)
+{
+  host_publisher_t *publisher = scanner->host_publisher;
+
+  if (publisher == NULL)
+    return;
+
+  /* Hand over alive hosts directly from now on. */
+  scanner->host_publisher = NULL;
+
+  g_async_queue_push (publisher->queue, &host_publisher_stop_signal);
+  if (pthread_join (publisher->thread_id, NULL) != 0)
+    g_warning ("%s: pthread_join() failed.", __func__);
+
+  if ((kb_lnk_reset (publisher->kb)) != 0)
+    g_warning ("%s: error in kb_lnk_reset()", __func__);
+  g_async_queue_unref (publisher->queue);
+  g_free (publisher);
+}
+
 /**
  * @brief Checks if the finish signal is already set.
  *
@@ -381,7 +546,10 @@ handle_scan_restrictions (scanner_t *scanner, gchar *addr_str)
     {
       /* Print host on command line if no kb is available. No kb available could
        * mean that boreas is used as commandline tool.*/
-      if (kb != NULL)
+      if (scanner->host_publisher != NULL)
+        g_async_queue_push (scanner->host_publisher->queue,
+                            g_strdup (addr_str));
+      else if (kb != NULL)
         put_host_on_queue (kb, addr_str);
       else
         {
@@ -496,3 +664,29 @@ get_alive_test_ports (void)
 {
   return prefs_get ("ALIVE_TEST_PORTS");
 }
+
+/**
+ * @brief Get the number of sender threads the target hosts are sharded across.
+ *
+ * @return Number of sender threads. 1 if not set or invalid.
+ */
+int
+get_alive_test_sender_threads (void)
+{
+  const gchar *pref_str;
+  int sender_threads;
+
+  pref_str = prefs_get ("alive_test_sender_threads");
+  if (pref_str == NULL)
+    return 1;
+
+  sender_threads = atoi (pref_str);
+  if (sender_threads < 1 || sender_threads > MAX_SENDER_THREADS)
+    {
+      g_debug ("%s: Invalid alive_test_sender_threads value. It must be an "
+               "integer between 1 and %d.",
+               __func__, MAX_SENDER_THREADS);
+      return 1;
+    }
+  return sender_threads;
+}
@@ -34,6 +34,12 @@ put_host_on_queue (kb_t, char *);
 void
 put_finish_signal_on_queue (void *);
 
+int
+start_host_publisher (scanner_t *);
+
+void
+stop_host_publisher (scanner_t *);
+
 void realloc_finish_signal_on_queue (kb_t);
 
 int finish_signal_on_queue (kb_t);
@@ -56,6 +62,9 @@ get_alive_test_methods (alive_test_t *);
 const gchar *
 get_alive_test_ports (void);
 
+int
+get_alive_test_sender_threads (void);
+
 int
 get_alive_hosts_count (void);
 
@@ -37,6 +37,17 @@
  */
 #define G_LOG_DOMAIN "libgvm boreas"
 
+/**
+ * @brief Initialize a scanner for a scan of the cli.
+ *
+ * @param scanner       Scanner to initialize.
+ * @param hosts         Hosts to scan.
+ * @param alive_test    Methods of alive detection to use provided as bitflag.
+ * @param port_list     Ports for TCP-SYN/TCP-ACK pings.
+ * @param print_results 1 to print the results to stdout, else 0.
+ *
+ * @return 0 on success, boreas_error_t on error.
+ */
 static boreas_error_t
 init_cli (scanner_t *scanner, gvm_hosts_t *hosts, alive_test_t alive_test,
           const gchar *port_list, const int print_results)
@@ -60,6 +71,8 @@ init_cli (scanner_t *scanner, gvm_hosts_t *hosts, alive_test_t alive_test,
   for (host = gvm_hosts_next (hosts); host; host = gvm_hosts_next (hosts))
     g_hash_table_insert (scanner->hosts_data->targethosts,
                          gvm_host_value_str (host), host);
+  scanner->hosts_data->alive_set =
+    alive_set_new (g_hash_table_size (scanner->hosts_data->targethosts));
 
   /* Sockets. */
   if ((error = set_all_needed_sockets (scanner, alive_test)) != 0)
@@ -82,6 +95,14 @@ init_cli (scanner_t *scanner, gvm_hosts_t *hosts, alive_test_t alive_test,
   return error;
 }
 
+/**
+ * @brief Free the data of a scanner initialized with init_cli().
+ *
+ * @param scanner     Scanner.
+ * @param alive_test  Methods of alive detection used.
+ *
+ * @return 0 on success, boreas_error_t on error.
+ */
 static boreas_error_t
 free_cli (scanner_t *scanner, alive_test_t alive_test)
 {
@@ -95,11 +116,20 @@ free_cli (scanner_t *scanner, alive_test_t alive_test)
     }
   g_hash_table_destroy (scanner->hosts_data->alivehosts);
   g_hash_table_destroy (scanner->hosts_data->targethosts);
+  alive_set_free (scanner->hosts_data->alive_set);
   g_free (scanner->hosts_data);
 
   return close_err;
 }
 
+/**
+ * @brief Run an alive scan with a scanner initialized with init_cli().
+ *
+ * @param scanner     Scanner.
+ * @param alive_test  Methods of alive detection to use provided as bitflag.
+ *
+ * @return 0 on success, boreas_error_t on error.
+ */
 static boreas_error_t
 run_cli_scan (scanner_t *scanner, alive_test_t alive_test)
 {
@@ -119,40 +149,13 @@ run_cli_scan (scanner_t *scanner, alive_test_t alive_test)
   if (error)
     return error;
 
-  if (alive_test & (ALIVE_TEST_ICMP))
-    {
-      g_hash_table_foreach (scanner->hosts_data->targethosts, send_icmp,
-                            scanner);
-      wait_until_so_sndbuf_empty (scanner->icmpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner->icmpv6soc, 10);
-      usleep (500000);
-    }
-  if (alive_test & (ALIVE_TEST_TCP_SYN_SERVICE))
-    {
-      scanner->tcp_flag = 0x02; /* SYN */
-      g_hash_table_foreach (scanner->hosts_data->targethosts, send_tcp,
-                            scanner);
-      wait_until_so_sndbuf_empty (scanner->tcpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner->tcpv6soc, 10);
-      usleep (500000);
-    }
-  if (alive_test & (ALIVE_TEST_TCP_ACK_SERVICE))
-    {
-      scanner->tcp_flag = 0x10; /* ACK */
-      g_hash_table_foreach (scanner->hosts_data->targethosts, send_tcp,
-                            scanner);
-      wait_until_so_sndbuf_empty (scanner->tcpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner->tcpv6soc, 10);
-      usleep (500000);
-    }
-  if (alive_test & (ALIVE_TEST_ARP))
-    {
-      g_hash_table_foreach (scanner->hosts_data->targethosts, send_arp,
-                            scanner);
-      wait_until_so_sndbuf_empty (scanner->arpv4soc, 10);
-      wait_until_so_sndbuf_empty (scanner->arpv6soc, 10);
-      usleep (500000);
-    }
+  /* Send the probes of all chosen methods in a single pipelined pass over
+   * the target hosts. Hosts found alive by a reply to an earlier probe are
+   * skipped. */
+  scanner->alive_test = alive_test;
+  send_probes (scanner);
+  wait_until_all_so_sndbuf_empty (scanner, alive_test, 10);
+  usleep (500000);
 
   sleep (WAIT_FOR_REPLIES_TIMEOUT);
 
@@ -32,6 +32,7 @@
 #include <netinet/ip6.h>
 #include <netinet/ip_icmp.h>
 #include <netinet/tcp.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
@@ -45,26 +46,42 @@
  */
 #define G_LOG_DOMAIN "libgvm boreas"
 
-struct v6pseudohdr
-{
-  struct in6_addr s6addr;
-  struct in6_addr d6addr;
-  u_short length;
-  u_char zero1;
-  u_char zero2;
-  u_char zero3;
-  u_char protocol;
-  struct tcphdr tcpheader;
-};
+/* Length of icmp pings: ICMP header and 56 bytes of data. */
+#define ICMP_PING_LEN (8 + 56)
+/* Length of tcp pings: IP header and TCP header without options. */
+#define TCP_PING_V4_LEN (sizeof (struct ip) + sizeof (struct tcphdr))
+#define TCP_PING_V6_LEN (sizeof (struct ip6_hdr) + sizeof (struct tcphdr))
+
+/* Number of hosts by which the probes of a method trail those of the
+ * previous method. At the maximum rate of BURST probes per BURST_TIMEOUT this
+ * lets about PROBE_REPLY_WAIT pass between the probes to a host. */
+#define PROBE_LAG BURST
+/* Minimum time in microseconds between two probes to the same host, so that
+ * a reply to the first can arrive before the second is sent. */
+#define PROBE_REPLY_WAIT BURST_TIMEOUT
+/* Time in microseconds between two progress reports of the sender threads. */
+#define PROBE_PROGRESS_INTERVAL 100000
+
+/* send_arp_v4() works on global libnet state and must not be called by
+ * several sender threads at once. */
+static pthread_mutex_t arp_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-struct pseudohdr
+/**
+ * @brief Shard of the target hosts handled by a single sender thread.
+ */
+struct sender_shard
 {
-  struct in_addr saddr;
-  struct in_addr daddr;
-  u_char zero;
-  u_char protocol;
-  u_short length;
-  struct tcphdr tcpheader;
+  /* Copy of the scanner with its own sockets and rate limits. */
+  scanner_t scanner;
+  /* Keys and values of all target hosts. */
+  GPtrArray *keys;
+  GPtrArray *values;
+  /* Index range [start, end) of the target hosts of this shard. */
+  guint start;
+  guint end;
+  /* Counters shared by all shards. */
+  gint *hosts_done;
+  gint *threads_done;
 };
 
 /**
@@ -89,6 +106,51 @@ get_so_sndbuf (int soc, int *so_sndbuf)
   return 0;
 }
 
+/**
+ * @brief Kinds of sockets whose send buffer size is cached per thread.
+ */
+enum sndbuf_socket
+{
+  SNDBUF_ICMPV4,
+  SNDBUF_ICMPV6,
+  SNDBUF_TCPV4,
+  SNDBUF_TCPV6,
+  SNDBUF_SOCKETS
+};
+
+/* Send buffer sizes of the sockets of a sender thread, -1 if unknown. Every
+ * sender thread has its own sockets, so the sizes are kept per thread. */
+static GPrivate thread_so_sndbufs = G_PRIVATE_INIT (g_free);
+
+/**
+ * @brief Get the cached size of the send buffer of a socket of this thread.
+ *
+ * @param soc   The socket.
+ * @param kind  Kind of the socket.
+ *
+ * @return The size of the send buffer, -1 if it could not be determined.
+ */
+static int
+thread_so_sndbuf (int soc, enum sndbuf_socket kind)
+{
+  int *so_sndbufs;
+
+  so_sndbufs = g_private_get (&thread_so_sndbufs);
+  if (so_sndbufs == NULL)
+    {
+      so_sndbufs = g_malloc_n (SNDBUF_SOCKETS, sizeof (int));
+      for (int i = 0; i < SNDBUF_SOCKETS; i++)
+        so_sndbufs[i] = -1;
+      g_private_set (&thread_so_sndbufs, so_sndbufs);
+    }
+
+  /* Get size of empty SO_SNDBUF */
+  if (so_sndbufs[kind] == -1)
+    get_so_sndbuf (soc, &so_sndbufs[kind]);
+
+  return so_sndbufs[kind];
+}
+
 /**
  * @brief Wait until output queue is small enough for sending new packets.
  *
@@ -134,6 +196,44 @@ throttle (int soc, int so_sndbuf)
   return;
 }
 
+/**
+ * @brief Get the precomputed icmp ping of the given type.
+ *
+ * The ICMPv6 checksum is always computed by the kernel.
+ *
+ * @param type  Type of imcp. e.g. ND_NEIGHBOR_SOLICIT or ICMP6_ECHO_REQUEST.
+ *
+ * @return ICMPv6 packet of ICMP_PING_LEN bytes.
+ */
+static const u_char *
+icmp_template_v6 (int type)
+{
+  static u_char echo_request[ICMP_PING_LEN];
+  static u_char neighbor_solicit[ICMP_PING_LEN];
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      u_char *templates[] = {echo_request, neighbor_solicit};
+      int types[] = {ICMP6_ECHO_REQUEST, ND_NEIGHBOR_SOLICIT};
+
+      for (int i = 0; i < 2; i++)
+        {
+          struct icmp6_hdr *icmp6 = (struct icmp6_hdr *) templates[i];
+
+          memset (templates[i], 0xa5, ICMP_PING_LEN);
+          icmp6->icmp6_type = types[i];
+          icmp6->icmp6_code = 0;
+          icmp6->icmp6_cksum = 0;
+          icmp6->icmp6_id = 234;
+          icmp6->icmp6_seq = 0;
+        }
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return type == ND_NEIGHBOR_SOLICIT ? neighbor_solicit : echo_request;
+}
+
 /**
  * @brief Send icmp ping.
  *
@@ -145,47 +245,54 @@ static void
 send_icmp_v6 (int soc, struct in6_addr *dst, int type)
 {
   struct sockaddr_in6 soca;
-  char sendbuf[1500];
-  int len;
-  int datalen = 56;
-  struct icmp6_hdr *icmp6;
-
-  /* Throttling related variables */
-  static int so_sndbuf = -1; // socket send buffer
-  static int init = -1;
-
-  icmp6 = (struct icmp6_hdr *) sendbuf;
-  icmp6->icmp6_type = type; /* ND_NEIGHBOR_SOLICIT or ICMP6_ECHO_REQUEST */
-  icmp6->icmp6_code = 0;
-  icmp6->icmp6_id = 234;
-  icmp6->icmp6_seq = 0;
-
-  memset ((icmp6 + 1), 0xa5, datalen);
-  gettimeofday ((struct timeval *) (icmp6 + 1), NULL); // only for testing
-  len = 8 + datalen;
 
   /* send packet */
   memset (&soca, 0, sizeof (struct sockaddr_in6));
   soca.sin6_family = AF_INET6;
   soca.sin6_addr = *dst;
 
-  /* Get size of empty SO_SNDBUF */
-  if (init == -1)
-    {
-      if (get_so_sndbuf (soc, &so_sndbuf) == 0)
-        init = 1;
-    }
   /* Throttle speed if needed */
-  throttle (soc, so_sndbuf);
+  throttle (soc, thread_so_sndbuf (soc, SNDBUF_ICMPV6));
 
-  if (sendto (soc, sendbuf, len, MSG_NOSIGNAL, (struct sockaddr *) &soca,
-              sizeof (struct sockaddr_in6))
+  if (sendto (soc, icmp_template_v6 (type), ICMP_PING_LEN, MSG_NOSIGNAL,
+              (struct sockaddr *) &soca, sizeof (struct sockaddr_in6))
       < 0)
     {
       g_warning ("%s: sendto(): %s", __func__, strerror (errno));
     }
 }
 
+/**
+ * @brief Get the precomputed icmp echo request.
+ *
+ * The packet does not depend on the destination, so its checksum is only
+ * computed once.
+ *
+ * @return ICMP packet of ICMP_PING_LEN bytes.
+ */
+static const u_char *
+icmp_template_v4 (void)
+{
+  static u_char echo_request[ICMP_PING_LEN];
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      struct icmphdr *icmp = (struct icmphdr *) echo_request;
+
+      memset (echo_request, 0xa5, ICMP_PING_LEN);
+      icmp->type = ICMP_ECHO;
+      icmp->code = 0;
+      icmp->un.echo.id = 0;
+      icmp->un.echo.sequence = 0;
+      icmp->checksum = 0;
+      icmp->checksum = in_cksum ((uint16_t *) icmp, ICMP_PING_LEN);
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return echo_request;
+}
+
 /**
  * @brief Send icmp ping.
  *
@@ -195,41 +302,17 @@ send_icmp_v6 (int soc, struct in6_addr *dst, int type)
 static void
 send_icmp_v4 (int soc, struct in_addr *dst)
 {
-  /* datalen + MAXIPLEN + MAXICMPLEN */
-  char sendbuf[56 + 60 + 76];
   struct sockaddr_in soca;
 
-  int len;
-  int datalen = 56;
-  struct icmphdr *icmp;
-
-  /* Throttling related variables */
-  static int so_sndbuf = -1; // socket send buffer
-  static int init = -1;
-
-  icmp = (struct icmphdr *) sendbuf;
-  icmp->type = ICMP_ECHO;
-  icmp->code = 0;
-
-  len = 8 + datalen;
-  icmp->checksum = 0;
-  icmp->checksum = in_cksum ((u_short *) icmp, len);
-
   memset (&soca, 0, sizeof (soca));
   soca.sin_family = AF_INET;
   soca.sin_addr = *dst;
 
-  /* Get size of empty SO_SNDBUF */
-  if (init == -1)
-    {
-      if (get_so_sndbuf (soc, &so_sndbuf) == 0)
-        init = 1;
-    }
   /* Throttle speed if needed */
-  throttle (soc, so_sndbuf);
+  throttle (soc, thread_so_sndbuf (soc, SNDBUF_ICMPV4));
 
-  if (sendto (soc, sendbuf, len, MSG_NOSIGNAL, (const struct sockaddr *) &soca,
-              sizeof (struct sockaddr_in))
+  if (sendto (soc, icmp_template_v4 (), ICMP_PING_LEN, MSG_NOSIGNAL,
+              (const struct sockaddr *) &soca, sizeof (struct sockaddr_in))
       < 0)
     {
       g_warning ("%s: sendto(): %s", __func__, strerror (errno));
@@ -237,33 +320,21 @@ send_icmp_v4 (int soc, struct in_addr *dst)
 }
 
 /**
- * @brief Is called in g_hash_table_foreach(). Check if ipv6 or ipv4, get
- * correct socket and start appropriate ping function.
+ * @brief Check if ipv6 or ipv4, get correct socket and start appropriate icmp
+ * ping function.
  *
- * @param key Ip string.
- * @param value Pointer to gvm_host_t.
- * @param scanner_p Pointer to scanner struct.
+ * @param scanner Pointer to scanner struct.
+ * @param host Host to ping.
  */
-void
-send_icmp (gpointer key, gpointer value, gpointer scanner_p)
+static void
+icmp_probe (scanner_t *scanner, gvm_host_t *host)
 {
-  scanner_t *scanner;
   struct in6_addr dst6;
   struct in6_addr *dst6_p = &dst6;
   struct in_addr dst4;
   struct in_addr *dst4_p = &dst4;
-  static int count = 0;
-
-  scanner = (scanner_t *) scanner_p;
-
-  if (g_hash_table_contains (scanner->hosts_data->alivehosts, key))
-    return;
 
-  count++;
-  if (count % BURST == 0)
-    usleep (BURST_TIMEOUT);
-
-  if (gvm_host_get_addr6 ((gvm_host_t *) value, dst6_p) < 0)
+  if (gvm_host_get_addr6 (host, dst6_p) < 0)
     g_warning ("%s: could not get addr6 from gvm_host_t", __func__);
   if (dst6_p == NULL)
     {
@@ -282,11 +353,99 @@ send_icmp (gpointer key, gpointer value, gpointer scanner_p)
 }
 
 /**
- * @brief Send tcp ping.
+ * @brief Is called in g_hash_table_foreach(). Check if ipv6 or ipv4, get
+ * correct socket and start appropriate ping function.
+ *
+ * @param key Ip string.
+ * @param value Pointer to gvm_host_t.
+ * @param scanner_p Pointer to scanner struct.
+ */
+void
+send_icmp (gpointer key, gpointer value, gpointer scanner_p)
+{
+  scanner_t *scanner;
+  static int count = 0;
+
+  scanner = (scanner_t *) scanner_p;
+
+  if (alive_set_contains (scanner->hosts_data->alive_set, key))
+    return;
+
+  count++;
+  if (count % BURST == 0)
+    usleep (BURST_TIMEOUT);
+
+  icmp_probe (scanner, (gvm_host_t *) value);
+}
+
+/**
+ * @brief Get the precomputed tcp ping with the given flag.
+ *
+ * Source and destination address and port are zero. The TCP checksum covers
+ * the pseudo header and is updated incrementally for the actual values.
  *
- * @param soc Socket to use for sending.
- * @param dst Destination address to send to.
  * @param tcp_flag  TH_SYN or TH_ACK.
+ *
+ * @return IPv6 packet of TCP_PING_V6_LEN bytes.
+ */
+static const u_char *
+tcp_template_v6 (uint8_t tcp_flag)
+{
+  static u_char syn[TCP_PING_V6_LEN];
+  static u_char ack[TCP_PING_V6_LEN];
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      u_char *templates[] = {syn, ack};
+      uint8_t flags[] = {TH_SYN, TH_ACK};
+
+      for (int i = 0; i < 2; i++)
+        {
+          struct ip6_hdr *ip = (struct ip6_hdr *) templates[i];
+          struct tcphdr *tcp =
+            (struct tcphdr *) (templates[i] + sizeof (struct ip6_hdr));
+          uint64_t sum;
+
+          memset (templates[i], 0, TCP_PING_V6_LEN);
+          /* IPv6 */
+          ip->ip6_flow = htonl ((6 << 28) | (0 << 20) | 0);
+          ip->ip6_plen = htons (20); // TCP_HDRLEN
+          ip->ip6_nxt = IPPROTO_TCP;
+          ip->ip6_hops = 255; // max value
+
+          /* TCP */
+          tcp->th_sport = htons (FILTER_PORT);
+          tcp->th_seq = htonl (0);
+          tcp->th_ack = htonl (0);
+          tcp->th_x2 = 0;
+          tcp->th_off = 20 / 4; // TCP_HDRLEN / 4 (size of tcphdr in 32 bit
+                                // words)
+          tcp->th_flags = flags[i]; // TH_SYN or TH_ACK
+          tcp->th_win = htons (65535);
+          tcp->th_urp = htons (0);
+          tcp->th_sum = 0;
+
+          /* Pseudo header without addresses: upper-layer packet length and
+           * next header. */
+          sum = htons (sizeof (struct tcphdr)) + htons (IPPROTO_TCP);
+          sum = in_cksum_add (sum, tcp, sizeof (struct tcphdr));
+          tcp->th_sum = ~in_cksum_fold (sum);
+        }
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return tcp_flag == TH_ACK ? ack : syn;
+}
+
+/**
+ * @brief Send tcp ping.
+ *
+ * The packet is copied from a template. Only the checksum of the changed
+ * addresses and ports is updated.
+ *
+ * @param scanner Scanner struct which includes all needed data for tcp_v6 ping.
+ * @param dst_p Destination address to send to.
  */
 static void
 send_tcp_v6 (scanner_t *scanner, struct in6_addr *dst_p)
@@ -294,17 +453,14 @@ send_tcp_v6 (scanner_t *scanner, struct in6_addr *dst_p)
   boreas_error_t error;
   struct sockaddr_in6 soca;
   struct in6_addr src;
-
-  /* Throttling related variables */
-  static int so_sndbuf = -1; // socket send buffer
-  static int init = -1;
+  struct in6_addr no_addr[2] = {IN6ADDR_ANY_INIT, IN6ADDR_ANY_INIT};
 
   GArray *ports = scanner->ports;
   int *udpv6soc = &(scanner->udpv6soc);
   int soc = scanner->tcpv6soc;
   uint8_t tcp_flag = scanner->tcp_flag;
 
-  u_char packet[sizeof (struct ip6_hdr) + sizeof (struct tcphdr)];
+  u_char packet[TCP_PING_V6_LEN];
   struct ip6_hdr *ip = (struct ip6_hdr *) packet;
   struct tcphdr *tcp = (struct tcphdr *) (packet + sizeof (struct ip6_hdr));
 
@@ -324,62 +480,31 @@ send_tcp_v6 (scanner_t *scanner, struct in6_addr *dst_p)
   if (ports->len == 0)
     return;
 
+  /* Source and destination address are adjacent in the IPv6 header. */
+  memcpy (packet, tcp_template_v6 (tcp_flag), sizeof (packet));
+  ip->ip6_src = src;
+  ip->ip6_dst = *dst_p;
+  tcp->th_sum = in_cksum_update (tcp->th_sum, no_addr, &ip->ip6_src,
+                                 2 * sizeof (struct in6_addr));
+
+  memset (&soca, 0, sizeof (soca));
+  soca.sin6_family = AF_INET6;
+  soca.sin6_addr = ip->ip6_dst;
+
   /* For ports in ports array send packet. */
   for (guint i = 0; i < ports->len; i++)
     {
-      memset (packet, 0, sizeof (packet));
-      /* IPv6 */
-      ip->ip6_flow = htonl ((6 << 28) | (0 << 20) | 0);
-      ip->ip6_plen = htons (20); // TCP_HDRLEN
-      ip->ip6_nxt = IPPROTO_TCP;
-      ip->ip6_hops = 255; // max value
-
-      ip->ip6_src = src;
-      ip->ip6_dst = *dst_p;
-
-      /* TCP */
-      tcp->th_sport = htons (FILTER_PORT);
-      tcp->th_dport = htons (g_array_index (ports, uint16_t, i));
-      tcp->th_seq = htonl (0);
-      tcp->th_ack = htonl (0);
-      tcp->th_x2 = 0;
-      tcp->th_off = 20 / 4; // TCP_HDRLEN / 4 (size of tcphdr in 32 bit words)
-      tcp->th_flags = tcp_flag; // TH_SYN or TH_ACK
-      tcp->th_win = htons (65535);
-      tcp->th_urp = htons (0);
-      tcp->th_sum = 0;
-
-      /* CKsum */
-      {
-        struct v6pseudohdr pseudoheader;
-
-        memset (&pseudoheader, 0, 38 + sizeof (struct tcphdr));
-        memcpy (&pseudoheader.s6addr, &ip->ip6_src, sizeof (struct in6_addr));
-        memcpy (&pseudoheader.d6addr, &ip->ip6_dst, sizeof (struct in6_addr));
-
-        pseudoheader.protocol = IPPROTO_TCP;
-        pseudoheader.length = htons (sizeof (struct tcphdr));
-        memcpy ((char *) &pseudoheader.tcpheader, (char *) tcp,
-                sizeof (struct tcphdr));
-        tcp->th_sum = in_cksum ((unsigned short *) &pseudoheader,
-                                38 + sizeof (struct tcphdr));
-      }
+      uint16_t dport = htons (g_array_index (ports, uint16_t, i));
 
-      memset (&soca, 0, sizeof (soca));
-      soca.sin6_family = AF_INET6;
-      soca.sin6_addr = ip->ip6_dst;
+      tcp->th_sum = in_cksum_update (tcp->th_sum, &tcp->th_dport, &dport,
+                                     sizeof (dport));
+      tcp->th_dport = dport;
 
-      /* Get size of empty SO_SNDBUF */
-      if (init == -1)
-        {
-          if (get_so_sndbuf (soc, &so_sndbuf) == 0)
-            init = 1;
-        }
       /* Throttle speed if needed */
-      throttle (soc, so_sndbuf);
+      throttle (soc, thread_so_sndbuf (soc, SNDBUF_TCPV6));
 
       /*  TCP_HDRLEN(20) IP6_HDRLEN(40) */
-      if (sendto (soc, (const void *) ip, 40 + 20, MSG_NOSIGNAL,
+      if (sendto (soc, (const void *) ip, TCP_PING_V6_LEN, MSG_NOSIGNAL,
                   (struct sockaddr *) &soca, sizeof (struct sockaddr_in6))
           < 0)
         {
@@ -388,9 +513,73 @@ send_tcp_v6 (scanner_t *scanner, struct in6_addr *dst_p)
     }
 }
 
+/**
+ * @brief Get the precomputed tcp ping with the given flag.
+ *
+ * Source and destination address, port and sequence number are zero. The TCP
+ * checksum covers the pseudo header and is updated incrementally for the
+ * actual values. The IP checksum is always computed by the kernel.
+ *
+ * @param tcp_flag  TH_SYN or TH_ACK.
+ *
+ * @return IPv4 packet of TCP_PING_V4_LEN bytes.
+ */
+static const u_char *
+tcp_template_v4 (uint8_t tcp_flag)
+{
+  static u_char syn[TCP_PING_V4_LEN];
+  static u_char ack[TCP_PING_V4_LEN];
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      u_char *templates[] = {syn, ack};
+      uint8_t flags[] = {TH_SYN, TH_ACK};
+
+      for (int i = 0; i < 2; i++)
+        {
+          struct ip *ip = (struct ip *) templates[i];
+          struct tcphdr *tcp =
+            (struct tcphdr *) (templates[i] + sizeof (struct ip));
+          uint64_t sum;
+
+          memset (templates[i], 0, TCP_PING_V4_LEN);
+          /* IP */
+          ip->ip_hl = 5;
+          ip->ip_off = htons (0);
+          ip->ip_v = 4;
+          ip->ip_tos = 0;
+          ip->ip_p = IPPROTO_TCP;
+          ip->ip_ttl = 0x40;
+          ip->ip_sum = 0;
+
+          /* TCP */
+          tcp->th_sport = htons (FILTER_PORT);
+          tcp->th_flags = flags[i]; // TH_SYN TH_ACK;
+          tcp->th_ack = 0;
+          tcp->th_x2 = 0;
+          tcp->th_off = 5;
+          tcp->th_win = 2048;
+          tcp->th_urp = 0;
+          tcp->th_sum = 0;
+
+          /* Pseudo header without addresses: protocol and TCP length. */
+          sum = htons (IPPROTO_TCP) + htons (sizeof (struct tcphdr));
+          sum = in_cksum_add (sum, tcp, sizeof (struct tcphdr));
+          tcp->th_sum = ~in_cksum_fold (sum);
+        }
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return tcp_flag == TH_ACK ? ack : syn;
+}
+
 /**
  * @brief Send tcp ping.
  *
+ * The packet is copied from a template. Only the checksum of the changed
+ * addresses, ports and sequence numbers is updated.
+ *
  * @param scanner Scanner struct which includes all needed data for tcp_v4 ping.
  * @param dst Destination address to send to.
  */
@@ -400,17 +589,14 @@ send_tcp_v4 (scanner_t *scanner, struct in_addr *dst_p)
   boreas_error_t error;
   struct sockaddr_in soca;
   struct in_addr src;
-
-  /* Throttling related variables */
-  static int so_sndbuf = -1; // socket send buffer
-  static int init = -1;
+  struct in_addr no_addr[2] = {{0}, {0}};
 
   int soc = scanner->tcpv4soc;          /* Socket used for sending. */
   GArray *ports = scanner->ports;       /* Ports to ping. */
   int *udpv4soc = &(scanner->udpv4soc); /* Socket used for getting src addr */
   uint8_t tcp_flag = scanner->tcp_flag; /* SYN or ACK tcp flag. */
 
-  u_char packet[sizeof (struct ip) + sizeof (struct tcphdr)];
+  u_char packet[TCP_PING_V4_LEN];
   struct ip *ip = (struct ip *) packet;
   struct tcphdr *tcp = (struct tcphdr *) (packet + sizeof (struct ip));
 
@@ -429,67 +615,35 @@ send_tcp_v4 (scanner_t *scanner, struct in_addr *dst_p)
       return;
     }
 
+  /* Source and destination address are adjacent in the IP header. */
+  memcpy (packet, tcp_template_v4 (tcp_flag), sizeof (packet));
+  ip->ip_src = src;
+  ip->ip_dst = *dst_p;
+  tcp->th_sum = in_cksum_update (tcp->th_sum, no_addr, &ip->ip_src,
+                                 2 * sizeof (struct in_addr));
+
+  memset (&soca, 0, sizeof (soca));
+  soca.sin_family = AF_INET;
+  soca.sin_addr = ip->ip_dst;
+
   /* For ports in ports array send packet. */
   for (guint i = 0; i < ports->len; i++)
     {
-      memset (packet, 0, sizeof (packet));
-      /* IP */
-      ip->ip_hl = 5;
-      ip->ip_off = htons (0);
-      ip->ip_v = 4;
-      ip->ip_tos = 0;
-      ip->ip_p = IPPROTO_TCP;
+      uint16_t dport = htons (g_array_index (ports, uint16_t, i));
+      tcp_seq seq = rand ();
+
+      tcp->th_sum = in_cksum_update (tcp->th_sum, &tcp->th_dport, &dport,
+                                     sizeof (dport));
+      tcp->th_dport = dport;
+      tcp->th_sum =
+        in_cksum_update (tcp->th_sum, &tcp->th_seq, &seq, sizeof (seq));
+      tcp->th_seq = seq;
       ip->ip_id = rand ();
-      ip->ip_ttl = 0x40;
-      ip->ip_src = src;
-      ip->ip_dst = *dst_p;
-      ip->ip_sum = 0;
-
-      /* TCP */
-      tcp->th_sport = htons (FILTER_PORT);
-      tcp->th_flags = tcp_flag; // TH_SYN TH_ACK;
-      tcp->th_dport = htons (g_array_index (ports, uint16_t, i));
-      tcp->th_seq = rand ();
-      tcp->th_ack = 0;
-      tcp->th_x2 = 0;
-      tcp->th_off = 5;
-      tcp->th_win = 2048;
-      tcp->th_urp = 0;
-      tcp->th_sum = 0;
-
-      /* CKsum */
-      {
-        struct in_addr source, dest;
-        struct pseudohdr pseudoheader;
-        source.s_addr = ip->ip_src.s_addr;
-        dest.s_addr = ip->ip_dst.s_addr;
-
-        memset (&pseudoheader, 0, 12 + sizeof (struct tcphdr));
-        pseudoheader.saddr.s_addr = source.s_addr;
-        pseudoheader.daddr.s_addr = dest.s_addr;
-
-        pseudoheader.protocol = IPPROTO_TCP;
-        pseudoheader.length = htons (sizeof (struct tcphdr));
-        memcpy ((char *) &pseudoheader.tcpheader, (char *) tcp,
-                sizeof (struct tcphdr));
-        tcp->th_sum = in_cksum ((unsigned short *) &pseudoheader,
-                                12 + sizeof (struct tcphdr));
-      }
 
-      memset (&soca, 0, sizeof (soca));
-      soca.sin_family = AF_INET;
-      soca.sin_addr = ip->ip_dst;
-
-      /* Get size of empty SO_SNDBUF */
-      if (init == -1)
-        {
-          if (get_so_sndbuf (soc, &so_sndbuf) == 0)
-            init = 1;
-        }
       /* Throttle speed if needed */
-      throttle (soc, so_sndbuf);
+      throttle (soc, thread_so_sndbuf (soc, SNDBUF_TCPV4));
 
-      if (sendto (soc, (const void *) ip, 40, MSG_NOSIGNAL,
+      if (sendto (soc, (const void *) ip, TCP_PING_V4_LEN, MSG_NOSIGNAL,
                   (struct sockaddr *) &soca, sizeof (soca))
           < 0)
         {
@@ -499,33 +653,20 @@ send_tcp_v4 (scanner_t *scanner, struct in_addr *dst_p)
 }
 
 /**
- * @brief Is called in g_hash_table_foreach(). Check if ipv6 or ipv4, get
- * correct socket and start appropriate ping function.
+ * @brief Check if ipv6 or ipv4 and start appropriate tcp ping function.
  *
- * @param key Ip string.
- * @param value Pointer to gvm_host_t.
- * @param scanner_p Pointer to scanner struct.
+ * @param scanner Pointer to scanner struct.
+ * @param host Host to ping.
  */
-void
-send_tcp (gpointer key, gpointer value, gpointer scanner_p)
+static void
+tcp_probe (scanner_t *scanner, gvm_host_t *host)
 {
-  scanner_t *scanner;
   struct in6_addr dst6;
   struct in6_addr *dst6_p = &dst6;
   struct in_addr dst4;
   struct in_addr *dst4_p = &dst4;
-  static int count = 0;
-
-  scanner = (scanner_t *) scanner_p;
-
-  if (g_hash_table_contains (scanner->hosts_data->alivehosts, key))
-    return;
 
-  count++;
-  if (count % BURST == 0)
-    usleep (BURST_TIMEOUT);
-
-  if (gvm_host_get_addr6 ((gvm_host_t *) value, dst6_p) < 0)
+  if (gvm_host_get_addr6 (host, dst6_p) < 0)
     g_warning ("%s: could not get addr6 from gvm_host_t", __func__);
   if (dst6_p == NULL)
     {
@@ -547,28 +688,43 @@ send_tcp (gpointer key, gpointer value, gpointer scanner_p)
  * @brief Is called in g_hash_table_foreach(). Check if ipv6 or ipv4, get
  * correct socket and start appropriate ping function.
  *
- * @param host_value_str Ip string.
+ * @param key Ip string.
  * @param value Pointer to gvm_host_t.
  * @param scanner_p Pointer to scanner struct.
  */
 void
-send_arp (gpointer host_value_str, gpointer value, gpointer scanner_p)
+send_tcp (gpointer key, gpointer value, gpointer scanner_p)
 {
   scanner_t *scanner;
-  struct in6_addr dst6;
-  struct in6_addr *dst6_p = &dst6;
   static int count = 0;
 
   scanner = (scanner_t *) scanner_p;
 
-  if (g_hash_table_contains (scanner->hosts_data->alivehosts, host_value_str))
+  if (alive_set_contains (scanner->hosts_data->alive_set, key))
     return;
 
   count++;
   if (count % BURST == 0)
     usleep (BURST_TIMEOUT);
 
-  if (gvm_host_get_addr6 ((gvm_host_t *) value, dst6_p) < 0)
+  tcp_probe (scanner, (gvm_host_t *) value);
+}
+
+/**
+ * @brief Check if ipv6 or ipv4, get correct socket and start appropriate arp
+ * ping function.
+ *
+ * @param scanner Pointer to scanner struct.
+ * @param host_value_str Ip string.
+ * @param host Host to ping.
+ */
+static void
+arp_probe (scanner_t *scanner, gpointer host_value_str, gvm_host_t *host)
+{
+  struct in6_addr dst6;
+  struct in6_addr *dst6_p = &dst6;
+
+  if (gvm_host_get_addr6 (host, dst6_p) < 0)
     g_warning ("%s: could not get addr6 from gvm_host_t", __func__);
   if (dst6_p == NULL)
     {
@@ -595,6 +751,368 @@ send_arp (gpointer host_value_str, gpointer value, gpointer scanner_p)
           g_warning ("%s: Error: %s. Skipping ARP ping for '%s'", __func__,
                      strerror (errno), (char *) host_value_str);
         }
+      pthread_mutex_lock (&arp_mutex);
       send_arp_v4 (ipv4_str);
+      pthread_mutex_unlock (&arp_mutex);
+    }
+}
+
+/**
+ * @brief Is called in g_hash_table_foreach(). Check if ipv6 or ipv4, get
+ * correct socket and start appropriate ping function.
+ *
+ * @param host_value_str Ip string.
+ * @param value Pointer to gvm_host_t.
+ * @param scanner_p Pointer to scanner struct.
+ */
+void
+send_arp (gpointer host_value_str, gpointer value, gpointer scanner_p)
+{
+  scanner_t *scanner;
+  static int count = 0;
+
+  scanner = (scanner_t *) scanner_p;
+
+  if (alive_set_contains (scanner->hosts_data->alive_set, host_value_str))
+    return;
+
+  count++;
+  if (count % BURST == 0)
+    usleep (BURST_TIMEOUT);
+
+  arp_probe (scanner, host_value_str, (gvm_host_t *) value);
+}
+
+/**
+ * @brief Wait until another probe of a method may be sent.
+ *
+ * At most BURST probes are sent per BURST_TIMEOUT window. The windows of the
+ * different methods are independent, so that interleaving the methods does
+ * not multiply the time spent waiting.
+ *
+ * @param rate_limit Rate limiting state of the probe method.
+ */
+static void
+wait_for_probe_slot (probe_rate_limit_t *rate_limit)
+{
+  gint64 elapsed;
+
+  if (BURST <= 0)
+    return;
+
+  if (rate_limit->window_start == 0)
+    rate_limit->window_start = g_get_monotonic_time ();
+
+  if (rate_limit->sent < BURST)
+    {
+      rate_limit->sent++;
+      return;
+    }
+
+  elapsed = g_get_monotonic_time () - rate_limit->window_start;
+  if (elapsed < BURST_TIMEOUT)
+    usleep (BURST_TIMEOUT - elapsed);
+
+  rate_limit->window_start = g_get_monotonic_time ();
+  rate_limit->sent = 1;
+}
+
+/**
+ * @brief Send the probe of a single method to a host.
+ *
+ * @param scanner Pointer to scanner struct.
+ * @param method  Alive test method of the probe.
+ * @param key     Ip string.
+ * @param host    Host to ping.
+ */
+static void
+send_probe (scanner_t *scanner, alive_test_t method, gpointer key,
+            gvm_host_t *host)
+{
+  switch (method)
+    {
+    case ALIVE_TEST_ICMP:
+      wait_for_probe_slot (&scanner->icmp_rate_limit);
+      icmp_probe (scanner, host);
+      break;
+    case ALIVE_TEST_TCP_SYN_SERVICE:
+      wait_for_probe_slot (&scanner->tcp_syn_rate_limit);
+      scanner->tcp_flag = TH_SYN;
+      tcp_probe (scanner, host);
+      break;
+    case ALIVE_TEST_TCP_ACK_SERVICE:
+      wait_for_probe_slot (&scanner->tcp_ack_rate_limit);
+      scanner->tcp_flag = TH_ACK;
+      tcp_probe (scanner, host);
+      break;
+    case ALIVE_TEST_ARP:
+      wait_for_probe_slot (&scanner->arp_rate_limit);
+      arp_probe (scanner, key, host);
+      break;
+    default:
+      break;
+    }
+}
+
+/**
+ * @brief Send the probes of all methods set in scanner->alive_test to a range
+ * of target hosts.
+ *
+ * The methods are pipelined in a single pass over the hosts: every method
+ * trails the previous one by PROBE_LAG hosts, and a host gets its next probe
+ * no earlier than PROBE_REPLY_WAIT after its previous one. Replies to earlier
+ * probes thus have time to arrive, and the remaining probes of hosts that are
+ * alive by then are skipped.
+ *
+ * Only the hosts between the first and the last stage need their send time,
+ * so the times are kept in a ring of (n_stages - 1) * PROBE_LAG + 1 slots
+ * indexed by host position.
+ *
+ * @param scanner     Pointer to scanner struct.
+ * @param keys        Ip strings of all target hosts.
+ * @param values      gvm_host_t of all target hosts.
+ * @param start       Index of the first host of the range.
+ * @param end         Index after the last host of the range.
+ * @param hosts_done  Counter incremented for every host reached by the first
+ *                    stage, or NULL.
+ */
+static void
+send_probes_range (scanner_t *scanner, GPtrArray *keys, GPtrArray *values,
+                   guint start, guint end, gint *hosts_done)
+{
+  alive_test_t methods[] = {ALIVE_TEST_ICMP, ALIVE_TEST_TCP_SYN_SERVICE,
+                            ALIVE_TEST_TCP_ACK_SERVICE, ALIVE_TEST_ARP};
+  alive_test_t stages[G_N_ELEMENTS (methods)];
+  alive_set_t *alive_set;
+  guint n_stages, count, ring_size;
+  gint64 *sent_at;
+
+  n_stages = 0;
+  for (guint i = 0; i < G_N_ELEMENTS (methods); i++)
+    if (scanner->alive_test & methods[i])
+      stages[n_stages++] = methods[i];
+  count = end > start ? end - start : 0;
+  if (n_stages == 0 || count == 0)
+    return;
+
+  alive_set = scanner->hosts_data->alive_set;
+  /* Time of the last probe sent to each host in flight, 0 if none. */
+  ring_size = (n_stages - 1) * PROBE_LAG + 1;
+  sent_at = g_malloc0_n (ring_size, sizeof (gint64));
+  for (guint step = 0; step < count + (n_stages - 1) * PROBE_LAG; step++)
+    for (guint stage = 0; stage < n_stages && step >= stage * PROBE_LAG;
+         stage++)
+      {
+        guint index = step - stage * PROBE_LAG;
+        guint slot = index % ring_size;
+        gpointer key;
+
+        if (index >= count)
+          continue;
+        /* The first stage takes over the slot of a host that is done. */
+        if (stage == 0)
+          {
+            sent_at[slot] = 0;
+            if (hosts_done)
+              g_atomic_int_inc (hosts_done);
+          }
+        key = g_ptr_array_index (keys, start + index);
+        if (alive_set_contains (alive_set, key))
+          continue;
+
+        if (sent_at[slot])
+          {
+            gint64 wait;
+
+            wait = sent_at[slot] + PROBE_REPLY_WAIT - g_get_monotonic_time ();
+            if (wait > 0)
+              {
+                usleep (wait);
+                if (alive_set_contains (alive_set, key))
+                  continue;
+              }
+          }
+
+        send_probe (scanner, stages[stage], key,
+                    g_ptr_array_index (values, start + index));
+        sent_at[slot] = g_get_monotonic_time ();
+      }
+  g_free (sent_at);
+}
+
+/**
+ * @brief Collect the target hosts of a scanner in two parallel arrays.
+ *
+ * @param[in]   scanner Pointer to scanner struct.
+ * @param[out]  keys    Ip strings of the target hosts.
+ * @param[out]  values  gvm_host_t of the target hosts.
+ */
+static void
+target_hosts_arrays (scanner_t *scanner, GPtrArray **keys, GPtrArray **values)
+{
+  GHashTableIter target_hosts_iter;
+  gpointer key, value;
+  guint number_of_targets;
+
+  number_of_targets = g_hash_table_size (scanner->hosts_data->targethosts);
+  *keys = g_ptr_array_sized_new (number_of_targets);
+  *values = g_ptr_array_sized_new (number_of_targets);
+  for (g_hash_table_iter_init (&target_hosts_iter,
+                               scanner->hosts_data->targethosts);
+       g_hash_table_iter_next (&target_hosts_iter, &key, &value);)
+    {
+      g_ptr_array_add (*keys, key);
+      g_ptr_array_add (*values, value);
+    }
+}
+
+/**
+ * @brief Send the probes of all methods set in scanner->alive_test to all
+ * target hosts, with the sockets of the scanner.
+ *
+ * See send_probes_range() for the order of the probes. The sniffer thread
+ * must be running, so that hosts are marked alive while probes are sent.
+ *
+ * @param scanner Pointer to scanner struct.
+ */
+void
+send_probes (scanner_t *scanner)
+{
+  GPtrArray *keys, *values;
+
+  target_hosts_arrays (scanner, &keys, &values);
+  send_probes_range (scanner, keys, values, 0, keys->len, NULL);
+  g_ptr_array_free (keys, TRUE);
+  g_ptr_array_free (values, TRUE);
+}
+
+/**
+ * @brief Send all probes to the target hosts of a single shard.
+ *
+ * @param shard_p Pointer to sender_shard struct.
+ */
+static void *
+sender_thread (void *shard_p)
+{
+  struct sender_shard *shard = (struct sender_shard *) shard_p;
+
+  send_probes_range (&shard->scanner, shard->keys, shard->values, shard->start,
+                     shard->end, shard->hosts_done);
+  wait_until_all_so_sndbuf_empty (&shard->scanner, shard->scanner.alive_test,
+                                  10);
+  g_atomic_int_inc (shard->threads_done);
+
+  return NULL;
+}
+
+/**
+ * @brief Send the probes of all methods set in scanner->alive_test to all
+ * target hosts, sharded across several sender threads.
+ *
+ * The target hosts are split into contiguous index ranges. Every sender thread
+ * gets its own raw sockets and rate limits. Replies are still processed by the
+ * single sniffer thread, so alive hosts are handled exactly as in the single
+ * threaded case. Blocks until all sender threads are finished.
+ *
+ * While the sender threads run, progress is called every
+ * PROBE_PROGRESS_INTERVAL with the number of hosts handled by all of them.
+ *
+ * @param scanner       Pointer to scanner struct.
+ * @param n_threads     Number of sender threads to use.
+ * @param progress      Function called with the progress, or NULL.
+ * @param progress_data Data passed to progress.
+ *
+ * @return 0 on success, boreas_error_t on error.
+ */
+boreas_error_t
+send_probes_sharded (scanner_t *scanner, int n_threads,
+                     probe_progress_t progress, gpointer progress_data)
+{
+  GPtrArray *keys, *values;
+  struct sender_shard *shards;
+  pthread_t *thread_ids;
+  gboolean *thread_started;
+  guint number_of_targets;
+  boreas_error_t error;
+  gint hosts_done, threads_done;
+  int n_started;
+
+  number_of_targets = g_hash_table_size (scanner->hosts_data->targethosts);
+  if (n_threads > (int) number_of_targets)
+    n_threads = number_of_targets;
+  if (n_threads < 1)
+    return NO_ERROR;
+
+  target_hosts_arrays (scanner, &keys, &values);
+
+  error = NO_ERROR;
+  hosts_done = 0;
+  threads_done = 0;
+  n_started = 0;
+  shards = g_malloc0_n (n_threads, sizeof (struct sender_shard));
+  thread_ids = g_malloc0_n (n_threads, sizeof (pthread_t));
+  thread_started = g_malloc0_n (n_threads, sizeof (gboolean));
+  for (int i = 0; i < n_threads; i++)
+    {
+      struct sender_shard *shard = &shards[i];
+
+      shard->scanner = *scanner;
+      memset (&shard->scanner.icmp_rate_limit, 0, sizeof (probe_rate_limit_t));
+      memset (&shard->scanner.tcp_syn_rate_limit, 0,
+              sizeof (probe_rate_limit_t));
+      memset (&shard->scanner.tcp_ack_rate_limit, 0,
+              sizeof (probe_rate_limit_t));
+      memset (&shard->scanner.arp_rate_limit, 0, sizeof (probe_rate_limit_t));
+      shard->keys = keys;
+      shard->values = values;
+      shard->start = (guint) ((guint64) number_of_targets * i / n_threads);
+      shard->end = (guint) ((guint64) number_of_targets * (i + 1) / n_threads);
+      shard->hosts_done = &hosts_done;
+      shard->threads_done = &threads_done;
+
+      if ((error = set_all_needed_sockets (&shard->scanner,
+                                           scanner->alive_test))
+          != 0)
+        {
+          g_warning ("%s: Could not open sockets for sender thread %d. %s",
+                     __func__, i, str_boreas_error (error));
+          break;
+        }
+      if (pthread_create (&thread_ids[i], NULL, sender_thread, shard) != 0)
+        {
+          g_warning ("%s: pthread_create() failed for sender thread %d.",
+                     __func__, i);
+          close_all_needed_sockets (&shard->scanner, scanner->alive_test);
+          error = BOREAS_OPENING_SOCKET_FAILED;
+          break;
+        }
+      thread_started[i] = TRUE;
+      n_started++;
     }
+
+  if (progress)
+    {
+      while (g_atomic_int_get (&threads_done) < n_started)
+        {
+          progress (g_atomic_int_get (&hosts_done), progress_data);
+          usleep (PROBE_PROGRESS_INTERVAL);
+        }
+      progress (g_atomic_int_get (&hosts_done), progress_data);
+    }
+
+  for (int i = 0; i < n_threads; i++)
+    {
+      if (!thread_started[i])
+        continue;
+      pthread_join (thread_ids[i], NULL);
+      close_all_needed_sockets (&shards[i].scanner, scanner->alive_test);
+    }
+
+  g_free (thread_started);
+  g_free (thread_ids);
+  g_free (shards);
+  g_ptr_array_free (keys, TRUE);
+  g_ptr_array_free (values, TRUE);
+
+  return error;
 }
@@ -20,6 +20,9 @@
 #ifndef BOREAS_PING_H
 #define BOREAS_PING_H
 
+#include "alivedetection.h"
+#include "boreas_error.h"
+
 #include <glib.h>
 
 void send_icmp (gpointer, gpointer, gpointer);
@@ -28,4 +31,12 @@ void send_tcp (gpointer, gpointer, gpointer);
 
 void send_arp (gpointer, gpointer, gpointer);
 
+void send_probes (scanner_t *);
+
+/* Called with the number of target hosts handled so far. */
+typedef void (*probe_progress_t) (int, gpointer);
+
+boreas_error_t
+send_probes_sharded (scanner_t *, int, probe_progress_t, gpointer);
+
 #endif /* not BOREAS_PING_H */
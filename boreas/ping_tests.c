@@ -19,6 +19,7 @@
 
 #include "ping.c"
 
+#include <arpa/inet.h>
 #include <cgreen/cgreen.h>
 #include <cgreen/mocks.h>
 
@@ -35,6 +36,172 @@ Ensure (ping, dummy_test)
   assert_that (0, is_equal_to (0));
 }
 
+Ensure (ping, wait_for_probe_slot_limits_burst)
+{
+  probe_rate_limit_t rate_limit = {0};
+  gint64 start;
+
+  /* The first BURST probes of a window are sent without waiting. */
+  for (int i = 0; i < BURST; i++)
+    wait_for_probe_slot (&rate_limit);
+  assert_that (rate_limit.sent, is_equal_to (BURST));
+
+  /* The next probe waits for the window to expire and opens a new one. */
+  start = rate_limit.window_start;
+  wait_for_probe_slot (&rate_limit);
+  assert_that (rate_limit.sent, is_equal_to (1));
+  assert_that (rate_limit.window_start - start,
+               is_greater_than (BURST_TIMEOUT - 1));
+}
+
+/* Sockets and state used by __wrap_sendto in the send_probes tests. */
+static int test_icmp_soc = -1;
+static int test_tcp_soc = -1;
+static alive_set_t *test_alive_set;
+static const gchar *test_replying_host;
+static GHashTable *test_tcp_probes;
+static int test_icmp_probes;
+
+int
+__wrap_sendto (int sockfd, const void *buf, size_t len, int flags,
+               const struct sockaddr *dest_addr, socklen_t addrlen)
+{
+  char addr_str[INET_ADDRSTRLEN];
+
+  (void) buf;
+  (void) flags;
+  (void) addrlen;
+  inet_ntop (AF_INET, &((const struct sockaddr_in *) dest_addr)->sin_addr,
+             addr_str, sizeof (addr_str));
+
+  if (sockfd == test_icmp_soc)
+    {
+      test_icmp_probes++;
+      /* The reply arrives before the next probe to the host is due, however
+       * slow the machine is. */
+      if (test_replying_host && g_str_equal (addr_str, test_replying_host))
+        alive_set_add (test_alive_set, (gpointer) test_replying_host);
+    }
+  else if (sockfd == test_tcp_soc)
+    {
+      int count;
+
+      count = GPOINTER_TO_INT (g_hash_table_lookup (test_tcp_probes, addr_str));
+      g_hash_table_insert (test_tcp_probes, g_strdup (addr_str),
+                           GINT_TO_POINTER (count + 1));
+    }
+
+  return len;
+}
+
+/**
+ * @brief Set up a scanner for ICMP and TCP-SYN probes to some hosts.
+ *
+ * @param scanner     Scanner.
+ * @param hosts_data  Hosts data of the scanner.
+ * @param addrs       Ip strings of the target hosts.
+ * @param n_addrs     Number of target hosts.
+ */
+static void
+setup_probe_scanner (scanner_t *scanner, hosts_data_t *hosts_data,
+                     gchar **addrs, guint n_addrs)
+{
+  uint16_t port = 80;
+
+  hosts_data->targethosts =
+    g_hash_table_new_full (g_str_hash, g_str_equal, NULL, gvm_host_free);
+  for (guint i = 0; i < n_addrs; i++)
+    g_hash_table_insert (hosts_data->targethosts, addrs[i],
+                         gvm_host_from_str (addrs[i]));
+  hosts_data->alive_set = alive_set_new (n_addrs);
+
+  scanner->hosts_data = hosts_data;
+  scanner->alive_test = ALIVE_TEST_ICMP | ALIVE_TEST_TCP_SYN_SERVICE;
+  scanner->ports = g_array_new (FALSE, TRUE, sizeof (uint16_t));
+  g_array_append_val (scanner->ports, port);
+  /* Real sockets for the throttling ioctls. Nothing is sent on them. */
+  scanner->icmpv4soc = socket (AF_INET, SOCK_DGRAM, 0);
+  scanner->tcpv4soc = socket (AF_INET, SOCK_DGRAM, 0);
+  scanner->udpv4soc = socket (AF_INET, SOCK_DGRAM, 0);
+
+  test_icmp_soc = scanner->icmpv4soc;
+  test_tcp_soc = scanner->tcpv4soc;
+  test_alive_set = hosts_data->alive_set;
+  test_replying_host = NULL;
+  test_tcp_probes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           NULL);
+  test_icmp_probes = 0;
+}
+
+/**
+ * @brief Free a scanner set up by setup_probe_scanner.
+ *
+ * @param scanner     Scanner.
+ * @param hosts_data  Hosts data of the scanner.
+ */
+static void
+teardown_probe_scanner (scanner_t *scanner, hosts_data_t *hosts_data)
+{
+  test_icmp_soc = test_tcp_soc = -1;
+  close (scanner->icmpv4soc);
+  close (scanner->tcpv4soc);
+  close (scanner->udpv4soc);
+  g_array_free (scanner->ports, TRUE);
+  g_hash_table_destroy (test_tcp_probes);
+  g_hash_table_destroy (hosts_data->targethosts);
+  alive_set_free (hosts_data->alive_set);
+}
+
+Ensure (ping, send_probes_skips_hosts_alive_by_earlier_reply)
+{
+  gchar *addrs[] = {"127.0.0.1", "127.0.0.2", "127.0.0.3"};
+  scanner_t scanner = {0};
+  hosts_data_t hosts_data = {0};
+
+  setup_probe_scanner (&scanner, &hosts_data, addrs, G_N_ELEMENTS (addrs));
+  test_replying_host = "127.0.0.2";
+
+  send_probes (&scanner);
+
+  /* The TCP-SYN probe of the replying host was skipped, as its reply arrived
+   * before the probe was due. */
+  assert_that (test_icmp_probes, is_equal_to (3));
+  assert_that (g_hash_table_lookup (test_tcp_probes, "127.0.0.1"),
+               is_equal_to (GINT_TO_POINTER (1)));
+  assert_that (g_hash_table_lookup (test_tcp_probes, "127.0.0.2"), is_null);
+  assert_that (g_hash_table_lookup (test_tcp_probes, "127.0.0.3"),
+               is_equal_to (GINT_TO_POINTER (1)));
+
+  teardown_probe_scanner (&scanner, &hosts_data);
+}
+
+Ensure (ping, send_probes_probes_each_host_once_per_method)
+{
+  /* More hosts than the ring of send times has slots. */
+  gchar *addrs[2 * PROBE_LAG + 50];
+  scanner_t scanner = {0};
+  hosts_data_t hosts_data = {0};
+  GHashTableIter iter;
+  gpointer value;
+
+  for (guint i = 0; i < G_N_ELEMENTS (addrs); i++)
+    addrs[i] = g_strdup_printf ("127.0.%u.%u", i / 200, i % 200 + 1);
+  setup_probe_scanner (&scanner, &hosts_data, addrs, G_N_ELEMENTS (addrs));
+
+  send_probes (&scanner);
+
+  assert_that (test_icmp_probes, is_equal_to (G_N_ELEMENTS (addrs)));
+  assert_that (g_hash_table_size (test_tcp_probes),
+               is_equal_to (G_N_ELEMENTS (addrs)));
+  g_hash_table_iter_init (&iter, test_tcp_probes);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    assert_that (value, is_equal_to (GINT_TO_POINTER (1)));
+
+  teardown_probe_scanner (&scanner, &hosts_data);
+  for (guint i = 0; i < G_N_ELEMENTS (addrs); i++)
+    g_free (addrs[i]);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -43,6 +210,11 @@ main (int argc, char **argv)
   suite = create_test_suite ();
 
   add_test_with_context (suite, ping, dummy_test);
+  add_test_with_context (suite, ping, wait_for_probe_slot_limits_burst);
+  add_test_with_context (suite, ping,
+                         send_probes_skips_hosts_alive_by_earlier_reply);
+  add_test_with_context (suite, ping,
+                         send_probes_probes_each_host_once_per_method);
 
   if (argc > 1)
     return run_single_test (suite, argv[1], create_text_reporter ());
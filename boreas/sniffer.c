@@ -21,6 +21,7 @@
 
 #include "alivedetection.h"
 #include "boreas_io.h"
+#include "util.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
@@ -157,6 +158,7 @@ got_packet (u_char *user_data,
        * evaluation to not add hosts to the hash table which are not in our
        * target list.*/
       if ((g_hash_table_contains (hosts_data->targethosts, addr_str) == TRUE)
+          && alive_set_add (hosts_data->alive_set, addr_str)
           && (g_hash_table_add (hosts_data->alivehosts, g_strdup (addr_str))))
         {
           /* handle max_scan_hosts related restrictions. */
@@ -179,6 +181,7 @@ got_packet (u_char *user_data,
        * evaluation to not add hosts to the hash table which are not in our
        * target list.*/
       if ((g_hash_table_contains (hosts_data->targethosts, addr_str) == TRUE)
+          && alive_set_add (hosts_data->alive_set, addr_str)
           && (g_hash_table_add (hosts_data->alivehosts, g_strdup (addr_str))))
         {
           /* handle max_scan_hosts related restrictions. */
@@ -207,6 +210,7 @@ got_packet (u_char *user_data,
        * evaluation to not add hosts to the hash table which are not in our
        * target list.*/
       if ((g_hash_table_contains (hosts_data->targethosts, addr_str) == TRUE)
+          && alive_set_add (hosts_data->alive_set, addr_str)
           && (g_hash_table_add (hosts_data->alivehosts, g_strdup (addr_str))))
         {
           /* handle max_scan_hosts related restrictions. */
@@ -44,42 +44,122 @@ static boreas_error_t
 set_socket (socket_type_t, int *);
 
 /**
- * @brief Checksum calculation.
+ * @brief Fixed size open addressing hash set of alive host address strings.
  *
- * From W.Richard Stevens "UNIX NETWORK PROGRAMMING" book. libfree/in_cksum.c
- * TODO: Section 8.7 of TCPv2 has more efficient implementation
- **/
-uint16_t
-in_cksum (uint16_t *addr, int len)
+ * Entries are only ever added, never removed. Slots are claimed with an atomic
+ * compare-and-exchange, so the set can be queried and extended concurrently
+ * without locking.
+ */
+struct alive_set
+{
+  guint size;    /* Number of slots. Always a power of two. */
+  gchar **slots; /* Address strings, NULL for empty slots. */
+};
+
+/**
+ * @brief Add a buffer to a partial internet checksum.
+ *
+ * The buffer is summed up in 32 bit words into a 64 bit accumulator. Carries
+ * are only folded once in in_cksum_fold(), so the loop has no dependency
+ * between iterations besides the addition and can be vectorised by the
+ * compiler. As the one's complement sum is independent of byte order and of
+ * the word size used for summing, partial sums of several buffers can simply
+ * be added up, e.g. for a pseudo header followed by a TCP header.
+ *
+ * Only the last buffer added to a sum may have an odd length.
+ *
+ * @param sum Partial sum to add to. 0 for a new sum.
+ * @param buf Buffer to add.
+ * @param len Length of the buffer in bytes.
+ *
+ * @return The new partial sum.
+ */
+uint64_t
+in_cksum_add (uint64_t sum, const void *buf, int len)
 {
-  int nleft = len;
-  uint32_t sum = 0;
-  uint16_t *w = addr;
-  uint16_t answer = 0;
-
-  /*
-   * Our algorithm is simple, using a 32 bit accumulator (sum), we add
-   * sequential 16 bit words to it, and at the end, fold back all the
-   * carry bits from the top 16 bits into the lower 16 bits.
-   */
-  while (nleft > 1)
+  const uint8_t *p = buf;
+  uint32_t word32;
+  uint16_t word16;
+
+  for (; len >= 4; len -= 4, p += 4)
     {
-      sum += *w++;
-      nleft -= 2;
+      memcpy (&word32, p, 4);
+      sum += word32;
+    }
+  if (len >= 2)
+    {
+      memcpy (&word16, p, 2);
+      sum += word16;
+      len -= 2;
+      p += 2;
     }
-
   /* mop up an odd byte, if necessary */
-  if (nleft == 1)
+  if (len == 1)
     {
-      *(unsigned char *) (&answer) = *(unsigned char *) w;
-      sum += answer;
+      word16 = 0;
+      *(uint8_t *) &word16 = *p;
+      sum += word16;
     }
 
-  /* add back carry outs from top 16 bits to low 16 bits */
-  sum = (sum >> 16) + (sum & 0xffff); /* add hi 16 to low 16 */
-  sum += (sum >> 16);                 /* add carry */
-  answer = ~sum;                      /* truncate to 16 bits */
-  return (answer);
+  return sum;
+}
+
+/**
+ * @brief Fold a partial internet checksum into 16 bits.
+ *
+ * @param sum Partial sum as returned by in_cksum_add().
+ *
+ * @return The one's complement sum. The checksum is its complement.
+ */
+uint16_t
+in_cksum_fold (uint64_t sum)
+{
+  sum = (sum >> 32) + (sum & 0xffffffff);
+  sum = (sum >> 32) + (sum & 0xffffffff);
+  sum = (sum >> 16) + (sum & 0xffff);
+  sum = (sum >> 16) + (sum & 0xffff);
+  sum = (sum >> 16) + (sum & 0xffff);
+  return sum;
+}
+
+/**
+ * @brief Checksum calculation.
+ *
+ * @param addr Buffer to compute the checksum of.
+ * @param len Length of the buffer in bytes.
+ *
+ * @return The internet checksum of the buffer.
+ **/
+uint16_t
+in_cksum (uint16_t *addr, int len)
+{
+  return ~in_cksum_fold (in_cksum_add (0, addr, len));
+}
+
+/**
+ * @brief Update a checksum for a changed part of the checksummed data.
+ *
+ * Incremental update as described in RFC 1624, eqn. 3:
+ * HC' = ~(~HC + ~m + m'). Its cost only depends on the size of the changed
+ * part and not on the size of the whole packet.
+ *
+ * @param cksum Checksum of the data before the change.
+ * @param old   Old content of the changed part.
+ * @param new   New content of the changed part.
+ * @param len   Length of the changed part in bytes. Must be even.
+ *
+ * @return Checksum of the data after the change.
+ */
+uint16_t
+in_cksum_update (uint16_t cksum, const void *old, const void *new, int len)
+{
+  uint64_t sum;
+
+  sum = (uint16_t) ~cksum;
+  sum += (uint16_t) ~in_cksum_fold (in_cksum_add (0, old, len));
+  sum = in_cksum_add (sum, new, len);
+
+  return ~in_cksum_fold (sum);
 }
 
 /**
@@ -586,6 +666,114 @@ set_all_needed_sockets (scanner_t *scanner, alive_test_t alive_test)
   return error;
 }
 
+/**
+ * @brief Create a new alive set.
+ *
+ * @param capacity  Maximum number of hosts which will be added to the set.
+ *
+ * @return New alive set. Free with alive_set_free().
+ */
+alive_set_t *
+alive_set_new (guint capacity)
+{
+  alive_set_t *set;
+
+  set = g_malloc0 (sizeof (alive_set_t));
+  /* Keep the load factor at or below 0.5 for short probe sequences. */
+  set->size = 16;
+  while (set->size < capacity * 2)
+    set->size <<= 1;
+  set->slots = g_malloc0_n (set->size, sizeof (gchar *));
+
+  return set;
+}
+
+/**
+ * @brief Free an alive set and all address strings in it.
+ *
+ * @param set  Alive set to free.
+ */
+void
+alive_set_free (alive_set_t *set)
+{
+  if (set == NULL)
+    return;
+
+  for (guint i = 0; i < set->size; i++)
+    g_free (set->slots[i]);
+  g_free (set->slots);
+  g_free (set);
+}
+
+/**
+ * @brief Add a host to the alive set.
+ *
+ * @param set       Alive set.
+ * @param addr_str  IP addr in str representation.
+ *
+ * @return TRUE if the host was newly added, FALSE if it was already in the set
+ * or the set is full.
+ */
+gboolean
+alive_set_add (alive_set_t *set, const gchar *addr_str)
+{
+  guint mask, index;
+  gchar *new_addr_str = NULL;
+
+  mask = set->size - 1;
+  index = g_str_hash (addr_str) & mask;
+  for (guint probes = 0; probes < set->size;
+       probes++, index = (index + 1) & mask)
+    {
+      gchar *slot = g_atomic_pointer_get (&set->slots[index]);
+
+      if (slot == NULL)
+        {
+          if (new_addr_str == NULL)
+            new_addr_str = g_strdup (addr_str);
+          if (g_atomic_pointer_compare_and_exchange (&set->slots[index], NULL,
+                                                     new_addr_str))
+            return TRUE;
+          /* Another thread claimed the slot in the meantime. */
+          slot = g_atomic_pointer_get (&set->slots[index]);
+        }
+      if (g_str_equal (slot, addr_str))
+        break;
+    }
+
+  g_free (new_addr_str);
+  return FALSE;
+}
+
+/**
+ * @brief Check if a host is in the alive set.
+ *
+ * @param set       Alive set.
+ * @param addr_str  IP addr in str representation.
+ *
+ * @return TRUE if the host is in the set, else FALSE.
+ */
+gboolean
+alive_set_contains (alive_set_t *set, const gchar *addr_str)
+{
+  guint mask, index;
+
+  mask = set->size - 1;
+  index = g_str_hash (addr_str) & mask;
+  for (guint probes = 0; probes < set->size;
+       probes++, index = (index + 1) & mask)
+    {
+      gchar *slot = g_atomic_pointer_get (&set->slots[index]);
+
+      if (slot == NULL)
+        return FALSE;
+      if (g_str_equal (slot, addr_str))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 /**
  * @brief Subtract two hashtables and count the remaining elements.
  *
@@ -657,3 +845,33 @@ wait_until_so_sndbuf_empty (int soc, int timeout)
       usleep (100000);
     }
 }
+
+/**
+ * @brief Wait until the send buffers of all sockets used by the chosen
+ * detection methods are empty or timeout reached.
+ *
+ * @param scanner     Reference to scanner struct.
+ * @param alive_test  Methods of alive detection to use provided as bitflag.
+ * @param timeout     Timeout in seconds per socket.
+ */
+void
+wait_until_all_so_sndbuf_empty (scanner_t *scanner, alive_test_t alive_test,
+                                int timeout)
+{
+  if (alive_test & ALIVE_TEST_ICMP)
+    {
+      wait_until_so_sndbuf_empty (scanner->icmpv4soc, timeout);
+      wait_until_so_sndbuf_empty (scanner->icmpv6soc, timeout);
+    }
+  if ((alive_test & ALIVE_TEST_TCP_ACK_SERVICE)
+      || (alive_test & ALIVE_TEST_TCP_SYN_SERVICE))
+    {
+      wait_until_so_sndbuf_empty (scanner->tcpv4soc, timeout);
+      wait_until_so_sndbuf_empty (scanner->tcpv6soc, timeout);
+    }
+  if (alive_test & ALIVE_TEST_ARP)
+    {
+      wait_until_so_sndbuf_empty (scanner->arpv4soc, timeout);
+      wait_until_so_sndbuf_empty (scanner->arpv6soc, timeout);
+    }
+}
@@ -25,9 +25,18 @@
 
 #include <stdint.h>
 
+uint64_t
+in_cksum_add (uint64_t, const void *, int);
+
+uint16_t
+in_cksum_fold (uint64_t);
+
 uint16_t
 in_cksum (uint16_t *addr, int len);
 
+uint16_t
+in_cksum_update (uint16_t, const void *, const void *, int);
+
 int
 get_source_mac_addr (char *, uint8_t *);
 
@@ -48,9 +57,26 @@ close_all_needed_sockets (scanner_t *, alive_test_t);
 void
 wait_until_so_sndbuf_empty (int, int);
 
+void
+wait_until_all_so_sndbuf_empty (scanner_t *, alive_test_t, int);
+
 /* Misc hashtable functions. */
 
 int
 count_difference (GHashTable *, GHashTable *);
 
+/* Lock-free alive set functions. */
+
+alive_set_t *
+alive_set_new (guint);
+
+void
+alive_set_free (alive_set_t *);
+
+gboolean
+alive_set_add (alive_set_t *, const gchar *);
+
+gboolean
+alive_set_contains (alive_set_t *, const gchar *);
+
 #endif /* not BOREAS_UTIL_H */
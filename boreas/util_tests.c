@@ -211,6 +211,58 @@ Ensure (util, fill_ports_array)
   g_array_free (ports_garray, TRUE);
 }
 
+Ensure (util, alive_set)
+{
+  alive_set_t *set;
+  gchar addr_str[INET_ADDRSTRLEN];
+
+  set = alive_set_new (300);
+  assert_that (alive_set_contains (set, "192.168.0.1"), is_false);
+
+  /* Hosts are only added once. */
+  assert_that (alive_set_add (set, "192.168.0.1"), is_true);
+  assert_that (alive_set_add (set, "192.168.0.1"), is_false);
+  assert_that (alive_set_contains (set, "192.168.0.1"), is_true);
+
+  /* Fill the set up to its capacity. */
+  for (int i = 2; i <= 300; i++)
+    {
+      g_snprintf (addr_str, sizeof (addr_str), "192.168.%d.%d", i / 256,
+                  i % 256);
+      assert_that (alive_set_add (set, addr_str), is_true);
+    }
+  assert_that (alive_set_contains (set, "192.168.1.44"), is_true);
+  assert_that (alive_set_contains (set, "10.0.0.1"), is_false);
+
+  alive_set_free (set);
+}
+
+Ensure (util, in_cksum_update)
+{
+  uint8_t data[61];
+  uint16_t cksum, expected;
+  uint32_t new_addr = htonl (0xc0a80001);
+  uint16_t new_port = htons (443);
+
+  for (guint i = 0; i < sizeof (data); i++)
+    data[i] = i * 7;
+
+  /* Odd length and partial sums. */
+  expected = in_cksum ((uint16_t *) data, sizeof (data));
+  assert_that (~in_cksum_fold (in_cksum_add (in_cksum_add (0, data, 20),
+                                             data + 20, sizeof (data) - 20))
+                 & 0xffff,
+               is_equal_to (expected));
+
+  /* Incremental update matches full recomputation. */
+  cksum = in_cksum ((uint16_t *) data, 40);
+  cksum = in_cksum_update (cksum, data + 12, &new_addr, sizeof (new_addr));
+  memcpy (data + 12, &new_addr, sizeof (new_addr));
+  cksum = in_cksum_update (cksum, data + 22, &new_port, sizeof (new_port));
+  memcpy (data + 22, &new_port, sizeof (new_port));
+  assert_that (cksum, is_equal_to (in_cksum ((uint16_t *) data, 40)));
+}
+
 int
 main (int argc, char **argv)
 {
@@ -223,6 +275,8 @@ main (int argc, char **argv)
   add_test_with_context (suite, util, set_socket);
   add_test_with_context (suite, util, get_source_addr_v4);
   add_test_with_context (suite, util, get_source_addr_v6);
+  add_test_with_context (suite, util, alive_set);
+  add_test_with_context (suite, util, in_cksum_update);
 
   if (argc > 1)
     return run_single_test (suite, argv[1], create_text_reporter ());
@@ -530,6 +530,27 @@ gmp_authenticate_info_ext_c (gvm_connection_t *connection,
   return 2;
 }
 
+/**
+ * @brief Append a scanner preference of a new task to a GMP request.
+ *
+ * @param[in,out]  request  Request.
+ * @param[in]      name     Name of the preference.
+ * @param[in]      value    Value of the preference.  Nothing is appended if
+ *                          this is NULL.
+ */
+static void
+append_task_preference (GString *request, const char *name, const char *value)
+{
+  if (value == NULL)
+    return;
+
+  g_string_append (request, "<preference><scanner_name>");
+  g_string_append (request, name);
+  g_string_append (request, "</scanner_name><value>");
+  xml_string_append_text (request, value, -1);
+  g_string_append (request, "</value></preference>");
+}
+
 /**
  * @brief Create a task.
  *
@@ -549,125 +570,65 @@ gmp_create_task_ext (gnutls_session_t *session, gmp_create_task_opts_t opts,
 {
   /* Create the GMP request. */
 
-  gchar *prefs, *start, *hosts_ordering, *scanner, *schedule, *slave;
-  GString *alerts, *observers;
+  GString *request;
   int ret;
   if ((opts.config_id == NULL) || (opts.target_id == NULL))
     return -1;
 
-  prefs = NULL;
-  start = g_markup_printf_escaped (
-    "<create_task>"
-    "<config id=\"%s\"/>"
-    "<target id=\"%s\"/>"
-    "<name>%s</name>"
-    "<comment>%s</comment>"
-    "<alterable>%d</alterable>",
-    opts.config_id, opts.target_id, opts.name ? opts.name : "unnamed",
-    opts.comment ? opts.comment : "", opts.alterable ? 1 : 0);
+  request = g_string_sized_new (1024);
+  g_string_append (request, "<create_task><config id=\"");
+  xml_string_append_text (request, opts.config_id, -1);
+  g_string_append (request, "\"/><target id=\"");
+  xml_string_append_text (request, opts.target_id, -1);
+  g_string_append (request, "\"/><name>");
+  xml_string_append_text (request, opts.name ? opts.name : "unnamed", -1);
+  g_string_append (request, "</name><comment>");
+  xml_string_append_text (request, opts.comment, -1);
+  g_string_append_printf (request, "</comment><alterable>%d</alterable>",
+                          opts.alterable ? 1 : 0);
+
+  if (opts.max_checks || opts.max_hosts || opts.in_assets || opts.source_iface)
+    {
+      g_string_append (request, "<preferences>");
+      append_task_preference (request, "in_assets", opts.in_assets);
+      append_task_preference (request, "max_checks", opts.max_checks);
+      append_task_preference (request, "max_hosts", opts.max_hosts);
+      append_task_preference (request, "source_iface", opts.source_iface);
+      g_string_append (request, "</preferences>");
+    }
 
   if (opts.hosts_ordering)
-    hosts_ordering = g_strdup_printf ("<hosts_ordering>%s</hosts_ordering>",
-                                      opts.hosts_ordering);
-  else
-    hosts_ordering = NULL;
+    g_string_append_printf (request, "<hosts_ordering>%s</hosts_ordering>",
+                            opts.hosts_ordering);
 
   if (opts.scanner_id)
-    scanner = g_strdup_printf ("<scanner id=\"%s\"/>", opts.scanner_id);
-  else
-    scanner = NULL;
+    g_string_append_printf (request, "<scanner id=\"%s\"/>", opts.scanner_id);
 
   if (opts.schedule_id)
-    schedule = g_strdup_printf ("<schedule id=\"%s\"/>"
-                                "<schedule_periods>%d</schedule_periods>",
-                                opts.schedule_id, opts.schedule_periods);
-  else
-    schedule = NULL;
+    g_string_append_printf (request,
+                            "<schedule id=\"%s\"/>"
+                            "<schedule_periods>%d</schedule_periods>",
+                            opts.schedule_id, opts.schedule_periods);
 
   if (opts.slave_id)
-    slave = g_strdup_printf ("<slave id=\"%s\"/>", opts.slave_id);
-  else
-    slave = NULL;
-
-  if (opts.max_checks || opts.max_hosts || opts.in_assets || opts.source_iface)
-    {
-      gchar *in_assets, *checks, *hosts, *source_iface;
-
-      in_assets = checks = hosts = source_iface = NULL;
-
-      if (opts.in_assets)
-        in_assets = g_markup_printf_escaped ("<preference>"
-                                             "<scanner_name>"
-                                             "in_assets"
-                                             "</scanner_name>"
-                                             "<value>"
-                                             "%s"
-                                             "</value>"
-                                             "</preference>",
-                                             opts.in_assets);
-
-      if (opts.max_hosts)
-        hosts = g_markup_printf_escaped ("<preference>"
-                                         "<scanner_name>"
-                                         "max_hosts"
-                                         "</scanner_name>"
-                                         "<value>"
-                                         "%s"
-                                         "</value>"
-                                         "</preference>",
-                                         opts.max_hosts);
-
-      if (opts.max_checks)
-        checks = g_markup_printf_escaped ("<preference>"
-                                          "<scanner_name>"
-                                          "max_checks"
-                                          "</scanner_name>"
-                                          "<value>"
-                                          "%s"
-                                          "</value>"
-                                          "</preference>",
-                                          opts.max_checks);
-
-      if (opts.source_iface)
-        source_iface = g_markup_printf_escaped ("<preference>"
-                                                "<scanner_name>"
-                                                "source_iface"
-                                                "</scanner_name>"
-                                                "<value>"
-                                                "%s"
-                                                "</value>"
-                                                "</preference>",
-                                                opts.source_iface);
-
-      prefs =
-        g_strdup_printf ("<preferences>%s%s%s%s</preferences>",
-                         in_assets ? in_assets : "", checks ? checks : "",
-                         hosts ? hosts : "", source_iface ? source_iface : "");
-      g_free (in_assets);
-      g_free (checks);
-      g_free (hosts);
-      g_free (source_iface);
-    }
+    g_string_append_printf (request, "<slave id=\"%s\"/>", opts.slave_id);
 
   if (opts.alert_ids)
     {
       unsigned int i;
-      alerts = g_string_new ("");
       for (i = 0; i < opts.alert_ids->len; i++)
         {
           char *alert = (char *) g_ptr_array_index (opts.alert_ids, i);
-          g_string_append_printf (alerts, "<alert id=\"%s\"/>", alert);
+          g_string_append_printf (request, "<alert id=\"%s\"/>", alert);
         }
     }
-  else
-    alerts = g_string_new ("");
 
   if (opts.observers || opts.observer_groups)
     {
-      observers = g_string_new ("<observers>");
+      g_string_append (request, "<observers>");
 
       if (opts.observers)
-        g_string_append (observers, opts.observers);
+        g_string_append (request, opts.observers);
 
       if (opts.observer_groups)
         {
@@ -676,28 +637,17 @@ gmp_create_task_ext (gnutls_session_t *session, gmp_create_task_opts_t opts,
             {
               char *group =
                 (char *) g_ptr_array_index (opts.observer_groups, i);
-              g_string_append_printf (observers, "<group id=\"%s\"/>", group);
+              g_string_append_printf (request, "<group id=\"%s\"/>", group);
             }
         }
-      g_string_append (observers, "</observers>");
+      g_string_append (request, "</observers>");
     }
-  else
-    observers = g_string_new ("");
+
+  g_string_append (request, "</create_task>");
 
   /* Send the request. */
-  ret = gvm_server_sendf (
-    session, "%s%s%s%s%s%s%s%s</create_task>", start, prefs ? prefs : "",
-    hosts_ordering ? hosts_ordering : "", scanner ? scanner : "",
-    schedule ? schedule : "", slave ? slave : "", alerts ? alerts->str : "",
-    observers ? observers->str : "");
-  g_free (start);
-  g_free (prefs);
-  g_free (hosts_ordering);
-  g_free (scanner);
-  g_free (schedule);
-  g_free (slave);
-  g_string_free (alerts, TRUE);
-  g_string_free (observers, TRUE);
+  ret = gvm_server_send (session, request->str, request->len);
+  g_string_free (request, TRUE);
 
   if (ret)
     return -1;
@@ -1380,6 +1330,61 @@ gmp_get_targets (gnutls_session_t *session, const char *id, int tasks,
   return gmp_check_response (session, target);
 }
 
+/**
+ * @brief Build a get_reports command.
+ *
+ * @param[in]  opts  Struct containing the options to apply.
+ *
+ * @return Newly allocated command.
+ */
+static gchar *
+get_report_command (gmp_get_report_opts_t opts)
+{
+  return g_strdup_printf (
+    "<get_reports"
+    " details=\"1\""
+    " report_id=\"%s\""
+    " format_id=\"%s\""
+    " host_first_result=\"%i\""
+    " host_max_results=\"%i\""
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s"
+    "%s%s%s%s%s%s%s/>",
+    opts.report_id, opts.format_id, opts.host_first_result,
+    opts.host_max_results, GMP_FMT_STRING_ATTRIB (opts, type),
+    GMP_FMT_STRING_ATTRIB (opts, filter),
+    GMP_FMT_STRING_ATTRIB (opts, filt_id),
+    GMP_FMT_STRING_ATTRIB (opts, host), GMP_FMT_STRING_ATTRIB (opts, pos),
+    GMP_FMT_STRING_ATTRIB (opts, timezone),
+    GMP_FMT_STRING_ATTRIB (opts, alert_id),
+    GMP_FMT_STRING_ATTRIB (opts, delta_report_id),
+    GMP_FMT_STRING_ATTRIB (opts, delta_states),
+    GMP_FMT_STRING_ATTRIB (opts, host_levels),
+    GMP_FMT_STRING_ATTRIB (opts, search_phrase),
+    GMP_FMT_STRING_ATTRIB (opts, host_search_phrase),
+    GMP_FMT_STRING_ATTRIB (opts, min_cvss_base),
+    GMP_FMT_STRING_ATTRIB (opts, min_qod),
+    GMP_FMT_BOOL_ATTRIB (opts, notes),
+    GMP_FMT_BOOL_ATTRIB (opts, notes_details),
+    GMP_FMT_BOOL_ATTRIB (opts, overrides),
+    GMP_FMT_BOOL_ATTRIB (opts, override_details),
+    GMP_FMT_BOOL_ATTRIB (opts, apply_overrides),
+    GMP_FMT_BOOL_ATTRIB (opts, result_hosts_only),
+    GMP_FMT_BOOL_ATTRIB (opts, ignore_pagination));
+}
+
 /**
  * @brief Get a report (generic version).
  *
@@ -1398,54 +1403,15 @@ gmp_get_report_ext (gnutls_session_t *session, gmp_get_report_opts_t opts,
 {
   int ret;
   const char *status_code;
+  gchar *command;
 
   if (response == NULL)
     return -1;
 
-  if (gvm_server_sendf (
-        session,
-        "<get_reports"
-        " details=\"1\""
-        " report_id=\"%s\""
-        " format_id=\"%s\""
-        " host_first_result=\"%i\""
-        " host_max_results=\"%i\""
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s"
-        "%s%s%s%s%s%s%s/>",
-        opts.report_id, opts.format_id, opts.host_first_result,
-        opts.host_max_results, GMP_FMT_STRING_ATTRIB (opts, type),
-        GMP_FMT_STRING_ATTRIB (opts, filter),
-        GMP_FMT_STRING_ATTRIB (opts, filt_id),
-        GMP_FMT_STRING_ATTRIB (opts, host), GMP_FMT_STRING_ATTRIB (opts, pos),
-        GMP_FMT_STRING_ATTRIB (opts, timezone),
-        GMP_FMT_STRING_ATTRIB (opts, alert_id),
-        GMP_FMT_STRING_ATTRIB (opts, delta_report_id),
-        GMP_FMT_STRING_ATTRIB (opts, delta_states),
-        GMP_FMT_STRING_ATTRIB (opts, host_levels),
-        GMP_FMT_STRING_ATTRIB (opts, search_phrase),
-        GMP_FMT_STRING_ATTRIB (opts, host_search_phrase),
-        GMP_FMT_STRING_ATTRIB (opts, min_cvss_base),
-        GMP_FMT_STRING_ATTRIB (opts, min_qod),
-        GMP_FMT_BOOL_ATTRIB (opts, notes),
-        GMP_FMT_BOOL_ATTRIB (opts, notes_details),
-        GMP_FMT_BOOL_ATTRIB (opts, overrides),
-        GMP_FMT_BOOL_ATTRIB (opts, override_details),
-        GMP_FMT_BOOL_ATTRIB (opts, apply_overrides),
-        GMP_FMT_BOOL_ATTRIB (opts, result_hosts_only),
-        GMP_FMT_BOOL_ATTRIB (opts, ignore_pagination)))
+  command = get_report_command (opts);
+  ret = gvm_server_send (session, command, strlen (command));
+  g_free (command);
+  if (ret)
     return -1;
 
   *response = NULL;
@@ -1481,6 +1447,163 @@ gmp_get_report_ext (gnutls_session_t *session, gmp_get_report_opts_t opts,
   return ret;
 }
 
+/**
+ * @brief Results of a report page, for gmp_get_report_results_c.
+ */
+typedef struct
+{
+  entity_callback_t callback; ///< Called with each result.
+  gpointer user_data;         ///< User data for callback.
+  int count;                  ///< Number of results on the page.
+} report_page_t;
+
+/**
+ * @brief Count a result of a report page and pass it on.
+ *
+ * @param[in]  result  Result element.
+ * @param[in]  data    Report page.
+ */
+static void
+report_page_result (entity_t result, gpointer data)
+{
+  report_page_t *page = (report_page_t *) data;
+
+  page->count++;
+  page->callback (result, page->user_data);
+}
+
+/**
+ * @brief Request a page of the results of a report.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  opts        Struct containing the options to apply.
+ * @param[in]  first       Number of the first result on the page.
+ * @param[in]  rows        Number of results on the page.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+send_report_page (gvm_connection_t *connection, gmp_get_report_opts_t opts,
+                  int first, int rows)
+{
+  gchar *filter, *command;
+  int ret;
+
+  filter = g_strdup_printf ("%s%sfirst=%i rows=%i",
+                            opts.filter ? opts.filter : "",
+                            opts.filter ? " " : "", first, rows);
+  opts.filter = filter;
+  opts.ignore_pagination = 0;
+  command = get_report_command (opts);
+  ret = gvm_connection_sendf (connection, "%s", command);
+  g_free (command);
+  g_free (filter);
+  return ret ? -1 : 0;
+}
+
+/**
+ * @brief Get the status of a GMP response as a return value.
+ *
+ * @param[in]  response  GMP response.
+ *
+ * @return 0 on success, -1 or GMP response code on error.
+ */
+static int
+response_status (entity_t response)
+{
+  const char *status;
+  int ret;
+
+  status = entity_attribute (response, "status");
+  if (status == NULL || strlen (status) == 0)
+    return -1;
+  if (status[0] == '2')
+    return 0;
+  ret = (int) strtol (status, NULL, 10);
+  if (errno == ERANGE)
+    return -1;
+  return ret;
+}
+
+/**
+ * @brief Get the results of a report page by page.
+ *
+ * The results are requested in pages of page_size results with the first
+ * and rows filter keywords, starting at opts.first_result.  Each result is
+ * passed to the callback as soon as it is parsed and freed afterwards, so
+ * memory stays bounded by the size of a page's report without its results,
+ * whatever the size of the report.
+ *
+ * The next page is only requested once the current page is read, because
+ * the reading functions drop any data after the end of a response.
+ *
+ * opts.max_results limits the total number of results if positive.
+ * opts.timeout is ignored.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  opts        Struct containing the options to apply.
+ * @param[in]  page_size   Number of results per page.
+ * @param[in]  callback    Called with each result.  The result is freed
+ *                         when the callback returns.
+ * @param[in]  user_data   User data for callback.
+ * @param[out] report      Return location for the response to the first
+ *                         page without its results, or NULL.
+ *
+ * @return 0 on success, -1 or GMP response code on error.
+ */
+int
+gmp_get_report_results_c (gvm_connection_t *connection,
+                          gmp_get_report_opts_t opts, int page_size,
+                          entity_callback_t callback, gpointer user_data,
+                          entity_t *report)
+{
+  report_page_t page;
+  int first, rows, remaining;
+
+  if (page_size <= 0 || callback == NULL)
+    return -1;
+
+  if (report)
+    *report = NULL;
+
+  page.callback = callback;
+  page.user_data = user_data;
+
+  first = opts.first_result > 0 ? opts.first_result : 1;
+  remaining = opts.max_results > 0 ? opts.max_results : -1;
+  rows = remaining > 0 ? MIN (page_size, remaining) : page_size;
+
+  while (1)
+    {
+      entity_t response;
+      int ret;
+
+      if (send_report_page (connection, opts, first, rows))
+        return -1;
+
+      page.count = 0;
+      if (read_entity_stream_named (connection, 4, "result",
+                                    report_page_result, &page, &response))
+        return -1;
+
+      ret = response_status (response);
+      if (ret == 0 && report && *report == NULL)
+        *report = response;
+      else
+        free_entity (response);
+
+      if (remaining > 0)
+        remaining -= page.count;
+
+      if (ret || page.count < rows || remaining == 0)
+        return ret;
+
+      first += rows;
+      if (remaining > 0)
+        rows = MIN (page_size, remaining);
+    }
+}
+
 /**
  * @brief Delete a port list.
  *
@@ -363,6 +363,10 @@ gmp_get_targets (gnutls_session_t *, const char *, int, int, entity_t *);
 int
 gmp_get_report_ext (gnutls_session_t *, gmp_get_report_opts_t, entity_t *);
 
+int
+gmp_get_report_results_c (gvm_connection_t *, gmp_get_report_opts_t, int,
+                          entity_callback_t, gpointer, entity_t *);
+
 int
 gmp_delete_port_list_ext (gnutls_session_t *, const char *, gmp_delete_opts_t);
 
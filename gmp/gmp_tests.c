@@ -0,0 +1,205 @@
+/* Copyright (C) 2021 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "gmp.c"
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+Describe (gmp);
+BeforeEach (gmp)
+{
+}
+AfterEach (gmp)
+{
+}
+
+/* gmp_get_report_results_c */
+
+/**
+ * @brief Manager answering each request on a socket with a canned page.
+ */
+struct page_server
+{
+  int socket;         ///< Socket of the manager end.
+  const char **pages; ///< NULL terminated responses, one per request.
+  GString *requests;  ///< Requests received.
+};
+
+/**
+ * @brief Answer each request with the next page.
+ *
+ * @param[in]  data  The page_server.
+ *
+ * @return NULL.
+ */
+static gpointer
+serve_pages (gpointer data)
+{
+  struct page_server *server = data;
+  char buffer[4096];
+  int index;
+
+  for (index = 0; server->pages[index]; index++)
+    {
+      ssize_t count;
+
+      count = read (server->socket, buffer, sizeof (buffer));
+      if (count <= 0)
+        break;
+      g_string_append_len (server->requests, buffer, count);
+      if (write (server->socket, server->pages[index],
+                 strlen (server->pages[index]))
+          < 0)
+        break;
+    }
+  close (server->socket);
+  return NULL;
+}
+
+#define REPORT_PAGE(results)                                   \
+  "<get_reports_response status='200' status_text='OK'>"      \
+  "<report id='r1'><report id='r1'>"                          \
+  "<results>" results "</results>"                            \
+  "<result_count><filtered>3</filtered></result_count>"       \
+  "</report></report>"                                        \
+  "</get_reports_response>"
+
+static void
+collect_result_id (entity_t result, gpointer ids)
+{
+  g_ptr_array_add ((GPtrArray *) ids,
+                   g_strdup (entity_attribute (result, "id")));
+}
+
+/**
+ * @brief Get the results of report r1 from a page server.
+ *
+ * @param[in]   pages        NULL terminated responses, one per request.
+ * @param[in]   max_results  Maximum number of results, -1 for all.
+ * @param[out]  ids          IDs of the results passed to the callback.
+ * @param[out]  report       Report without its results.
+ * @param[out]  requests     Requests the server received.
+ *
+ * @return Return value of gmp_get_report_results_c.
+ */
+static int
+get_results_from_pages (const char **pages, int max_results, GPtrArray *ids,
+                        entity_t *report, GString *requests)
+{
+  gvm_connection_t connection = {0};
+  gmp_get_report_opts_t opts;
+  struct page_server server;
+  GThread *thread;
+  int sockets[2], ret;
+
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  server.socket = sockets[1];
+  server.pages = pages;
+  server.requests = requests;
+  thread = g_thread_new ("gmp-test", serve_pages, &server);
+
+  connection.socket = sockets[0];
+  opts = gmp_get_report_opts_defaults;
+  opts.report_id = "r1";
+  opts.max_results = max_results;
+  ret = gmp_get_report_results_c (&connection, opts, 2, collect_result_id, ids,
+                                  report);
+  close (sockets[0]);
+  g_thread_join (thread);
+  return ret;
+}
+
+Ensure (gmp, gmp_get_report_results_c_passes_results_in_order)
+{
+  const char *pages[] = {
+    REPORT_PAGE ("<result id='1'/><result id='2'/>"),
+    REPORT_PAGE ("<result id='3'/>"), NULL};
+  GPtrArray *ids;
+  GString *requests;
+  entity_t report, inner;
+
+  ids = g_ptr_array_new_with_free_func (g_free);
+  requests = g_string_new ("");
+  assert_that (get_results_from_pages (pages, -1, ids, &report, requests),
+               is_equal_to (0));
+
+  assert_that (ids->len, is_equal_to (3));
+  assert_that (g_ptr_array_index (ids, 0), is_equal_to_string ("1"));
+  assert_that (g_ptr_array_index (ids, 1), is_equal_to_string ("2"));
+  assert_that (g_ptr_array_index (ids, 2), is_equal_to_string ("3"));
+
+  /* The second page is only requested after the first was read. */
+  assert_that (requests->str, contains_string ("first=1 rows=2"));
+  assert_that (requests->str, contains_string ("first=3 rows=2"));
+
+  /* The report of the first page is returned, without its results. */
+  assert_that (report, is_not_null);
+  inner = entity_child (entity_child (report, "report"), "report");
+  assert_that (entity_child (inner, "result_count"), is_not_null);
+  assert_that (entity_child (entity_child (inner, "results"), "result"),
+               is_null);
+  free_entity (report);
+
+  g_ptr_array_free (ids, TRUE);
+  g_string_free (requests, TRUE);
+}
+
+Ensure (gmp, gmp_get_report_results_c_stops_at_max_results)
+{
+  const char *pages[] = {
+    REPORT_PAGE ("<result id='1'/><result id='2'/>"),
+    REPORT_PAGE ("<result id='3'/>"), NULL};
+  GPtrArray *ids;
+  GString *requests;
+
+  ids = g_ptr_array_new_with_free_func (g_free);
+  requests = g_string_new ("");
+  assert_that (get_results_from_pages (pages, 3, ids, NULL, requests),
+               is_equal_to (0));
+
+  assert_that (ids->len, is_equal_to (3));
+  assert_that (g_ptr_array_index (ids, 2), is_equal_to_string ("3"));
+  assert_that (requests->str, contains_string ("first=3 rows=1"));
+
+  g_ptr_array_free (ids, TRUE);
+  g_string_free (requests, TRUE);
+}
+
+/* Test suite. */
+
+int
+main (int argc, char **argv)
+{
+  TestSuite *suite;
+
+  suite = create_test_suite ();
+
+  add_test_with_context (suite, gmp,
+                         gmp_get_report_results_c_passes_results_in_order);
+  add_test_with_context (suite, gmp,
+                         gmp_get_report_results_c_stops_at_max_results);
+
+  if (argc > 1)
+    return run_single_test (suite, argv[1], create_text_reporter ());
+
+  return run_test_suite (suite, create_text_reporter ());
+}
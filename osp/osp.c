@@ -52,6 +52,7 @@ struct osp_connection
   int socket;               /**< Socket. */
   char *host;               /**< Host. */
   int port;                 /**< Port. */
+  char *cert;               /**< Client certificate, for TLS resumption. */
 };
 
 /**
@@ -121,9 +122,18 @@ static int
 osp_send_command (osp_connection_t *, entity_t *, const char *, ...)
   __attribute__ ((__format__ (__printf__, 3, 4)));
 
+static int
+osp_send_command_arena (osp_connection_t *, entity_t *, const char *, ...)
+  __attribute__ ((__format__ (__printf__, 3, 4)));
+
 /**
  * @brief Open a new connection to an OSP server.
  *
+ * ospd closes the connection after each command, so a connection is opened
+ * per command.  TLS connections resume the TLS session of an earlier
+ * connection to the server where the server allows it, which skips the full
+ * handshake.
+ *
  * @param[in]   host    Host of OSP server.
  * @param[in]   port    Port of OSP server.
  * @param[in]   cacert  CA public key.
@@ -173,9 +183,11 @@ osp_connection_new (const char *host, int port, const char *cacert,
       connection = g_malloc0 (sizeof (*connection));
       connection->socket = gvm_server_open_with_cert (
         &connection->session, host, port, cacert, cert, key);
+      connection->cert = g_strdup (cert);
     }
   if (connection->socket == -1)
     {
+      g_free (connection->cert);
       g_free (connection);
       return NULL;
     }
@@ -185,6 +197,68 @@ osp_connection_new (const char *host, int port, const char *cacert,
   return connection;
 }
 
+/**
+ * @brief Wrap a connection to an OSP server in a gvm_connection_t.
+ *
+ * The wrapper shares the socket and session of the connection, so it must
+ * not be freed.
+ *
+ * @param[in]   connection      Connection to OSP server.
+ * @param[out]  gvm_connection  Wrapper.
+ */
+static void
+osp_gvm_connection (osp_connection_t *connection,
+                    gvm_connection_t *gvm_connection)
+{
+  memset (gvm_connection, 0, sizeof (*gvm_connection));
+  gvm_connection->tls = *connection->host != '/';
+  gvm_connection->socket = connection->socket;
+  gvm_connection->session = connection->session;
+}
+
+/**
+ * @brief Send a command that is already built to an OSP server.
+ *
+ * @param[in]  connection  Connection to OSP server.
+ * @param[in]  command     OSP command to send.
+ * @param[in]  length      Length of command.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+osp_send (osp_connection_t *connection, const char *command, gsize length)
+{
+  int rc;
+
+  if (*connection->host == '/')
+    rc = gvm_socket_send (connection->socket, command, length);
+  else
+    rc = gvm_server_send (&connection->session, command, length);
+  return rc == -1 ? -1 : 0;
+}
+
+/**
+ * @brief Format a command and send it to an OSP server.
+ *
+ * @param[in]  connection  Connection to OSP server.
+ * @param[in]  fmt         OSP Command to send.
+ * @param[in]  ap          Args for fmt.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+osp_vsend (osp_connection_t *connection, const char *fmt, va_list ap)
+{
+  GString *command;
+  int rc;
+
+  command = g_string_new (NULL);
+  g_string_vprintf (command, fmt, ap);
+  rc = osp_send (connection, command->str, command->len);
+  g_string_free (command, TRUE);
+  return rc;
+}
+
 /**
  * @brief Send a command to an OSP server.
  *
@@ -199,6 +273,7 @@ osp_send_command (osp_connection_t *connection, entity_t *response,
                   const char *fmt, ...)
 {
   va_list ap;
+  gvm_connection_t gvm_connection;
   int rc = 1;
 
   va_start (ap, fmt);
@@ -206,20 +281,118 @@ osp_send_command (osp_connection_t *connection, entity_t *response,
   if (!connection || !fmt || !response)
     goto out;
 
-  if (*connection->host == '/')
-    {
-      if (gvm_socket_vsendf (connection->socket, fmt, ap) == -1)
-        goto out;
-      if (read_entity_s (connection->socket, response))
-        goto out;
-    }
-  else
-    {
-      if (gvm_server_vsendf (&connection->session, fmt, ap) == -1)
-        goto out;
-      if (read_entity (&connection->session, response))
-        goto out;
-    }
+  osp_gvm_connection (connection, &gvm_connection);
+  if (osp_vsend (connection, fmt, ap)
+      || read_entity_c (&gvm_connection, response))
+    goto out;
+
+  rc = 0;
+
+out:
+  va_end (ap);
+
+  return rc;
+}
+
+/**
+ * @brief Send a command that is already built to an OSP server.
+ *
+ * Unlike osp_send_command, the command is sent as is, without formatting it
+ * into a copy first.
+ *
+ * @param[in]   connection  Connection to OSP server.
+ * @param[out]  response    Response from OSP server.
+ * @param[in]   command     OSP command to send.
+ *
+ * @return 0 and response, 1 if error.
+ */
+static int
+osp_send_command_string (osp_connection_t *connection, entity_t *response,
+                         const GString *command)
+{
+  gvm_connection_t gvm_connection;
+
+  if (!connection || !command || !response)
+    return 1;
+
+  osp_gvm_connection (connection, &gvm_connection);
+  if (osp_send (connection, command->str, command->len)
+      || read_entity_c (&gvm_connection, response))
+    return 1;
+
+  return 0;
+}
+
+/**
+ * @brief Send a command to an OSP server, reading the response into an arena.
+ *
+ * For responses that are only read and then freed as a whole, see
+ * read_entity_arena_c.
+ *
+ * @param[in]   connection  Connection to OSP server.
+ * @param[out]  response    Response from OSP server.
+ * @param[in]   fmt         OSP Command to send.
+ *
+ * @return 0 and response, 1 if error.
+ */
+static int
+osp_send_command_arena (osp_connection_t *connection, entity_t *response,
+                        const char *fmt, ...)
+{
+  va_list ap;
+  gvm_connection_t gvm_connection;
+  int rc = 1;
+
+  va_start (ap, fmt);
+
+  if (!connection || !fmt || !response)
+    goto out;
+
+  osp_gvm_connection (connection, &gvm_connection);
+  if (osp_vsend (connection, fmt, ap)
+      || read_entity_arena_c (&gvm_connection, response))
+    goto out;
+
+  rc = 0;
+
+out:
+  va_end (ap);
+
+  return rc;
+}
+
+/**
+ * @brief Send a command to an OSP server, streaming elements of the response.
+ *
+ * @param[in]   connection  Connection to OSP server.
+ * @param[in]   depth       Depth of the streamed elements of the response.
+ * @param[in]   callback    Called with each streamed element.
+ * @param[in]   user_data   User data for callback.
+ * @param[out]  response    Response from OSP server, without the streamed
+ *                          elements.
+ * @param[in]   fmt         OSP Command to send.
+ *
+ * @return 0 and response, 1 if error.
+ */
+static int
+osp_send_command_stream (osp_connection_t *connection, int depth,
+                         entity_callback_t callback, gpointer user_data,
+                         entity_t *response, const char *fmt, ...)
+{
+  va_list ap;
+  gvm_connection_t gvm_connection;
+  int rc = 1;
+
+  va_start (ap, fmt);
+
+  if (!connection || !fmt || !response)
+    goto out;
+
+  osp_gvm_connection (connection, &gvm_connection);
+  if (osp_vsend (connection, fmt, ap)
+      || read_entity_stream (&gvm_connection, depth, callback, user_data,
+                             response))
+    goto out;
 
   rc = 0;
 
@@ -229,6 +402,31 @@ out:
   return rc;
 }
 
+/**
+ * @brief Register a connection to an OSP server with a client event loop.
+ *
+ * OSP servers close the connection after each response, so the client
+ * fails with GVM_CLIENT_CLOSED once the response to its first command is
+ * complete, and is then removed and the connection closed.
+ *
+ * @param[in]  loop        Client event loop.
+ * @param[in]  connection  Connection to OSP server.
+ *
+ * @return Client, or NULL on error.
+ */
+gvm_client_t *
+osp_connection_add_to_loop (gvm_client_loop_t *loop,
+                            osp_connection_t *connection)
+{
+  gvm_connection_t gvm_connection;
+
+  if (connection == NULL)
+    return NULL;
+
+  osp_gvm_connection (connection, &gvm_connection);
+  return gvm_client_loop_add (loop, &gvm_connection);
+}
+
 /**
  * @brief Close a connection to an OSP server.
  *
@@ -243,8 +441,14 @@ osp_connection_close (osp_connection_t *connection)
   if (*connection->host == '/')
     close (connection->socket);
   else
-    gvm_server_close (connection->socket, connection->session);
+    {
+      /* Save the session again now that any TLS 1.3 ticket has arrived. */
+      gvm_server_save_session (connection->session, connection->host,
+                               connection->port, connection->cert);
+      gvm_server_close (connection->socket, connection->session);
+    }
   g_free (connection->host);
+  g_free (connection->cert);
   g_free (connection);
 }
 
@@ -454,6 +658,94 @@ osp_get_vts_ext (osp_connection_t *connection, osp_get_vts_opts_t opts,
   return 0;
 }
 
+/**
+ * @brief Synchronise VTs from an OSP server incrementally.
+ *
+ * Nothing is transferred if the VTs version of the server matches the
+ * cached version.  Otherwise only the VTs modified after the given time are
+ * requested, or all VTs if no time is given.  Each VT is passed to the
+ * callback as soon as it is read and freed afterwards, so the whole
+ * collection is never held in memory.
+ *
+ * @param[in]   connection      Connection to an OSP server.
+ * @param[in]   cached_version  VTs version of the last sync, or NULL.
+ * @param[in]   modified_since  Modification time of the last sync, 0 to get
+ *                              all VTs.
+ * @param[in]   callback        Called with each changed VT.
+ * @param[in]   user_data       User data for callback.
+ * @param[out]  vts_version     VTs version of the server, or NULL.
+ * @param[out]  error           Pointer to error, if any.
+ *
+ * @return 0 if success, 1 if error.
+ */
+int
+osp_sync_vts (osp_connection_t *connection, const char *cached_version,
+              time_t modified_since, entity_callback_t callback,
+              gpointer user_data, char **vts_version, char **error)
+{
+  entity_t entity, vts;
+  char *version = NULL;
+  const char *status;
+  int ret;
+
+  if (!connection || !callback)
+    return 1;
+
+  if (osp_get_vts_version (connection, &version, error))
+    return 1;
+
+  if (version && cached_version && strcmp (version, cached_version) == 0)
+    {
+      g_debug ("%s: VTs version %s is up to date.", __func__, version);
+      if (vts_version)
+        *vts_version = version;
+      else
+        g_free (version);
+      return 0;
+    }
+
+  if (modified_since > 0)
+    ret = osp_send_command_stream (
+      connection, 2, callback, user_data, &entity,
+      "<get_vts filter='modification_time&gt;%ld'/>", (long) modified_since);
+  else
+    ret = osp_send_command_stream (connection, 2, callback, user_data,
+                                   &entity, "<get_vts/>");
+  if (ret)
+    {
+      g_free (version);
+      return 1;
+    }
+
+  status = entity_attribute (entity, "status");
+  if (status == NULL || strcmp (status, "200"))
+    {
+      const char *status_text = entity_attribute (entity, "status_text");
+
+      g_debug ("%s: %s - %s.", __func__, status, status_text);
+      if (error)
+        *error = g_strdup (status_text);
+      g_free (version);
+      free_entity (entity);
+      return 1;
+    }
+
+  /* The feed may have been updated since the version was requested. */
+  vts = entity_child (entity, "vts");
+  if (vts && entity_attribute (vts, "vts_version"))
+    {
+      g_free (version);
+      version = g_strdup (entity_attribute (vts, "vts_version"));
+    }
+
+  if (vts_version)
+    *vts_version = version;
+  else
+    g_free (version);
+  free_entity (entity);
+  return 0;
+}
+
 /**
  * @brief Delete a scan from an OSP server.
  *
@@ -650,11 +942,12 @@ osp_get_scan_pop (osp_connection_t *connection, const char *scan_id,
       return -1;
     }
   assert (scan_id);
-  rc = osp_send_command (connection, &entity,
-                         "<get_scans scan_id='%s'"
-                         " details='%d'"
-                         " pop_results='%d'/>",
-                         scan_id, pop_results ? 1 : 0, details ? 1 : 0);
+  /* The response can hold many results and is only printed to a string. */
+  rc = osp_send_command_arena (connection, &entity,
+                               "<get_scans scan_id='%s'"
+                               " details='%d'"
+                               " pop_results='%d'/>",
+                               scan_id, pop_results ? 1 : 0, details ? 1 : 0);
   if (rc)
     {
       if (error)
@@ -755,29 +1048,24 @@ osp_stop_scan (osp_connection_t *connection, const char *scan_id, char **error)
 }
 
 /**
- * @brief Concatenate options as xml.
- *
- * @param[in]     key      Tag name for xml element.
- * @param[in]     value    Text for xml element.
- * @param[in,out] pstr     Parameters as xml concatenated xml elements.
+ * @brief Append an option as XML to a string buffer.
  *
+ * @param[in]     key         Tag name for xml element.
+ * @param[in]     value       Text for xml element.
+ * @param[in,out] xml_string  XML string buffer to append to.
  */
 static void
-option_concat_as_xml (gpointer key, gpointer value, gpointer pstr)
+option_append_as_xml (gpointer key, gpointer value, gpointer xml_string)
 {
-  char *options_str, *tmp, *key_escaped, *value_escaped;
-
-  options_str = *(char **) pstr;
-
-  key_escaped = g_markup_escape_text ((char *) key, -1);
-  value_escaped = g_markup_escape_text ((char *) value, -1);
-  tmp = g_strdup_printf ("%s<%s>%s</%s>", options_str ? options_str : "",
-                         key_escaped, value_escaped, key_escaped);
-
-  g_free (options_str);
-  g_free (key_escaped);
-  g_free (value_escaped);
-  *(char **) pstr = tmp;
+  GString *xml = xml_string;
+
+  g_string_append_c (xml, '<');
+  xml_string_append_text (xml, key, -1);
+  g_string_append_c (xml, '>');
+  xml_string_append_text (xml, value, -1);
+  g_string_append (xml, "</");
+  xml_string_append_text (xml, key, -1);
+  g_string_append_c (xml, '>');
 }
 
 /**
@@ -798,7 +1086,7 @@ osp_start_scan (osp_connection_t *connection, const char *target,
                 char **error)
 {
   entity_t entity;
-  char *options_str = NULL;
+  GString *options_str;
   int status;
   int rc;
 
@@ -812,15 +1100,16 @@ osp_start_scan (osp_connection_t *connection, const char *target,
 
   assert (target);
   /* Construct options string. */
+  options_str = g_string_new ("");
   if (options)
-    g_hash_table_foreach (options, option_concat_as_xml, &options_str);
+    g_hash_table_foreach (options, option_append_as_xml, options_str);
 
   rc = osp_send_command (connection, &entity,
                          "<start_scan target='%s' ports='%s' scan_id='%s'>"
                          "<scanner_params>%s</scanner_params></start_scan>",
                          target, ports ? ports : "", scan_id ? scan_id : "",
-                         options_str ? options_str : "");
-  g_free (options_str);
+                         options_str->str);
+  g_string_free (options_str, TRUE);
   if (rc)
     {
       if (error)
@@ -860,21 +1149,40 @@ credential_append_as_xml (osp_credential_t *credential, GString *xml_string)
   GHashTableIter auth_data_iter;
   gchar *auth_data_name, *auth_data_value;
 
-  xml_string_append (xml_string,
-                     "<credential type=\"%s\" service=\"%s\" port=\"%s\">",
-                     credential->type ? credential->type : "",
-                     credential->service ? credential->service : "",
-                     credential->port ? credential->port : "");
+  g_string_append (xml_string, "<credential type=\"");
+  xml_string_append_text (xml_string, credential->type, -1);
+  g_string_append (xml_string, "\" service=\"");
+  xml_string_append_text (xml_string, credential->service, -1);
+  g_string_append (xml_string, "\" port=\"");
+  xml_string_append_text (xml_string, credential->port, -1);
+  g_string_append (xml_string, "\">");
 
   g_hash_table_iter_init (&auth_data_iter, credential->auth_data);
   while (g_hash_table_iter_next (&auth_data_iter, (gpointer *) &auth_data_name,
                                  (gpointer *) &auth_data_value))
-    {
-      xml_string_append (xml_string, "<%s>%s</%s>", auth_data_name,
-                         auth_data_value, auth_data_name);
-    }
+    option_append_as_xml (auth_data_name, auth_data_value, xml_string);
 
-  xml_string_append (xml_string, "</credential>");
+  g_string_append (xml_string, "</credential>");
+}
+
+/**
+ * @brief Append an element with escaped text to a string buffer.
+ *
+ * @param[in,out] xml_string  XML string buffer to append to.
+ * @param[in]     name        Name of the element.
+ * @param[in]     text        Text of the element, NULL for empty.
+ */
+static void
+element_append_as_xml (GString *xml_string, const char *name,
+                       const char *text)
+{
+  g_string_append_c (xml_string, '<');
+  g_string_append (xml_string, name);
+  g_string_append_c (xml_string, '>');
+  xml_string_append_text (xml_string, text, -1);
+  g_string_append (xml_string, "</");
+  g_string_append (xml_string, name);
+  g_string_append_c (xml_string, '>');
 }
 
 /**
@@ -887,47 +1195,39 @@ credential_append_as_xml (osp_credential_t *credential, GString *xml_string)
 static void
 target_append_as_xml (osp_target_t *target, GString *xml_string)
 {
-  xml_string_append (xml_string,
-                     "<target>"
-                     "<hosts>%s</hosts>"
-                     "<exclude_hosts>%s</exclude_hosts>"
-                     "<finished_hosts>%s</finished_hosts>"
-                     "<ports>%s</ports>",
-                     target->hosts ? target->hosts : "",
-                     target->exclude_hosts ? target->exclude_hosts : "",
-                     target->finished_hosts ? target->finished_hosts : "",
-                     target->ports ? target->ports : "");
+  g_string_append (xml_string, "<target>");
+  element_append_as_xml (xml_string, "hosts", target->hosts);
+  element_append_as_xml (xml_string, "exclude_hosts", target->exclude_hosts);
+  element_append_as_xml (xml_string, "finished_hosts", target->finished_hosts);
+  element_append_as_xml (xml_string, "ports", target->ports);
 
   /* Alive test specified as bitfield */
   if (target->alive_test > 0)
-    xml_string_append (xml_string, "<alive_test>%d</alive_test>",
-                       target->alive_test);
+    g_string_append_printf (xml_string, "<alive_test>%d</alive_test>",
+                            target->alive_test);
   /* Alive test specified via dedicated methods. Dedicted methods are ignored if
    * alive test was already specified as bitfield.*/
   else if (target->icmp == TRUE || target->tcp_syn == TRUE
            || target->tcp_ack == TRUE || target->arp == TRUE
            || target->consider_alive == TRUE)
     {
-      xml_string_append (xml_string,
-                         "<alive_test_methods>"
-                         "<icmp>%d</icmp>"
-                         "<tcp_syn>%d</tcp_syn>"
-                         "<tcp_ack>%d</tcp_ack>"
-                         "<arp>%d</arp>"
-                         "<consider_alive>%d</consider_alive>"
-                         "</alive_test_methods>",
-                         target->icmp, target->tcp_syn, target->tcp_ack,
-                         target->arp, target->consider_alive);
+      g_string_append_printf (xml_string,
+                              "<alive_test_methods>"
+                              "<icmp>%d</icmp>"
+                              "<tcp_syn>%d</tcp_syn>"
+                              "<tcp_ack>%d</tcp_ack>"
+                              "<arp>%d</arp>"
+                              "<consider_alive>%d</consider_alive>"
+                              "</alive_test_methods>",
+                              target->icmp, target->tcp_syn, target->tcp_ack,
+                              target->arp, target->consider_alive);
     }
 
   if (target->reverse_lookup_unify == 1)
-    xml_string_append (xml_string,
-                       "<reverse_lookup_unify>%d</reverse_lookup_unify>",
-                       target->reverse_lookup_unify);
+    g_string_append (xml_string,
+                     "<reverse_lookup_unify>1</reverse_lookup_unify>");
   if (target->reverse_lookup_only == 1)
-    xml_string_append (xml_string,
-                       "<reverse_lookup_only>%d</reverse_lookup_only>",
-                       target->reverse_lookup_only);
+    g_string_append (xml_string, "<reverse_lookup_only>1</reverse_lookup_only>");
 
   if (target->credentials)
     {
@@ -936,7 +1236,7 @@ target_append_as_xml (osp_target_t *target, GString *xml_string)
                        xml_string);
       g_string_append (xml_string, "</credentials>");
     }
-  xml_string_append (xml_string, "</target>");
+  g_string_append (xml_string, "</target>");
 }
 
 /**
@@ -948,7 +1248,9 @@ target_append_as_xml (osp_target_t *target, GString *xml_string)
 static void
 vt_group_append_as_xml (osp_vt_group_t *vt_group, GString *xml_string)
 {
-  xml_string_append (xml_string, "<vt_group filter=\"%s\"/>", vt_group->filter);
+  g_string_append (xml_string, "<vt_group filter=\"");
+  xml_string_append_text (xml_string, vt_group->filter, -1);
+  g_string_append (xml_string, "\"/>");
 }
 
 /**
@@ -962,8 +1264,11 @@ vt_group_append_as_xml (osp_vt_group_t *vt_group, GString *xml_string)
 static void
 vt_value_append_as_xml (gpointer id, gchar *value, GString *xml_string)
 {
-  xml_string_append (xml_string, "<vt_value id=\"%s\">%s</vt_value>",
-                     id ? id : "", value ? value : "");
+  g_string_append (xml_string, "<vt_value id=\"");
+  xml_string_append_text (xml_string, id, -1);
+  g_string_append (xml_string, "\">");
+  xml_string_append_text (xml_string, value, -1);
+  g_string_append (xml_string, "</vt_value>");
 }
 
 /**
@@ -975,10 +1280,12 @@ vt_value_append_as_xml (gpointer id, gchar *value, GString *xml_string)
 static void
 vt_single_append_as_xml (osp_vt_single_t *vt_single, GString *xml_string)
 {
-  xml_string_append (xml_string, "<vt_single id=\"%s\">", vt_single->vt_id);
+  g_string_append (xml_string, "<vt_single id=\"");
+  xml_string_append_text (xml_string, vt_single->vt_id, -1);
+  g_string_append (xml_string, "\">");
   g_hash_table_foreach (vt_single->vt_values, (GHFunc) vt_value_append_as_xml,
                         xml_string);
-  xml_string_append (xml_string, "</vt_single>");
+  g_string_append (xml_string, "</vt_single>");
 }
 
 /**
@@ -994,15 +1301,9 @@ int
 osp_start_scan_ext (osp_connection_t *connection, osp_start_scan_opts_t opts,
                     char **error)
 {
-  gchar *scanner_params_xml = NULL;
   GString *xml;
-  GSList *list_item;
-  int list_count;
   int rc, status;
   entity_t entity;
-  gchar *cmd;
-  char filename[] = "/tmp/osp-cmd-XXXXXX";
-  int fd;
 
   if (!connection)
     {
@@ -1012,12 +1313,11 @@ osp_start_scan_ext (osp_connection_t *connection, osp_start_scan_opts_t opts,
       return -1;
     }
 
-  fd = mkstemp (filename);
-  FILE *file = fdopen (fd, "w");
-
-  xml = g_string_sized_new (10240);
-  g_string_append (xml, "<start_scan");
-  xml_string_append (xml, " scan_id=\"%s\">", opts.scan_id ? opts.scan_id : "");
+  /* Roughly 100 bytes per VT, so the buffer rarely has to grow. */
+  xml = g_string_sized_new (10240 + 100 * g_slist_length (opts.vts));
+  g_string_append (xml, "<start_scan scan_id=\"");
+  xml_string_append_text (xml, opts.scan_id, -1);
+  g_string_append (xml, "\">");
 
   g_string_append (xml, "<targets>");
   g_slist_foreach (opts.targets, (GFunc) target_append_as_xml, xml);
@@ -1025,58 +1325,18 @@ osp_start_scan_ext (osp_connection_t *connection, osp_start_scan_opts_t opts,
 
   g_string_append (xml, "<scanner_params>");
   if (opts.scanner_params)
-    {
-      scanner_params_xml = NULL;
-      g_hash_table_foreach (opts.scanner_params, (GHFunc) option_concat_as_xml,
-                            &scanner_params_xml);
-      if (scanner_params_xml)
-        g_string_append (xml, scanner_params_xml);
-      g_free (scanner_params_xml);
-    }
+    g_hash_table_foreach (opts.scanner_params, option_append_as_xml, xml);
   g_string_append (xml, "</scanner_params>");
 
   g_string_append (xml, "<vt_selection>");
   g_slist_foreach (opts.vt_groups, (GFunc) vt_group_append_as_xml, xml);
-
-  fprintf (file, "%s", xml->str);
-
-  g_string_free (xml, TRUE);
-
-  xml = g_string_new ("");
-  list_item = opts.vts;
-  list_count = 0;
-  while (list_item)
-    {
-      list_count++;
-      vt_single_append_as_xml (list_item->data, xml);
-
-      list_item = list_item->next;
-
-      if (list_count == 1000)
-        {
-          fprintf (file, "%s", xml->str);
-
-          g_string_free (xml, TRUE);
-          xml = g_string_new ("");
-          list_count = 0;
-        }
-    }
-
+  g_slist_foreach (opts.vts, (GFunc) vt_single_append_as_xml, xml);
   g_string_append (xml, "</vt_selection>");
   g_string_append (xml, "</start_scan>");
 
-  fprintf (file, "%s", xml->str);
-  fflush (file);
-  fclose (file);
+  rc = osp_send_command_string (connection, &entity, xml);
   g_string_free (xml, TRUE);
 
-  g_file_get_contents (filename, &cmd, NULL, NULL);
-
-  rc = osp_send_command (connection, &entity, "%s", cmd);
-
-  g_free (cmd);
-  unlink (filename);
-
   if (rc)
     {
       if (error)
@@ -25,9 +25,11 @@
 #ifndef _GVM_OSP_H
 #define _GVM_OSP_H
 
+#include "../util/clientloop.h"
 #include "../util/xmlutils.h"
 
 #include <glib.h> /* for GHashTable, GSList */
+#include <time.h> /* for time_t */
 
 /* Type definitions */
 
@@ -93,6 +95,9 @@ osp_connection_new (const char *, int, const char *, const char *,
 void
 osp_connection_close (osp_connection_t *);
 
+gvm_client_t *
+osp_connection_add_to_loop (gvm_client_loop_t *, osp_connection_t *);
+
 /* OSP commands */
 int
 osp_get_version (osp_connection_t *, char **, char **, char **, char **,
@@ -118,6 +123,10 @@ static const osp_get_vts_opts_t osp_get_vts_opts_default = {NULL, 0};
 int
 osp_get_vts_ext (osp_connection_t *, osp_get_vts_opts_t, entity_t *);
 
+int
+osp_sync_vts (osp_connection_t *, const char *, time_t, entity_callback_t,
+              gpointer, char **, char **);
+
 int
 osp_start_scan (osp_connection_t *, const char *, const char *, GHashTable *,
                 const char *, char **);
@@ -19,8 +19,12 @@
 
 #include "osp.c"
 
+#include <arpa/inet.h>
 #include <cgreen/cgreen.h>
 #include <cgreen/mocks.h>
+#include <gnutls/x509.h>
+#include <netinet/in.h>
+#include <signal.h>
 
 Describe (osp);
 BeforeEach (osp)
@@ -51,6 +55,495 @@ Ensure (osp, osp_get_vts_no_conn_ret_error)
   assert_that (osp_get_vts (NULL, NULL), is_equal_to (1));
 }
 
+static void
+ignore_vt (entity_t vt, gpointer user_data)
+{
+  (void) vt;
+  (void) user_data;
+}
+
+Ensure (osp, osp_sync_vts_no_conn_ret_error)
+{
+  assert_that (osp_sync_vts (NULL, NULL, 0, ignore_vt, NULL, NULL, NULL),
+               is_equal_to (1));
+}
+
+Ensure (osp, osp_sync_vts_no_callback_ret_error)
+{
+  osp_connection_t *conn = g_malloc0 (sizeof (*conn));
+  assert_that (osp_sync_vts (conn, NULL, 0, NULL, NULL, NULL, NULL),
+               is_equal_to (1));
+  g_free (conn);
+}
+
+/**
+ * @brief Listen on a temporary unix socket.
+ *
+ * @param[out]  path  Path of the socket.
+ *
+ * @return Listening socket.
+ */
+static int
+listen_unix (char **path)
+{
+  struct sockaddr_un addr;
+  int listener;
+
+  *path = g_strdup_printf ("%s/osp-test-%d.sock", g_get_tmp_dir (), getpid ());
+  unlink (*path);
+  listener = socket (AF_UNIX, SOCK_STREAM, 0);
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strncpy (addr.sun_path, *path, sizeof (addr.sun_path) - 1);
+  bind (listener, (struct sockaddr *) &addr, sizeof (addr));
+  listen (listener, 8);
+  return listener;
+}
+
+/**
+ * @brief Server answering the requests on one connection with canned data.
+ */
+struct canned_server
+{
+  char *path;             ///< Path of the listening socket.
+  int listener;           ///< Listening socket.
+  GThread *thread;        ///< Thread serving the connection.
+  const char **responses; ///< NULL terminated responses, one per request.
+  GString *requests;      ///< Requests received.
+};
+
+/**
+ * @brief Accept one connection and answer each request with a response.
+ *
+ * @param[in]  data  The canned_server.
+ *
+ * @return NULL.
+ */
+static gpointer
+serve_canned (gpointer data)
+{
+  struct canned_server *server = data;
+  char buffer[4096];
+  int peer, index;
+
+  peer = accept (server->listener, NULL, NULL);
+  for (index = 0; server->responses[index]; index++)
+    {
+      ssize_t count;
+
+      count = read (peer, buffer, sizeof (buffer));
+      if (count <= 0)
+        break;
+      g_string_append_len (server->requests, buffer, count);
+      if (write (peer, server->responses[index],
+                 strlen (server->responses[index]))
+          < 0)
+        break;
+    }
+  close (peer);
+  return NULL;
+}
+
+/**
+ * @brief Start a canned server and connect to it.
+ *
+ * @param[out]  server     Server.
+ * @param[in]   responses  NULL terminated responses, one per request.
+ *
+ * @return Connection to the server.
+ */
+static osp_connection_t *
+canned_server_start (struct canned_server *server, const char **responses)
+{
+  server->listener = listen_unix (&server->path);
+  server->responses = responses;
+  server->requests = g_string_new ("");
+  server->thread = g_thread_new ("osp-test", serve_canned, server);
+  return osp_connection_new (server->path, 0, NULL, NULL, NULL);
+}
+
+/**
+ * @brief Close the connection to a canned server and stop the server.
+ *
+ * The requests the server received stay in server->requests, which the
+ * caller must free.
+ *
+ * @param[in]  server      Server.
+ * @param[in]  connection  Connection to the server.
+ */
+static void
+canned_server_finish (struct canned_server *server,
+                      osp_connection_t *connection)
+{
+  osp_connection_close (connection);
+  g_thread_join (server->thread);
+  close (server->listener);
+  unlink (server->path);
+  g_free (server->path);
+}
+
+Ensure (osp, osp_get_scan_pop_prints_scan_read_into_arena)
+{
+  const char *responses[] = {
+    "<get_scans_response status='200' status_text='OK'>"
+    "<scan id='s1' progress='42'>"
+    "<results><result name='r'>x</result></results>"
+    "</scan>"
+    "</get_scans_response>",
+    NULL};
+  struct canned_server server;
+  osp_connection_t *connection;
+  char *report_xml, *error;
+
+  connection = canned_server_start (&server, responses);
+  assert_that (connection, is_not_null);
+  report_xml = error = NULL;
+  assert_that (osp_get_scan_pop (connection, "s1", &report_xml, 0, 1, &error),
+               is_equal_to (42));
+  assert_that (error, is_null);
+  assert_that (report_xml, contains_string ("<scan "));
+  assert_that (report_xml,
+               contains_string ("<results><result name=\"r\">x</result>"
+                                "</results></scan>"));
+
+  canned_server_finish (&server, connection);
+  assert_that (server.requests->str,
+               contains_string ("<get_scans scan_id='s1'"));
+  g_string_free (server.requests, TRUE);
+  g_free (report_xml);
+}
+
+Ensure (osp, osp_connection_per_command_like_ospd)
+{
+  const char *responses[] = {
+    "<delete_scan_response status='200' status_text='OK'/>", NULL};
+  struct canned_server server;
+  osp_connection_t *connection;
+  int round;
+
+  /* Like ospd the server closes the connection after each command. */
+  for (round = 0; round < 2; round++)
+    {
+      connection = canned_server_start (&server, responses);
+      assert_that (connection, is_not_null);
+      assert_that (osp_delete_scan (connection, "s1"), is_equal_to (0));
+      canned_server_finish (&server, connection);
+      assert_that (server.requests->str,
+                   is_equal_to_string ("<delete_scan scan_id='s1'/>"));
+      g_string_free (server.requests, TRUE);
+    }
+}
+
+/**
+ * @brief TLS server answering one request per connection, like ospd.
+ */
+struct tls_server
+{
+  int listener;                            ///< Listening socket.
+  int port;                                ///< Port of listener.
+  GThread *thread;                         ///< Thread serving connections.
+  int connections;                         ///< Number of connections to serve.
+  gchar *cert;                             ///< Certificate, also the CA.
+  gchar *key;                              ///< Private key.
+  gnutls_certificate_credentials_t creds;  ///< Server credentials.
+  gnutls_datum_t ticket_key;               ///< Session ticket key.
+};
+
+/**
+ * @brief Create a self signed certificate for 127.0.0.1.
+ *
+ * @param[out]  cert  Certificate in PEM format.
+ * @param[out]  key   Private key in PEM format.
+ */
+static void
+make_self_signed_cert (gchar **cert, gchar **key)
+{
+  gnutls_x509_privkey_t privkey;
+  gnutls_x509_crt_t crt;
+  gnutls_datum_t datum;
+  unsigned char serial = 1;
+  time_t now;
+
+  gnutls_x509_privkey_init (&privkey);
+  gnutls_x509_privkey_generate (
+    privkey, GNUTLS_PK_ECDSA, GNUTLS_CURVE_TO_BITS (GNUTLS_ECC_CURVE_SECP256R1),
+    0);
+
+  now = time (NULL);
+  gnutls_x509_crt_init (&crt);
+  gnutls_x509_crt_set_version (crt, 3);
+  gnutls_x509_crt_set_serial (crt, &serial, sizeof (serial));
+  gnutls_x509_crt_set_activation_time (crt, now - 3600);
+  gnutls_x509_crt_set_expiration_time (crt, now + 3600);
+  gnutls_x509_crt_set_dn_by_oid (crt, GNUTLS_OID_X520_COMMON_NAME, 0,
+                                 "127.0.0.1", strlen ("127.0.0.1"));
+  gnutls_x509_crt_set_key (crt, privkey);
+  gnutls_x509_crt_set_ca_status (crt, 1);
+  gnutls_x509_crt_set_key_usage (crt, GNUTLS_KEY_DIGITAL_SIGNATURE
+                                        | GNUTLS_KEY_KEY_CERT_SIGN);
+  gnutls_x509_crt_sign2 (crt, crt, privkey, GNUTLS_DIG_SHA256, 0);
+
+  gnutls_x509_crt_export2 (crt, GNUTLS_X509_FMT_PEM, &datum);
+  *cert = g_strndup ((gchar *) datum.data, datum.size);
+  gnutls_free (datum.data);
+  gnutls_x509_privkey_export2 (privkey, GNUTLS_X509_FMT_PEM, &datum);
+  *key = g_strndup ((gchar *) datum.data, datum.size);
+  gnutls_free (datum.data);
+
+  gnutls_x509_crt_deinit (crt);
+  gnutls_x509_privkey_deinit (privkey);
+}
+
+/**
+ * @brief Answer one request on each connection, then close it.
+ *
+ * @param[in]  data  The tls_server.
+ *
+ * @return NULL.
+ */
+static gpointer
+serve_tls (gpointer data)
+{
+  struct tls_server *server = data;
+  const char *response = "<delete_scan_response status='200' "
+                         "status_text='OK'/>";
+
+  for (int index = 0; index < server->connections; index++)
+    {
+      gnutls_session_t session;
+      char buffer[4096];
+      int peer, ret;
+
+      peer = accept (server->listener, NULL, NULL);
+      gnutls_init (&session, GNUTLS_SERVER);
+      gnutls_set_default_priority (session);
+      gnutls_credentials_set (session, GNUTLS_CRD_CERTIFICATE, server->creds);
+      gnutls_session_ticket_enable_server (session, &server->ticket_key);
+      gnutls_transport_set_int (session, peer);
+      do
+        ret = gnutls_handshake (session);
+      while (ret < 0 && gnutls_error_is_fatal (ret) == 0);
+      if (ret == 0
+          && gnutls_record_recv (session, buffer, sizeof (buffer)) > 0)
+        {
+          gnutls_record_send (session, response, strlen (response));
+          gnutls_bye (session, GNUTLS_SHUT_WR);
+        }
+      gnutls_deinit (session);
+      close (peer);
+    }
+  return NULL;
+}
+
+/**
+ * @brief Start a TLS server on a free port of 127.0.0.1.
+ *
+ * @param[out]  server       Server.
+ * @param[in]   connections  Number of connections to serve.
+ */
+static void
+tls_server_start (struct tls_server *server, int connections)
+{
+  struct sockaddr_in addr;
+  socklen_t length;
+  gnutls_datum_t cert, key;
+
+  make_self_signed_cert (&server->cert, &server->key);
+  cert.data = (unsigned char *) server->cert;
+  cert.size = strlen (server->cert);
+  key.data = (unsigned char *) server->key;
+  key.size = strlen (server->key);
+  gnutls_certificate_allocate_credentials (&server->creds);
+  gnutls_certificate_set_x509_key_mem (server->creds, &cert, &key,
+                                       GNUTLS_X509_FMT_PEM);
+  gnutls_session_ticket_key_generate (&server->ticket_key);
+
+  server->listener = socket (AF_INET, SOCK_STREAM, 0);
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  bind (server->listener, (struct sockaddr *) &addr, sizeof (addr));
+  listen (server->listener, 8);
+  length = sizeof (addr);
+  getsockname (server->listener, (struct sockaddr *) &addr, &length);
+  server->port = ntohs (addr.sin_port);
+
+  server->connections = connections;
+  server->thread = g_thread_new ("osp-tls-test", serve_tls, server);
+}
+
+/**
+ * @brief Wait for a TLS server to serve its connections and free it.
+ *
+ * @param[in]  server  Server.
+ */
+static void
+tls_server_finish (struct tls_server *server)
+{
+  g_thread_join (server->thread);
+  close (server->listener);
+  gnutls_certificate_free_credentials (server->creds);
+  gnutls_free (server->ticket_key.data);
+  g_free (server->cert);
+  g_free (server->key);
+}
+
+Ensure (osp, osp_connection_new_resumes_tls_session)
+{
+  struct tls_server server;
+  osp_connection_t *connection;
+
+  /* The server may still write while the client closes. */
+  signal (SIGPIPE, SIG_IGN);
+  tls_server_start (&server, 2);
+
+  /* The first connection makes a full handshake and saves the session when
+   * closed. */
+  connection = osp_connection_new ("127.0.0.1", server.port, server.cert,
+                                   server.cert, server.key);
+  assert_that (connection, is_not_null);
+  assert_that (gnutls_session_is_resumed (connection->session), is_false);
+  assert_that (osp_delete_scan (connection, "s1"), is_equal_to (0));
+  osp_connection_close (connection);
+
+  /* The next connection per command resumes it. */
+  connection = osp_connection_new ("127.0.0.1", server.port, server.cert,
+                                   server.cert, server.key);
+  assert_that (connection, is_not_null);
+  assert_that (gnutls_session_is_resumed (connection->session), is_true);
+  assert_that (osp_delete_scan (connection, "s1"), is_equal_to (0));
+  osp_connection_close (connection);
+
+  tls_server_finish (&server);
+}
+
+/* osp_sync_vts */
+
+#define VTS_VERSION_RESPONSE                              \
+  "<get_vts_response status='200' status_text='OK'>"    \
+  "<vts vts_version='2'/>"                              \
+  "</get_vts_response>"
+
+#define VTS_RESPONSE                                      \
+  "<get_vts_response status='200' status_text='OK'>"    \
+  "<vts vts_version='3'>"                               \
+  "<vt id='1'><name>One</name></vt>"                    \
+  "<vt id='2'><name>Two</name></vt>"                    \
+  "</vts>"                                              \
+  "</get_vts_response>"
+
+static void
+collect_vt_id (entity_t vt, gpointer ids)
+{
+  g_ptr_array_add ((GPtrArray *) ids, g_strdup (entity_attribute (vt, "id")));
+}
+
+Ensure (osp, osp_sync_vts_sends_no_get_vts_for_cached_version)
+{
+  const char *responses[] = {VTS_VERSION_RESPONSE, VTS_RESPONSE, NULL};
+  struct canned_server server;
+  osp_connection_t *connection;
+  GPtrArray *ids;
+  char *version;
+
+  connection = canned_server_start (&server, responses);
+  assert_that (connection, is_not_null);
+  ids = g_ptr_array_new_with_free_func (g_free);
+  version = NULL;
+  assert_that (osp_sync_vts (connection, "2", 0, collect_vt_id, ids, &version,
+                             NULL),
+               is_equal_to (0));
+  assert_that (version, is_equal_to_string ("2"));
+  assert_that (ids->len, is_equal_to (0));
+
+  /* Only the version was requested. */
+  canned_server_finish (&server, connection);
+  assert_that (server.requests->str,
+               is_equal_to_string ("<get_vts version_only='1'/>"));
+  g_string_free (server.requests, TRUE);
+  g_ptr_array_free (ids, TRUE);
+  g_free (version);
+}
+
+Ensure (osp, osp_sync_vts_filters_by_modification_time)
+{
+  const char *responses[] = {VTS_VERSION_RESPONSE, VTS_RESPONSE, NULL};
+  struct canned_server server;
+  osp_connection_t *connection;
+  GPtrArray *ids;
+
+  connection = canned_server_start (&server, responses);
+  assert_that (connection, is_not_null);
+  ids = g_ptr_array_new_with_free_func (g_free);
+  assert_that (osp_sync_vts (connection, "1", 1234, collect_vt_id, ids, NULL,
+                             NULL),
+               is_equal_to (0));
+
+  canned_server_finish (&server, connection);
+  assert_that (server.requests->str,
+               contains_string ("<get_vts filter='modification_time&gt;1234'"
+                                "/>"));
+  g_string_free (server.requests, TRUE);
+  g_ptr_array_free (ids, TRUE);
+}
+
+Ensure (osp, osp_sync_vts_passes_each_vt_to_callback)
+{
+  const char *responses[] = {VTS_VERSION_RESPONSE, VTS_RESPONSE, NULL};
+  struct canned_server server;
+  osp_connection_t *connection;
+  GPtrArray *ids;
+  char *version;
+
+  connection = canned_server_start (&server, responses);
+  assert_that (connection, is_not_null);
+  ids = g_ptr_array_new_with_free_func (g_free);
+  version = NULL;
+  assert_that (osp_sync_vts (connection, "1", 0, collect_vt_id, ids, &version,
+                             NULL),
+               is_equal_to (0));
+  assert_that (ids->len, is_equal_to (2));
+  assert_that (g_ptr_array_index (ids, 0), is_equal_to_string ("1"));
+  assert_that (g_ptr_array_index (ids, 1), is_equal_to_string ("2"));
+
+  /* The version of the VTs sent wins over the one requested before. */
+  assert_that (version, is_equal_to_string ("3"));
+
+  canned_server_finish (&server, connection);
+  assert_that (server.requests->str, contains_string ("<get_vts/>"));
+  g_string_free (server.requests, TRUE);
+  g_ptr_array_free (ids, TRUE);
+  g_free (version);
+}
+
+Ensure (osp, osp_send_command_stream_keeps_no_streamed_vts)
+{
+  const char *responses[] = {VTS_RESPONSE, NULL};
+  struct canned_server server;
+  osp_connection_t *connection;
+  GPtrArray *ids;
+  entity_t entity, vts;
+
+  connection = canned_server_start (&server, responses);
+  assert_that (connection, is_not_null);
+  ids = g_ptr_array_new_with_free_func (g_free);
+  assert_that (osp_send_command_stream (connection, 2, collect_vt_id, ids,
+                                        &entity, "<get_vts/>"),
+               is_equal_to (0));
+  assert_that (ids->len, is_equal_to (2));
+
+  vts = entity_child (entity, "vts");
+  assert_that (vts, is_not_null);
+  assert_that (entity_attribute (vts, "vts_version"),
+               is_equal_to_string ("3"));
+  assert_that (entity_child (vts, "vt"), is_null);
+  free_entity (entity);
+
+  canned_server_finish (&server, connection);
+  g_string_free (server.requests, TRUE);
+  g_ptr_array_free (ids, TRUE);
+}
+
 Ensure (osp, osp_target_add_alive_test_methods)
 {
   osp_target_t *target;
@@ -110,7 +603,21 @@ main (int argc, char **argv)
   add_test_with_context (suite, osp, osp_new_target_never_returns_null);
   add_test_with_context (suite, osp, osp_get_vts_no_conn_ret_error);
   add_test_with_context (suite, osp, osp_get_vts_no_vts_ret_error);
+  add_test_with_context (suite, osp, osp_sync_vts_no_conn_ret_error);
+  add_test_with_context (suite, osp, osp_sync_vts_no_callback_ret_error);
   add_test_with_context (suite, osp, osp_new_conn_ret_null);
+  add_test_with_context (suite, osp,
+                         osp_connection_per_command_like_ospd);
+  add_test_with_context (suite, osp, osp_connection_new_resumes_tls_session);
+  add_test_with_context (suite, osp,
+                         osp_get_scan_pop_prints_scan_read_into_arena);
+  add_test_with_context (suite, osp,
+                         osp_sync_vts_sends_no_get_vts_for_cached_version);
+  add_test_with_context (suite, osp,
+                         osp_sync_vts_filters_by_modification_time);
+  add_test_with_context (suite, osp, osp_sync_vts_passes_each_vt_to_callback);
+  add_test_with_context (suite, osp,
+                         osp_send_command_stream_keeps_no_streamed_vts);
   add_test_with_context (suite, osp, osp_target_add_alive_test_methods);
   add_test_with_context (suite, osp, target_append_as_xml);
 
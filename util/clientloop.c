@@ -0,0 +1,570 @@
+/* Copyright (C) 2021 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * @brief Event loop for asynchronous GMP and OSP clients.
+ *
+ * A single thread drives many connections to managers or scanners.  The
+ * connections are registered with an epoll based loop, commands are queued
+ * per connection with a completion callback, and responses are parsed
+ * incrementally as data arrives.  Each connection has at most one command
+ * in flight, as GMP and OSP servers answer the commands of a connection in
+ * order, so the next queued command is sent when the response to the
+ * previous one is complete.
+ *
+ * The loop is not thread safe.  A typical caller queues commands and then
+ * runs the loop until all are complete:
+ *
+ *   while (gvm_client_loop_pending (loop))
+ *     gvm_client_loop_run (loop, -1);
+ */
+
+#include "clientloop.h"
+
+#include <errno.h>         /* for errno, EAGAIN, EINTR */
+#include <fcntl.h>         /* for fcntl, F_GETFL, F_SETFL, O_NONBLOCK */
+#include <gnutls/gnutls.h> /* for gnutls_record_recv, gnutls_record_send */
+#include <string.h>        /* for memcpy, strerror, strlen */
+#include <sys/epoll.h>     /* for epoll_create1, epoll_ctl, epoll_wait */
+#include <unistd.h>        /* for close, read, write */
+
+#undef G_LOG_DOMAIN
+/**
+ * @brief GLib logging domain.
+ */
+#define G_LOG_DOMAIN "libgvm util"
+
+/**
+ * @brief Maximum number of events handled per iteration of the loop.
+ */
+#define CLIENT_LOOP_EVENTS 64
+
+/**
+ * @brief Size of the buffer for reading from connections.
+ */
+#define CLIENT_LOOP_BUFFER_SIZE 65536
+
+/**
+ * @brief Event loop driving many client connections.
+ */
+struct gvm_client_loop
+{
+  int epoll;            ///< Epoll instance.
+  GList *clients;       ///< Registered clients.
+  GList *removed;       ///< Clients removed while dispatching events.
+  gboolean dispatching; ///< Whether events are being dispatched.
+  int pending;          ///< Number of commands awaiting completion.
+  char *buffer;         ///< Buffer for reading from connections.
+};
+
+/**
+ * @brief Command queued on a client.
+ */
+typedef struct
+{
+  gchar *data;                    ///< Command, compressed with the connection.
+  gsize length;                   ///< Length of data.
+  gvm_client_callback_t callback; ///< Called on completion, or NULL.
+  gpointer user_data;             ///< User data for callback.
+} client_command_t;
+
+/**
+ * @brief Client connection registered with an event loop.
+ */
+struct gvm_client
+{
+  gvm_client_loop_t *loop;     ///< Loop of the client.
+  gvm_connection_t connection; ///< Copy of the connection, not owned.
+  gvm_compress_stream_t *compression; ///< Compression of the connection.
+  int flags;                   ///< Status flags of the socket when added.
+  entity_parser_t *parser;     ///< Parser of the head command's response.
+  GQueue *commands;            ///< Queued commands, the head is in flight.
+  gsize sent;                  ///< Number of bytes of the head command sent.
+  guint32 events;              ///< Events the client waits for.
+  gboolean failed;             ///< Whether failed or removed.
+};
+
+/**
+ * @brief Set the events a client waits for.
+ *
+ * @param[in]  client  Client.
+ * @param[in]  events  Epoll events.
+ */
+static void
+client_watch (gvm_client_t *client, guint32 events)
+{
+  struct epoll_event event;
+
+  if (client->events == events)
+    return;
+
+  event.events = events;
+  event.data.ptr = client;
+  if (epoll_ctl (client->loop->epoll, EPOLL_CTL_MOD, client->connection.socket,
+                 &event))
+    g_warning ("%s: epoll_ctl: %s", __func__, strerror (errno));
+  else
+    client->events = events;
+}
+
+/**
+ * @brief Complete the head command of a client.
+ *
+ * @param[in]  client    Client.
+ * @param[in]  status    Status for the callback.
+ * @param[in]  response  Response, or NULL.
+ */
+static void
+client_complete (gvm_client_t *client, int status, entity_t response)
+{
+  client_command_t *command;
+
+  command = g_queue_pop_head (client->commands);
+  client->sent = 0;
+  client->loop->pending--;
+  if (command->callback)
+    command->callback (client, status, response, command->user_data);
+  g_free (command->data);
+  g_free (command);
+}
+
+/**
+ * @brief Stop using the connection of a client and complete its commands.
+ *
+ * @param[in]  client  Client.
+ * @param[in]  status  Status for the callbacks.
+ */
+static void
+client_fail (gvm_client_t *client, int status)
+{
+  if (client->failed)
+    return;
+
+  client->failed = TRUE;
+  if (epoll_ctl (client->loop->epoll, EPOLL_CTL_DEL, client->connection.socket,
+                 NULL))
+    g_warning ("%s: epoll_ctl: %s", __func__, strerror (errno));
+
+  while (!g_queue_is_empty (client->commands))
+    client_complete (client, status, NULL);
+}
+
+/**
+ * @brief Send as much of the head command of a client as possible.
+ *
+ * @param[in]  client  Client.
+ *
+ * @return 0 success, GVM_CLIENT_ERROR on error.
+ */
+static int
+client_write (gvm_client_t *client)
+{
+  client_command_t *command;
+
+  while ((command = g_queue_peek_head (client->commands))
+         && client->sent < command->length)
+    {
+      const char *data;
+      gsize left;
+      ssize_t count;
+
+      data = command->data + client->sent;
+      left = command->length - client->sent;
+      if (client->connection.tls)
+        {
+          /* A send that would block must be repeated with the same data,
+           * which stays at the head of the queue until it is sent. */
+          count = gnutls_record_send (client->connection.session, data, left);
+          if (count == GNUTLS_E_AGAIN)
+            {
+              client_watch (client, EPOLLIN | EPOLLOUT);
+              return 0;
+            }
+          if (count == GNUTLS_E_INTERRUPTED)
+            continue;
+          if (count < 0)
+            {
+              g_warning ("%s: Failed to write to server: %s", __func__,
+                         gnutls_strerror (count));
+              return GVM_CLIENT_ERROR;
+            }
+        }
+      else
+        {
+          count = write (client->connection.socket, data, left);
+          if (count < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                  client_watch (client, EPOLLIN | EPOLLOUT);
+                  return 0;
+                }
+              g_warning ("%s: Failed to write to server: %s", __func__,
+                         strerror (errno));
+              return GVM_CLIENT_ERROR;
+            }
+        }
+      client->sent += count;
+    }
+
+  client_watch (client, EPOLLIN);
+  return 0;
+}
+
+/**
+ * @brief Read and parse everything available on the connection of a client.
+ *
+ * @param[in]  client  Client.
+ *
+ * @return 0 success, else a GVM_CLIENT status to fail the client with.
+ */
+static int
+client_read (gvm_client_t *client)
+{
+  char *buffer = client->loop->buffer;
+
+  while (1)
+    {
+      client_command_t *command;
+      entity_t response;
+      ssize_t count;
+
+      if (client->connection.tls)
+        {
+          count = gnutls_record_recv (client->connection.session, buffer,
+                                      CLIENT_LOOP_BUFFER_SIZE);
+          if (count == GNUTLS_E_AGAIN)
+            return 0;
+          if (count == GNUTLS_E_INTERRUPTED || count == GNUTLS_E_REHANDSHAKE)
+            continue;
+          if (count < 0)
+            {
+              g_warning ("%s: Failed to read from server: %s", __func__,
+                         gnutls_strerror (count));
+              return GVM_CLIENT_ERROR;
+            }
+        }
+      else
+        {
+          count = read (client->connection.socket, buffer,
+                        CLIENT_LOOP_BUFFER_SIZE);
+          if (count < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+              g_warning ("%s: Failed to read from server: %s", __func__,
+                         strerror (errno));
+              return GVM_CLIENT_ERROR;
+            }
+        }
+
+      if (count == 0)
+        return GVM_CLIENT_CLOSED;
+
+      command = g_queue_peek_head (client->commands);
+      if (command == NULL || client->sent < command->length)
+        {
+          g_warning ("%s: Server sent data before a command", __func__);
+          return GVM_CLIENT_ERROR;
+        }
+
+      switch (entity_parser_feed (client->parser, buffer, count, &response))
+        {
+        case 0:
+          break;
+        case 1:
+          client_complete (client, GVM_CLIENT_OK, response);
+          free_entity (response);
+          if (client->failed)
+            return 0;
+          /* Send the next command. */
+          if (client_write (client))
+            return GVM_CLIENT_ERROR;
+          break;
+        default:
+          return GVM_CLIENT_PARSE;
+        }
+    }
+}
+
+/**
+ * @brief Free a client.
+ *
+ * @param[in]  client  Client.
+ */
+static void
+client_free (gvm_client_t *client)
+{
+  entity_parser_free (client->parser);
+  g_queue_free (client->commands);
+  g_free (client);
+}
+
+/**
+ * @brief Create an event loop for client connections.
+ *
+ * @return Event loop, to be freed with gvm_client_loop_free, or NULL on
+ *         error.
+ */
+gvm_client_loop_t *
+gvm_client_loop_new (void)
+{
+  gvm_client_loop_t *loop;
+  int epoll;
+
+  epoll = epoll_create1 (EPOLL_CLOEXEC);
+  if (epoll == -1)
+    {
+      g_warning ("%s: epoll_create1: %s", __func__, strerror (errno));
+      return NULL;
+    }
+
+  loop = g_malloc0 (sizeof (*loop));
+  loop->epoll = epoll;
+  loop->buffer = g_malloc (CLIENT_LOOP_BUFFER_SIZE);
+  return loop;
+}
+
+/**
+ * @brief Free an event loop, removing all its clients.
+ *
+ * Must not be called while the loop is running.
+ *
+ * @param[in]  loop  Event loop.
+ */
+void
+gvm_client_loop_free (gvm_client_loop_t *loop)
+{
+  if (loop == NULL)
+    return;
+
+  while (loop->clients)
+    gvm_client_loop_remove (loop->clients->data);
+
+  close (loop->epoll);
+  g_free (loop->buffer);
+  g_free (loop);
+}
+
+/**
+ * @brief Register a connection with an event loop.
+ *
+ * The socket of the connection is switched to non-blocking mode until the
+ * client is removed, and the connection must not be used directly in the
+ * meantime.  The connection stays owned by the caller, who closes it after
+ * removing the client.  Once the connection fails the client refuses
+ * further commands, and should be removed.
+ *
+ * @param[in]  loop        Event loop.
+ * @param[in]  connection  Open connection.
+ *
+ * @return Client, or NULL on error.
+ */
+gvm_client_t *
+gvm_client_loop_add (gvm_client_loop_t *loop,
+                     const gvm_connection_t *connection)
+{
+  struct epoll_event event;
+  gvm_client_t *client;
+  int flags;
+
+  if (loop == NULL || connection == NULL)
+    return NULL;
+
+  flags = fcntl (connection->socket, F_GETFL);
+  if (flags == -1
+      || fcntl (connection->socket, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+      g_warning ("%s: fcntl: %s", __func__, strerror (errno));
+      return NULL;
+    }
+
+  client = g_malloc0 (sizeof (*client));
+  client->loop = loop;
+  client->connection = *connection;
+  client->flags = flags;
+  client->events = EPOLLIN;
+
+  event.events = client->events;
+  event.data.ptr = client;
+  if (epoll_ctl (loop->epoll, EPOLL_CTL_ADD, connection->socket, &event))
+    {
+      g_warning ("%s: epoll_ctl: %s", __func__, strerror (errno));
+      fcntl (connection->socket, F_SETFL, flags);
+      g_free (client);
+      return NULL;
+    }
+
+  client->compression = gvm_connection_compression (connection);
+  client->parser = entity_parser_new (client->compression);
+  client->commands = g_queue_new ();
+  loop->clients = g_list_prepend (loop->clients, client);
+  return client;
+}
+
+/**
+ * @brief Remove a client from its event loop.
+ *
+ * Queued commands complete with GVM_CLIENT_CANCELLED.  The socket is
+ * switched back to its previous mode.  May be called from a callback.
+ *
+ * @param[in]  client  Client, freed by this function.
+ */
+void
+gvm_client_loop_remove (gvm_client_t *client)
+{
+  gvm_client_loop_t *loop;
+
+  if (client == NULL || g_list_find (client->loop->clients, client) == NULL)
+    return;
+
+  loop = client->loop;
+  loop->clients = g_list_remove (loop->clients, client);
+  client_fail (client, GVM_CLIENT_CANCELLED);
+  if (fcntl (client->connection.socket, F_SETFL, client->flags) == -1)
+    g_warning ("%s: fcntl: %s", __func__, strerror (errno));
+
+  /* Events of the client may still be waiting for dispatch. */
+  if (loop->dispatching)
+    loop->removed = g_list_prepend (loop->removed, client);
+  else
+    client_free (client);
+}
+
+/**
+ * @brief Wait for events and handle them.
+ *
+ * @param[in]  loop     Event loop.
+ * @param[in]  timeout  Time to wait for events in milliseconds, -1 to wait
+ *                      forever.
+ *
+ * @return Number of events handled, -1 on error.
+ */
+int
+gvm_client_loop_run (gvm_client_loop_t *loop, int timeout)
+{
+  struct epoll_event events[CLIENT_LOOP_EVENTS];
+  int count;
+
+  count = epoll_wait (loop->epoll, events, CLIENT_LOOP_EVENTS, timeout);
+  if (count == -1)
+    {
+      if (errno == EINTR)
+        return 0;
+      g_warning ("%s: epoll_wait: %s", __func__, strerror (errno));
+      return -1;
+    }
+
+  loop->dispatching = TRUE;
+  for (int index = 0; index < count; index++)
+    {
+      gvm_client_t *client = events[index].data.ptr;
+      int ret = 0;
+
+      if (client->failed)
+        continue;
+
+      if (events[index].events & EPOLLOUT)
+        ret = client_write (client);
+      if (ret == 0 && client->failed == FALSE
+          && events[index].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        ret = client_read (client);
+      if (ret)
+        client_fail (client, ret);
+    }
+  loop->dispatching = FALSE;
+
+  g_list_free_full (loop->removed, (GDestroyNotify) client_free);
+  loop->removed = NULL;
+
+  return count;
+}
+
+/**
+ * @brief Get the number of commands of a loop awaiting completion.
+ *
+ * @param[in]  loop  Event loop.
+ *
+ * @return Number of commands.
+ */
+int
+gvm_client_loop_pending (gvm_client_loop_t *loop)
+{
+  return loop->pending;
+}
+
+/**
+ * @brief Queue a command on a client.
+ *
+ * The command is sent by the loop once the responses to the commands
+ * queued before it are complete.  The callback is called from the loop,
+ * never from this function.
+ *
+ * @param[in]  client     Client.
+ * @param[in]  command    Command, e.g. "<get_version/>".
+ * @param[in]  callback   Called with the response, or NULL.
+ * @param[in]  user_data  User data for callback.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+gvm_client_send (gvm_client_t *client, const char *command,
+                 gvm_client_callback_t callback, gpointer user_data)
+{
+  client_command_t *queued;
+
+  if (client == NULL || command == NULL || client->failed)
+    return -1;
+
+  queued = g_malloc0 (sizeof (*queued));
+  if (client->compression)
+    {
+      const void *data;
+      unsigned long length;
+
+      data = gvm_compress_stream_deflate (client->compression, command,
+                                          strlen (command), &length);
+      if (data == NULL)
+        {
+          g_free (queued);
+          return -1;
+        }
+      queued->data = g_malloc (length);
+      memcpy (queued->data, data, length);
+      queued->length = length;
+    }
+  else
+    {
+      queued->length = strlen (command);
+      queued->data = g_strndup (command, queued->length);
+    }
+  queued->callback = callback;
+  queued->user_data = user_data;
+
+  g_queue_push_tail (client->commands, queued);
+  client->loop->pending++;
+  if (g_queue_get_length (client->commands) == 1)
+    client_watch (client, EPOLLIN | EPOLLOUT);
+  return 0;
+}
@@ -0,0 +1,88 @@
+/* Copyright (C) 2021 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * @brief API of an event loop for asynchronous GMP and OSP clients.
+ */
+
+#ifndef _GVM_CLIENTLOOP_H
+#define _GVM_CLIENTLOOP_H
+
+#include "serverutils.h"
+#include "xmlutils.h"
+
+#include <glib.h>
+
+/**
+ * @brief Event loop driving many client connections, see
+ *        gvm_client_loop_new.
+ */
+typedef struct gvm_client_loop gvm_client_loop_t;
+
+/**
+ * @brief Client connection registered with an event loop.
+ */
+typedef struct gvm_client gvm_client_t;
+
+/**
+ * @brief Error codes passed to a gvm_client_callback_t.
+ */
+enum gvm_client_status
+{
+  GVM_CLIENT_OK = 0,         ///< Response received.
+  GVM_CLIENT_ERROR = -1,     ///< Read or write error.
+  GVM_CLIENT_PARSE = -2,     ///< Response could not be parsed.
+  GVM_CLIENT_CLOSED = -3,    ///< Server closed the connection.
+  GVM_CLIENT_CANCELLED = -4, ///< Client removed from the loop.
+};
+
+/**
+ * @brief Completion callback of a command.
+ *
+ * Arguments are the client, the status, the response when the status is
+ * GVM_CLIENT_OK, else NULL, and the user data.  The response is freed when
+ * the callback returns.
+ */
+typedef void (*gvm_client_callback_t) (gvm_client_t *, int, entity_t,
+                                       gpointer);
+
+gvm_client_loop_t *
+gvm_client_loop_new (void);
+
+void
+gvm_client_loop_free (gvm_client_loop_t *);
+
+gvm_client_t *
+gvm_client_loop_add (gvm_client_loop_t *, const gvm_connection_t *);
+
+void
+gvm_client_loop_remove (gvm_client_t *);
+
+int
+gvm_client_loop_run (gvm_client_loop_t *, int);
+
+int
+gvm_client_loop_pending (gvm_client_loop_t *);
+
+int
+gvm_client_send (gvm_client_t *, const char *, gvm_client_callback_t,
+                 gpointer);
+
+#endif /* not _GVM_CLIENTLOOP_H */
@@ -0,0 +1,360 @@
+/* Copyright (C) 2021 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "clientloop.c"
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+#include <sys/socket.h>
+
+Describe (clientloop);
+BeforeEach (clientloop)
+{
+}
+AfterEach (clientloop)
+{
+}
+
+/**
+ * @brief Completions seen by record_completion.
+ */
+typedef struct
+{
+  GArray *statuses;         ///< Status of each completion, in order.
+  GString *names;           ///< Name of each response, or "-" if none.
+  gboolean remove_on_first; ///< Whether to remove the client on completion.
+} completions_t;
+
+/**
+ * @brief Record the completion of a command.
+ *
+ * @param[in]  client     Client.
+ * @param[in]  status     Status.
+ * @param[in]  response   Response, or NULL.
+ * @param[in]  user_data  Completions.
+ */
+static void
+record_completion (gvm_client_t *client, int status, entity_t response,
+                   gpointer user_data)
+{
+  completions_t *completions = user_data;
+
+  g_array_append_val (completions->statuses, status);
+  g_string_append_printf (completions->names, "%s ",
+                          response ? entity_name (response) : "-");
+  if (completions->remove_on_first)
+    {
+      completions->remove_on_first = FALSE;
+      gvm_client_loop_remove (client);
+    }
+}
+
+/**
+ * @brief Set up a loop with a client on one end of a socketpair.
+ *
+ * @param[out]  loop         Loop.
+ * @param[out]  sockets      Client and server end of the socketpair.
+ * @param[out]  completions  Completions, initialised.
+ *
+ * @return Client.
+ */
+static gvm_client_t *
+setup_client (gvm_client_loop_t **loop, int *sockets,
+              completions_t *completions)
+{
+  gvm_connection_t connection = {0};
+
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  connection.socket = sockets[0];
+  *loop = gvm_client_loop_new ();
+  assert_that (*loop, is_not_null);
+
+  completions->statuses = g_array_new (FALSE, FALSE, sizeof (int));
+  completions->names = g_string_new ("");
+  completions->remove_on_first = FALSE;
+
+  return gvm_client_loop_add (*loop, &connection);
+}
+
+/**
+ * @brief Free what setup_client set up.
+ *
+ * @param[in]  loop         Loop.
+ * @param[in]  sockets      Sockets.
+ * @param[in]  completions  Completions.
+ */
+static void
+teardown_client (gvm_client_loop_t *loop, int *sockets,
+                 completions_t *completions)
+{
+  gvm_client_loop_free (loop);
+  close (sockets[0]);
+  close (sockets[1]);
+  g_array_free (completions->statuses, TRUE);
+  g_string_free (completions->names, TRUE);
+}
+
+/**
+ * @brief Read a command of a given length on the server end.
+ *
+ * @param[in]  socket  Server end.
+ * @param[in]  length  Length of the command.
+ *
+ * @return The command.
+ */
+static GString *
+read_command (int socket, gsize length)
+{
+  GString *command;
+  char buffer[4096];
+
+  command = g_string_new ("");
+  while (command->len < length)
+    {
+      ssize_t count;
+
+      count = read (socket, buffer, MIN (sizeof (buffer),
+                                         length - command->len));
+      if (count <= 0)
+        break;
+      g_string_append_len (command, buffer, count);
+    }
+  return command;
+}
+
+/**
+ * @brief Run a loop until no commands are pending.
+ *
+ * @param[in]  loop  Loop.
+ */
+static void
+run_until_done (gvm_client_loop_t *loop)
+{
+  while (gvm_client_loop_pending (loop))
+    assert_that (gvm_client_loop_run (loop, 1000), is_not_equal_to (-1));
+}
+
+Ensure (clientloop, queued_commands_complete_in_order)
+{
+  gvm_client_loop_t *loop;
+  gvm_client_t *client;
+  completions_t completions;
+  GString *command;
+  int sockets[2];
+
+  client = setup_client (&loop, sockets, &completions);
+  assert_that (client, is_not_null);
+
+  assert_that (gvm_client_send (client, "<first/>", record_completion,
+                                &completions),
+               is_equal_to (0));
+  assert_that (gvm_client_send (client, "<second/>", record_completion,
+                                &completions),
+               is_equal_to (0));
+  assert_that (gvm_client_loop_pending (loop), is_equal_to (2));
+
+  /* Only the first command is in flight. */
+  assert_that (gvm_client_loop_run (loop, 1000), is_equal_to (1));
+  command = read_command (sockets[1], strlen ("<first/>"));
+  assert_that (command->str, is_equal_to_string ("<first/>"));
+  g_string_free (command, TRUE);
+
+  /* Its response is split, and sends the second command when complete. */
+  assert_that (write (sockets[1], "<first_response", 15), is_equal_to (15));
+  assert_that (gvm_client_loop_run (loop, 1000), is_equal_to (1));
+  assert_that (completions.statuses->len, is_equal_to (0));
+  assert_that (write (sockets[1], "/>", 2), is_equal_to (2));
+  assert_that (gvm_client_loop_run (loop, 1000), is_equal_to (1));
+  assert_that (completions.statuses->len, is_equal_to (1));
+
+  command = read_command (sockets[1], strlen ("<second/>"));
+  assert_that (command->str, is_equal_to_string ("<second/>"));
+  g_string_free (command, TRUE);
+  assert_that (write (sockets[1], "<second_response/>", 18), is_equal_to (18));
+  run_until_done (loop);
+
+  assert_that (completions.statuses->len, is_equal_to (2));
+  assert_that (g_array_index (completions.statuses, int, 0),
+               is_equal_to (GVM_CLIENT_OK));
+  assert_that (g_array_index (completions.statuses, int, 1),
+               is_equal_to (GVM_CLIENT_OK));
+  assert_that (completions.names->str,
+               is_equal_to_string ("first_response second_response "));
+
+  teardown_client (loop, sockets, &completions);
+}
+
+Ensure (clientloop, partial_write_resumes_after_eagain)
+{
+  gvm_client_loop_t *loop;
+  gvm_client_t *client;
+  completions_t completions;
+  GString *large, *command;
+  int sockets[2], size;
+
+  client = setup_client (&loop, sockets, &completions);
+  assert_that (client, is_not_null);
+
+  /* A command much larger than the socket buffer. */
+  size = 4096;
+  assert_that (setsockopt (sockets[0], SOL_SOCKET, SO_SNDBUF, &size,
+                           sizeof (size)),
+               is_equal_to (0));
+  large = g_string_new ("<large>");
+  while (large->len < 1024 * 1024)
+    g_string_append (large, "Data which does not fit into the socket. ");
+  g_string_append (large, "</large>");
+  assert_that (gvm_client_send (client, large->str, record_completion,
+                                &completions),
+               is_equal_to (0));
+
+  /* The first write stops when the socket is full. */
+  assert_that (gvm_client_loop_run (loop, 1000), is_equal_to (1));
+  assert_that (client->sent, is_greater_than (0));
+  assert_that (client->sent, is_less_than (large->len));
+  assert_that (client->events & EPOLLOUT, is_not_equal_to (0));
+
+  /* Reading the server end lets the loop send the rest. */
+  command = g_string_new ("");
+  while (command->len < large->len)
+    {
+      char buffer[65536];
+      ssize_t count;
+
+      count = recv (sockets[1], buffer, sizeof (buffer), MSG_DONTWAIT);
+      if (count > 0)
+        g_string_append_len (command, buffer, count);
+      assert_that (gvm_client_loop_run (loop, 10), is_not_equal_to (-1));
+    }
+  assert_that (command->str, is_equal_to_string (large->str));
+  assert_that (client->events & EPOLLOUT, is_equal_to (0));
+
+  assert_that (write (sockets[1], "<large_response/>", 17), is_equal_to (17));
+  run_until_done (loop);
+  assert_that (g_array_index (completions.statuses, int, 0),
+               is_equal_to (GVM_CLIENT_OK));
+
+  g_string_free (command, TRUE);
+  g_string_free (large, TRUE);
+  teardown_client (loop, sockets, &completions);
+}
+
+Ensure (clientloop, server_close_mid_response_fails_commands)
+{
+  gvm_client_loop_t *loop;
+  gvm_client_t *client;
+  completions_t completions;
+  GString *command;
+  int sockets[2];
+
+  client = setup_client (&loop, sockets, &completions);
+  assert_that (client, is_not_null);
+
+  assert_that (gvm_client_send (client, "<get_vts/>", record_completion,
+                                &completions),
+               is_equal_to (0));
+  assert_that (gvm_client_send (client, "<get_scans/>", record_completion,
+                                &completions),
+               is_equal_to (0));
+  assert_that (gvm_client_loop_run (loop, 1000), is_equal_to (1));
+  command = read_command (sockets[1], strlen ("<get_vts/>"));
+  g_string_free (command, TRUE);
+
+  assert_that (write (sockets[1], "<get_vts_response><vts>", 23),
+               is_equal_to (23));
+  shutdown (sockets[1], SHUT_RDWR);
+  run_until_done (loop);
+
+  assert_that (completions.statuses->len, is_equal_to (2));
+  assert_that (g_array_index (completions.statuses, int, 0),
+               is_equal_to (GVM_CLIENT_CLOSED));
+  assert_that (g_array_index (completions.statuses, int, 1),
+               is_equal_to (GVM_CLIENT_CLOSED));
+  assert_that (completions.names->str, is_equal_to_string ("- - "));
+
+  /* The failed client refuses further commands. */
+  assert_that (gvm_client_send (client, "<get_vts/>", NULL, NULL),
+               is_equal_to (-1));
+
+  teardown_client (loop, sockets, &completions);
+}
+
+Ensure (clientloop, remove_from_callback_cancels_remaining_commands)
+{
+  gvm_client_loop_t *loop;
+  gvm_client_t *client;
+  completions_t completions;
+  GString *command;
+  int sockets[2];
+
+  client = setup_client (&loop, sockets, &completions);
+  assert_that (client, is_not_null);
+  completions.remove_on_first = TRUE;
+
+  assert_that (gvm_client_send (client, "<first/>", record_completion,
+                                &completions),
+               is_equal_to (0));
+  assert_that (gvm_client_send (client, "<second/>", record_completion,
+                                &completions),
+               is_equal_to (0));
+  assert_that (gvm_client_loop_run (loop, 1000), is_equal_to (1));
+  command = read_command (sockets[1], strlen ("<first/>"));
+  g_string_free (command, TRUE);
+
+  assert_that (write (sockets[1], "<first_response/>", 17), is_equal_to (17));
+  run_until_done (loop);
+
+  assert_that (completions.statuses->len, is_equal_to (2));
+  assert_that (g_array_index (completions.statuses, int, 0),
+               is_equal_to (GVM_CLIENT_OK));
+  assert_that (g_array_index (completions.statuses, int, 1),
+               is_equal_to (GVM_CLIENT_CANCELLED));
+  assert_that (completions.names->str,
+               is_equal_to_string ("first_response - "));
+  assert_that (loop->clients, is_null);
+
+  /* The socket is blocking again. */
+  assert_that (fcntl (sockets[0], F_GETFL) & O_NONBLOCK, is_equal_to (0));
+
+  teardown_client (loop, sockets, &completions);
+}
+
+/* Test suite. */
+
+int
+main (int argc, char **argv)
+{
+  TestSuite *suite;
+
+  suite = create_test_suite ();
+
+  add_test_with_context (suite, clientloop,
+                         queued_commands_complete_in_order);
+  add_test_with_context (suite, clientloop,
+                         partial_write_resumes_after_eagain);
+  add_test_with_context (suite, clientloop,
+                         server_close_mid_response_fails_commands);
+  add_test_with_context (suite, clientloop,
+                         remove_from_callback_cancels_remaining_commands);
+
+  if (argc > 1)
+    return run_single_test (suite, argv[1], create_text_reporter ());
+
+  return run_test_suite (suite, create_text_reporter ());
+}
@@ -31,8 +31,10 @@
 
 #include "compressutils.h"
 
-#include <glib.h> /* for g_free, g_malloc0 */
-#include <zlib.h> /* for z_stream, Z_NULL, Z_OK, Z_BUF_ERROR, Z_STREAM_END */
+#include <errno.h>  /* for errno */
+#include <glib.h>   /* for g_free, g_malloc0, g_byte_array_set_size */
+#include <string.h> /* for memcpy, strerror */
+#include <zlib.h>   /* for z_stream, Z_NULL, Z_OK, Z_BUF_ERROR, Z_STREAM_END */
 
 #undef G_LOG_DOMAIN
 /**
@@ -178,9 +180,401 @@ gvm_uncompress (const void *src, unsigned long srclen, unsigned long *dstlen)
     }
 }
 
+/**
+ * @brief Size of the steps in which stream output buffers grow.
+ */
+#define COMPRESS_STREAM_CHUNK 16384
+
+/**
+ * @brief Size of the blocks a gzip writer compresses independently.
+ */
+#define GZIP_BLOCK_SIZE (128 * 1024)
+
+/**
+ * @brief Size of the deflate window, the dictionary of the next block.
+ */
+#define GZIP_DICT_SIZE (32 * 1024)
+
+/**
+ * @brief Block of a gzip writer, compressed by a worker thread.
+ */
+typedef struct
+{
+  gvm_gzip_writer_t *writer; ///< Writer.
+  guchar *input;             ///< Dictionary followed by the block.
+  unsigned long dictlen;     ///< Length of the dictionary.
+  unsigned long len;         ///< Length of the block.
+  gboolean last;             ///< Whether this is the last block.
+  GByteArray *output;        ///< Raw deflate data of the block.
+  uLong crc;                 ///< CRC-32 of the block.
+  gboolean error;            ///< Whether compressing failed.
+  gboolean done;             ///< Whether the job finished.  Under mutex.
+} compress_job_t;
+
+/**
+ * @brief Parallel gzip compressor.
+ */
+struct gvm_gzip_writer
+{
+  int level;                 ///< Compression level.
+  int threads;               ///< Maximum number of blocks in flight.
+  gvm_compress_sink_t sink;  ///< Receives the compressed data.
+  void *sink_data;           ///< User data for sink.
+  guchar *block;             ///< Dictionary and block being filled.
+  unsigned long dictlen;     ///< Length of the dictionary in block.
+  unsigned long blocklen;    ///< Length of the data in block.
+  GThreadPool *pool;         ///< Workers, NULL until the second block.
+  GQueue jobs;               ///< Blocks in flight, in order.
+  GMutex mutex;              ///< Protects the done flags of the jobs.
+  GCond cond;                ///< Signalled when a job is done.
+  uLong crc;                 ///< CRC-32 of the data written out.
+  uLong total;               ///< Length of the data written out.
+  gboolean error;            ///< Whether compressing or the sink failed.
+};
+
+/**
+ * @brief Compress a block as raw deflate data.
+ *
+ * Every block but the last ends with a sync flush, so that the blocks can
+ * be concatenated.  Using the end of the previous block as dictionary keeps
+ * the compression ratio close to that of a single stream.
+ *
+ * @param[in]  job  Job.
+ */
+static void
+compress_job_run (compress_job_t *job)
+{
+  z_stream strm;
+  uLong bound;
+
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  if (deflateInit2 (&strm, job->writer->level, Z_DEFLATED, -15, 8,
+                    Z_DEFAULT_STRATEGY)
+      != Z_OK)
+    {
+      job->error = TRUE;
+      return;
+    }
+  if (job->dictlen)
+    deflateSetDictionary (&strm, job->input, job->dictlen);
+
+  strm.next_in = job->input + job->dictlen;
+  strm.avail_in = job->len;
+  /* Room for the sync flush marker as well. */
+  bound = deflateBound (&strm, job->len) + 16;
+  g_byte_array_set_size (job->output, bound);
+  strm.next_out = job->output->data;
+  strm.avail_out = bound;
+
+  for (;;)
+    {
+      int err;
+      uLong used;
+
+      err = deflate (&strm, job->last ? Z_FINISH : Z_SYNC_FLUSH);
+      if (err == Z_STREAM_ERROR)
+        {
+          job->error = TRUE;
+          break;
+        }
+      if (job->last ? err == Z_STREAM_END : strm.avail_out != 0)
+        break;
+
+      used = strm.total_out;
+      g_byte_array_set_size (job->output, used + COMPRESS_STREAM_CHUNK);
+      strm.next_out = job->output->data + used;
+      strm.avail_out = COMPRESS_STREAM_CHUNK;
+    }
+  g_byte_array_set_size (job->output, strm.total_out);
+  deflateEnd (&strm);
+
+  job->crc = crc32 (crc32 (0L, Z_NULL, 0), job->input + job->dictlen, job->len);
+}
+
+/**
+ * @brief Compress a block in a worker thread of a gzip writer.
+ *
+ * @param[in]  data       Job.
+ * @param[in]  user_data  Unused.
+ */
+static void
+compress_job_thread (gpointer data, gpointer user_data)
+{
+  compress_job_t *job = data;
+
+  (void) user_data;
+  compress_job_run (job);
+
+  g_mutex_lock (&job->writer->mutex);
+  job->done = TRUE;
+  g_cond_broadcast (&job->writer->cond);
+  g_mutex_unlock (&job->writer->mutex);
+}
+
+/**
+ * @brief Free a job.
+ *
+ * @param[in]  job  Job.
+ */
+static void
+compress_job_free (compress_job_t *job)
+{
+  g_free (job->input);
+  g_byte_array_free (job->output, TRUE);
+  g_free (job);
+}
+
+/**
+ * @brief Pass the blocks that are done to the sink, in order.
+ *
+ * @param[in]  writer  Writer.
+ * @param[in]  keep    Wait until at most this many blocks are in flight.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+gzip_writer_drain (gvm_gzip_writer_t *writer, guint keep)
+{
+  compress_job_t *job;
+
+  while ((job = g_queue_peek_head (&writer->jobs)))
+    {
+      gboolean done;
+
+      g_mutex_lock (&writer->mutex);
+      while (!job->done && writer->jobs.length > keep)
+        g_cond_wait (&writer->cond, &writer->mutex);
+      done = job->done;
+      g_mutex_unlock (&writer->mutex);
+      if (!done)
+        break;
+
+      g_queue_pop_head (&writer->jobs);
+      if (job->error)
+        {
+          g_warning ("%s: Failed to compress block", __func__);
+          writer->error = TRUE;
+        }
+      else if (!writer->error)
+        {
+          if (writer->sink (job->output->data, job->output->len,
+                            writer->sink_data))
+            writer->error = TRUE;
+          writer->crc = crc32_combine (writer->crc, job->crc, job->len);
+          writer->total += job->len;
+        }
+      compress_job_free (job);
+    }
+
+  return writer->error ? -1 : 0;
+}
+
+/**
+ * @brief Hand the current block of a gzip writer to the workers.
+ *
+ * @param[in]  writer  Writer.
+ * @param[in]  last    Whether this is the last block.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+gzip_writer_submit (gvm_gzip_writer_t *writer, gboolean last)
+{
+  compress_job_t *job;
+
+  job = g_malloc0 (sizeof (*job));
+  job->writer = writer;
+  job->input = writer->block;
+  job->dictlen = writer->dictlen;
+  job->len = writer->blocklen;
+  job->last = last;
+  job->output = g_byte_array_new ();
+
+  writer->block = NULL;
+  writer->dictlen = writer->blocklen = 0;
+  if (!last)
+    {
+      unsigned long window;
+
+      /* The end of the data so far is the dictionary of the next block. */
+      window = MIN (GZIP_DICT_SIZE, job->dictlen + job->len);
+      writer->block = g_malloc (GZIP_DICT_SIZE + GZIP_BLOCK_SIZE);
+      memcpy (writer->block, job->input + job->dictlen + job->len - window,
+              window);
+      writer->dictlen = window;
+    }
+
+  if (writer->threads <= 1 || (last && g_queue_is_empty (&writer->jobs)))
+    {
+      /* A single block is not worth a thread. */
+      compress_job_run (job);
+      job->done = TRUE;
+      g_queue_push_tail (&writer->jobs, job);
+    }
+  else
+    {
+      if (writer->pool == NULL)
+        /* Exclusive, because shared pool threads do not survive a fork. */
+        writer->pool = g_thread_pool_new (compress_job_thread, NULL,
+                                          writer->threads, TRUE, NULL);
+      g_queue_push_tail (&writer->jobs, job);
+      g_thread_pool_push (writer->pool, job, NULL);
+    }
+
+  return gzip_writer_drain (writer, last ? 0 : writer->threads - 1);
+}
+
+/**
+ * @brief Create a parallel gzip compressor.
+ *
+ * The data is split into blocks that are compressed independently by
+ * worker threads, like pigz does, and passed to the sink in order as a
+ * single gzip stream.  Memory use is bounded by the number of blocks in
+ * flight, whatever the size of the data.
+ *
+ * @param[in]  level      Compression level, 0 to 9, or -1 for the default.
+ * @param[in]  threads    Number of blocks compressed in parallel, 0 for the
+ *                        number of processors.
+ * @param[in]  sink       Called with each piece of compressed data.
+ * @param[in]  sink_data  User data for sink.
+ *
+ * @return Writer, to be finished with gvm_gzip_writer_finish, or NULL on
+ *         error.
+ */
+gvm_gzip_writer_t *
+gvm_gzip_writer_new (int level, int threads, gvm_compress_sink_t sink,
+                     void *sink_data)
+{
+  gvm_gzip_writer_t *writer;
+  /* Magic, deflate, no flags, no time, OS Unix. */
+  guchar header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3};
+
+  if (sink == NULL || level < Z_DEFAULT_COMPRESSION || level > 9)
+    return NULL;
+
+  /* Extra flags as zlib sets them. */
+  if (level == 9)
+    header[8] = 2;
+  else if (level == 1)
+    header[8] = 4;
+  if (sink (header, sizeof (header), sink_data))
+    return NULL;
+
+  writer = g_malloc0 (sizeof (*writer));
+  writer->level = level;
+  writer->threads = threads > 0 ? threads : (int) g_get_num_processors ();
+  writer->sink = sink;
+  writer->sink_data = sink_data;
+  writer->block = g_malloc (GZIP_DICT_SIZE + GZIP_BLOCK_SIZE);
+  g_queue_init (&writer->jobs);
+  g_mutex_init (&writer->mutex);
+  g_cond_init (&writer->cond);
+  writer->crc = crc32 (0L, Z_NULL, 0);
+  return writer;
+}
+
+/**
+ * @brief Compress data with a gzip writer.
+ *
+ * @param[in]  writer  Writer.
+ * @param[in]  src     Data to compress.
+ * @param[in]  srclen  Length of data.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_gzip_writer_write (gvm_gzip_writer_t *writer, const void *src,
+                       unsigned long srclen)
+{
+  const guchar *data = src;
+
+  if (writer == NULL || (src == NULL && srclen))
+    return -1;
+
+  while (srclen && !writer->error)
+    {
+      unsigned long count;
+
+      count = MIN (srclen, GZIP_BLOCK_SIZE - writer->blocklen);
+      memcpy (writer->block + writer->dictlen + writer->blocklen, data, count);
+      writer->blocklen += count;
+      data += count;
+      srclen -= count;
+      if (writer->blocklen == GZIP_BLOCK_SIZE)
+        gzip_writer_submit (writer, FALSE);
+    }
+
+  return writer->error ? -1 : 0;
+}
+
+/**
+ * @brief Compress the rest of the data, end the gzip stream and free the
+ *        writer.
+ *
+ * Must be called for every writer, also after errors.
+ *
+ * @param[in]  writer  Writer.
+ *
+ * @return 0 on success, -1 if this or an earlier call failed.
+ */
+int
+gvm_gzip_writer_finish (gvm_gzip_writer_t *writer)
+{
+  guchar trailer[8];
+  int rc;
+
+  if (writer == NULL)
+    return -1;
+
+  if (!writer->error)
+    gzip_writer_submit (writer, TRUE);
+  gzip_writer_drain (writer, 0);
+  if (writer->pool)
+    g_thread_pool_free (writer->pool, FALSE, TRUE);
+
+  rc = writer->error ? -1 : 0;
+  if (rc == 0)
+    {
+      /* CRC-32 and length of the data, little endian. */
+      for (int index = 0; index < 4; index++)
+        {
+          trailer[index] = (writer->crc >> (8 * index)) & 0xff;
+          trailer[4 + index] = (writer->total >> (8 * index)) & 0xff;
+        }
+      if (writer->sink (trailer, sizeof (trailer), writer->sink_data))
+        rc = -1;
+    }
+
+  g_mutex_clear (&writer->mutex);
+  g_cond_clear (&writer->cond);
+  g_free (writer->block);
+  g_free (writer);
+  return rc;
+}
+
+/**
+ * @brief Sink that appends to a GByteArray.
+ *
+ * @param[in]  data   Data.
+ * @param[in]  len    Length of data.
+ * @param[in]  array  GByteArray.
+ *
+ * @return 0.
+ */
+static int
+byte_array_sink (const void *data, unsigned long len, void *array)
+{
+  g_byte_array_append (array, data, len);
+  return 0;
+}
+
 /**
  * @brief Compresses data in src buffer, gzip format compatible.
  *
+ * Large buffers are compressed on all processors, see gvm_gzip_writer_new.
+ *
  * @param[in]   src     Buffer of data to compress.
  * @param[in]   srclen  Length of data to compress.
  * @param[out]  dstlen  Length of compressed data.
@@ -191,63 +585,446 @@ void *
 gvm_compress_gzipheader (const void *src, unsigned long srclen,
                          unsigned long *dstlen)
 {
-  unsigned long buflen = srclen * 2;
-  int windowsBits = 15;
-  int GZIP_ENCODING = 16;
+  gvm_gzip_writer_t *writer;
+  GByteArray *compressed;
+  int rc;
 
   if (src == NULL || dstlen == NULL)
     return NULL;
 
-  if (buflen < 30)
-    buflen = 30;
+  /* Reports usually compress to well below a quarter. */
+  compressed = g_byte_array_sized_new (MIN (srclen / 4, G_MAXINT) + 64);
+  writer = gvm_gzip_writer_new (Z_DEFAULT_COMPRESSION, 0, byte_array_sink,
+                                compressed);
+  if (writer == NULL)
+    {
+      g_byte_array_free (compressed, TRUE);
+      return NULL;
+    }
+  rc = gvm_gzip_writer_write (writer, src, srclen);
+  if (gvm_gzip_writer_finish (writer) || rc)
+    {
+      g_byte_array_free (compressed, TRUE);
+      return NULL;
+    }
 
-  while (1)
+  *dstlen = compressed->len;
+  return g_byte_array_free (compressed, FALSE);
+}
+
+/**
+ * @brief Size of the output buffer of an uncompress stream.
+ */
+#define UNCOMPRESS_CHUNK (64 * 1024)
+
+/**
+ * @brief State of a streaming decompression.
+ */
+struct gvm_uncompress_stream
+{
+  z_stream strm;             ///< Inflate state.
+  gvm_compress_sink_t sink;  ///< Receives the uncompressed data.
+  void *sink_data;           ///< User data for sink.
+  unsigned long max;         ///< Maximum length of output, 0 for no limit.
+  int status;                ///< 0, or the error of an earlier call.
+  gboolean ended;            ///< Whether the end of the data was reached.
+  guchar out[UNCOMPRESS_CHUNK]; ///< Output buffer.
+};
+
+/**
+ * @brief Create a streaming decompression.
+ *
+ * Accepts zlib and gzip data.  The data is uncompressed in pieces of a
+ * fixed size which are passed to the sink, so memory use does not depend on
+ * the length of the data.
+ *
+ * @param[in]  max        Maximum length of the output, 0 for no limit.
+ *                        Protects against decompression bombs.
+ * @param[in]  sink       Called with each piece of uncompressed data.
+ * @param[in]  sink_data  User data for sink.
+ *
+ * @return Stream, to be finished with gvm_uncompress_stream_finish, or NULL
+ *         on error.
+ */
+gvm_uncompress_stream_t *
+gvm_uncompress_stream_new (unsigned long max, gvm_compress_sink_t sink,
+                           void *sink_data)
+{
+  gvm_uncompress_stream_t *stream;
+
+  if (sink == NULL)
+    return NULL;
+
+  stream = g_malloc0 (sizeof (*stream));
+  /* Add 32 to windowBits for automatic zlib and gzip header detection. */
+  if (inflateInit2 (&stream->strm, 15 + 32) != Z_OK)
     {
+      g_free (stream);
+      return NULL;
+    }
+  stream->sink = sink;
+  stream->sink_data = sink_data;
+  stream->max = max;
+  return stream;
+}
+
+/**
+ * @brief Uncompress the next piece of data of a streaming decompression.
+ *
+ * Data after the end of the compressed data is ignored, as in
+ * gvm_uncompress.
+ *
+ * @param[in]  stream  Stream.
+ * @param[in]  src     Compressed data.
+ * @param[in]  srclen  Length of compressed data.
+ *
+ * @return 0 on success, -1 on error, -2 if the output exceeds the maximum.
+ *         Once a call failed, all further calls fail the same way.
+ */
+int
+gvm_uncompress_stream_write (gvm_uncompress_stream_t *stream, const void *src,
+                             unsigned long srclen)
+{
+  z_stream *strm;
+
+  if (stream == NULL || (src == NULL && srclen))
+    return -1;
+
+  strm = &stream->strm;
+#ifdef z_const
+  strm->next_in = src;
+#else
+  /* Workaround for older zlib. */
+  strm->next_in = (void *) src;
+#endif
+  strm->avail_in = srclen;
+
+  while (stream->status == 0 && !stream->ended
+         && (strm->avail_in || strm->avail_out == 0))
+    {
+      unsigned long len;
       int err;
-      void *buffer;
-      z_stream strm;
 
-      /* Initialize deflate state */
-      strm.zalloc = Z_NULL;
-      strm.zfree = Z_NULL;
-      strm.opaque = Z_NULL;
-      strm.avail_in = srclen;
+      strm->next_out = stream->out;
+      strm->avail_out = sizeof (stream->out);
+      err = inflate (strm, Z_NO_FLUSH);
+      if (err == Z_STREAM_END)
+        stream->ended = TRUE;
+      else if (err != Z_OK && err != Z_BUF_ERROR)
+        {
+          g_debug ("%s: inflate failed: %s", __func__,
+                   strm->msg ? strm->msg : "unknown error");
+          stream->status = -1;
+          break;
+        }
+
+      len = sizeof (stream->out) - strm->avail_out;
+      if (stream->max && strm->total_out > stream->max)
+        {
+          g_warning ("%s: Uncompressed data exceeds %lu bytes", __func__,
+                     stream->max);
+          stream->status = -2;
+        }
+      else if (len && stream->sink (stream->out, len, stream->sink_data))
+        stream->status = -1;
+    }
+
+  /* Do not keep a pointer into the caller's buffer. */
+  strm->next_in = Z_NULL;
+  strm->avail_in = 0;
+  return stream->status;
+}
+
+/**
+ * @brief End a streaming decompression and free it.
+ *
+ * Must be called for every stream, also after errors.  Like gvm_uncompress,
+ * this accepts data without end marker, as gvm_compress produces it.
+ *
+ * @param[in]   stream  Stream.
+ * @param[out]  dstlen  Length of uncompressed data, or NULL.
+ *
+ * @return 0 on success, -1 on error, -2 if the output exceeded the maximum.
+ */
+int
+gvm_uncompress_stream_finish (gvm_uncompress_stream_t *stream,
+                              unsigned long *dstlen)
+{
+  int rc;
+
+  if (stream == NULL)
+    return -1;
+
+  rc = stream->status;
+  if (dstlen)
+    *dstlen = stream->strm.total_out;
+
+  inflateEnd (&stream->strm);
+  g_free (stream);
+  return rc;
+}
+
+/**
+ * @brief Uncompresses data in src buffer to a sink.
+ *
+ * Unlike gvm_uncompress, the uncompressed data is never held in memory as a
+ * whole.
+ *
+ * @param[in]   src        Buffer of data to uncompress, zlib or gzip.
+ * @param[in]   srclen     Length of data to uncompress.
+ * @param[in]   max        Maximum length of the output, 0 for no limit.
+ * @param[in]   sink       Called with each piece of uncompressed data.
+ * @param[in]   sink_data  User data for sink.
+ * @param[out]  dstlen     Length of uncompressed data, or NULL.
+ *
+ * @return 0 on success, -1 on error, -2 if the output exceeds the maximum.
+ */
+int
+gvm_uncompress_to_sink (const void *src, unsigned long srclen,
+                        unsigned long max, gvm_compress_sink_t sink,
+                        void *sink_data, unsigned long *dstlen)
+{
+  gvm_uncompress_stream_t *stream;
+
+  if (src == NULL)
+    return -1;
+
+  stream = gvm_uncompress_stream_new (max, sink, sink_data);
+  if (stream == NULL)
+    return -1;
+  gvm_uncompress_stream_write (stream, src, srclen);
+  return gvm_uncompress_stream_finish (stream, dstlen);
+}
+
+/**
+ * @brief Sink that writes to a FILE.
+ *
+ * @param[in]  data  Data.
+ * @param[in]  len   Length of data.
+ * @param[in]  file  FILE.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+file_sink (const void *data, unsigned long len, void *file)
+{
+  if (fwrite (data, 1, len, file) != len)
+    {
+      g_warning ("%s: Failed to write uncompressed data: %s", __func__,
+                 strerror (errno));
+      return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Uncompresses a file to another file.
+ *
+ * Reads and writes in pieces, so memory use does not depend on the length
+ * of the data.
+ *
+ * @param[in]   in      File to read zlib or gzip data from.
+ * @param[in]   out     File to write the uncompressed data to.
+ * @param[in]   max     Maximum length of the output, 0 for no limit.
+ * @param[out]  dstlen  Length of uncompressed data, or NULL.
+ *
+ * @return 0 on success, -1 on error, -2 if the output exceeds the maximum.
+ */
+int
+gvm_uncompress_file (FILE *in, FILE *out, unsigned long max,
+                     unsigned long *dstlen)
+{
+  gvm_uncompress_stream_t *stream;
+  guchar buffer[UNCOMPRESS_CHUNK];
+  size_t count;
+
+  if (in == NULL || out == NULL)
+    return -1;
+
+  stream = gvm_uncompress_stream_new (max, file_sink, out);
+  if (stream == NULL)
+    return -1;
+
+  while ((count = fread (buffer, 1, sizeof (buffer), in)) > 0)
+    if (gvm_uncompress_stream_write (stream, buffer, count))
+      break;
+  if (ferror (in))
+    {
+      g_warning ("%s: Failed to read compressed data: %s", __func__,
+                 strerror (errno));
+      gvm_uncompress_stream_finish (stream, dstlen);
+      return -1;
+    }
+
+  return gvm_uncompress_stream_finish (stream, dstlen);
+}
+
+/**
+ * @brief State of a compressed stream in both directions.
+ */
+struct gvm_compress_stream
+{
+  z_stream deflate;     /**< Outgoing stream. */
+  z_stream inflate;     /**< Incoming stream. */
+  GByteArray *deflated; /**< Output of the last deflate call. */
+  GByteArray *inflated; /**< Output of the last inflate call. */
+};
+
+/**
+ * @brief Create the state of a compressed stream.
+ *
+ * Both directions use the zlib format.  Every chunk that is deflated is
+ * flushed to a byte boundary, so that the peer can inflate and process it
+ * without waiting for more data.
+ *
+ * @param[in]  level  Compression level, 0 to 9, or -1 for the default.
+ *
+ * @return Stream state, NULL on error.
+ */
+gvm_compress_stream_t *
+gvm_compress_stream_new (int level)
+{
+  gvm_compress_stream_t *stream;
+
+  stream = g_malloc0 (sizeof (*stream));
+  if (deflateInit (&stream->deflate, level) != Z_OK)
+    {
+      g_free (stream);
+      return NULL;
+    }
+  if (inflateInit (&stream->inflate) != Z_OK)
+    {
+      deflateEnd (&stream->deflate);
+      g_free (stream);
+      return NULL;
+    }
+  stream->deflated = g_byte_array_sized_new (COMPRESS_STREAM_CHUNK);
+  stream->inflated = g_byte_array_sized_new (COMPRESS_STREAM_CHUNK);
+  return stream;
+}
+
+/**
+ * @brief Free the state of a compressed stream.
+ *
+ * @param[in]  stream  Stream state.
+ */
+void
+gvm_compress_stream_free (gvm_compress_stream_t *stream)
+{
+  if (stream == NULL)
+    return;
+
+  deflateEnd (&stream->deflate);
+  inflateEnd (&stream->inflate);
+  g_byte_array_free (stream->deflated, TRUE);
+  g_byte_array_free (stream->inflated, TRUE);
+  g_free (stream);
+}
+
+/**
+ * @brief Run a zlib stream over some input until all output is produced.
+ *
+ * @param[in]  strm       zlib stream.
+ * @param[in]  deflating  Whether to deflate, else inflate.
+ * @param[in]  src        Input.
+ * @param[in]  srclen     Length of input.
+ * @param[in]  output     Buffer that receives the output.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+compress_stream_run (z_stream *strm, int deflating, const void *src,
+                     unsigned long srclen, GByteArray *output)
+{
+  g_byte_array_set_size (output, 0);
+
+  strm->avail_in = srclen;
 #ifdef z_const
-      strm.next_in = src;
+  strm->next_in = src;
 #else
-      /* Workaround for older zlib. */
-      strm.next_in = (void *) src;
+  /* Workaround for older zlib. */
+  strm->next_in = (void *) src;
 #endif
 
-      if (deflateInit2 (&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
-                        windowsBits | GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY)
-          != Z_OK)
-        return NULL;
+  do
+    {
+      int err;
+      guint used;
 
-      buffer = g_malloc0 (buflen);
-      strm.avail_out = buflen;
-      strm.next_out = buffer;
+      used = output->len;
+      g_byte_array_set_size (output, used + COMPRESS_STREAM_CHUNK);
+      strm->avail_out = COMPRESS_STREAM_CHUNK;
+      strm->next_out = output->data + used;
 
-      err = deflate (&strm, Z_FINISH);
-      deflateEnd (&strm);
-      switch (err)
+      err = deflating ? deflate (strm, Z_SYNC_FLUSH)
+                      : inflate (strm, Z_SYNC_FLUSH);
+      g_byte_array_set_size (output,
+                             used + COMPRESS_STREAM_CHUNK - strm->avail_out);
+      if (err == Z_BUF_ERROR)
+        /* No progress possible, e.g. no input at all. */
+        break;
+      if (err == Z_STREAM_END && !deflating)
         {
-        case Z_OK:
-        case Z_STREAM_END:
-          if (strm.avail_out != 0)
-            {
-              *dstlen = strm.total_out;
-              return buffer;
-            }
-          /* Fallthrough. */
-        case Z_BUF_ERROR:
-          g_free (buffer);
-          buflen *= 2;
+          /* The peer finished the stream, anything after it is garbage. */
+          if (strm->avail_in)
+            return -1;
           break;
-
-        default:
-          g_free (buffer);
-          return NULL;
         }
+      if (err != Z_OK)
+        return -1;
     }
+  while (strm->avail_out == 0 || strm->avail_in);
+
+  return 0;
+}
+
+/**
+ * @brief Compress the next chunk of an outgoing stream.
+ *
+ * @param[in]   stream  Stream state.
+ * @param[in]   src     Data to compress.
+ * @param[in]   srclen  Length of data to compress.
+ * @param[out]  dstlen  Length of compressed data.
+ *
+ * @return Compressed data if success, NULL otherwise.  The data belongs to
+ *         the stream and stays valid until the next compression.
+ */
+const void *
+gvm_compress_stream_deflate (gvm_compress_stream_t *stream, const void *src,
+                             unsigned long srclen, unsigned long *dstlen)
+{
+  if (stream == NULL || dstlen == NULL || (src == NULL && srclen))
+    return NULL;
+
+  if (compress_stream_run (&stream->deflate, 1, src, srclen, stream->deflated))
+    return NULL;
+  *dstlen = stream->deflated->len;
+  return stream->deflated->data;
+}
+
+/**
+ * @brief Uncompress the next chunk of an incoming stream.
+ *
+ * The chunk may end anywhere in the stream.  Data that can't be uncompressed
+ * yet is kept in the stream state for the next chunk.
+ *
+ * @param[in]   stream  Stream state.
+ * @param[in]   src     Data to uncompress.
+ * @param[in]   srclen  Length of data to uncompress.
+ * @param[out]  dstlen  Length of uncompressed data.
+ *
+ * @return Uncompressed data if success, NULL otherwise.  The data belongs to
+ *         the stream and stays valid until the next uncompression.
+ */
+const void *
+gvm_compress_stream_inflate (gvm_compress_stream_t *stream, const void *src,
+                             unsigned long srclen, unsigned long *dstlen)
+{
+  if (stream == NULL || dstlen == NULL || (src == NULL && srclen))
+    return NULL;
+
+  if (compress_stream_run (&stream->inflate, 0, src, srclen, stream->inflated))
+    return NULL;
+  *dstlen = stream->inflated->len;
+  return stream->inflated->data;
 }
@@ -25,6 +25,8 @@
 #ifndef _GVM_COMPRESSUTILS_H
 #define _GVM_COMPRESSUTILS_H
 
+#include <stdio.h> /* for FILE */
+
 void *
 gvm_compress (const void *, unsigned long, unsigned long *);
 
@@ -34,4 +36,67 @@ gvm_compress_gzipheader (const void *, unsigned long, unsigned long *);
 void *
 gvm_uncompress (const void *, unsigned long, unsigned long *);
 
+/**
+ * @brief Receives output of the compression functions.
+ *
+ * Arguments are the data, its length and the user data.  Returns 0 on
+ * success, -1 to abort.
+ */
+typedef int (*gvm_compress_sink_t) (const void *, unsigned long, void *);
+
+/**
+ * @brief Parallel gzip compressor, see gvm_gzip_writer_new.
+ */
+typedef struct gvm_gzip_writer gvm_gzip_writer_t;
+
+gvm_gzip_writer_t *
+gvm_gzip_writer_new (int, int, gvm_compress_sink_t, void *);
+
+int
+gvm_gzip_writer_write (gvm_gzip_writer_t *, const void *, unsigned long);
+
+int
+gvm_gzip_writer_finish (gvm_gzip_writer_t *);
+
+/**
+ * @brief Streaming decompression, see gvm_uncompress_stream_new.
+ */
+typedef struct gvm_uncompress_stream gvm_uncompress_stream_t;
+
+gvm_uncompress_stream_t *
+gvm_uncompress_stream_new (unsigned long, gvm_compress_sink_t, void *);
+
+int
+gvm_uncompress_stream_write (gvm_uncompress_stream_t *, const void *,
+                             unsigned long);
+
+int
+gvm_uncompress_stream_finish (gvm_uncompress_stream_t *, unsigned long *);
+
+int
+gvm_uncompress_to_sink (const void *, unsigned long, unsigned long,
+                        gvm_compress_sink_t, void *, unsigned long *);
+
+int
+gvm_uncompress_file (FILE *, FILE *, unsigned long, unsigned long *);
+
+/**
+ * @brief State of a compressed stream, see gvm_compress_stream_new.
+ */
+typedef struct gvm_compress_stream gvm_compress_stream_t;
+
+gvm_compress_stream_t *
+gvm_compress_stream_new (int);
+
+void
+gvm_compress_stream_free (gvm_compress_stream_t *);
+
+const void *
+gvm_compress_stream_deflate (gvm_compress_stream_t *, const void *,
+                             unsigned long, unsigned long *);
+
+const void *
+gvm_compress_stream_inflate (gvm_compress_stream_t *, const void *,
+                             unsigned long, unsigned long *);
+
 #endif /* not _GVM_COMPRESSUTILS_H */
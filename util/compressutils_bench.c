@@ -0,0 +1,244 @@
+/* Copyright (C) 2021 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * @brief Stand-alone benchmark of decompressing large blobs.
+ *
+ * A synthetic report of the given size is compressed and then uncompressed
+ * with gvm_uncompress, or streamed through gvm_uncompress_to_sink with
+ * --stream, e.g.:
+ *
+ *   ./compressutils-bench --size 200 --stream
+ *
+ * Run the two variants separately to compare their peak memory use.
+ */
+
+#include "compressutils.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <zlib.h>
+
+/**
+ * @brief Sink that appends to a GByteArray.
+ *
+ * @param[in]  data   Data.
+ * @param[in]  len    Length of data.
+ * @param[in]  array  GByteArray.
+ *
+ * @return 0.
+ */
+static int
+array_sink (const void *data, unsigned long len, void *array)
+{
+  g_byte_array_append (array, data, len);
+  return 0;
+}
+
+/**
+ * @brief Generate a compressed synthetic report.
+ *
+ * The report is compressed while it is generated, so that it is never held
+ * in memory as a whole.
+ *
+ * @param[in]   size  Minimum size of the report in bytes.
+ * @param[out]  len   Length of the report.
+ * @param[out]  crc   CRC-32 of the report.
+ *
+ * @return The compressed report, NULL on error.
+ */
+static GByteArray *
+make_compressed_report (gsize size, unsigned long *len, uLong *crc)
+{
+  gvm_gzip_writer_t *writer;
+  GByteArray *compressed;
+  GString *xml;
+
+  compressed = g_byte_array_new ();
+  writer = gvm_gzip_writer_new (-1, 0, array_sink, compressed);
+  if (writer == NULL)
+    {
+      g_byte_array_free (compressed, TRUE);
+      return NULL;
+    }
+
+  *crc = crc32 (0L, Z_NULL, 0);
+  *len = 0;
+  xml = g_string_new ("<report id=\"synthetic\"><results>");
+  for (int index = 0; *len + xml->len < size; index++)
+    {
+      g_string_append_printf (
+        xml,
+        "<result id=\"%08x-0000-4000-8000-%012x\">"
+        "<host>192.168.%d.%d</host><port>%d/tcp</port>"
+        "<nvt oid=\"1.3.6.1.4.1.25623.1.0.%d\"><name>Synthetic Test %d</name>"
+        "</nvt><severity>%d.%d</severity>"
+        "<description>Installed version: %d.%d.%d</description></result>",
+        index, index * 7919, (index / 256) % 256, index % 256, index % 65536,
+        index % 100000, index % 100000, index % 10, index % 7, index % 5,
+        index % 13, index % 17);
+      if (xml->len > 65536)
+        {
+          *crc = crc32 (*crc, (Bytef *) xml->str, xml->len);
+          *len += xml->len;
+          gvm_gzip_writer_write (writer, xml->str, xml->len);
+          g_string_truncate (xml, 0);
+        }
+    }
+  g_string_append (xml, "</results></report>");
+  *crc = crc32 (*crc, (Bytef *) xml->str, xml->len);
+  *len += xml->len;
+  gvm_gzip_writer_write (writer, xml->str, xml->len);
+  g_string_free (xml, TRUE);
+
+  if (gvm_gzip_writer_finish (writer))
+    {
+      g_byte_array_free (compressed, TRUE);
+      return NULL;
+    }
+  return compressed;
+}
+
+/**
+ * @brief Sink that only checksums the data.
+ *
+ * @param[in]  data  Data.
+ * @param[in]  len   Length of data.
+ * @param[in]  crc   CRC-32 so far.
+ *
+ * @return 0.
+ */
+static int
+crc_sink (const void *data, unsigned long len, void *crc)
+{
+  *(uLong *) crc = crc32 (*(uLong *) crc, data, len);
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  static gint size = 200;
+  static gint rounds = 3;
+  static gboolean stream = FALSE;
+  static GOptionEntry entries[] = {
+    {"size", 's', 0, G_OPTION_ARG_INT, &size,
+     "Size of the uncompressed report in MB (default 200)", "<MB>"},
+    {"rounds", 'r', 0, G_OPTION_ARG_INT, &rounds,
+     "Number of times the report is uncompressed (default 3)", "<N>"},
+    {"stream", 0, 0, G_OPTION_ARG_NONE, &stream,
+     "Stream the output with gvm_uncompress_to_sink", NULL},
+    {NULL, 0, 0, 0, NULL, NULL, NULL}};
+  GOptionContext *option_context;
+  GError *error = NULL;
+  GByteArray *compressed;
+  unsigned long report_len;
+  uLong report_crc;
+  struct rusage usage;
+  long rss_before;
+  gint64 best;
+
+  option_context =
+    g_option_context_new ("- benchmark uncompressing a large report");
+  g_option_context_add_main_entries (option_context, entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (option_context);
+
+  if (size <= 0 || rounds <= 0)
+    {
+      fprintf (stderr, "Size and rounds must be positive.\n");
+      return 1;
+    }
+
+  compressed = make_compressed_report ((gsize) size * 1024 * 1024,
+                                       &report_len, &report_crc);
+  if (compressed == NULL)
+    {
+      fprintf (stderr, "Error while compressing the report.\n");
+      return 1;
+    }
+
+  getrusage (RUSAGE_SELF, &usage);
+  rss_before = usage.ru_maxrss;
+
+  best = G_MAXINT64;
+  for (int round = 0; round < rounds; round++)
+    {
+      unsigned long len;
+      uLong crc;
+      gint64 start, time;
+
+      crc = crc32 (0L, Z_NULL, 0);
+      start = g_get_monotonic_time ();
+      if (stream)
+        {
+          if (gvm_uncompress_to_sink (compressed->data, compressed->len, 0,
+                                      crc_sink, &crc, &len))
+            {
+              fprintf (stderr, "Error while uncompressing the report.\n");
+              return 1;
+            }
+        }
+      else
+        {
+          void *uncompressed;
+
+          uncompressed = gvm_uncompress (compressed->data, compressed->len,
+                                         &len);
+          if (uncompressed == NULL)
+            {
+              fprintf (stderr, "Error while uncompressing the report.\n");
+              return 1;
+            }
+          crc = crc32 (crc, uncompressed, len);
+          g_free (uncompressed);
+        }
+      time = g_get_monotonic_time () - start;
+
+      if (len != report_len || crc != report_crc)
+        {
+          fprintf (stderr, "Uncompressed report differs.\n");
+          return 1;
+        }
+
+      printf ("Round %d: %.3f s\n", round + 1, time / 1000000.0);
+      best = MIN (best, time);
+    }
+
+  getrusage (RUSAGE_SELF, &usage);
+  printf ("Report size:             %.1f MB\n", report_len / (1024.0 * 1024.0));
+  printf ("Compressed size:         %.1f MB\n",
+          compressed->len / (1024.0 * 1024.0));
+  printf ("Streaming:               %s\n", stream ? "yes" : "no");
+  printf ("Best time:               %.3f s\n", best / 1000000.0);
+  printf ("Throughput:              %.1f MB/s\n",
+          (report_len / (1024.0 * 1024.0)) / MAX (best / 1000000.0, 1e-6));
+  printf ("Peak memory growth:      %.1f MB\n",
+          (usage.ru_maxrss - rss_before) / 1024.0);
+
+  g_byte_array_free (compressed, TRUE);
+
+  return 0;
+}
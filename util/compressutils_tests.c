@@ -0,0 +1,375 @@
+/* Copyright (C) 2019-2021 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "compressutils.c"
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+Describe (compressutils);
+BeforeEach (compressutils)
+{
+}
+AfterEach (compressutils)
+{
+}
+
+/**
+ * @brief Generate data that is partly compressible.
+ *
+ * @param[in]  len  Length of the data.
+ *
+ * @return The data.
+ */
+static guchar *
+make_data (gsize len)
+{
+  guchar *data;
+
+  data = g_malloc (len + 1);
+  for (gsize index = 0; index < len; index++)
+    data[index] = (index % 997 < 500) ? 'a' + (index * 7 % 26)
+                                      : g_random_int_range (0, 256);
+  return data;
+}
+
+/**
+ * @brief Check that gzip data decompresses to the original data.
+ *
+ * @param[in]  compressed  Compressed data.
+ * @param[in]  len         Length of compressed data.
+ * @param[in]  data        Original data.
+ * @param[in]  datalen     Length of original data.
+ */
+static void
+assert_gzip_round_trip (const void *compressed, unsigned long len,
+                        const guchar *data, unsigned long datalen)
+{
+  void *uncompressed;
+  unsigned long uncompressed_len;
+
+  assert_that (compressed, is_not_null);
+  assert_that (((const guchar *) compressed)[0], is_equal_to (0x1f));
+  assert_that (((const guchar *) compressed)[1], is_equal_to (0x8b));
+
+  uncompressed = gvm_uncompress (compressed, len, &uncompressed_len);
+  assert_that (uncompressed, is_not_null);
+  assert_that (uncompressed_len, is_equal_to (datalen));
+  assert_that (memcmp (uncompressed, data, datalen), is_equal_to (0));
+  g_free (uncompressed);
+}
+
+/* gvm_compress_gzipheader */
+
+Ensure (compressutils, gvm_compress_gzipheader_handles_empty_input)
+{
+  void *compressed;
+  unsigned long len;
+
+  compressed = gvm_compress_gzipheader ("", 0, &len);
+  assert_that (compressed, is_not_null);
+  /* Header, empty final block and trailer. */
+  assert_that (len, is_less_than (24));
+  g_free (compressed);
+}
+
+Ensure (compressutils, gvm_compress_gzipheader_round_trips_small_input)
+{
+  void *compressed;
+  unsigned long len;
+  guchar *data;
+
+  data = make_data (1000);
+  compressed = gvm_compress_gzipheader (data, 1000, &len);
+  assert_gzip_round_trip (compressed, len, data, 1000);
+  g_free (compressed);
+  g_free (data);
+}
+
+Ensure (compressutils, gvm_compress_gzipheader_round_trips_many_blocks)
+{
+  gsize sizes[] = {GZIP_BLOCK_SIZE, GZIP_BLOCK_SIZE + 1,
+                   7 * GZIP_BLOCK_SIZE + 12345};
+
+  for (gsize index = 0; index < G_N_ELEMENTS (sizes); index++)
+    {
+      void *compressed;
+      unsigned long len;
+      guchar *data;
+
+      data = make_data (sizes[index]);
+      compressed = gvm_compress_gzipheader (data, sizes[index], &len);
+      assert_that (len, is_less_than (sizes[index]));
+      assert_gzip_round_trip (compressed, len, data, sizes[index]);
+      g_free (compressed);
+      g_free (data);
+    }
+}
+
+/* gvm_gzip_writer */
+
+Ensure (compressutils, gvm_gzip_writer_matches_with_any_thread_count)
+{
+  gsize datalen = 5 * GZIP_BLOCK_SIZE + 999;
+  guchar *data;
+
+  data = make_data (datalen);
+  for (int threads = 1; threads <= 4; threads++)
+    {
+      gvm_gzip_writer_t *writer;
+      GByteArray *compressed;
+
+      compressed = g_byte_array_new ();
+      writer = gvm_gzip_writer_new (6, threads, byte_array_sink, compressed);
+      assert_that (writer, is_not_null);
+      /* Odd sizes, so that writes straddle the blocks. */
+      for (gsize done = 0; done < datalen; done += 10007)
+        assert_that (gvm_gzip_writer_write (writer, data + done,
+                                            MIN (10007, datalen - done)),
+                     is_equal_to (0));
+      assert_that (gvm_gzip_writer_finish (writer), is_equal_to (0));
+
+      assert_gzip_round_trip (compressed->data, compressed->len, data,
+                              datalen);
+      g_byte_array_free (compressed, TRUE);
+    }
+  g_free (data);
+}
+
+/**
+ * @brief Sink that fails after a number of calls.
+ *
+ * @param[in]  data   Data.
+ * @param[in]  len    Length of data.
+ * @param[in]  calls  Number of calls left.
+ *
+ * @return 0 while calls are left, else -1.
+ */
+static int
+failing_sink (const void *data, unsigned long len, void *calls)
+{
+  (void) data;
+  (void) len;
+  return (*(int *) calls)-- > 0 ? 0 : -1;
+}
+
+Ensure (compressutils, gvm_gzip_writer_reports_sink_errors)
+{
+  gvm_gzip_writer_t *writer;
+  guchar *data;
+  int calls;
+
+  calls = 0;
+  assert_that (gvm_gzip_writer_new (6, 2, failing_sink, &calls), is_null);
+
+  data = make_data (4 * GZIP_BLOCK_SIZE);
+  calls = 2;
+  writer = gvm_gzip_writer_new (6, 2, failing_sink, &calls);
+  assert_that (writer, is_not_null);
+  gvm_gzip_writer_write (writer, data, 4 * GZIP_BLOCK_SIZE);
+  assert_that (gvm_gzip_writer_finish (writer), is_equal_to (-1));
+  g_free (data);
+}
+
+Ensure (compressutils, gvm_gzip_writer_rejects_bad_arguments)
+{
+  assert_that (gvm_gzip_writer_new (10, 1, byte_array_sink, NULL), is_null);
+  assert_that (gvm_gzip_writer_new (6, 1, NULL, NULL), is_null);
+  assert_that (gvm_gzip_writer_write (NULL, "", 0), is_equal_to (-1));
+  assert_that (gvm_gzip_writer_finish (NULL), is_equal_to (-1));
+}
+
+/* gvm_uncompress_stream */
+
+Ensure (compressutils, gvm_uncompress_to_sink_handles_gzip_and_zlib)
+{
+  gsize datalen = 3 * UNCOMPRESS_CHUNK + 17;
+  void *compressed[2];
+  unsigned long len[2];
+  guchar *data;
+
+  data = make_data (datalen);
+  compressed[0] = gvm_compress_gzipheader (data, datalen, &len[0]);
+  compressed[1] = gvm_compress (data, datalen, &len[1]);
+  for (int index = 0; index < 2; index++)
+    {
+      GByteArray *uncompressed;
+      unsigned long dstlen;
+
+      uncompressed = g_byte_array_new ();
+      assert_that (gvm_uncompress_to_sink (compressed[index], len[index], 0,
+                                           byte_array_sink, uncompressed,
+                                           &dstlen),
+                   is_equal_to (0));
+      assert_that (dstlen, is_equal_to (datalen));
+      assert_that (uncompressed->len, is_equal_to (datalen));
+      assert_that (memcmp (uncompressed->data, data, datalen),
+                   is_equal_to (0));
+      g_byte_array_free (uncompressed, TRUE);
+      g_free (compressed[index]);
+    }
+  g_free (data);
+}
+
+Ensure (compressutils, gvm_uncompress_stream_accepts_data_in_pieces)
+{
+  gvm_uncompress_stream_t *stream;
+  GByteArray *uncompressed;
+  gsize datalen = 2 * UNCOMPRESS_CHUNK;
+  unsigned long len, dstlen;
+  guchar *data, *compressed;
+
+  data = make_data (datalen);
+  compressed = gvm_compress_gzipheader (data, datalen, &len);
+
+  uncompressed = g_byte_array_new ();
+  stream = gvm_uncompress_stream_new (0, byte_array_sink, uncompressed);
+  assert_that (stream, is_not_null);
+  for (unsigned long done = 0; done < len; done += 777)
+    assert_that (gvm_uncompress_stream_write (stream, compressed + done,
+                                              MIN (777, len - done)),
+                 is_equal_to (0));
+  assert_that (gvm_uncompress_stream_finish (stream, &dstlen),
+               is_equal_to (0));
+  assert_that (dstlen, is_equal_to (datalen));
+  assert_that (memcmp (uncompressed->data, data, datalen), is_equal_to (0));
+
+  g_byte_array_free (uncompressed, TRUE);
+  g_free (compressed);
+  g_free (data);
+}
+
+Ensure (compressutils, gvm_uncompress_to_sink_limits_output)
+{
+  GByteArray *uncompressed;
+  void *compressed;
+  unsigned long len;
+  guchar *data;
+
+  /* Compresses to a few kilobytes. */
+  data = g_malloc0 (10 * 1024 * 1024);
+  compressed = gvm_compress (data, 10 * 1024 * 1024, &len);
+
+  uncompressed = g_byte_array_new ();
+  assert_that (gvm_uncompress_to_sink (compressed, len, 1024 * 1024,
+                                       byte_array_sink, uncompressed, NULL),
+               is_equal_to (-2));
+  assert_that (uncompressed->len, is_less_than (1024 * 1024 + 1));
+
+  g_byte_array_set_size (uncompressed, 0);
+  assert_that (gvm_uncompress_to_sink (compressed, len, 10 * 1024 * 1024,
+                                       byte_array_sink, uncompressed, NULL),
+               is_equal_to (0));
+  assert_that (uncompressed->len, is_equal_to (10 * 1024 * 1024));
+
+  g_byte_array_free (uncompressed, TRUE);
+  g_free (compressed);
+  g_free (data);
+}
+
+Ensure (compressutils, gvm_uncompress_to_sink_fails_on_bad_data)
+{
+  GByteArray *uncompressed;
+  guchar *compressed;
+  unsigned long len;
+
+  uncompressed = g_byte_array_new ();
+  assert_that (gvm_uncompress_to_sink ("not compressed", 14, 0,
+                                       byte_array_sink, uncompressed, NULL),
+               is_equal_to (-1));
+
+  compressed = gvm_compress_gzipheader ("corrupt data", 12, &len);
+  compressed[len - 5] ^= 0xff;
+  assert_that (gvm_uncompress_to_sink (compressed, len, 0, byte_array_sink,
+                                       uncompressed, NULL),
+               is_equal_to (-1));
+
+  g_byte_array_free (uncompressed, TRUE);
+  g_free (compressed);
+}
+
+Ensure (compressutils, gvm_uncompress_file_writes_uncompressed_file)
+{
+  FILE *in, *out;
+  gsize datalen = 5 * UNCOMPRESS_CHUNK + 3;
+  unsigned long len, dstlen;
+  guchar *data, *read_back;
+  void *compressed;
+
+  data = make_data (datalen);
+  compressed = gvm_compress_gzipheader (data, datalen, &len);
+  in = tmpfile ();
+  out = tmpfile ();
+  assert_that (fwrite (compressed, 1, len, in), is_equal_to (len));
+  rewind (in);
+
+  assert_that (gvm_uncompress_file (in, out, 0, &dstlen), is_equal_to (0));
+  assert_that (dstlen, is_equal_to (datalen));
+
+  read_back = g_malloc (datalen);
+  rewind (out);
+  assert_that (fread (read_back, 1, datalen, out), is_equal_to (datalen));
+  assert_that (memcmp (read_back, data, datalen), is_equal_to (0));
+
+  fclose (in);
+  fclose (out);
+  g_free (read_back);
+  g_free (compressed);
+  g_free (data);
+}
+
+/* Test suite. */
+
+int
+main (int argc, char **argv)
+{
+  TestSuite *suite;
+
+  suite = create_test_suite ();
+
+  add_test_with_context (suite, compressutils,
+                         gvm_compress_gzipheader_handles_empty_input);
+  add_test_with_context (suite, compressutils,
+                         gvm_compress_gzipheader_round_trips_small_input);
+  add_test_with_context (suite, compressutils,
+                         gvm_compress_gzipheader_round_trips_many_blocks);
+
+  add_test_with_context (suite, compressutils,
+                         gvm_gzip_writer_matches_with_any_thread_count);
+  add_test_with_context (suite, compressutils,
+                         gvm_gzip_writer_reports_sink_errors);
+  add_test_with_context (suite, compressutils,
+                         gvm_gzip_writer_rejects_bad_arguments);
+
+  add_test_with_context (suite, compressutils,
+                         gvm_uncompress_to_sink_handles_gzip_and_zlib);
+  add_test_with_context (suite, compressutils,
+                         gvm_uncompress_stream_accepts_data_in_pieces);
+  add_test_with_context (suite, compressutils,
+                         gvm_uncompress_to_sink_limits_output);
+  add_test_with_context (suite, compressutils,
+                         gvm_uncompress_to_sink_fails_on_bad_data);
+  add_test_with_context (suite, compressutils,
+                         gvm_uncompress_file_writes_uncompressed_file);
+
+  if (argc > 1)
+    return run_single_test (suite, argv[1], create_text_reporter ());
+
+  return run_test_suite (suite, create_text_reporter ());
+}
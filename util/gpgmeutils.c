@@ -32,7 +32,7 @@
 #include <stdlib.h>    /* for mkdtemp */
 #include <string.h>    /* for strlen */
 #include <sys/stat.h>  /* for mkdir */
-#include <unistd.h>    /* for access, F_OK */
+#include <unistd.h>    /* for access, F_OK, getpid */
 
 #undef G_LOG_DOMAIN
 /**
@@ -40,6 +40,26 @@
  */
 #define G_LOG_DOMAIN "libgvm util"
 
+/**
+ * @brief Template for the GPG home directories of keyrings.
+ */
+#define KEYRING_TEMPLATE "/tmp/gvmd-gpg-XXXXXX"
+
+/**
+ * @brief Maximum number of cached keyrings.
+ */
+#define KEYRING_CACHE_SIZE 32
+
+/**
+ * @brief Seconds after which an unused keyring is removed from the cache.
+ */
+#define KEYRING_IDLE_TIME 3600
+
+/**
+ * @brief Maximum number of idle contexts kept per keyring.
+ */
+#define KEYRING_IDLE_CONTEXTS 4
+
 /**
  * @brief Log function with extra gpg-error style output
  *
@@ -480,6 +500,428 @@ create_all_certificates_trustlist (gpgme_ctx_t ctx, const char *homedir)
   return 0;
 }
 
+/**
+ * @brief Keyring with an imported key, cached across encryptions.
+ */
+typedef struct
+{
+  gchar homedir[sizeof (KEYRING_TEMPLATE)]; ///< GPG home directory.
+  gpgme_protocol_t protocol;                ///< Protocol of the key.
+  gpgme_key_t key;                          ///< Key to encrypt for.
+  gchar *digest;      ///< Digest of the key string, the key of the cache.
+  pid_t pid;          ///< Process that created homedir.
+  GSList *contexts;   ///< Idle contexts using homedir.
+  int users;          ///< Number of encryptions using the keyring.
+  gboolean cached;    ///< Whether the keyring is in the cache.
+  gint64 used;        ///< Monotonic time the keyring was last released.
+} keyring_t;
+
+/**
+ * @brief Cached keyrings by digest of the key string, the email and the
+ *        protocol they were created from.
+ */
+static GHashTable *keyrings = NULL;
+
+/**
+ * @brief Process that owns the cached keyrings.
+ *
+ * A forked child inherits the cache, but the keyrings in it belong to the
+ * parent, so the child starts a cache of its own.
+ */
+static pid_t keyrings_pid = 0;
+
+/**
+ * @brief Protects the keyring cache.
+ */
+static GMutex keyrings_mutex;
+
+/**
+ * @brief Create a context on the home directory of a keyring.
+ *
+ * @param[in]  keyring  Keyring.
+ *
+ * @return The context, NULL on error.
+ */
+static gpgme_ctx_t
+keyring_context_new (keyring_t *keyring)
+{
+  gpgme_ctx_t ctx;
+  gpgme_error_t err;
+
+  err = gpgme_new (&ctx);
+  if (err)
+    {
+      log_gpgme (G_LOG_LEVEL_WARNING, err, "%s: gpgme_new failed", __func__);
+      return NULL;
+    }
+
+  gpgme_set_armor (ctx, keyring->protocol == GPGME_PROTOCOL_CMS ? 0 : 1);
+  err = gpgme_ctx_set_engine_info (ctx, keyring->protocol, NULL,
+                                   keyring->homedir);
+  if (!err)
+    err = gpgme_set_protocol (ctx, keyring->protocol);
+  if (!err)
+    err = gpgme_set_keylist_mode (ctx, GPGME_KEYLIST_MODE_LOCAL);
+  if (err)
+    {
+      log_gpgme (G_LOG_LEVEL_WARNING, err, "%s: Setting up context failed",
+                 __func__);
+      gpgme_release (ctx);
+      return NULL;
+    }
+  gpgme_set_offline (ctx, 1);
+
+  return ctx;
+}
+
+/**
+ * @brief Free a keyring and remove its home directory.
+ *
+ * The home directory is only removed by the process that created it, never
+ * by a forked child.
+ *
+ * @param[in]  keyring  Keyring.
+ */
+static void
+keyring_free (keyring_t *keyring)
+{
+  g_slist_free_full (keyring->contexts, (GDestroyNotify) gpgme_release);
+  if (keyring->key)
+    gpgme_key_unref (keyring->key);
+  if (keyring->pid == getpid ())
+    gvm_file_remove_recurse (keyring->homedir);
+  g_free (keyring->digest);
+  g_free (keyring);
+}
+
+/**
+ * @brief Create a keyring in a temporary home directory and import a key.
+ *
+ * @param[in]  key_str    String containing the public key or certificate.
+ * @param[in]  key_len    Length of key / certificate, -1 to use strlen.
+ * @param[in]  uid_email  Email address of key / certificate to use.
+ * @param[in]  protocol   The protocol to use, e.g. OpenPGP or CMS.
+ * @param[in]  key_types  The expected GPGME buffered data types.
+ *
+ * @return The keyring, with one idle context, or NULL on error.
+ */
+static keyring_t *
+keyring_new (const char *key_str, ssize_t key_len, const char *uid_email,
+             gpgme_protocol_t protocol, GArray *key_types)
+{
+  keyring_t *keyring;
+  gpgme_ctx_t ctx;
+  const char *key_type_str;
+
+  if (protocol == GPGME_PROTOCOL_CMS)
+    key_type_str = "certificate";
+  else
+    key_type_str = "public key";
+
+  keyring = g_malloc0 (sizeof (*keyring));
+  g_strlcpy (keyring->homedir, KEYRING_TEMPLATE, sizeof (keyring->homedir));
+  keyring->protocol = protocol;
+  if (mkdtemp (keyring->homedir) == NULL)
+    {
+      g_warning ("%s: mkdtemp failed\n", __func__);
+      g_free (keyring);
+      return NULL;
+    }
+  keyring->pid = getpid ();
+
+  ctx = keyring_context_new (keyring);
+  if (ctx == NULL)
+    {
+      keyring_free (keyring);
+      return NULL;
+    }
+  keyring->contexts = g_slist_prepend (NULL, ctx);
+
+  // Import public key into context
+  if (gvm_gpg_import_many_types_from_string (ctx, key_str, key_len, key_types))
+    {
+      g_warning ("%s: Import of %s failed", __func__, key_type_str);
+      keyring_free (keyring);
+      return NULL;
+    }
+
+  // Get imported public key
+  keyring->key = find_email_encryption_key (ctx, uid_email);
+  if (keyring->key == NULL)
+    {
+      g_warning ("%s: Could not find %s for encryption", __func__,
+                 key_type_str);
+      keyring_free (keyring);
+      return NULL;
+    }
+
+  if (protocol == GPGME_PROTOCOL_CMS
+      && create_all_certificates_trustlist (ctx, keyring->homedir))
+    {
+      keyring_free (keyring);
+      return NULL;
+    }
+
+  return keyring;
+}
+
+/**
+ * @brief Compute the digest a keyring is cached under.
+ *
+ * @param[in]  key_str    String containing the public key or certificate.
+ * @param[in]  key_len    Length of key / certificate, -1 to use strlen.
+ * @param[in]  uid_email  Email address of key / certificate to use.
+ * @param[in]  protocol   The protocol to use, e.g. OpenPGP or CMS.
+ *
+ * @return Freshly allocated hex digest.
+ */
+static gchar *
+keyring_digest (const char *key_str, ssize_t key_len, const char *uid_email,
+                gpgme_protocol_t protocol)
+{
+  GChecksum *checksum;
+  gchar *digest;
+  int protocol_number;
+
+  if (key_str == NULL)
+    key_len = 0;
+  else if (key_len < 0)
+    key_len = strlen (key_str);
+
+  protocol_number = protocol;
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) &protocol_number,
+                     sizeof (protocol_number));
+  g_checksum_update (checksum, (const guchar *) uid_email,
+                     strlen (uid_email) + 1);
+  if (key_len)
+    g_checksum_update (checksum, (const guchar *) key_str, key_len);
+  digest = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return digest;
+}
+
+/**
+ * @brief Remove a keyring from the cache.
+ *
+ * The cache lock must be held.  The keyring is freed once its last user
+ * releases it.
+ *
+ * @param[in]  keyring  Cached keyring.
+ */
+static void
+keyring_uncache (keyring_t *keyring)
+{
+  g_hash_table_remove (keyrings, keyring->digest);
+  keyring->cached = FALSE;
+  if (keyring->users == 0)
+    keyring_free (keyring);
+}
+
+/**
+ * @brief Remove keyrings that were idle for too long, and the least
+ *        recently used idle keyrings while the cache is too large.
+ *
+ * The cache lock must be held.
+ */
+static void
+keyrings_evict (void)
+{
+  GHashTableIter iter;
+  gpointer value;
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+  for (;;)
+    {
+      keyring_t *oldest = NULL;
+
+      g_hash_table_iter_init (&iter, keyrings);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          keyring_t *keyring = value;
+
+          if (keyring->users)
+            continue;
+          if (now - keyring->used > KEYRING_IDLE_TIME * G_TIME_SPAN_SECOND)
+            {
+              oldest = keyring;
+              break;
+            }
+          if (oldest == NULL || keyring->used < oldest->used)
+            oldest = keyring;
+        }
+
+      if (oldest == NULL
+          || (g_hash_table_size (keyrings) <= KEYRING_CACHE_SIZE
+              && now - oldest->used
+                   <= KEYRING_IDLE_TIME * G_TIME_SPAN_SECOND))
+        break;
+      keyring_uncache (oldest);
+    }
+}
+
+/**
+ * @brief Release a keyring from keyring_acquire.
+ *
+ * @param[in]  keyring  Keyring.
+ * @param[in]  ctx      Context on the keyring, NULL to drop it.
+ */
+static void
+keyring_release (keyring_t *keyring, gpgme_ctx_t ctx)
+{
+  g_mutex_lock (&keyrings_mutex);
+  keyring->users--;
+  keyring->used = g_get_monotonic_time ();
+  if (ctx && keyring->cached
+      && g_slist_length (keyring->contexts) < KEYRING_IDLE_CONTEXTS)
+    {
+      keyring->contexts = g_slist_prepend (keyring->contexts, ctx);
+      ctx = NULL;
+    }
+  if (keyring->cached == FALSE && keyring->users == 0)
+    keyring_free (keyring);
+  g_mutex_unlock (&keyrings_mutex);
+
+  if (ctx)
+    gpgme_release (ctx);
+}
+
+/**
+ * @brief Get a keyring with a key imported, and a context on it.
+ *
+ * When caching, keyrings are cached by the digest of the key string, so that
+ * repeated encryptions for the same key skip setting up the GPG home
+ * directory and importing the key.  A changed key string gets a keyring of
+ * its own, even if its key has the same fingerprint.  Otherwise the keyring
+ * and its home directory are removed on release.
+ *
+ * @param[in]   key_str    String containing the public key or certificate.
+ * @param[in]   key_len    Length of key / certificate, -1 to use strlen.
+ * @param[in]   uid_email  Email address of key / certificate to use.
+ * @param[in]   protocol   The protocol to use, e.g. OpenPGP or CMS.
+ * @param[in]   key_types  The expected GPGME buffered data types.
+ * @param[in]   cache      Whether to use the keyring cache.
+ * @param[out]  ctx        Context on the keyring.
+ *
+ * @return The keyring, to be released with keyring_release, or NULL on
+ *         error.
+ */
+static keyring_t *
+keyring_acquire (const char *key_str, ssize_t key_len, const char *uid_email,
+                 gpgme_protocol_t protocol, GArray *key_types, gboolean cache,
+                 gpgme_ctx_t *ctx)
+{
+  keyring_t *keyring;
+  gchar *digest;
+
+  if (cache == FALSE)
+    {
+      keyring = keyring_new (key_str, key_len, uid_email, protocol, key_types);
+      if (keyring == NULL)
+        return NULL;
+      *ctx = keyring->contexts->data;
+      keyring->contexts =
+        g_slist_delete_link (keyring->contexts, keyring->contexts);
+      keyring->users = 1;
+      return keyring;
+    }
+
+  digest = keyring_digest (key_str, key_len, uid_email, protocol);
+
+  g_mutex_lock (&keyrings_mutex);
+  if (keyrings == NULL || keyrings_pid != getpid ())
+    {
+      /* Leave the keyrings inherited from a parent to the parent. */
+      keyrings = g_hash_table_new (g_str_hash, g_str_equal);
+      keyrings_pid = getpid ();
+    }
+  keyrings_evict ();
+  keyring = g_hash_table_lookup (keyrings, digest);
+  if (keyring)
+    {
+      g_free (digest);
+      keyring->users++;
+      *ctx = NULL;
+      if (keyring->contexts)
+        {
+          *ctx = keyring->contexts->data;
+          keyring->contexts =
+            g_slist_delete_link (keyring->contexts, keyring->contexts);
+        }
+      g_mutex_unlock (&keyrings_mutex);
+
+      if (*ctx == NULL)
+        *ctx = keyring_context_new (keyring);
+      if (*ctx == NULL)
+        {
+          keyring_release (keyring, NULL);
+          return NULL;
+        }
+      return keyring;
+    }
+  g_mutex_unlock (&keyrings_mutex);
+
+  keyring = keyring_new (key_str, key_len, uid_email, protocol, key_types);
+  if (keyring == NULL)
+    {
+      g_free (digest);
+      return NULL;
+    }
+  keyring->digest = digest;
+  *ctx = keyring->contexts->data;
+  keyring->contexts =
+    g_slist_delete_link (keyring->contexts, keyring->contexts);
+  keyring->users = 1;
+
+  g_mutex_lock (&keyrings_mutex);
+  /* If another thread was faster this keyring is only used once. */
+  if (g_hash_table_lookup (keyrings, digest) == NULL)
+    {
+      keyring->cached = TRUE;
+      g_hash_table_insert (keyrings, keyring->digest, keyring);
+      keyrings_evict ();
+    }
+  g_mutex_unlock (&keyrings_mutex);
+
+  return keyring;
+}
+
+/**
+ * @brief Remove all keyrings from the cache of the encryption functions.
+ *
+ * Keyrings in use are removed once the encryption using them is done.
+ *
+ * A process that used gvm_pgp_pubkey_encrypt_stream_cached or
+ * gvm_smime_encrypt_stream_cached must call this before it exits, as the
+ * cached keyrings are GPG home directories under /tmp.  That includes forked
+ * children, which have a cache of their own.  The keyrings of a parent are
+ * left to the parent.
+ */
+void
+gvm_gpg_keyring_cache_clear (void)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_mutex_lock (&keyrings_mutex);
+  if (keyrings && keyrings_pid == getpid ())
+    {
+      g_hash_table_iter_init (&iter, keyrings);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          keyring_t *keyring = value;
+
+          g_hash_table_iter_remove (&iter);
+          keyring->cached = FALSE;
+          if (keyring->users == 0)
+            keyring_free (keyring);
+        }
+    }
+  g_mutex_unlock (&keyrings_mutex);
+}
+
 #undef CHECK_ERR
 #define CHECK_ERR(func)                                                     \
   if (err)                                                                  \
@@ -489,16 +931,16 @@ create_all_certificates_trustlist (gpgme_ctx_t ctx, const char *homedir)
         gpgme_data_release (plain_data);                                    \
       if (encrypted_data)                                                   \
         gpgme_data_release (encrypted_data);                                \
-      if (ctx)                                                              \
-        gpgme_release (ctx);                                                \
-      gvm_file_remove_recurse (gpg_temp_dir);                               \
+      keyring_release (keyring, NULL);                                      \
+      gpgme_release (ctx);                                                  \
       return -1;                                                            \
     }
 
 /**
  * @brief Encrypt a stream for a PGP public key, writing to another stream.
  *
- * The output will use ASCII armor mode and no compression.
+ * The output will use ASCII armor mode and no compression.  The keyring
+ * with the imported key may be cached, see keyring_acquire.
  *
  * @param[in]  plain_file     Stream / FILE* providing the plain text.
  * @param[in]  encrypted_file Stream to write the encrypted text to.
@@ -507,6 +949,7 @@ create_all_certificates_trustlist (gpgme_ctx_t ctx, const char *homedir)
  * @param[in]  uid_email      Email address of key / certificate to use.
  * @param[in]  protocol       The protocol to use, e.g. OpenPGP or CMS.
  * @param[in]  key_types      The expected GPGME buffered data types.
+ * @param[in]  cache          Whether to use the keyring cache.
  *
  * @return 0 success, -1 error.
  */
@@ -514,19 +957,16 @@ static int
 encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
                          const char *key_str, ssize_t key_len,
                          const char *uid_email, gpgme_protocol_t protocol,
-                         GArray *key_types)
+                         GArray *key_types, gboolean cache)
 {
-  char gpg_temp_dir[] = "/tmp/gvmd-gpg-XXXXXX";
+  keyring_t *keyring;
   gpgme_ctx_t ctx;
   gpgme_data_t plain_data, encrypted_data;
-  gpgme_key_t key;
   gpgme_key_t keys[2] = {NULL, NULL};
   gpgme_error_t err;
   gpgme_encrypt_flags_t encrypt_flags;
-  const char *key_type_str;
   struct gpgme_data_cbs callbacks;
 
-  ctx = NULL;
   plain_data = NULL;
   encrypted_data = NULL;
 
@@ -543,60 +983,15 @@ encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
       return -1;
     }
 
-  if (protocol == GPGME_PROTOCOL_CMS)
-    key_type_str = "certificate";
-  else
-    key_type_str = "public key";
-
-  // Create temporary GPG home directory, set up context and encryption flags
-  if (mkdtemp (gpg_temp_dir) == NULL)
-    {
-      g_warning ("%s: mkdtemp failed\n", __func__);
-      return -1;
-    }
-
-  err = gpgme_new (&ctx);
-  CHECK_ERR ("gpgme_new")
-
-  if (protocol == GPGME_PROTOCOL_CMS)
-    gpgme_set_armor (ctx, 0);
-  else
-    gpgme_set_armor (ctx, 1);
-
-  err = gpgme_ctx_set_engine_info (ctx, protocol, NULL, gpg_temp_dir);
-  CHECK_ERR ("gpgme_ctx_set_engine_info")
-
-  err = gpgme_set_protocol (ctx, protocol);
-  CHECK_ERR ("gpgme_set_protocol")
-
-  err = gpgme_set_keylist_mode (ctx, GPGME_KEYLIST_MODE_LOCAL);
-  CHECK_ERR ("gpgme_set_keylist_mode")
-
-  gpgme_set_offline (ctx, 1);
+  // Get a keyring with the public key imported, and a context on it
+  keyring = keyring_acquire (key_str, key_len, uid_email, protocol, key_types,
+                             cache, &ctx);
+  if (keyring == NULL)
+    return -1;
+  keys[0] = keyring->key;
 
   encrypt_flags = GPGME_ENCRYPT_ALWAYS_TRUST | GPGME_ENCRYPT_NO_COMPRESS;
 
-  // Import public key into context
-  if (gvm_gpg_import_many_types_from_string (ctx, key_str, key_len, key_types))
-    {
-      g_warning ("%s: Import of %s failed", __func__, key_type_str);
-      gpgme_release (ctx);
-      gvm_file_remove_recurse (gpg_temp_dir);
-      return -1;
-    }
-
-  // Get imported public key
-  key = find_email_encryption_key (ctx, uid_email);
-  if (key == NULL)
-    {
-      g_warning ("%s: Could not find %s for encryption", __func__,
-                 key_type_str);
-      gpgme_release (ctx);
-      gvm_file_remove_recurse (gpg_temp_dir);
-      return -1;
-    }
-  keys[0] = key;
-
   // Set up data objects for input and output streams
   err = gpgme_data_new_from_stream (&plain_data, plain_file);
   CHECK_ERR ("gpgme_data_new_from_stream for plain text")
@@ -612,18 +1007,7 @@ encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
   CHECK_ERR ("gpgme_data_new_from_stream for encrypted text")
 
   if (protocol == GPGME_PROTOCOL_CMS)
-    {
-      gpgme_data_set_encoding (encrypted_data, GPGME_DATA_ENCODING_BASE64);
-
-      if (create_all_certificates_trustlist (ctx, gpg_temp_dir))
-        {
-          gpgme_data_release (plain_data);
-          gpgme_data_release (encrypted_data);
-          gpgme_release (ctx);
-          gvm_file_remove_recurse (gpg_temp_dir);
-          return -1;
-        }
-    }
+    gpgme_data_set_encoding (encrypted_data, GPGME_DATA_ENCODING_BASE64);
 
   // Encrypt data
   err = gpgme_op_encrypt (ctx, keys, encrypt_flags, plain_data, encrypted_data);
@@ -631,8 +1015,7 @@ encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
 
   gpgme_data_release (plain_data);
   gpgme_data_release (encrypted_data);
-  gpgme_release (ctx);
-  gvm_file_remove_recurse (gpg_temp_dir);
+  keyring_release (keyring, ctx);
 
   return 0;
 }
@@ -647,14 +1030,15 @@ encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
  * @param[in]  uid_email        Email address of public key to use.
  * @param[in]  public_key_str   String containing the public key.
  * @param[in]  public_key_len   Length of public key or -1 to use strlen.
+ * @param[in]  cache            Whether to use the keyring cache.
  *
  * @return 0 success, -1 error.
  */
-int
-gvm_pgp_pubkey_encrypt_stream (FILE *plain_file, FILE *encrypted_file,
-                               const char *uid_email,
-                               const char *public_key_str,
-                               ssize_t public_key_len)
+static int
+pgp_pubkey_encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
+                                    const char *uid_email,
+                                    const char *public_key_str,
+                                    ssize_t public_key_len, gboolean cache)
 {
   int ret;
   const gpgme_data_type_t types_ptr[1] = {GPGME_DATA_TYPE_PGP_KEY};
@@ -663,12 +1047,62 @@ gvm_pgp_pubkey_encrypt_stream (FILE *plain_file, FILE *encrypted_file,
   g_array_append_vals (key_types, types_ptr, 1);
   ret = encrypt_stream_internal (plain_file, encrypted_file, public_key_str,
                                  public_key_len, uid_email,
-                                 GPGME_PROTOCOL_OpenPGP, key_types);
+                                 GPGME_PROTOCOL_OpenPGP, key_types, cache);
   g_array_free (key_types, TRUE);
 
   return ret;
 }
 
+/**
+ * @brief Encrypt a stream for a PGP public key, writing to another stream.
+ *
+ * The output will use ASCII armor mode and no compression.
+ *
+ * @param[in]  plain_file       Stream / FILE* providing the plain text.
+ * @param[in]  encrypted_file   Stream to write the encrypted text to.
+ * @param[in]  uid_email        Email address of public key to use.
+ * @param[in]  public_key_str   String containing the public key.
+ * @param[in]  public_key_len   Length of public key or -1 to use strlen.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+gvm_pgp_pubkey_encrypt_stream (FILE *plain_file, FILE *encrypted_file,
+                               const char *uid_email,
+                               const char *public_key_str,
+                               ssize_t public_key_len)
+{
+  return pgp_pubkey_encrypt_stream_internal (plain_file, encrypted_file,
+                                             uid_email, public_key_str,
+                                             public_key_len, FALSE);
+}
+
+/**
+ * @brief Encrypt a stream for a PGP public key, caching the keyring.
+ *
+ * Like gvm_pgp_pubkey_encrypt_stream, but the keyring with the imported key
+ * is kept for further encryptions for the same key, until
+ * gvm_gpg_keyring_cache_clear, which the caller must call before exiting.
+ *
+ * @param[in]  plain_file       Stream / FILE* providing the plain text.
+ * @param[in]  encrypted_file   Stream to write the encrypted text to.
+ * @param[in]  uid_email        Email address of public key to use.
+ * @param[in]  public_key_str   String containing the public key.
+ * @param[in]  public_key_len   Length of public key or -1 to use strlen.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+gvm_pgp_pubkey_encrypt_stream_cached (FILE *plain_file, FILE *encrypted_file,
+                                      const char *uid_email,
+                                      const char *public_key_str,
+                                      ssize_t public_key_len)
+{
+  return pgp_pubkey_encrypt_stream_internal (plain_file, encrypted_file,
+                                             uid_email, public_key_str,
+                                             public_key_len, TRUE);
+}
+
 /**
  * @brief Encrypt a stream for a S/MIME certificate, writing to another stream.
  *
@@ -679,13 +1113,15 @@ gvm_pgp_pubkey_encrypt_stream (FILE *plain_file, FILE *encrypted_file,
  * @param[in]  uid_email        Email address of certificate to use.
  * @param[in]  certificate_str  String containing the public key.
  * @param[in]  certificate_len  Length of public key or -1 to use strlen.
+ * @param[in]  cache            Whether to use the keyring cache.
  *
  * @return 0 success, -1 error.
  */
-int
-gvm_smime_encrypt_stream (FILE *plain_file, FILE *encrypted_file,
-                          const char *uid_email, const char *certificate_str,
-                          ssize_t certificate_len)
+static int
+smime_encrypt_stream_internal (FILE *plain_file, FILE *encrypted_file,
+                               const char *uid_email,
+                               const char *certificate_str,
+                               ssize_t certificate_len, gboolean cache)
 {
   int ret;
   const gpgme_data_type_t types_ptr[2] = {GPGME_DATA_TYPE_X509_CERT,
@@ -695,8 +1131,57 @@ gvm_smime_encrypt_stream (FILE *plain_file, FILE *encrypted_file,
   g_array_append_vals (key_types, types_ptr, 2);
   ret = encrypt_stream_internal (plain_file, encrypted_file, certificate_str,
                                  certificate_len, uid_email, GPGME_PROTOCOL_CMS,
-                                 key_types);
+                                 key_types, cache);
   g_array_free (key_types, TRUE);
 
   return ret;
 }
+
+/**
+ * @brief Encrypt a stream for a S/MIME certificate, writing to another stream.
+ *
+ * The output will use ASCII armor mode and no compression.
+ *
+ * @param[in]  plain_file       Stream / FILE* providing the plain text.
+ * @param[in]  encrypted_file   Stream to write the encrypted text to.
+ * @param[in]  uid_email        Email address of certificate to use.
+ * @param[in]  certificate_str  String containing the public key.
+ * @param[in]  certificate_len  Length of public key or -1 to use strlen.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+gvm_smime_encrypt_stream (FILE *plain_file, FILE *encrypted_file,
+                          const char *uid_email, const char *certificate_str,
+                          ssize_t certificate_len)
+{
+  return smime_encrypt_stream_internal (plain_file, encrypted_file, uid_email,
+                                        certificate_str, certificate_len,
+                                        FALSE);
+}
+
+/**
+ * @brief Encrypt a stream for a S/MIME certificate, caching the keyring.
+ *
+ * Like gvm_smime_encrypt_stream, but the keyring with the imported
+ * certificate is kept for further encryptions for the same certificate,
+ * until gvm_gpg_keyring_cache_clear, which the caller must call before
+ * exiting.
+ *
+ * @param[in]  plain_file       Stream / FILE* providing the plain text.
+ * @param[in]  encrypted_file   Stream to write the encrypted text to.
+ * @param[in]  uid_email        Email address of certificate to use.
+ * @param[in]  certificate_str  String containing the public key.
+ * @param[in]  certificate_len  Length of public key or -1 to use strlen.
+ *
+ * @return 0 success, -1 error.
+ */
+int
+gvm_smime_encrypt_stream_cached (FILE *plain_file, FILE *encrypted_file,
+                                 const char *uid_email,
+                                 const char *certificate_str,
+                                 ssize_t certificate_len)
+{
+  return smime_encrypt_stream_internal (plain_file, encrypted_file, uid_email,
+                                        certificate_str, certificate_len, TRUE);
+}
@@ -48,7 +48,18 @@ int
 gvm_pgp_pubkey_encrypt_stream (FILE *, FILE *, const char *, const char *,
                                ssize_t);
 
+int
+gvm_pgp_pubkey_encrypt_stream_cached (FILE *, FILE *, const char *,
+                                      const char *, ssize_t);
+
 int
 gvm_smime_encrypt_stream (FILE *, FILE *, const char *, const char *, ssize_t);
 
+int
+gvm_smime_encrypt_stream_cached (FILE *, FILE *, const char *, const char *,
+                                 ssize_t);
+
+void
+gvm_gpg_keyring_cache_clear (void);
+
 #endif /*_GVM_GPGMEUTILS_H*/
@@ -829,6 +829,67 @@ redis_push_str (kb_t kb, const char *name, const char *value)
   return rc;
 }
 
+/**
+ * @brief Push several new entries under a given key in a single command.
+ *
+ * @param[in] kb  KB handle where to store the items.
+ * @param[in] name  Key to push to.
+ * @param[in] values Values to push.
+ * @param[in] count Number of values.
+ *
+ * @return 0 on success, non-null on error.
+ */
+static int
+redis_push_strs (kb_t kb, const char *name, const char **values, size_t count)
+{
+  struct kb_redis *kbr;
+  redisReply *rep = NULL;
+  const char **argv;
+  int retry = 0;
+  int rc = 0;
+
+  if (count == 0)
+    return 0;
+
+  kbr = redis_kb (kb);
+  argv = g_malloc0_n (count + 2, sizeof (char *));
+  argv[0] = "LPUSH";
+  argv[1] = name;
+  memcpy (argv + 2, values, count * sizeof (char *));
+
+  do
+    {
+      if (get_redis_ctx (kbr) < 0)
+        {
+          g_free (argv);
+          return -1;
+        }
+
+      rep = redisCommandArgv (kbr->rctx, count + 2, argv, NULL);
+      if (kbr->rctx->err)
+        {
+          if (rep != NULL)
+            freeReplyObject (rep);
+          rep = NULL;
+
+          redis_lnk_reset (kb);
+          retry = !retry;
+        }
+      else
+        retry = 0;
+    }
+  while (retry);
+
+  if (!rep || rep->type == REDIS_REPLY_ERROR)
+    rc = -1;
+
+  if (rep)
+    freeReplyObject (rep);
+  g_free (argv);
+
+  return rc;
+}
+
 /**
  * @brief Pops a single KB string item.
  *
@@ -1810,6 +1871,7 @@ static const struct kb_operations KBRedisOperations = {
   .kb_save = redis_save,
   .kb_flush = redis_flush_all,
   .kb_direct_conn = redis_direct_conn,
-  .kb_get_kb_index = redis_get_kb_index};
+  .kb_get_kb_index = redis_get_kb_index,
+  .kb_push_strs = redis_push_strs};
 
 const struct kb_operations *KBDefaultOperations = &KBRedisOperations;
@@ -231,6 +231,13 @@ struct kb_operations
   int (*kb_lnk_reset) (kb_t);           /**< Reset connection to KB. */
   int (*kb_flush) (kb_t, const char *); /**< Flush redis DB. */
   int (*kb_get_kb_index) (kb_t);        /**< Get kb index. */
+
+  /* Appended at the end to keep the offsets of the older members. */
+  /**
+   * Function provided by an implementation to push several new values under
+   * a key at once. Optional, kb_item_push_strs() falls back to kb_push_str.
+   */
+  int (*kb_push_strs) (kb_t, const char *, const char **, size_t);
 };
 
 /**
@@ -410,6 +417,42 @@ kb_item_push_str (kb_t kb, const char *name, const char *value)
   return kb->kb_ops->kb_push_str (kb, name, value);
 }
 
+/**
+ * @brief Push several new values under a given key at once.
+ *
+ * The values are pushed in order, as if kb_item_push_str() was called for
+ * each of them, but in a single round trip. Implementations without
+ * kb_push_strs get one kb_push_str call per value instead.
+ *
+ * @param[in] kb      KB handle where to store the items.
+ * @param[in] name    Key to push to.
+ * @param[in] values  Values to push.
+ * @param[in] count   Number of values.
+ * @return 0 on success, non-null on error.
+ */
+static inline int
+kb_item_push_strs (kb_t kb, const char *name, const char **values,
+                   size_t count)
+{
+  assert (kb);
+  assert (kb->kb_ops);
+
+  if (kb->kb_ops->kb_push_strs == NULL)
+    {
+      assert (kb->kb_ops->kb_push_str);
+      for (size_t i = 0; i < count; i++)
+        {
+          int rc = kb->kb_ops->kb_push_str (kb, name, values[i]);
+
+          if (rc)
+            return rc;
+        }
+      return 0;
+    }
+
+  return kb->kb_ops->kb_push_strs (kb, name, values, count);
+}
+
 /**
  * @brief Pop a single KB string item.
  * @param[in] kb  KB handle where to fetch the item.
@@ -22,6 +22,8 @@
 #include "uuidutils.h" /* gvm_uuid_make */
 
 #include <glib.h>
+#include <string.h> /* for strlen */
+#include <unistd.h> /* for getpid */
 
 #undef G_LOG_DOMAIN
 #define G_LOG_DOMAIN "lib  mqtt"
@@ -29,6 +31,43 @@
 #define QOS 1
 #define TIMEOUT 10000L
 
+/**
+ * @brief Maximum number of messages an asynchronous publisher has in flight.
+ *
+ * Matches the limit of the Paho client for unreliable connections.
+ */
+#define PUBLISH_WINDOW 10
+
+/**
+ * @brief Keep-alive interval of connections in seconds.
+ */
+#define KEEPALIVE 30
+
+/**
+ * @brief Seconds the broker keeps the session of a lost connection.
+ */
+#define SESSION_EXPIRY 3600
+
+/**
+ * @brief Seconds to wait for the broker when connecting.
+ */
+#define CONNECT_TIMEOUT 10
+
+/**
+ * @brief First delay before reconnecting in milliseconds.
+ */
+#define RECONNECT_DELAY_MIN 500
+
+/**
+ * @brief Maximum delay before reconnecting in milliseconds.
+ */
+#define RECONNECT_DELAY_MAX 60000
+
+/**
+ * @brief Maximum number of messages kept while disconnected.
+ */
+#define OUTBOUND_BUFFER_SIZE 10000
+
 /**
  * @brief Check for MQTT support
  *
@@ -43,7 +82,79 @@ gvm_has_mqtt_support ()
   return 0;
 }
 
+/**
+ * @brief Message queued for publishing.
+ */
+typedef struct
+{
+  gchar *topic;   ///< Topic to publish on.
+  gchar *payload; ///< Message.
+} queued_message_t;
+
+/**
+ * @brief Create a queued message.
+ *
+ * @param[in]  topic  Topic to publish on.
+ * @param[in]  msg    Message.
+ *
+ * @return Message.
+ */
+static queued_message_t *
+queued_message_new (const char *topic, const char *msg)
+{
+  queued_message_t *message;
+
+  message = g_malloc (sizeof (*message));
+  message->topic = g_strdup (topic);
+  message->payload = g_strdup (msg);
+  return message;
+}
+
+/**
+ * @brief Free a queued message.
+ *
+ * @param[in]  message  Message.
+ */
+static void
+queued_message_free (queued_message_t *message)
+{
+  if (message == NULL)
+    return;
+  g_free (message->topic);
+  g_free (message->payload);
+  g_free (message);
+}
+
 #ifdef HAVE_MQTT
+/**
+ * @brief Connection to a broker, shared by all users in the process.
+ */
+typedef struct
+{
+  mqtt_t mqtt;           ///< Handle.  First, so that handles can be cast.
+  gchar *key;            ///< Key in sessions.
+  pid_t pid;             ///< Process that owns the session.
+  int references;        ///< Users of the session.  Protected by sessions.
+  gint connected;        ///< Whether connected.  Accessed atomically.
+  GMutex mutex;          ///< Protects the fields below.
+  gint64 next_attempt;   ///< Monotonic time of the next reconnect attempt.
+  int delay;             ///< Delay after a failed attempt in milliseconds.
+  GQueue outbound;       ///< Messages published while disconnected.
+} mqtt_session_t;
+
+/**
+ * @brief Sessions by process ID and server URI.
+ *
+ * A forked child inherits the table, but its lookups include its own
+ * process ID, so it never gets a session of its parent.
+ */
+static GHashTable *sessions = NULL;
+
+/**
+ * @brief Protects sessions and the references of the sessions.
+ */
+static GMutex sessions_mutex;
+
 /**
  * Create a new mqtt client.
  *
@@ -69,11 +180,327 @@ mqtt_create (const char *server_uri, char *id)
     }
   return client;
 }
+
+/**
+ * @brief Connect a client to its broker.
+ *
+ * @param client      MQTT client.
+ * @param cleanstart  Whether to start a new session instead of resuming the
+ *                    session of the client id.
+ *
+ * @return MQTTCLIENT_SUCCESS or error code.
+ */
+static int
+broker_connect (MQTTClient client, int cleanstart)
+{
+  MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer5;
+  MQTTProperties connect_properties = MQTTProperties_initializer;
+  MQTTProperty property;
+  MQTTResponse resp;
+  int rc;
+
+  conn_opts.keepAliveInterval = KEEPALIVE;
+  conn_opts.cleanstart = cleanstart;
+  conn_opts.connectTimeout = CONNECT_TIMEOUT;
+  conn_opts.MQTTVersion = MQTTVERSION_5;
+  /* Allow several messages in flight, for mqtt_publish_async. */
+  conn_opts.reliable = 0;
+
+  /* Let the broker keep the session, and with it the messages in flight,
+   * while the connection is down. */
+  property.identifier = MQTTPROPERTY_CODE_SESSION_EXPIRY_INTERVAL;
+  property.value.integer4 = SESSION_EXPIRY;
+  MQTTProperties_add (&connect_properties, &property);
+
+  resp = MQTTClient_connect5 (client, &conn_opts, &connect_properties, NULL);
+  rc = resp.reasonCode;
+  MQTTProperties_free (&connect_properties);
+  MQTTResponse_free (resp);
+  return rc;
+}
+
+/**
+ * @brief Mark a session as disconnected.
+ *
+ * @param session  Session.
+ */
+static void
+session_lost (mqtt_session_t *session)
+{
+  if (g_atomic_int_compare_and_exchange (&session->connected, 1, 0))
+    g_warning ("%s: Lost connection to %s", __func__, session->mqtt.addr);
+}
+
+/**
+ * @brief Paho callback for a lost connection.
+ *
+ * @param context  Session.
+ * @param cause    Cause, may be NULL.
+ */
+static void
+connection_lost (void *context, char *cause)
+{
+  (void) cause;
+  session_lost (context);
+}
+
+/**
+ * @brief Paho callback for an arrived message.
+ *
+ * Nothing is subscribed, so messages are only freed.
+ *
+ * @param context    Session.
+ * @param topic      Topic of the message.
+ * @param topic_len  Length of topic.
+ * @param message    Message.
+ *
+ * @return 1, as the message was handled.
+ */
+static int
+message_arrived (void *context, char *topic, int topic_len,
+                 MQTTClient_message *message)
+{
+  (void) context;
+  (void) topic_len;
+  MQTTClient_freeMessage (&message);
+  MQTTClient_free (topic);
+  return 1;
+}
+
+/**
+ * @brief Wait until the broker acknowledged a message.
+ *
+ * @param[in]   client     MQTT client.
+ * @param[in]   token      Delivery token of the message.
+ * @param[out]  published  Incremented if the message was acknowledged.
+ * @param[out]  failed     Incremented otherwise.
+ */
+static void
+wait_for_delivery (MQTTClient client, MQTTClient_deliveryToken token,
+                   unsigned long *published, unsigned long *failed)
+{
+  int rc;
+
+  rc = MQTTClient_waitForCompletion (client, token, TIMEOUT);
+  if (rc == MQTTCLIENT_SUCCESS)
+    (*published)++;
+  else
+    {
+      g_debug ("%s: Message with delivery token %d could not be published: %s",
+               __func__, token, MQTTClient_strerror (rc));
+      (*failed)++;
+    }
+}
+
+/**
+ * @brief Publish a batch of messages without waiting for each one.
+ *
+ * Up to PUBLISH_WINDOW messages are in flight at a time.  Waiting for the
+ * oldest of them also processes the acknowledgements of the others.
+ *
+ * If the connection is lost, the messages that were not sent yet stay in
+ * the batch.
+ *
+ * @param[in]   session    Session.
+ * @param[in]   batch      Messages.  Sent messages are removed and freed.
+ * @param[out]  published  Incremented for each acknowledged message.
+ * @param[out]  failed     Incremented for each other sent message.
+ */
+static void
+publish_batch (mqtt_session_t *session, GQueue *batch,
+               unsigned long *published, unsigned long *failed)
+{
+  MQTTClient client = session->mqtt.client;
+  MQTTClient_deliveryToken tokens[PUBLISH_WINDOW];
+  queued_message_t *message;
+  int first, count;
+
+  first = count = 0;
+  while ((message = g_queue_pop_head (batch)))
+    {
+      MQTTClient_message pubmsg = MQTTClient_message_initializer;
+      MQTTResponse resp;
+      int rc;
+
+      pubmsg.payload = message->payload;
+      pubmsg.payloadlen = (int) strlen (message->payload);
+      pubmsg.qos = QOS;
+      pubmsg.retained = 0;
+
+      for (;;)
+        {
+          if (count == PUBLISH_WINDOW)
+            {
+              wait_for_delivery (client, tokens[first], published, failed);
+              first = (first + 1) % PUBLISH_WINDOW;
+              count--;
+            }
+          resp = MQTTClient_publishMessage5 (client, message->topic, &pubmsg,
+                                             &tokens[(first + count)
+                                                     % PUBLISH_WINDOW]);
+          rc = resp.reasonCode;
+          MQTTResponse_free (resp);
+          if (rc != MQTTCLIENT_MAX_MESSAGES_INFLIGHT || count == 0)
+            break;
+          /* The client allows fewer messages in flight, wait for one. */
+          wait_for_delivery (client, tokens[first], published, failed);
+          first = (first + 1) % PUBLISH_WINDOW;
+          count--;
+        }
+
+      if (rc == MQTTCLIENT_DISCONNECTED)
+        {
+          g_queue_push_head (batch, message);
+          session_lost (session);
+          break;
+        }
+      if (rc == MQTTCLIENT_SUCCESS)
+        count++;
+      else
+        {
+          g_warning ("%s: Failed to publish on topic %s: %s", __func__,
+                     message->topic, MQTTClient_strerror (rc));
+          (*failed)++;
+        }
+      queued_message_free (message);
+    }
+
+  for (; count; count--, first = (first + 1) % PUBLISH_WINDOW)
+    wait_for_delivery (client, tokens[first], published, failed);
+}
+
+/**
+ * @brief Publish the outbound buffer of a session.
+ *
+ * The session mutex must be held.
+ *
+ * @param session  Session.
+ */
+static void
+session_flush (mqtt_session_t *session)
+{
+  unsigned long published, failed;
+
+  if (g_queue_is_empty (&session->outbound))
+    return;
+
+  published = failed = 0;
+  publish_batch (session, &session->outbound, &published, &failed);
+  g_debug ("%s: Published %lu buffered messages to %s, %lu failed", __func__,
+           published, session->mqtt.addr, failed);
+}
+
+/**
+ * @brief Make sure a session is connected, reconnecting if it is time to.
+ *
+ * Reconnects resume the session of the client id, and are attempted with
+ * an exponential backoff.  After a reconnect the outbound buffer is
+ * published.
+ *
+ * @param session  Session.
+ *
+ * @return 0 if connected, -1 otherwise.
+ */
+static int
+session_connect (mqtt_session_t *session)
+{
+  gint64 now;
+  int rc;
+
+  if (g_atomic_int_get (&session->connected))
+    return 0;
+
+  g_mutex_lock (&session->mutex);
+  now = g_get_monotonic_time ();
+  if (g_atomic_int_get (&session->connected) || now < session->next_attempt)
+    {
+      g_mutex_unlock (&session->mutex);
+      return g_atomic_int_get (&session->connected) ? 0 : -1;
+    }
+
+  rc = broker_connect (session->mqtt.client, 0);
+  if (rc != MQTTCLIENT_SUCCESS)
+    {
+      g_debug ("%s: Reconnecting to %s failed: %s, next attempt in %d ms",
+               __func__, session->mqtt.addr, MQTTClient_strerror (rc),
+               session->delay);
+      session->next_attempt = now + session->delay * G_TIME_SPAN_MILLISECOND;
+      session->delay = MIN (session->delay * 2, RECONNECT_DELAY_MAX);
+      g_mutex_unlock (&session->mutex);
+      return -1;
+    }
+
+  g_message ("%s: Reconnected to %s", __func__, session->mqtt.addr);
+  session->delay = RECONNECT_DELAY_MIN;
+  g_atomic_int_set (&session->connected, 1);
+  session_flush (session);
+  g_mutex_unlock (&session->mutex);
+  return 0;
+}
+
+/**
+ * @brief Get the time of the next reconnect attempt of a session.
+ *
+ * @param session  Session.
+ *
+ * @return Monotonic time.
+ */
+static gint64
+session_next_attempt (mqtt_session_t *session)
+{
+  gint64 next_attempt;
+
+  g_mutex_lock (&session->mutex);
+  next_attempt = session->next_attempt;
+  g_mutex_unlock (&session->mutex);
+  return next_attempt;
+}
+
+/**
+ * @brief Move messages to the outbound buffer of a session.
+ *
+ * @param session   Session.
+ * @param messages  Messages.  Emptied.
+ *
+ * @return Number of messages dropped because the buffer is full.
+ */
+static unsigned int
+session_buffer (mqtt_session_t *session, GQueue *messages)
+{
+  queued_message_t *message;
+  unsigned int dropped;
+
+  dropped = 0;
+  g_mutex_lock (&session->mutex);
+  while ((message = g_queue_pop_head (messages)))
+    if (session->outbound.length < OUTBOUND_BUFFER_SIZE)
+      g_queue_push_tail (&session->outbound, message);
+    else
+      {
+        queued_message_free (message);
+        dropped++;
+      }
+  if (dropped)
+    g_warning ("%s: Outbound buffer for %s is full, dropped %u messages",
+               __func__, session->mqtt.addr, dropped);
+  /* The connection may have come back meanwhile. */
+  if (g_atomic_int_get (&session->connected))
+    session_flush (session);
+  g_mutex_unlock (&session->mutex);
+
+  return dropped;
+}
 #endif /* HAVE_MQTT */
 
 /**
  * @brief connect to a mqtt broker.
  *
+ * The connection is shared by all callers in the process that connect to
+ * the same broker, and must be released with mqtt_disconnect.  A forked
+ * child gets a connection of its own.  It keeps its client id for its
+ * lifetime and reconnects with an exponential backoff when it is lost,
+ * resuming the session on the broker.
+ *
  * @param server_uri  Address of the broker.
  *
  * @return Mqtt handle, NULL on error.
@@ -83,92 +510,186 @@ mqtt_connect (const char *server_uri)
 {
 #ifdef HAVE_MQTT
   char *uuid;
+  gchar *key;
   int rc;
   MQTTClient client;
-  mqtt_t *mqtt = NULL;
-  MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer5;
-  MQTTProperties connect_properties = MQTTProperties_initializer;
-  MQTTResponse resp;
+  mqtt_session_t *session;
+
+  key = g_strdup_printf ("%d %s", (int) getpid (), server_uri);
+
+  g_mutex_lock (&sessions_mutex);
+  if (sessions == NULL)
+    sessions = g_hash_table_new (g_str_hash, g_str_equal);
+  session = g_hash_table_lookup (sessions, key);
+  if (session)
+    {
+      session->references++;
+      g_mutex_unlock (&sessions_mutex);
+      g_free (key);
+      return &session->mqtt;
+    }
 
   uuid = gvm_uuid_make ();
   client = mqtt_create (server_uri, uuid);
   if (!client)
-    return NULL;
+    {
+      g_mutex_unlock (&sessions_mutex);
+      g_free (uuid);
+      g_free (key);
+      return NULL;
+    }
 
-  conn_opts.keepAliveInterval = 0;
-  conn_opts.cleanstart = 1;
-  conn_opts.MQTTVersion = MQTTVERSION_5;
+  session = g_malloc0 (sizeof (*session));
+  /* Callbacks make the client keep the connection alive in the background. */
+  MQTTClient_setCallbacks (client, session, connection_lost, message_arrived,
+                           NULL);
 
-  resp = MQTTClient_connect5 (client, &conn_opts, &connect_properties, NULL);
-  rc = resp.reasonCode;
-  MQTTProperties_free (&connect_properties);
+  rc = broker_connect (client, 1);
   if (rc != MQTTCLIENT_SUCCESS)
     {
+      g_mutex_unlock (&sessions_mutex);
       g_log (G_LOG_DOMAIN, G_LOG_LEVEL_CRITICAL,
              "%s: mqtt connection error to %s: %s", __func__, server_uri,
              MQTTClient_strerror (rc));
-      MQTTResponse_free (resp);
+      MQTTClient_destroy (&client);
+      g_free (session);
+      g_free (uuid);
+      g_free (key);
       return NULL;
     }
 
-  mqtt = g_malloc0 (sizeof (mqtt));
-  mqtt->client = client;
-  mqtt->addr = g_strdup (server_uri);
-  mqtt->client_id = uuid;
+  session->key = key;
+  session->pid = getpid ();
+  session->mqtt.client = client;
+  session->mqtt.addr = g_strdup (server_uri);
+  session->mqtt.client_id = uuid;
+  session->references = 1;
+  session->connected = 1;
+  g_mutex_init (&session->mutex);
+  session->delay = RECONNECT_DELAY_MIN;
+  g_queue_init (&session->outbound);
+  g_hash_table_insert (sessions, session->key, session);
+  g_mutex_unlock (&sessions_mutex);
 
-  return mqtt;
+  return &session->mqtt;
 #else
   (void) server_uri;
   return NULL;
 #endif /* HAVE_MQTT */
 }
 
+/**
+ * @brief Release a handle from mqtt_connect.
+ *
+ * The last release of a connection tries to publish the outbound buffer,
+ * then disconnects from the broker.  Handles inherited from a parent process
+ * are left alone, as the connection belongs to the parent.
+ *
+ * @param mqtt  MQTT handle.
+ */
+void
+mqtt_disconnect (mqtt_t *mqtt)
+{
+#ifdef HAVE_MQTT
+  mqtt_session_t *session = (mqtt_session_t *) mqtt;
+  queued_message_t *message;
+  MQTTClient client;
+
+  if (mqtt == NULL || session->pid != getpid ())
+    return;
+
+  g_mutex_lock (&sessions_mutex);
+  if (--session->references > 0)
+    {
+      g_mutex_unlock (&sessions_mutex);
+      return;
+    }
+  g_hash_table_remove (sessions, session->key);
+  g_mutex_unlock (&sessions_mutex);
+
+  client = mqtt->client;
+  session_connect (session);
+  if (!g_queue_is_empty (&session->outbound))
+    g_warning ("%s: Dropping %u messages which could not be published to %s",
+               __func__, session->outbound.length, mqtt->addr);
+  while ((message = g_queue_pop_head (&session->outbound)))
+    queued_message_free (message);
+
+  if (g_atomic_int_get (&session->connected))
+    MQTTClient_disconnect5 (client, TIMEOUT,
+                            MQTTREASONCODE_NORMAL_DISCONNECTION, NULL);
+  MQTTClient_destroy (&client);
+  g_mutex_clear (&session->mutex);
+  g_free (mqtt->addr);
+  g_free (mqtt->client_id);
+  g_free (session->key);
+  g_free (session);
+#else
+  (void) mqtt;
+#endif /* HAVE_MQTT */
+}
+
 /**
  * @brief Publish message on topic.
  *
+ * While the broker is unreachable the message is kept in an outbound
+ * buffer, which is published after the connection is back.
+ *
  * @param mqtt  MQTT handle.
  * @param topic Topic to publish on.
  * @param msg   Message to publish on queue.
  *
- * @return 0 on success, negative errorcode on failure.
+ * @return 0 on success or if buffered, negative errorcode on failure.
  */
 int
 mqtt_publish (mqtt_t *mqtt, const char *topic, const char *msg)
 {
 #ifdef HAVE_MQTT
+  mqtt_session_t *session = (mqtt_session_t *) mqtt;
   MQTTClient client;
   MQTTClient_message pubmsg = MQTTClient_message_initializer;
   MQTTClient_deliveryToken token;
   MQTTResponse resp;
+  GQueue messages;
   int rc;
 
   client = mqtt->client;
   if (!client)
     return -1;
 
-  pubmsg.payload = (char *) msg;
-  pubmsg.payloadlen = (int) strlen (msg);
-  pubmsg.qos = QOS;
-  pubmsg.retained = 0;
-
-  resp = MQTTClient_publishMessage5 (client, topic, &pubmsg, &token);
-  rc = resp.reasonCode;
-  if (rc != MQTTCLIENT_SUCCESS)
+  if (session_connect (session) == 0)
     {
-      g_warning ("Failed to connect: %s", MQTTClient_strerror (rc));
-      MQTTResponse_free (resp);
-      return -1;
-    }
+      pubmsg.payload = (char *) msg;
+      pubmsg.payloadlen = (int) strlen (msg);
+      pubmsg.qos = QOS;
+      pubmsg.retained = 0;
 
-  if ((rc = MQTTClient_waitForCompletion (client, token, TIMEOUT))
-      != MQTTCLIENT_SUCCESS)
-    {
-      g_debug ("Message '%s' with delivery token %d could not be "
-               "published on topic %s",
-               msg, token, topic);
+      resp = MQTTClient_publishMessage5 (client, topic, &pubmsg, &token);
+      rc = resp.reasonCode;
+      MQTTResponse_free (resp);
+      if (rc == MQTTCLIENT_SUCCESS)
+        {
+          if ((rc = MQTTClient_waitForCompletion (client, token, TIMEOUT))
+              != MQTTCLIENT_SUCCESS)
+            {
+              g_debug ("Message '%s' with delivery token %d could not be "
+                       "published on topic %s",
+                       msg, token, topic);
+            }
+          return rc;
+        }
+      if (rc != MQTTCLIENT_DISCONNECTED)
+        {
+          g_warning ("Failed to publish: %s", MQTTClient_strerror (rc));
+          return -1;
+        }
+      session_lost (session);
     }
 
-  return rc;
+  /* Keep the message for when the connection is back. */
+  g_queue_init (&messages);
+  g_queue_push_tail (&messages, queued_message_new (topic, msg));
+  return session_buffer (session, &messages) ? -1 : 0;
 #else
   (void) mqtt;
   (void) topic;
@@ -176,3 +697,269 @@ mqtt_publish (mqtt_t *mqtt, const char *topic, const char *msg)
   return -1;
 #endif /* HAVE_MQTT */
 }
+
+/**
+ * @brief Asynchronous publisher.
+ */
+struct mqtt_publisher
+{
+  mqtt_t *mqtt;                 ///< MQTT handle.
+  GMutex mutex;                 ///< Protects the fields below.
+  GCond cond;                   ///< Signalled when the queue changes.
+  GQueue queue;                 ///< Queued messages.
+  unsigned int queue_size;      ///< Maximum number of queued messages.
+  mqtt_queue_policy_t policy;   ///< What to do when the queue is full.
+  unsigned int sending;         ///< Messages taken by the sender.
+  gboolean stop;                ///< Whether the sender should stop.
+  mqtt_publisher_stats_t stats; ///< Counters.
+  GThread *sender;              ///< Sender thread.
+};
+
+#ifdef HAVE_MQTT
+/**
+ * @brief Sender thread of an asynchronous publisher.
+ *
+ * Takes all queued messages at once and publishes them as a batch, until
+ * the publisher is stopped and the queue is empty.  While the broker is
+ * unreachable the messages stay queued, so that the policy of the publisher
+ * applies.  When stopping they go to the outbound buffer of the connection.
+ *
+ * @param[in]  data  Publisher.
+ *
+ * @return NULL.
+ */
+static gpointer
+publisher_sender (gpointer data)
+{
+  mqtt_publisher_t *publisher = data;
+  mqtt_session_t *session = (mqtt_session_t *) publisher->mqtt;
+
+  g_mutex_lock (&publisher->mutex);
+  for (;;)
+    {
+      GQueue batch;
+      unsigned long published, failed, dropped;
+      gint64 next_attempt;
+      gboolean connected;
+
+      while (g_queue_is_empty (&publisher->queue) && !publisher->stop)
+        g_cond_wait (&publisher->cond, &publisher->mutex);
+      if (g_queue_is_empty (&publisher->queue))
+        break;
+
+      g_mutex_unlock (&publisher->mutex);
+      connected = session_connect (session) == 0;
+      next_attempt = session_next_attempt (session);
+      g_mutex_lock (&publisher->mutex);
+      if (!connected && !publisher->stop)
+        {
+          g_cond_wait_until (&publisher->cond, &publisher->mutex,
+                             next_attempt);
+          continue;
+        }
+
+      batch = publisher->queue;
+      g_queue_init (&publisher->queue);
+      publisher->sending = batch.length;
+      /* Wake up publishers waiting for space. */
+      g_cond_broadcast (&publisher->cond);
+      g_mutex_unlock (&publisher->mutex);
+
+      published = failed = dropped = 0;
+      publish_batch (session, &batch, &published, &failed);
+      /* Keep what was not sent for when the connection is back. */
+      if (!g_queue_is_empty (&batch))
+        dropped = session_buffer (session, &batch);
+
+      g_mutex_lock (&publisher->mutex);
+      publisher->stats.published += published;
+      publisher->stats.failed += failed;
+      publisher->stats.dropped += dropped;
+      publisher->sending = 0;
+      /* Wake up mqtt_publisher_flush. */
+      g_cond_broadcast (&publisher->cond);
+    }
+  g_mutex_unlock (&publisher->mutex);
+
+  return NULL;
+}
+#endif /* HAVE_MQTT */
+
+/**
+ * @brief Create an asynchronous publisher.
+ *
+ * Messages passed to mqtt_publish_async are queued and published by a
+ * sender thread, which keeps several messages in flight instead of waiting
+ * for the broker after each one.
+ *
+ * @param[in]  mqtt        MQTT handle.  Must outlive the publisher.
+ * @param[in]  queue_size  Maximum number of queued messages.
+ * @param[in]  policy      What to do when the queue is full.
+ *
+ * @return Publisher, NULL on error.
+ */
+mqtt_publisher_t *
+mqtt_publisher_new (mqtt_t *mqtt, unsigned int queue_size,
+                    mqtt_queue_policy_t policy)
+{
+#ifdef HAVE_MQTT
+  mqtt_publisher_t *publisher;
+
+  if (mqtt == NULL || mqtt->client == NULL || queue_size == 0)
+    return NULL;
+
+  publisher = g_malloc0 (sizeof (*publisher));
+  publisher->mqtt = mqtt;
+  g_mutex_init (&publisher->mutex);
+  g_cond_init (&publisher->cond);
+  g_queue_init (&publisher->queue);
+  publisher->queue_size = queue_size;
+  publisher->policy = policy;
+  publisher->sender =
+    g_thread_new ("mqtt publisher", publisher_sender, publisher);
+
+  return publisher;
+#else
+  (void) mqtt;
+  (void) queue_size;
+  (void) policy;
+  return NULL;
+#endif /* HAVE_MQTT */
+}
+
+/**
+ * @brief Queue a message for publishing on a topic.
+ *
+ * @param publisher  Publisher.
+ * @param topic      Topic to publish on.
+ * @param msg        Message to publish.
+ *
+ * @return 0 if queued, 1 if dropped because the queue was full, -1 on error.
+ */
+int
+mqtt_publish_async (mqtt_publisher_t *publisher, const char *topic,
+                    const char *msg)
+{
+  queued_message_t *message, *dropped;
+  int rc;
+
+  if (publisher == NULL || topic == NULL || msg == NULL)
+    return -1;
+
+  message = queued_message_new (topic, msg);
+  dropped = NULL;
+  rc = 0;
+
+  g_mutex_lock (&publisher->mutex);
+  if (publisher->stop)
+    {
+      g_mutex_unlock (&publisher->mutex);
+      queued_message_free (message);
+      return -1;
+    }
+  if (publisher->queue.length >= publisher->queue_size)
+    switch (publisher->policy)
+      {
+      case MQTT_QUEUE_BLOCK:
+        publisher->stats.blocked++;
+        while (publisher->queue.length >= publisher->queue_size)
+          g_cond_wait (&publisher->cond, &publisher->mutex);
+        break;
+      case MQTT_QUEUE_DROP_OLDEST:
+        dropped = g_queue_pop_head (&publisher->queue);
+        publisher->stats.dropped++;
+        break;
+      default: /* MQTT_QUEUE_DROP_NEWEST */
+        dropped = message;
+        message = NULL;
+        publisher->stats.dropped++;
+        rc = 1;
+        break;
+      }
+  if (message)
+    {
+      g_queue_push_tail (&publisher->queue, message);
+      publisher->stats.queued++;
+      publisher->stats.max_length =
+        MAX (publisher->stats.max_length, publisher->queue.length);
+      g_cond_broadcast (&publisher->cond);
+    }
+  g_mutex_unlock (&publisher->mutex);
+
+  queued_message_free (dropped);
+  return rc;
+}
+
+/**
+ * @brief Wait until all queued messages are published.
+ *
+ * @param publisher  Publisher.
+ * @param timeout    Maximum time to wait in milliseconds, -1 to wait forever.
+ *
+ * @return 0 if all messages were published or failed, -1 on timeout.
+ */
+int
+mqtt_publisher_flush (mqtt_publisher_t *publisher, int timeout)
+{
+  gint64 deadline;
+  int rc = 0;
+
+  if (publisher == NULL)
+    return -1;
+
+  deadline =
+    g_get_monotonic_time () + (gint64) timeout * G_TIME_SPAN_MILLISECOND;
+  g_mutex_lock (&publisher->mutex);
+  while (!g_queue_is_empty (&publisher->queue) || publisher->sending)
+    {
+      if (timeout < 0)
+        g_cond_wait (&publisher->cond, &publisher->mutex);
+      else if (!g_cond_wait_until (&publisher->cond, &publisher->mutex,
+                                   deadline))
+        {
+          rc = -1;
+          break;
+        }
+    }
+  g_mutex_unlock (&publisher->mutex);
+
+  return rc;
+}
+
+/**
+ * @brief Get the counters of a publisher.
+ *
+ * @param[in]   publisher  Publisher.
+ * @param[out]  stats      Counters.
+ */
+void
+mqtt_publisher_stats (mqtt_publisher_t *publisher,
+                      mqtt_publisher_stats_t *stats)
+{
+  g_mutex_lock (&publisher->mutex);
+  *stats = publisher->stats;
+  g_mutex_unlock (&publisher->mutex);
+}
+
+/**
+ * @brief Publish the queued messages and free a publisher.
+ *
+ * @param publisher  Publisher.
+ */
+void
+mqtt_publisher_free (mqtt_publisher_t *publisher)
+{
+  if (publisher == NULL)
+    return;
+
+  g_mutex_lock (&publisher->mutex);
+  publisher->stop = TRUE;
+  g_cond_broadcast (&publisher->cond);
+  g_mutex_unlock (&publisher->mutex);
+  /* The sender only returns once the queue is empty. */
+  g_thread_join (publisher->sender);
+
+  g_cond_clear (&publisher->cond);
+  g_mutex_clear (&publisher->mutex);
+  g_free (publisher);
+}
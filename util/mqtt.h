@@ -37,7 +37,53 @@ gvm_has_mqtt_support (void);
 mqtt_t *
 mqtt_connect (const char *);
 
+void
+mqtt_disconnect (mqtt_t *);
+
 int
 mqtt_publish (mqtt_t *, const char *, const char *);
 
+/**
+ * @brief What an asynchronous publisher does when its queue is full.
+ */
+typedef enum
+{
+  MQTT_QUEUE_BLOCK,       ///< Wait until the sender made space.
+  MQTT_QUEUE_DROP_NEWEST, ///< Drop the message being published.
+  MQTT_QUEUE_DROP_OLDEST, ///< Drop the oldest queued message.
+} mqtt_queue_policy_t;
+
+/**
+ * @brief Counters of an asynchronous publisher.
+ */
+typedef struct
+{
+  unsigned long queued;    ///< Messages accepted into the queue.
+  unsigned long published; ///< Messages acknowledged by the broker.
+  unsigned long failed;    ///< Messages the broker did not acknowledge.
+  unsigned long dropped;   ///< Messages dropped because the queue was full.
+  unsigned long blocked;   ///< Publishes that waited for the full queue.
+  unsigned int max_length; ///< Highest number of queued messages.
+} mqtt_publisher_stats_t;
+
+/**
+ * @brief Asynchronous publisher, see mqtt_publisher_new.
+ */
+typedef struct mqtt_publisher mqtt_publisher_t;
+
+mqtt_publisher_t *
+mqtt_publisher_new (mqtt_t *, unsigned int, mqtt_queue_policy_t);
+
+int
+mqtt_publish_async (mqtt_publisher_t *, const char *, const char *);
+
+int
+mqtt_publisher_flush (mqtt_publisher_t *, int);
+
+void
+mqtt_publisher_stats (mqtt_publisher_t *, mqtt_publisher_stats_t *);
+
+void
+mqtt_publisher_free (mqtt_publisher_t *);
+
 #endif /* _GVM_MQTT_H */
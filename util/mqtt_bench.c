@@ -0,0 +1,154 @@
+/* Copyright (C) 2021 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/**
+ * @file
+ * @brief Stand-alone benchmark of publishing results over MQTT.
+ *
+ * Publishes synthetic result messages to a broker, e.g. a local mosquitto,
+ * one at a time with mqtt_publish or queued with mqtt_publish_async:
+ *
+ *   ./mqtt-bench --uri tcp://localhost:1883 --count 10000 --async
+ */
+
+#include "mqtt.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+int
+main (int argc, char **argv)
+{
+  static gchar *uri = "tcp://localhost:1883";
+  static gchar *topic = "scanner/results";
+  static gint count = 10000;
+  static gint size = 200;
+  static gint queue_size = 1000;
+  static gboolean async = FALSE;
+  static gboolean drop = FALSE;
+  static GOptionEntry entries[] = {
+    {"uri", 'u', 0, G_OPTION_ARG_STRING, &uri,
+     "URI of the broker (default tcp://localhost:1883)", "<URI>"},
+    {"topic", 't', 0, G_OPTION_ARG_STRING, &topic,
+     "Topic to publish on (default scanner/results)", "<TOPIC>"},
+    {"count", 'c', 0, G_OPTION_ARG_INT, &count,
+     "Number of messages (default 10000)", "<N>"},
+    {"size", 's', 0, G_OPTION_ARG_INT, &size,
+     "Size of a message in bytes (default 200)", "<BYTES>"},
+    {"async", 'a', 0, G_OPTION_ARG_NONE, &async,
+     "Publish with an asynchronous publisher", NULL},
+    {"queue-size", 'q', 0, G_OPTION_ARG_INT, &queue_size,
+     "Queue size of the asynchronous publisher (default 1000)", "<N>"},
+    {"drop", 'd', 0, G_OPTION_ARG_NONE, &drop,
+     "Drop the newest messages when the queue is full instead of waiting",
+     NULL},
+    {NULL, 0, 0, 0, NULL, NULL, NULL}};
+  GOptionContext *option_context;
+  GError *error = NULL;
+  mqtt_publisher_t *publisher;
+  mqtt_publisher_stats_t stats;
+  mqtt_t *mqtt;
+  gchar *msg;
+  gint64 start, queued, end;
+  int failed;
+
+  option_context =
+    g_option_context_new ("- benchmark publishing results over MQTT");
+  g_option_context_add_main_entries (option_context, entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (option_context);
+
+  if (count <= 0 || size <= 0 || queue_size <= 0)
+    {
+      fprintf (stderr, "Count, size and queue size must be positive.\n");
+      return 1;
+    }
+  if (!gvm_has_mqtt_support ())
+    {
+      fprintf (stderr, "Built without MQTT support.\n");
+      return 1;
+    }
+
+  mqtt = mqtt_connect (uri);
+  if (mqtt == NULL)
+    {
+      fprintf (stderr, "Could not connect to %s.\n", uri);
+      return 1;
+    }
+
+  msg = g_malloc (size + 1);
+  memset (msg, 'r', size);
+  msg[size] = '\0';
+
+  publisher = NULL;
+  if (async)
+    {
+      publisher = mqtt_publisher_new (
+        mqtt, queue_size, drop ? MQTT_QUEUE_DROP_NEWEST : MQTT_QUEUE_BLOCK);
+      if (publisher == NULL)
+        {
+          fprintf (stderr, "Could not create publisher.\n");
+          return 1;
+        }
+    }
+
+  failed = 0;
+  start = g_get_monotonic_time ();
+  for (int index = 0; index < count; index++)
+    if ((async ? mqtt_publish_async (publisher, topic, msg)
+               : mqtt_publish (mqtt, topic, msg))
+        < 0)
+      failed++;
+  queued = g_get_monotonic_time ();
+  if (async)
+    mqtt_publisher_flush (publisher, -1);
+  end = g_get_monotonic_time ();
+
+  printf ("Broker:                  %s\n", uri);
+  printf ("Messages:                %d of %d bytes\n", count, size);
+  printf ("Mode:                    %s\n", async ? "async" : "sync");
+  printf ("Failed publishes:        %d\n", failed);
+  if (async)
+    {
+      mqtt_publisher_stats (publisher, &stats);
+      printf ("Queued:                  %lu\n", stats.queued);
+      printf ("Published:               %lu\n", stats.published);
+      printf ("Failed deliveries:       %lu\n", stats.failed);
+      printf ("Dropped:                 %lu\n", stats.dropped);
+      printf ("Blocked publishes:       %lu\n", stats.blocked);
+      printf ("Highest queue length:    %u\n", stats.max_length);
+      printf ("Time to queue:           %.3f s\n",
+              (queued - start) / 1000000.0);
+      mqtt_publisher_free (publisher);
+    }
+  printf ("End-to-end time:         %.3f s\n", (end - start) / 1000000.0);
+  printf ("Throughput:              %.0f messages/s\n",
+          count / MAX ((end - start) / 1000000.0, 1e-6));
+
+  mqtt_disconnect (mqtt);
+  g_free (msg);
+
+  return 0;
+}
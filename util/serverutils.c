@@ -30,6 +30,7 @@
 #include "serverutils.h"
 
 #include "../base/hosts.h" /* for is_hostname, is_ipv4_address, is_ipv6_add.. */
+#include "../base/logging.h" /* for gvm_log_debug_enabled */
 
 #include <arpa/inet.h>
 #include <errno.h>  /* for errno, ENOTCONN, EAGAIN */
@@ -37,13 +38,17 @@
 #include <gcrypt.h> /* for gcry_control */
 #include <glib.h>   /* for g_warning, g_free, g_debug, gchar, g_markup... */
 #include <gnutls/x509.h> /* for gnutls_x509_crt_..., gnutls_x509_privkey_... */
+#include <limits.h>     /* for IOV_MAX */
 #include <netdb.h>      /* for addrinfo, freeaddrinfo, gai_strerror, getad... */
+#include <poll.h>       /* for poll, pollfd, POLLOUT */
 #include <signal.h>     /* for sigaction, SIGPIPE, sigemptyset, SIG_IGN */
 #include <stdio.h>      /* for fclose, FILE, SEEK_END, SEEK_SET */
 #include <string.h>     /* for strerror, strlen, memset */
 #include <sys/socket.h> /* for shutdown, connect, socket, SHUT_RDWR, SOCK_... */
+#include <sys/stat.h>   /* for stat */
 #include <sys/types.h>
-#include <unistd.h> /* for close, ssize_t, usleep */
+#include <sys/uio.h> /* for writev */
+#include <unistd.h>  /* for close, ssize_t, usleep */
 
 #undef G_LOG_DOMAIN
 /**
@@ -51,6 +56,16 @@
  */
 #define G_LOG_DOMAIN "libgvm util"
 
+/**
+ * @brief Initial size of send buffers.
+ */
+#define SEND_BUFFER_SIZE 4096
+
+/**
+ * @brief Size above which a send buffer is freed instead of kept for reuse.
+ */
+#define SEND_BUFFER_MAX (1024 * 1024)
+
 /**
  * @brief Server address.
  */
@@ -61,10 +76,106 @@ server_attach_internal (int, gnutls_session_t *, const char *, int);
 static int
 server_new_internal (unsigned int, const char *, const gchar *, const gchar *,
                      const gchar *, gnutls_session_t *,
-                     gnutls_certificate_credentials_t *);
+                     gnutls_certificate_credentials_t *, gboolean);
+static int
+server_new_gnutls_set (unsigned int, const char *, gnutls_session_t *,
+                       gnutls_certificate_credentials_t *);
 
 /* Connections. */
 
+/**
+ * @brief State of a connection that is kept outside of gvm_connection_t.
+ */
+typedef struct
+{
+  gvm_compress_stream_t *compression; ///< Compression, NULL if uncompressed.
+  GString *output;  ///< Output buffer of a corked connection, or NULL.
+  int corked;       ///< Number of gvm_connection_cork without uncork.
+  int output_quiet; ///< Whether the output buffer holds a quiet send.
+} connection_state_t;
+
+/**
+ * @brief States of connections by socket.
+ *
+ * Only connections that enabled a feature have a state, so gvm_connection_t
+ * keeps its layout and plain connections never look into the table.
+ */
+static GHashTable *connection_states = NULL;
+
+/**
+ * @brief Number of entries in connection_states.  Accessed atomically.
+ */
+static gint connection_states_size = 0;
+
+/**
+ * @brief Protects connection_states.
+ */
+static GMutex connection_states_mutex;
+
+/**
+ * @brief Get the state of a connection.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  create      Whether to create the state if there is none.
+ *
+ * @return State, or NULL if the connection has none and create is FALSE.
+ */
+static connection_state_t *
+connection_state (const gvm_connection_t *connection, gboolean create)
+{
+  connection_state_t *state;
+
+  if (create == FALSE && g_atomic_int_get (&connection_states_size) == 0)
+    return NULL;
+
+  g_mutex_lock (&connection_states_mutex);
+  if (connection_states == NULL)
+    connection_states = g_hash_table_new (g_direct_hash, g_direct_equal);
+  state = g_hash_table_lookup (connection_states,
+                               GINT_TO_POINTER (connection->socket));
+  if (state == NULL && create)
+    {
+      state = g_malloc0 (sizeof (*state));
+      g_hash_table_insert (connection_states,
+                           GINT_TO_POINTER (connection->socket), state);
+      g_atomic_int_inc (&connection_states_size);
+    }
+  g_mutex_unlock (&connection_states_mutex);
+  return state;
+}
+
+/**
+ * @brief Remove and free the state of a connection, if it has one.
+ *
+ * @param[in]  connection  Connection.
+ */
+static void
+connection_state_free (gvm_connection_t *connection)
+{
+  connection_state_t *state;
+
+  if (g_atomic_int_get (&connection_states_size) == 0)
+    return;
+
+  g_mutex_lock (&connection_states_mutex);
+  state = g_hash_table_lookup (connection_states,
+                               GINT_TO_POINTER (connection->socket));
+  if (state)
+    {
+      g_hash_table_remove (connection_states,
+                           GINT_TO_POINTER (connection->socket));
+      g_atomic_int_add (&connection_states_size, -1);
+    }
+  g_mutex_unlock (&connection_states_mutex);
+
+  if (state == NULL)
+    return;
+  gvm_compress_stream_free (state->compression);
+  if (state->output)
+    g_string_free (state->output, TRUE);
+  g_free (state);
+}
+
 /**
  * @brief Close UNIX socket connection.
  *
@@ -110,6 +221,7 @@ close_unix (gvm_connection_t *client_connection)
 void
 gvm_connection_free (gvm_connection_t *client_connection)
 {
+  connection_state_free (client_connection);
   if (client_connection->tls)
     gvm_server_free (client_connection->socket, client_connection->session,
                      client_connection->credentials);
@@ -117,6 +229,54 @@ gvm_connection_free (gvm_connection_t *client_connection)
     close_unix (client_connection);
 }
 
+/**
+ * @brief Compress all further traffic on a connection.
+ *
+ * Both peers must switch at the same point of the conversation, e.g. right
+ * after a command that negotiated compression.  Afterwards the connection
+ * functions like gvm_connection_sendf and read_entity_c compress and
+ * uncompress transparently, until gvm_connection_free.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  level       zlib compression level, 0 to 9, or -1 for the
+ *                         default.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_connection_enable_compression (gvm_connection_t *connection, int level)
+{
+  connection_state_t *state;
+
+  state = connection_state (connection, TRUE);
+  if (state->compression)
+    return 0;
+
+  state->compression = gvm_compress_stream_new (level);
+  if (state->compression == NULL)
+    {
+      g_warning ("%s: Failed to set up compression", __func__);
+      return -1;
+    }
+  return 0;
+}
+
+/**
+ * @brief Get the compression of a connection.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return Compression stream, or NULL if the connection is uncompressed.
+ */
+gvm_compress_stream_t *
+gvm_connection_compression (const gvm_connection_t *connection)
+{
+  connection_state_t *state;
+
+  state = connection_state (connection, FALSE);
+  return state ? state->compression : NULL;
+}
+
 /* Certificate verification. */
 
 /**
@@ -316,6 +476,584 @@ client_cert_callback (gnutls_session_t session,
   return 0;
 }
 
+/* Credentials cache. */
+
+/**
+ * @brief Credentials shared by the sessions with the same certificates.
+ */
+typedef struct
+{
+  gnutls_certificate_credentials_t credentials; ///< Credentials.
+  gchar *key;     ///< Key in credentials_cache.
+  gchar *stamp;   ///< Modification stamp of the certificate files.
+  int references; ///< Number of users, the cache included.
+} shared_credentials_t;
+
+/**
+ * @brief Shared credentials, by certificate file paths or certificate hash.
+ */
+static GHashTable *credentials_cache = NULL;
+
+/**
+ * @brief Shared credentials, by credentials.
+ */
+static GHashTable *credentials_shared = NULL;
+
+/**
+ * @brief Mutex protecting credentials_cache and credentials_shared.
+ */
+static GMutex credentials_mutex;
+
+/**
+ * @brief Get the modification stamp of certificate files.
+ *
+ * @param[in]  ca_cert_file  Certificate authority file or NULL.
+ * @param[in]  cert_file     Certificate file or NULL.
+ * @param[in]  key_file      Key file or NULL.
+ *
+ * @return Freshly allocated stamp, NULL if a file is missing.
+ */
+static gchar *
+credentials_files_stamp (const char *ca_cert_file, const char *cert_file,
+                         const char *key_file)
+{
+  const char *files[] = {ca_cert_file, cert_file, key_file};
+  GString *stamp;
+
+  stamp = g_string_new ("");
+  for (unsigned int index = 0; index < G_N_ELEMENTS (files); index++)
+    {
+      struct stat state;
+
+      if (files[index] == NULL)
+        continue;
+      if (stat (files[index], &state))
+        {
+          g_string_free (stamp, TRUE);
+          return NULL;
+        }
+      g_string_append_printf (stamp, "%llu:%lld.%09ld:%lld;",
+                              (unsigned long long) state.st_ino,
+                              (long long) state.st_mtim.tv_sec,
+                              state.st_mtim.tv_nsec,
+                              (long long) state.st_size);
+    }
+  return g_string_free (stamp, FALSE);
+}
+
+/**
+ * @brief Drop a reference to shared credentials.
+ *
+ * The caller must hold credentials_mutex.
+ *
+ * @param[in]  shared  Shared credentials.
+ */
+static void
+credentials_unref (shared_credentials_t *shared)
+{
+  if (--shared->references)
+    return;
+
+  g_hash_table_remove (credentials_shared, shared->credentials);
+  gnutls_certificate_free_credentials (shared->credentials);
+  g_free (shared->key);
+  g_free (shared->stamp);
+  g_free (shared);
+}
+
+/**
+ * @brief Get credentials from the cache.
+ *
+ * @param[in]  key        Key of the credentials.
+ * @param[in]  stamp      Modification stamp the credentials must have.
+ * @param[in]  reference  Whether the caller takes a reference, to be dropped
+ *                        with gvm_server_free_credentials.
+ *
+ * @return Credentials, NULL if not cached.
+ */
+static gnutls_certificate_credentials_t
+credentials_cache_get (const char *key, const char *stamp, gboolean reference)
+{
+  gnutls_certificate_credentials_t credentials = NULL;
+  shared_credentials_t *shared;
+
+  g_mutex_lock (&credentials_mutex);
+  shared = credentials_cache ? g_hash_table_lookup (credentials_cache, key)
+                             : NULL;
+  if (shared && strcmp (shared->stamp, stamp) == 0)
+    {
+      if (reference)
+        shared->references++;
+      credentials = shared->credentials;
+    }
+  g_mutex_unlock (&credentials_mutex);
+  return credentials;
+}
+
+/**
+ * @brief Add credentials to the cache.
+ *
+ * Credentials cached earlier under the key with another stamp are dropped
+ * from the cache, and freed once their last user is done.
+ *
+ * @param[in]  key          Key of the credentials.
+ * @param[in]  stamp        Modification stamp of the credentials.
+ * @param[in]  credentials  Credentials.
+ * @param[in]  reference    Whether the caller keeps a reference, to be
+ *                          dropped with gvm_server_free_credentials.
+ */
+static void
+credentials_cache_add (const char *key, const char *stamp,
+                       gnutls_certificate_credentials_t credentials,
+                       gboolean reference)
+{
+  shared_credentials_t *shared;
+
+  g_mutex_lock (&credentials_mutex);
+  if (credentials_cache == NULL)
+    {
+      credentials_cache = g_hash_table_new (g_str_hash, g_str_equal);
+      credentials_shared = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+
+  shared = g_hash_table_lookup (credentials_cache, key);
+  if (shared && strcmp (shared->stamp, stamp) == 0)
+    {
+      /* Another thread was first, so the credentials stay private. */
+      g_mutex_unlock (&credentials_mutex);
+      return;
+    }
+  if (shared)
+    {
+      g_hash_table_remove (credentials_cache, key);
+      credentials_unref (shared);
+    }
+
+  shared = g_malloc0 (sizeof (*shared));
+  shared->credentials = credentials;
+  shared->key = g_strdup (key);
+  shared->stamp = g_strdup (stamp);
+  shared->references = reference ? 2 : 1;
+  g_hash_table_insert (credentials_cache, shared->key, shared);
+  g_hash_table_insert (credentials_shared, credentials, shared);
+  g_mutex_unlock (&credentials_mutex);
+}
+
+/**
+ * @brief Free credentials, which may be shared with other sessions.
+ *
+ * Credentials returned by gvm_server_new_cached come from a cache of
+ * credentials by certificate file, so they must be freed with this
+ * function or gvm_server_free instead of gnutls_certificate_free_credentials.
+ * Other credentials are simply freed.
+ *
+ * @param[in]  credentials  Credentials.
+ */
+void
+gvm_server_free_credentials (gnutls_certificate_credentials_t credentials)
+{
+  shared_credentials_t *shared;
+
+  g_mutex_lock (&credentials_mutex);
+  shared = credentials_shared
+             ? g_hash_table_lookup (credentials_shared, credentials)
+             : NULL;
+  if (shared)
+    credentials_unref (shared);
+  g_mutex_unlock (&credentials_mutex);
+
+  if (shared == NULL)
+    gnutls_certificate_free_credentials (credentials);
+}
+
+/**
+ * @brief Make a client session, with credentials from the cache.
+ *
+ * Client credentials are kept for the life of the process, as the sessions
+ * of gvm_server_open_verify only have a shallow copy of them.
+ *
+ * @param[in]   ca_mem       CA certificate or NULL.
+ * @param[in]   pub_mem      Client certificate or NULL.
+ * @param[in]   priv_mem     Client private key or NULL.
+ * @param[out]  session      Session.
+ * @param[out]  credentials  Credentials of the session.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+client_session_new (const char *ca_mem, const char *pub_mem,
+                    const char *priv_mem, gnutls_session_t *session,
+                    gnutls_certificate_credentials_t *credentials)
+{
+  GChecksum *checksum;
+  gchar *key;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) (ca_mem ? ca_mem : ""), -1);
+  g_checksum_update (checksum, (const guchar *) (ca_mem ? "\1" : "\2"), 1);
+  g_checksum_update (checksum, (const guchar *) (pub_mem ? pub_mem : ""), -1);
+  g_checksum_update (checksum, (const guchar *) (pub_mem ? "\1" : "\2"), 1);
+  g_checksum_update (checksum, (const guchar *) (priv_mem ? priv_mem : ""),
+                     -1);
+  g_checksum_update (checksum, (const guchar *) (priv_mem ? "\1" : "\2"), 1);
+  key = g_strdup_printf ("client:%s", g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  *credentials = credentials_cache_get (key, "", FALSE);
+  if (*credentials)
+    {
+      g_free (key);
+      /* Balances the gnutls_global_deinit of gvm_server_free. */
+      if (gnutls_global_init ())
+        {
+          g_warning ("Failed to initialize GNUTLS.");
+          return -1;
+        }
+      return server_new_gnutls_set (GNUTLS_CLIENT, NULL, session, credentials);
+    }
+
+  if (gvm_server_new_mem (GNUTLS_CLIENT, ca_mem, pub_mem, priv_mem, session,
+                          credentials))
+    {
+      g_free (key);
+      return -1;
+    }
+
+  if (ca_mem && pub_mem && priv_mem)
+    gnutls_certificate_set_retrieve_function (*credentials,
+                                              client_cert_callback);
+
+  credentials_cache_add (key, "", *credentials, FALSE);
+  g_free (key);
+  return 0;
+}
+
+/* Client session resumption. */
+
+/**
+ * @brief TLS session data of client connections, see client_session_key.
+ */
+static GHashTable *client_sessions = NULL;
+
+/**
+ * @brief Mutex protecting client_sessions.
+ */
+static GMutex client_sessions_mutex;
+
+/**
+ * @brief Free saved TLS session data.
+ *
+ * @param[in]  data  Session data.
+ */
+static void
+client_session_data_free (gpointer data)
+{
+  gnutls_free (((gnutls_datum_t *) data)->data);
+  g_free (data);
+}
+
+/**
+ * @brief Get the key of a client session in client_sessions.
+ *
+ * The client certificate is part of the key, so that a session is never
+ * resumed under another identity.
+ *
+ * @param[in]  host     Host of the server.
+ * @param[in]  port     Port of the server.
+ * @param[in]  pub_mem  Client certificate or NULL.
+ *
+ * @return Freshly allocated key.
+ */
+static gchar *
+client_session_key (const char *host, int port, const char *pub_mem)
+{
+  gchar *checksum, *key;
+
+  if (pub_mem == NULL)
+    return g_strdup_printf ("%s:%d", host, port);
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, pub_mem, -1);
+  key = g_strdup_printf ("%s:%d:%s", host, port, checksum);
+  g_free (checksum);
+  return key;
+}
+
+/**
+ * @brief Offer the saved TLS session of a server for resumption.
+ *
+ * @param[in]  session  Client session, before the handshake.
+ * @param[in]  host     Host of the server.
+ * @param[in]  port     Port of the server.
+ * @param[in]  pub_mem  Client certificate or NULL.
+ */
+static void
+client_session_resume (gnutls_session_t session, const char *host, int port,
+                       const char *pub_mem)
+{
+  gchar *key;
+  gnutls_datum_t *data;
+
+  key = client_session_key (host, port, pub_mem);
+  g_mutex_lock (&client_sessions_mutex);
+  data = client_sessions ? g_hash_table_lookup (client_sessions, key) : NULL;
+  if (data && gnutls_session_set_data (session, data->data, data->size))
+    g_debug ("%s: Failed to set session data for %s", __func__, key);
+  g_mutex_unlock (&client_sessions_mutex);
+  g_free (key);
+}
+
+/**
+ * @brief Save the TLS session of a server connection for later resumption.
+ *
+ * The next gvm_server_open_verify to the same host and port offers the
+ * session to the server, which saves the full handshake if the server
+ * accepts it.
+ *
+ * With TLS 1.3 the resumption ticket arrives after the handshake, so callers
+ * should save the session again after an exchange with the server, e.g. when
+ * closing the connection.
+ *
+ * @param[in]  session  Client session, after the handshake.
+ * @param[in]  host     Host of the server.
+ * @param[in]  port     Port of the server.
+ * @param[in]  pub_mem  Client certificate the session was opened with or NULL.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_server_save_session (gnutls_session_t session, const char *host, int port,
+                         const char *pub_mem)
+{
+  gnutls_datum_t *data;
+
+  if (session == NULL || host == NULL)
+    return -1;
+
+  data = g_malloc0 (sizeof (*data));
+  if (gnutls_session_get_data2 (session, data))
+    {
+      g_free (data);
+      return -1;
+    }
+
+  g_mutex_lock (&client_sessions_mutex);
+  if (client_sessions == NULL)
+    client_sessions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                             client_session_data_free);
+  g_hash_table_replace (client_sessions,
+                        client_session_key (host, port, pub_mem), data);
+  g_mutex_unlock (&client_sessions_mutex);
+  return 0;
+}
+
+/* Connecting. */
+
+/**
+ * @brief Time in milliseconds before racing the next address of a server.
+ */
+#define CONNECT_ATTEMPT_DELAY 250
+
+/**
+ * @brief Time in milliseconds after which a connection attempt is given up.
+ */
+#define CONNECT_ATTEMPT_TIMEOUT 10000
+
+/**
+ * @brief Time in milliseconds after which connecting to a server fails.
+ */
+#define CONNECT_TIMEOUT 30000
+
+/**
+ * @brief Start a non-blocking connection attempt.
+ *
+ * @param[in]  address  Address to connect to.
+ *
+ * @return Socket, connected or connecting, -1 on error.
+ */
+static int
+connect_attempt_start (struct addrinfo *address)
+{
+  int server_socket, flags;
+
+  server_socket = socket (address->ai_family, SOCK_STREAM, 0);
+  if (server_socket == -1)
+    {
+      g_warning ("Failed to create server socket");
+      return -1;
+    }
+
+  flags = fcntl (server_socket, F_GETFL);
+  if (flags == -1 || fcntl (server_socket, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+      g_warning ("%s: failed to set server socket flag: %s", __func__,
+                 strerror (errno));
+      close (server_socket);
+      return -1;
+    }
+
+  if (connect (server_socket, address->ai_addr, address->ai_addrlen) == -1
+      && errno != EINPROGRESS)
+    {
+      g_debug ("%s: connect: %s", __func__, strerror (errno));
+      close (server_socket);
+      return -1;
+    }
+
+  return server_socket;
+}
+
+/**
+ * @brief Connect to the first server address that answers.
+ *
+ * The addresses are raced as in RFC 8305 (Happy Eyeballs): the address
+ * families alternate, an attempt starts whenever the previous one failed
+ * or has not connected within CONNECT_ATTEMPT_DELAY, and every attempt
+ * stays in the race until it connects, fails or reaches
+ * CONNECT_ATTEMPT_TIMEOUT.  An unreachable address in front of a working
+ * one thus delays the connection by the attempt delay at most, instead of
+ * the TCP timeout of the kernel.
+ *
+ * @param[in]  addresses  Addresses of the server.
+ *
+ * @return Blocking connected socket, -1 on error.
+ */
+static int
+server_connect (struct addrinfo *addresses)
+{
+  GPtrArray *first_family, *other_family, *order;
+  struct addrinfo *address;
+  struct pollfd *attempts;
+  gint64 *started, now, deadline, next_start;
+  guint next, count;
+  int server_socket, in_flight;
+
+  /* Alternate the address families, starting with the preferred one. */
+
+  first_family = g_ptr_array_new ();
+  other_family = g_ptr_array_new ();
+  for (address = addresses; address; address = address->ai_next)
+    if (address->ai_family == AF_INET || address->ai_family == AF_INET6)
+      g_ptr_array_add (address->ai_family == addresses->ai_family
+                         ? first_family
+                         : other_family,
+                       address);
+  order = g_ptr_array_new ();
+  for (guint index = 0; index < MAX (first_family->len, other_family->len);
+       index++)
+    {
+      if (index < first_family->len)
+        g_ptr_array_add (order, g_ptr_array_index (first_family, index));
+      if (index < other_family->len)
+        g_ptr_array_add (order, g_ptr_array_index (other_family, index));
+    }
+  g_ptr_array_free (first_family, TRUE);
+  g_ptr_array_free (other_family, TRUE);
+
+  /* Race the addresses. */
+
+  attempts = g_malloc0 (MAX (order->len, 1) * sizeof (*attempts));
+  started = g_malloc0 (MAX (order->len, 1) * sizeof (*started));
+  server_socket = -1;
+  next = count = 0;
+  in_flight = 0;
+  now = next_start = g_get_monotonic_time ();
+  deadline = now + CONNECT_TIMEOUT * 1000;
+  while (server_socket == -1 && now < deadline)
+    {
+      gint64 wake;
+
+      if (next < order->len && (now >= next_start || in_flight == 0))
+        {
+          int attempt;
+
+          attempt = connect_attempt_start (g_ptr_array_index (order, next++));
+          next_start = now + CONNECT_ATTEMPT_DELAY * 1000;
+          if (attempt == -1)
+            next_start = now;
+          else
+            {
+              attempts[count].fd = attempt;
+              attempts[count].events = POLLOUT;
+              started[count++] = now;
+              in_flight++;
+            }
+          continue;
+        }
+
+      if (in_flight == 0)
+        break;
+
+      /* Wait until an attempt completes or the next is due. */
+
+      wake = deadline;
+      if (next < order->len)
+        wake = MIN (wake, next_start);
+      for (guint index = 0; index < count; index++)
+        if (attempts[index].fd != -1)
+          wake = MIN (wake, started[index] + CONNECT_ATTEMPT_TIMEOUT * 1000);
+      if (poll (attempts, count, MAX (wake - now, 0) / 1000 + 1) == -1
+          && errno != EINTR)
+        {
+          g_warning ("%s: poll: %s", __func__, strerror (errno));
+          break;
+        }
+      now = g_get_monotonic_time ();
+
+      for (guint index = 0; index < count && server_socket == -1; index++)
+        {
+          int error;
+          socklen_t length;
+
+          if (attempts[index].fd == -1)
+            continue;
+
+          if (attempts[index].revents)
+            {
+              error = 0;
+              length = sizeof (error);
+              if (getsockopt (attempts[index].fd, SOL_SOCKET, SO_ERROR, &error,
+                              &length))
+                error = errno;
+              if (error == 0)
+                {
+                  server_socket = attempts[index].fd;
+                  attempts[index].fd = -1;
+                  continue;
+                }
+              g_debug ("%s: connect: %s", __func__, strerror (error));
+            }
+          else if (now < started[index] + CONNECT_ATTEMPT_TIMEOUT * 1000)
+            continue;
+
+          /* Failed or timed out, so start the next attempt right away. */
+          close (attempts[index].fd);
+          attempts[index].fd = -1;
+          in_flight--;
+          next_start = now;
+        }
+    }
+
+  for (guint index = 0; index < count; index++)
+    if (attempts[index].fd != -1)
+      close (attempts[index].fd);
+  g_free (attempts);
+  g_free (started);
+  g_ptr_array_free (order, TRUE);
+
+  if (server_socket != -1
+      && fcntl (server_socket, F_SETFL,
+                fcntl (server_socket, F_GETFL) & ~O_NONBLOCK)
+           == -1)
+    {
+      g_warning ("%s: failed to set server socket flag: %s", __func__,
+                 strerror (errno));
+      close (server_socket);
+      return -1;
+    }
+
+  return server_socket;
+}
+
 /**
  * @brief Connect to the server using a given host, port and cert.
  *
@@ -337,7 +1075,7 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
   int ret;
   int server_socket;
   struct addrinfo address_hints;
-  struct addrinfo *addresses, *address;
+  struct addrinfo *addresses;
   gchar *port_string;
   int host_type;
 
@@ -359,11 +1097,10 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
       return -1;
     }
 
-  /** @warning On success we are leaking the credentials. We can't free
-      them because the session only makes a shallow copy. */
+  /* The credentials stay in the cache, as the session only makes a shallow
+   * copy of them. */
 
-  if (gvm_server_new_mem (GNUTLS_CLIENT, ca_mem, pub_mem, priv_mem, session,
-                          &credentials))
+  if (client_session_new (ca_mem, pub_mem, priv_mem, session, &credentials))
     {
       g_warning ("Failed to create client TLS session.");
       return -1;
@@ -373,11 +1110,10 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
     {
       set_cert_pub_mem (pub_mem);
       set_cert_priv_mem (priv_mem);
-
-      gnutls_certificate_set_retrieve_function (credentials,
-                                                client_cert_callback);
     }
 
+  client_session_resume (*session, host, port, pub_mem);
+
   /* Create the port string. */
 
   port_string = g_strdup_printf ("%i", port);
@@ -395,47 +1131,19 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
       g_warning ("Failed to get server addresses for %s: %s", host,
                  gai_strerror (errno));
       gnutls_deinit (*session);
-      gnutls_certificate_free_credentials (credentials);
       return -1;
     }
   g_free (port_string);
 
-  /* Try to connect to each address in turn. */
-
-  for (address = addresses; address; address = address->ai_next)
-    {
-      /* Make server socket. */
-
-      if (address->ai_family == AF_INET6)
-        server_socket = socket (PF_INET6, SOCK_STREAM, 0);
-      else
-        server_socket = socket (PF_INET, SOCK_STREAM, 0);
-      if (server_socket == -1)
-        {
-          g_warning ("Failed to create server socket");
-          freeaddrinfo (addresses);
-          gnutls_deinit (*session);
-          gnutls_certificate_free_credentials (credentials);
-          return -1;
-        }
-
-      /* Connect to server. */
-
-      if (connect (server_socket, address->ai_addr, address->ai_addrlen) == -1)
-        {
-          close (server_socket);
-          continue;
-        }
-      break;
-    }
+  /* Connect to the first address that answers. */
 
+  server_socket = server_connect (addresses);
   freeaddrinfo (addresses);
 
-  if (address == NULL)
+  if (server_socket == -1)
     {
       g_warning ("Failed to connect to server");
       gnutls_deinit (*session);
-      gnutls_certificate_free_credentials (credentials);
       return -1;
     }
 
@@ -449,7 +1157,6 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
         {
           close (server_socket);
           gnutls_deinit (*session);
-          gnutls_certificate_free_credentials (credentials);
         }
       close (server_socket);
       return -1;
@@ -460,6 +1167,16 @@ gvm_server_open_verify (gnutls_session_t *session, const char *host, int port,
       return -1;
     }
 
+  if (gnutls_session_is_resumed (*session))
+    g_debug ("   Resumed TLS session with server '%s' port %d.", host, port);
+#if GNUTLS_VERSION_NUMBER >= 0x030603
+  /* TLS 1.3 tickets come after the handshake, see gvm_server_save_session. */
+  else if (gnutls_protocol_get_version (*session) != GNUTLS_TLS1_3)
+#else
+  else
+#endif
+    gvm_server_save_session (*session, host, port, pub_mem);
+
   return server_socket;
 }
 
@@ -529,71 +1246,253 @@ gvm_connection_close (gvm_connection_t *connection)
 }
 
 /**
- * @brief Attach a socket to a session, and shake hands with the peer.
+ * @brief Attach a socket to a session, and shake hands with the peer.
+ *
+ * @param[in]  socket   Socket.
+ * @param[in]  session  Pointer to GNUTLS session.
+ * @param[in]  host     NULL or the name of the host for diagnostics
+ * @param[in]  port     Port number for diagnostics; only used
+ *                      if \a host is not NULL
+ *
+ * @return 0 on success, -1 on general error, -2 if the TLS handshake failed.
+ */
+static int
+server_attach_internal (int socket, gnutls_session_t *session, const char *host,
+                        int port)
+{
+  unsigned int retries;
+
+  gnutls_transport_set_ptr (*session,
+                            (gnutls_transport_ptr_t) GSIZE_TO_POINTER (socket));
+
+  retries = 0;
+  while (1)
+    {
+      int ret = gnutls_handshake (*session);
+      if (ret >= 0)
+        break;
+      if (ret == GNUTLS_E_AGAIN || ret == GNUTLS_E_INTERRUPTED)
+        {
+          if (retries > 10)
+            usleep (MIN ((retries - 10) * 10000, 5000000));
+          retries++;
+          continue;
+        }
+      if (host)
+        g_debug ("Failed to shake hands with server '%s' port %d: %s", host,
+                 port, gnutls_strerror (ret));
+      else
+        g_debug ("Failed to shake hands with peer: %s", gnutls_strerror (ret));
+      if (shutdown (socket, SHUT_RDWR) == -1)
+        g_debug ("Failed to shutdown server socket");
+      return -2;
+    }
+  if (host)
+    g_debug ("   Shook hands with server '%s' port %d.", host, port);
+  else
+    g_debug ("   Shook hands with peer.");
+
+  return 0;
+}
+
+/**
+ * @brief Attach a socket to a session, and shake hands with the peer.
+ *
+ * @param[in]  socket   Socket.
+ * @param[in]  session  Pointer to GNUTLS session.
+ *                      FIXME: Why is this a pointer to a session?
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_server_attach (int socket, gnutls_session_t *session)
+{
+  int ret;
+
+  ret = server_attach_internal (socket, session, NULL, 0);
+  return ret ? -1 : 0;
+}
+
+/**
+ * @brief Send data to the server.
+ *
+ * @param[in]  session  Pointer to GNUTLS session.
+ * @param[in]  string   Data to send.
+ * @param[in]  left     Length of data.
+ * @param[in]  quiet    Whether to log debug and info messages.  Useful for
+ *                      hiding passwords.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+server_send_internal (gnutls_session_t *session, const char *string, int left,
+                      int quiet)
+{
+  gboolean debug;
+
+  /* Skip formatting the debug messages if they are not logged anyway. */
+  debug = quiet == 0 && gvm_log_debug_enabled (G_LOG_DOMAIN);
+  while (left > 0)
+    {
+      ssize_t count;
+
+      if (debug)
+        g_debug ("   send %d from %.*s[...]", left, left < 30 ? left : 30,
+                 string);
+      count = gnutls_record_send (*session, string, left);
+      if (count < 0)
+        {
+          if (count == GNUTLS_E_INTERRUPTED)
+            /* Interrupted, try write again. */
+            continue;
+          if (count == GNUTLS_E_REHANDSHAKE)
+            {
+              /* \todo Rehandshake. */
+              if (quiet == 0)
+                g_message ("   %s rehandshake", __func__);
+              continue;
+            }
+          g_warning ("Failed to write to server: %s", gnutls_strerror (count));
+          return -1;
+        }
+      if (count == 0)
+        {
+          /* Server closed connection. */
+          if (debug)
+            g_debug ("=  server closed");
+          return 1;
+        }
+      if (debug)
+        g_debug ("=> %.*s", (int) count, string);
+      string += count;
+      left -= count;
+    }
+  if (debug)
+    g_debug ("=> done");
+
+  return 0;
+}
+
+/**
+ * @brief Send several buffers to the server in as few records as possible.
+ *
+ * @param[in]  session  Pointer to GNUTLS session.
+ * @param[in]  iov      Buffers to send.
+ * @param[in]  iovcnt   Number of buffers.
+ * @param[in]  quiet    Whether to log debug and info messages.  Useful for
+ *                      hiding passwords.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+server_sendv_internal (gnutls_session_t *session, const struct iovec *iov,
+                       int iovcnt, int quiet)
+{
+  ssize_t ret;
+
+  /* GnuTLS has no writev, so collect the buffers in corked records. */
+  gnutls_record_cork (*session);
+  for (int index = 0; index < iovcnt; index++)
+    {
+      int rc;
+
+      rc = server_send_internal (session, iov[index].iov_base,
+                                 iov[index].iov_len, quiet);
+      if (rc)
+        {
+          gnutls_record_uncork (*session, 0);
+          return rc;
+        }
+    }
+
+  while ((ret = gnutls_record_uncork (*session, GNUTLS_RECORD_WAIT)) < 0)
+    {
+      if (ret == GNUTLS_E_INTERRUPTED || ret == GNUTLS_E_AGAIN)
+        continue;
+      g_warning ("Failed to write to server: %s", gnutls_strerror (ret));
+      return -1;
+    }
+
+  return 0;
+}
+
+/**
+ * @brief Buffer for formatting sends, reused by the sends of a thread.
+ */
+struct send_buffer
+{
+  GString *string; ///< The buffer, NULL if not allocated yet.
+  gboolean in_use; ///< Whether a send of the thread is using the buffer.
+};
+
+/**
+ * @brief Free a send buffer.
+ *
+ * @param[in]  send_buffer  The buffer.
+ */
+static void
+send_buffer_free (gpointer send_buffer)
+{
+  GString *string = ((struct send_buffer *) send_buffer)->string;
+
+  if (string)
+    g_string_free (string, TRUE);
+  g_free (send_buffer);
+}
+
+/**
+ * @brief Send buffer of the current thread.
+ */
+static GPrivate thread_send_buffer = G_PRIVATE_INIT (send_buffer_free);
+
+/**
+ * @brief Get an empty buffer for formatting a send.
  *
- * @param[in]  socket   Socket.
- * @param[in]  session  Pointer to GNUTLS session.
- * @param[in]  host     NULL or the name of the host for diagnostics
- * @param[in]  port     Port number for diagnostics; only used
- *                      if \a host is not NULL
+ * The buffer of the current thread is reused across sends.  A nested send
+ * gets a buffer of its own.
  *
- * @return 0 on success, -1 on general error, -2 if the TLS handshake failed.
+ * @return Buffer, to be released with send_buffer_release.
  */
-static int
-server_attach_internal (int socket, gnutls_session_t *session, const char *host,
-                        int port)
+static GString *
+send_buffer_acquire (void)
 {
-  unsigned int retries;
-
-  gnutls_transport_set_ptr (*session,
-                            (gnutls_transport_ptr_t) GSIZE_TO_POINTER (socket));
+  struct send_buffer *send_buffer = g_private_get (&thread_send_buffer);
 
-  retries = 0;
-  while (1)
+  if (send_buffer == NULL)
     {
-      int ret = gnutls_handshake (*session);
-      if (ret >= 0)
-        break;
-      if (ret == GNUTLS_E_AGAIN || ret == GNUTLS_E_INTERRUPTED)
-        {
-          if (retries > 10)
-            usleep (MIN ((retries - 10) * 10000, 5000000));
-          retries++;
-          continue;
-        }
-      if (host)
-        g_debug ("Failed to shake hands with server '%s' port %d: %s", host,
-                 port, gnutls_strerror (ret));
-      else
-        g_debug ("Failed to shake hands with peer: %s", gnutls_strerror (ret));
-      if (shutdown (socket, SHUT_RDWR) == -1)
-        g_debug ("Failed to shutdown server socket");
-      return -2;
+      send_buffer = g_malloc0 (sizeof (*send_buffer));
+      g_private_set (&thread_send_buffer, send_buffer);
     }
-  if (host)
-    g_debug ("   Shook hands with server '%s' port %d.", host, port);
-  else
-    g_debug ("   Shook hands with peer.");
-
-  return 0;
+  if (send_buffer->in_use)
+    return g_string_sized_new (SEND_BUFFER_SIZE);
+  if (send_buffer->string == NULL)
+    send_buffer->string = g_string_sized_new (SEND_BUFFER_SIZE);
+  send_buffer->in_use = TRUE;
+  g_string_truncate (send_buffer->string, 0);
+  return send_buffer->string;
 }
 
 /**
- * @brief Attach a socket to a session, and shake hands with the peer.
+ * @brief Release a buffer from send_buffer_acquire.
  *
- * @param[in]  socket   Socket.
- * @param[in]  session  Pointer to GNUTLS session.
- *                      FIXME: Why is this a pointer to a session?
+ * Buffers that grew above SEND_BUFFER_MAX are freed, so that a single large
+ * command does not pin its memory for the lifetime of the thread.
  *
- * @return 0 on success, -1 on error.
+ * @param[in]  string  The buffer.
  */
-int
-gvm_server_attach (int socket, gnutls_session_t *session)
+static void
+send_buffer_release (GString *string)
 {
-  int ret;
+  struct send_buffer *send_buffer = g_private_get (&thread_send_buffer);
 
-  ret = server_attach_internal (socket, session, NULL, 0);
-  return ret ? -1 : 0;
+  if (send_buffer && send_buffer->string == string)
+    {
+      send_buffer->in_use = FALSE;
+      if (string->allocated_len <= SEND_BUFFER_MAX)
+        return;
+      send_buffer->string = NULL;
+    }
+  g_string_free (string, TRUE);
 }
 
 /**
@@ -611,57 +1510,59 @@ static int
 gvm_server_vsendf_internal (gnutls_session_t *session, const char *fmt,
                             va_list ap, int quiet)
 {
-  char *sref, *string;
-  int rc = 0, left;
+  GString *string;
+  int rc;
+
+  string = send_buffer_acquire ();
+  g_string_vprintf (string, fmt, ap);
+  rc = server_send_internal (session, string->str, string->len, quiet);
+  send_buffer_release (string);
+  return rc;
+}
 
-  left = vasprintf (&string, fmt, ap);
-  if (left == -1)
-    string = NULL;
+/**
+ * @brief Send data to a UNIX socket.
+ *
+ * @param[in]  socket   Socket.
+ * @param[in]  string   Data to send.
+ * @param[in]  left     Length of data.
+ * @param[in]  quiet    Whether to log debug and info messages.  Useful for
+ *                      hiding passwords.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+unix_send_internal (int socket, const char *string, int left, int quiet)
+{
+  gboolean debug;
 
-  sref = string;
+  /* Skip formatting the debug messages if they are not logged anyway. */
+  debug = quiet == 0 && gvm_log_debug_enabled (G_LOG_DOMAIN);
   while (left > 0)
     {
       ssize_t count;
 
-      if (quiet == 0)
+      if (debug)
         g_debug ("   send %d from %.*s[...]", left, left < 30 ? left : 30,
                  string);
-      count = gnutls_record_send (*session, string, left);
+      count = write (socket, string, left);
       if (count < 0)
         {
-          if (count == GNUTLS_E_INTERRUPTED)
-            /* Interrupted, try write again. */
+          if (errno == EINTR || errno == EAGAIN)
             continue;
-          if (count == GNUTLS_E_REHANDSHAKE)
-            {
-              /* \todo Rehandshake. */
-              if (quiet == 0)
-                g_message ("   %s rehandshake", __func__);
-              continue;
-            }
-          g_warning ("Failed to write to server: %s", gnutls_strerror (count));
-          rc = -1;
-          goto out;
-        }
-      if (count == 0)
-        {
-          /* Server closed connection. */
-          if (quiet == 0)
-            g_debug ("=  server closed");
-          rc = 1;
-          goto out;
+          g_warning ("Failed to write to server: %s", strerror (errno));
+          return -1;
         }
-      if (quiet == 0)
+      if (debug)
         g_debug ("=> %.*s", (int) count, string);
+
       string += count;
       left -= count;
     }
-  if (quiet == 0)
+  if (debug)
     g_debug ("=> done");
 
-out:
-  g_free (sref);
-  return rc;
+  return 0;
 }
 
 /**
@@ -678,42 +1579,133 @@ out:
 static int
 unix_vsendf_internal (int socket, const char *fmt, va_list ap, int quiet)
 {
-  char *string_start, *string;
-  int rc = 0, left;
+  GString *string;
+  int rc;
 
-  left = vasprintf (&string, fmt, ap);
-  if (left == -1)
-    string = NULL;
+  string = send_buffer_acquire ();
+  g_string_vprintf (string, fmt, ap);
+  rc = unix_send_internal (socket, string->str, string->len, quiet);
+  send_buffer_release (string);
+  return rc;
+}
 
-  string_start = string;
-  while (left > 0)
+/**
+ * @brief Send several buffers to a UNIX socket with as few writes as possible.
+ *
+ * @param[in]  socket  Socket.
+ * @param[in]  iov     Buffers to send.
+ * @param[in]  iovcnt  Number of buffers.
+ * @param[in]  quiet   Whether to log debug and info messages.  Useful for
+ *                     hiding passwords.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+unix_sendv_internal (int socket, const struct iovec *iov, int iovcnt,
+                     int quiet)
+{
+  gboolean debug;
+
+  debug = quiet == 0 && gvm_log_debug_enabled (G_LOG_DOMAIN);
+  while (iovcnt > 0)
     {
       ssize_t count;
 
-      if (quiet == 0)
-        g_debug ("   send %d from %.*s[...]", left, left < 30 ? left : 30,
-                 string);
-      count = write (socket, string, left);
+      count = writev (socket, iov, MIN (iovcnt, IOV_MAX));
       if (count < 0)
         {
           if (errno == EINTR || errno == EAGAIN)
             continue;
           g_warning ("Failed to write to server: %s", strerror (errno));
-          rc = -1;
-          goto out;
+          return -1;
         }
-      if (quiet == 0)
-        g_debug ("=> %.*s", (int) count, string);
 
-      string += count;
-      left -= count;
+      /* Skip the buffers that were written completely. */
+      while (iovcnt > 0 && (size_t) count >= iov->iov_len)
+        {
+          if (debug)
+            g_debug ("=> %.*s", (int) iov->iov_len, (char *) iov->iov_base);
+          count -= iov->iov_len;
+          iov++;
+          iovcnt--;
+        }
+
+      /* Finish a buffer that was written partially. */
+      if (count > 0)
+        {
+          if (unix_send_internal (socket, (char *) iov->iov_base + count,
+                                  iov->iov_len - count, quiet))
+            return -1;
+          iov++;
+          iovcnt--;
+        }
     }
-  if (quiet == 0)
+  if (debug)
     g_debug ("=> done");
 
-out:
-  g_free (string_start);
-  return rc;
+  return 0;
+}
+
+/**
+ * @brief Compress and send data to the connection.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  compression Compression of the connection.
+ * @param[in]  string      Data to send.
+ * @param[in]  left        Length of data.
+ * @param[in]  quiet       Whether to log debug and info messages.  Useful for
+ *                         hiding passwords.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+compressed_send_internal (gvm_connection_t *connection,
+                          gvm_compress_stream_t *compression,
+                          const char *string, gsize left, int quiet)
+{
+  const void *compressed;
+  unsigned long length;
+
+  if (quiet == 0 && gvm_log_debug_enabled (G_LOG_DOMAIN))
+    g_debug ("=> %.*s (compressed)", (int) left, string);
+  compressed = gvm_compress_stream_deflate (compression, string, left,
+                                            &length);
+  if (compressed == NULL)
+    {
+      g_warning ("Failed to compress data for server");
+      return -1;
+    }
+
+  /* The compressed data is unreadable, so never log it. */
+  if (connection->tls)
+    return server_send_internal (&connection->session, compressed, length, 1);
+  return unix_send_internal (connection->socket, compressed, length, 1);
+}
+
+/**
+ * @brief Send data to the connection.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  string      Data to send.
+ * @param[in]  left        Length of data.
+ * @param[in]  quiet       Whether to log debug and info messages.  Useful for
+ *                         hiding passwords.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+static int
+connection_send_internal (gvm_connection_t *connection, const char *string,
+                          gsize left, int quiet)
+{
+  gvm_compress_stream_t *compression;
+
+  compression = gvm_connection_compression (connection);
+  if (compression)
+    return compressed_send_internal (connection, compression, string, left,
+                                     quiet);
+  if (connection->tls)
+    return server_send_internal (&connection->session, string, left, quiet);
+  return unix_send_internal (connection->socket, string, left, quiet);
 }
 
 /**
@@ -731,9 +1723,126 @@ static int
 gvm_connection_vsendf_internal (gvm_connection_t *connection, const char *fmt,
                                 va_list ap, int quiet)
 {
-  if (connection->tls)
-    return gvm_server_vsendf_internal (&connection->session, fmt, ap, quiet);
-  return unix_vsendf_internal (connection->socket, fmt, ap, quiet);
+  connection_state_t *state;
+  GString *string;
+  int rc;
+
+  state = connection_state (connection, FALSE);
+  if (state && state->corked)
+    {
+      g_string_append_vprintf (state->output, fmt, ap);
+      state->output_quiet |= quiet;
+      return 0;
+    }
+
+  string = send_buffer_acquire ();
+  g_string_vprintf (string, fmt, ap);
+  rc = connection_send_internal (connection, string->str, string->len, quiet);
+  send_buffer_release (string);
+  return rc;
+}
+
+/**
+ * @brief Send several buffers to the connection, without formatting them.
+ *
+ * The buffers are sent with a single writev on UNIX sockets and collected
+ * into as few TLS records as possible otherwise.  While the connection is
+ * corked the buffers are added to the output buffer instead.
+ *
+ * @param[in]  connection  Connection.
+ * @param[in]  iov         Buffers to send.
+ * @param[in]  iovcnt      Number of buffers.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+int
+gvm_connection_sendv (gvm_connection_t *connection, const struct iovec *iov,
+                      int iovcnt)
+{
+  connection_state_t *state;
+  gvm_compress_stream_t *compression;
+  gboolean corked;
+  GString *string;
+  int rc;
+
+  state = connection_state (connection, FALSE);
+  compression = state ? state->compression : NULL;
+  corked = state && state->corked;
+  if (corked == FALSE && compression == NULL)
+    {
+      if (connection->tls)
+        return server_sendv_internal (&connection->session, iov, iovcnt, 0);
+      return unix_sendv_internal (connection->socket, iov, iovcnt, 0);
+    }
+
+  /* The compression stream takes a single buffer. */
+  string = corked ? state->output : send_buffer_acquire ();
+  for (int index = 0; index < iovcnt; index++)
+    g_string_append_len (string, iov[index].iov_base, iov[index].iov_len);
+  if (corked)
+    return 0;
+
+  rc = compressed_send_internal (connection, compression, string->str,
+                                 string->len, 0);
+  send_buffer_release (string);
+  return rc;
+}
+
+/**
+ * @brief Cork a connection.
+ *
+ * Until the matching gvm_connection_uncork, sends on the connection only
+ * add to the output buffer of the connection, so that several commands go
+ * out in a single write.  Corks nest.  The output buffer is kept until
+ * gvm_connection_free.
+ *
+ * @param[in]  connection  Connection.
+ */
+void
+gvm_connection_cork (gvm_connection_t *connection)
+{
+  connection_state_t *state;
+
+  state = connection_state (connection, TRUE);
+  if (state->output == NULL)
+    state->output = g_string_sized_new (SEND_BUFFER_SIZE);
+  state->corked++;
+}
+
+/**
+ * @brief Uncork a connection, sending the output buffer with the last uncork.
+ *
+ * @param[in]  connection  Connection.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+int
+gvm_connection_uncork (gvm_connection_t *connection)
+{
+  connection_state_t *state;
+  GString *output;
+  int rc;
+
+  state = connection_state (connection, FALSE);
+  if (state == NULL || state->corked == 0 || --state->corked > 0)
+    return 0;
+
+  output = state->output;
+  rc = 0;
+  if (output->len)
+    rc = connection_send_internal (connection, output->str, output->len,
+                                   state->output_quiet);
+  state->output_quiet = 0;
+
+  if (output->allocated_len > SEND_BUFFER_MAX)
+    {
+      g_string_free (output, TRUE);
+      state->output = NULL;
+    }
+  else
+    g_string_truncate (output, 0);
+
+  return rc;
 }
 
 /**
@@ -766,6 +1875,36 @@ gvm_socket_vsendf (int socket, const char *fmt, va_list ap)
   return unix_vsendf_internal (socket, fmt, ap, 0);
 }
 
+/**
+ * @brief Send a buffer to the server as is, without formatting it.
+ *
+ * @param[in]  session  Pointer to GNUTLS session.
+ * @param[in]  data     Data to send.
+ * @param[in]  length   Length of data.
+ *
+ * @return 0 on success, 1 if server closed connection, -1 on error.
+ */
+int
+gvm_server_send (gnutls_session_t *session, const char *data, int length)
+{
+  return server_send_internal (session, data, length, 0);
+}
+
+/**
+ * @brief Send a buffer to the server as is, without formatting it.
+ *
+ * @param[in]  socket   Socket to send data through.
+ * @param[in]  data     Data to send.
+ * @param[in]  length   Length of data.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_socket_send (int socket, const char *data, int length)
+{
+  return unix_send_internal (socket, data, length, 0);
+}
+
 /**
  * @brief Send a string to the server.
  *
@@ -1093,6 +2232,8 @@ server_new_gnutls_set (unsigned int end_type, const char *priority,
  * @param[in]   key_file            Key file.
  * @param[out]  server_session      The session with the server.
  * @param[out]  server_credentials  Server credentials.
+ * @param[in]   cache               Whether to share the credentials with
+ *                                  other sessions made from the same files.
  *
  * @return 0 on success, -1 on error.
  */
@@ -1100,10 +2241,51 @@ static int
 server_new_internal (unsigned int end_type, const char *priority,
                      const gchar *ca_cert_file, const gchar *cert_file,
                      const gchar *key_file, gnutls_session_t *server_session,
-                     gnutls_certificate_credentials_t *server_credentials)
+                     gnutls_certificate_credentials_t *server_credentials,
+                     gboolean cache)
 {
+  gchar *key, *stamp;
+
+  /* Reuse the credentials of earlier sessions while the files are
+   * unchanged. */
+  key = NULL;
+  stamp = NULL;
+  if (cache)
+    {
+      key = g_strdup_printf ("files:%s\n%s\n%s",
+                             ca_cert_file ? ca_cert_file : "",
+                             cert_file ? cert_file : "",
+                             key_file ? key_file : "");
+      stamp = credentials_files_stamp (ca_cert_file, cert_file, key_file);
+    }
+  *server_credentials =
+    stamp ? credentials_cache_get (key, stamp, TRUE) : NULL;
+  if (*server_credentials)
+    {
+      g_free (key);
+      g_free (stamp);
+      /* Balances the gnutls_global_deinit of gvm_server_free. */
+      if (gnutls_global_init ())
+        {
+          g_warning ("Failed to initialize GNUTLS.");
+          gvm_server_free_credentials (*server_credentials);
+          return -1;
+        }
+      if (server_new_gnutls_set (end_type, priority, server_session,
+                                 server_credentials))
+        {
+          gvm_server_free_credentials (*server_credentials);
+          return -1;
+        }
+      return 0;
+    }
+
   if (server_new_gnutls_init (server_credentials))
-    return -1;
+    {
+      g_free (key);
+      g_free (stamp);
+      return -1;
+    }
 
   if (cert_file && key_file)
     {
@@ -1118,6 +2300,8 @@ server_new_internal (unsigned int end_type, const char *priority,
           g_warning ("%s:   cert file: %s\n", __func__, cert_file);
           g_warning ("%s:   key file : %s\n", __func__, key_file);
           gnutls_certificate_free_credentials (*server_credentials);
+          g_free (key);
+          g_free (stamp);
           return -1;
         }
     }
@@ -1134,14 +2318,21 @@ server_new_internal (unsigned int end_type, const char *priority,
                      gnutls_strerror (ret));
           g_warning ("%s: trust file: %s\n", __func__, ca_cert_file);
           gnutls_certificate_free_credentials (*server_credentials);
+          g_free (key);
+          g_free (stamp);
           return -1;
         }
     }
 
+  if (stamp)
+    credentials_cache_add (key, stamp, *server_credentials, TRUE);
+  g_free (key);
+  g_free (stamp);
+
   if (server_new_gnutls_set (end_type, priority, server_session,
                              server_credentials))
     {
-      gnutls_certificate_free_credentials (*server_credentials);
+      gvm_server_free_credentials (*server_credentials);
       return -1;
     }
 
@@ -1167,7 +2358,36 @@ gvm_server_new (unsigned int end_type, gchar *ca_cert_file, gchar *cert_file,
                 gnutls_certificate_credentials_t *server_credentials)
 {
   return server_new_internal (end_type, NULL, ca_cert_file, cert_file, key_file,
-                              server_session, server_credentials);
+                              server_session, server_credentials, FALSE);
+}
+
+/**
+ * @brief Make a session for connecting to a server, with cached credentials.
+ *
+ * Like gvm_server_new, but the credentials are shared with the other
+ * sessions made with this function from the same files while the files are
+ * unchanged, which saves loading the certificates for every session.  The
+ * credentials must not be modified, and must be freed with gvm_server_free
+ * or gvm_server_free_credentials.
+ *
+ * @param[in]   end_type            Connection end type (GNUTLS_SERVER or
+ *                                  GNUTLS_CLIENT).
+ * @param[in]   ca_cert_file        Certificate authority file.
+ * @param[in]   cert_file           Certificate file.
+ * @param[in]   key_file            Key file.
+ * @param[out]  server_session      The session with the server.
+ * @param[out]  server_credentials  Shared server credentials.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int
+gvm_server_new_cached (unsigned int end_type, const gchar *ca_cert_file,
+                       const gchar *cert_file, const gchar *key_file,
+                       gnutls_session_t *server_session,
+                       gnutls_certificate_credentials_t *server_credentials)
+{
+  return server_new_internal (end_type, NULL, ca_cert_file, cert_file, key_file,
+                              server_session, server_credentials, TRUE);
 }
 
 /**
@@ -1334,7 +2554,7 @@ gvm_server_free (int server_socket, gnutls_session_t server_session,
           return -1;
         }
       gnutls_deinit (server_session);
-      gnutls_certificate_free_credentials (server_credentials);
+      gvm_server_free_credentials (server_credentials);
     }
   else
     {
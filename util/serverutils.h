@@ -28,10 +28,13 @@
 #ifndef _GVM_SERVERUTILS_H
 #define _GVM_SERVERUTILS_H
 
+#include "compressutils.h" /* for gvm_compress_stream_t */
+
 #include <glib.h>          /* for gchar, gboolean, gint */
 #include <gnutls/gnutls.h> /* for gnutls_session_t, gnutls_certificate_cred... */
 #include <stdarg.h>        /* for va_list */
 #include <sys/param.h>
+#include <sys/uio.h> /* for iovec */
 #ifdef __FreeBSD__
 #include <netinet/in.h>
 #endif
@@ -63,6 +66,12 @@ gvm_connection_free (gvm_connection_t *);
 void
 gvm_connection_close (gvm_connection_t *);
 
+int
+gvm_connection_enable_compression (gvm_connection_t *, int);
+
+gvm_compress_stream_t *
+gvm_connection_compression (const gvm_connection_t *);
+
 int gvm_server_verify (gnutls_session_t);
 
 int
@@ -79,6 +88,9 @@ gvm_server_open_with_cert (gnutls_session_t *, const char *, int, const char *,
 int
 gvm_server_close (int, gnutls_session_t);
 
+int
+gvm_server_save_session (gnutls_session_t, const char *, int, const char *);
+
 int
 gvm_server_attach (int, gnutls_session_t *);
 
@@ -91,6 +103,11 @@ gvm_server_vsendf (gnutls_session_t *, const char *, va_list);
 int
 gvm_socket_vsendf (int, const char *, va_list);
 
+int
+gvm_server_send (gnutls_session_t *, const char *, int);
+int
+gvm_socket_send (int, const char *, int);
+
 int
 gvm_server_sendf_xml (gnutls_session_t *, const char *, ...);
 int
@@ -104,10 +121,24 @@ gvm_connection_sendf_xml_quiet (gvm_connection_t *, const char *, ...);
 int
 gvm_connection_sendf (gvm_connection_t *, const char *, ...);
 
+int
+gvm_connection_sendv (gvm_connection_t *, const struct iovec *, int);
+
+void
+gvm_connection_cork (gvm_connection_t *);
+
+int
+gvm_connection_uncork (gvm_connection_t *);
+
 int
 gvm_server_new (unsigned int, gchar *, gchar *, gchar *, gnutls_session_t *,
                 gnutls_certificate_credentials_t *);
 
+int
+gvm_server_new_cached (unsigned int, const gchar *, const gchar *,
+                       const gchar *, gnutls_session_t *,
+                       gnutls_certificate_credentials_t *);
+
 int
 gvm_server_new_mem (unsigned int, const char *, const char *, const char *,
                     gnutls_session_t *, gnutls_certificate_credentials_t *);
@@ -115,6 +146,9 @@ gvm_server_new_mem (unsigned int, const char *, const char *, const char *,
 int
 gvm_server_free (int, gnutls_session_t, gnutls_certificate_credentials_t);
 
+void
+gvm_server_free_credentials (gnutls_certificate_credentials_t);
+
 int gvm_server_session_free (gnutls_session_t,
                              gnutls_certificate_credentials_t);
 
@@ -0,0 +1,193 @@
+/* Copyright (C) 2021 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "serverutils.c"
+
+#include "xmlutils.h"
+
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+Describe (serverutils);
+BeforeEach (serverutils)
+{
+}
+AfterEach (serverutils)
+{
+}
+
+/* gvm_server_new */
+
+Ensure (serverutils, gvm_server_new_returns_private_credentials)
+{
+  gnutls_session_t first_session, second_session;
+  gnutls_certificate_credentials_t first, second;
+
+  assert_that (gvm_server_new (GNUTLS_CLIENT, NULL, NULL, NULL, &first_session,
+                               &first),
+               is_equal_to (0));
+  assert_that (gvm_server_new (GNUTLS_CLIENT, NULL, NULL, NULL,
+                               &second_session, &second),
+               is_equal_to (0));
+  assert_that (second, is_not_equal_to (first));
+
+  /* Callers own them, as before the cache. */
+  gnutls_deinit (first_session);
+  gnutls_deinit (second_session);
+  gnutls_certificate_free_credentials (first);
+  gnutls_certificate_free_credentials (second);
+}
+
+Ensure (serverutils, gvm_server_new_cached_shares_credentials)
+{
+  gnutls_session_t first_session, second_session;
+  gnutls_certificate_credentials_t first, second;
+
+  assert_that (gvm_server_new_cached (GNUTLS_CLIENT, NULL, NULL, NULL,
+                                      &first_session, &first),
+               is_equal_to (0));
+  assert_that (gvm_server_new_cached (GNUTLS_CLIENT, NULL, NULL, NULL,
+                                      &second_session, &second),
+               is_equal_to (0));
+  assert_that (second, is_equal_to (first));
+
+  gnutls_deinit (first_session);
+  gnutls_deinit (second_session);
+  gvm_server_free_credentials (first);
+  gvm_server_free_credentials (second);
+}
+
+/* gvm_connection_enable_compression */
+
+Ensure (serverutils, compressed_connection_round_trips_xml)
+{
+  gvm_connection_t client = {0}, server = {0};
+  entity_t entity;
+  GString *response;
+  int sockets[2];
+
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  client.socket = sockets[0];
+  server.socket = sockets[1];
+  assert_that (gvm_connection_enable_compression (&client, -1),
+               is_equal_to (0));
+  assert_that (gvm_connection_enable_compression (&server, 6),
+               is_equal_to (0));
+
+  /* Command from the client. */
+  assert_that (gvm_connection_sendf (&client, "<get_results filter='%s'/>",
+                                     "rows=1000"),
+               is_equal_to (0));
+  assert_that (read_entity_c (&server, &entity), is_equal_to (0));
+  assert_that (entity_name (entity), is_equal_to_string ("get_results"));
+  assert_that (entity_attribute (entity, "filter"),
+               is_equal_to_string ("rows=1000"));
+  free_entity (entity);
+
+  /* Response from the server, sent in pieces. */
+  response = g_string_new ("");
+  for (int index = 0; index < 1000; index++)
+    g_string_append_printf (response, "<result id='%d'>Repetitive</result>",
+                            index);
+  assert_that (gvm_connection_sendf (&server,
+                                     "<get_results_response status='200'>"),
+               is_equal_to (0));
+  assert_that (gvm_connection_sendf (&server, "%s</get_results_response>",
+                                     response->str),
+               is_equal_to (0));
+  g_string_free (response, TRUE);
+
+  assert_that (read_entity_c (&client, &entity), is_equal_to (0));
+  assert_that (entity_attribute (entity, "status"), is_equal_to_string ("200"));
+  assert_that (xml_count_entities (entity->entities), is_equal_to (1000));
+  assert_that (entity_text (entity_child (entity, "result")),
+               is_equal_to_string ("Repetitive"));
+  free_entity (entity);
+
+  gvm_connection_free (&client);
+  gvm_connection_free (&server);
+}
+
+/* gvm_connection_cork */
+
+Ensure (serverutils, corked_connection_sends_on_last_uncork)
+{
+  gvm_connection_t client = {0};
+  struct iovec iov[2];
+  char buffer[64];
+  int sockets[2];
+
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  client.socket = sockets[0];
+
+  gvm_connection_cork (&client);
+  gvm_connection_cork (&client);
+  assert_that (gvm_connection_sendf (&client, "<%s/>", "get_version"),
+               is_equal_to (0));
+  iov[0].iov_base = "<get_tasks";
+  iov[0].iov_len = strlen ("<get_tasks");
+  iov[1].iov_base = "/>";
+  iov[1].iov_len = strlen ("/>");
+  assert_that (gvm_connection_sendv (&client, iov, 2), is_equal_to (0));
+
+  /* The inner uncork sends nothing. */
+  assert_that (gvm_connection_uncork (&client), is_equal_to (0));
+  assert_that (recv (sockets[1], buffer, sizeof (buffer), MSG_DONTWAIT),
+               is_equal_to (-1));
+
+  assert_that (gvm_connection_uncork (&client), is_equal_to (0));
+  memset (buffer, 0, sizeof (buffer));
+  assert_that (recv (sockets[1], buffer, sizeof (buffer) - 1, MSG_DONTWAIT),
+               is_equal_to (strlen ("<get_version/><get_tasks/>")));
+  assert_that (buffer, is_equal_to_string ("<get_version/><get_tasks/>"));
+
+  /* Uncorked sends go out directly. */
+  assert_that (gvm_connection_sendf (&client, "<help/>"), is_equal_to (0));
+  memset (buffer, 0, sizeof (buffer));
+  assert_that (recv (sockets[1], buffer, sizeof (buffer) - 1, MSG_DONTWAIT),
+               is_equal_to (strlen ("<help/>")));
+  assert_that (buffer, is_equal_to_string ("<help/>"));
+
+  gvm_connection_free (&client);
+  close (sockets[1]);
+}
+
+/* Test suite. */
+
+int
+main (int argc, char **argv)
+{
+  TestSuite *suite;
+
+  suite = create_test_suite ();
+
+  add_test_with_context (suite, serverutils,
+                         gvm_server_new_returns_private_credentials);
+  add_test_with_context (suite, serverutils,
+                         gvm_server_new_cached_shares_credentials);
+  add_test_with_context (suite, serverutils,
+                         compressed_connection_round_trips_xml);
+  add_test_with_context (suite, serverutils,
+                         corked_connection_sends_on_last_uncork);
+
+  if (argc > 1)
+    return run_single_test (suite, argv[1], create_text_reporter ());
+
+  return run_test_suite (suite, create_text_reporter ());
+}
@@ -35,8 +35,8 @@
 #include <glib/gtypes.h> /* for GPOINTER_TO_INT, GINT_TO_POINTER, gsize */
 #include <libxml/parser.h>
 #include <libxml/tree.h>
+#include <poll.h>   /* for poll, pollfd */
 #include <string.h> /* for strcmp, strerror, strlen */
-#include <time.h>   /* for time, time_t */
 #include <unistd.h> /* for ssize_t */
 
 #undef G_LOG_DOMAIN
@@ -50,6 +50,128 @@
  */
 #define BUFFER_SIZE 1048576
 
+/**
+ * @brief Size of the memory blocks of an entity arena.
+ */
+#define ENTITY_ARENA_BLOCK_SIZE 65536
+
+/**
+ * @brief Arena holding all memory of an entity tree.
+ *
+ * Entities, their child lists and attribute lists are carved out of large
+ * blocks.  Names are interned and texts copied into a string chunk.  The
+ * whole tree is released at once when the root is freed.
+ */
+struct entity_arena
+{
+  entity_t root;         ///< Root of the tree.
+  GStringChunk *strings; ///< Names and texts.
+  GSList *blocks;        ///< Memory blocks, the current block first.
+  gsize block_used;      ///< Bytes used in the current block.
+  GSList *text_buffers;  ///< Text buffers of elements being parsed.
+  GSList *child_indexes; ///< Child indexes built by entity_index_children.
+};
+
+/**
+ * @brief Create an entity arena.
+ *
+ * @return A newly allocated arena.
+ */
+static entity_arena_t *
+entity_arena_new (void)
+{
+  entity_arena_t *arena;
+
+  arena = g_malloc0 (sizeof (*arena));
+  arena->strings = g_string_chunk_new (ENTITY_ARENA_BLOCK_SIZE);
+  arena->block_used = ENTITY_ARENA_BLOCK_SIZE;
+  return arena;
+}
+
+/**
+ * @brief Free an entity arena and with it the whole tree.
+ *
+ * @param[in]  arena  The arena.
+ */
+static void
+entity_arena_free (entity_arena_t *arena)
+{
+  for (GSList *list = arena->text_buffers; list; list = list->next)
+    g_string_free (list->data, TRUE);
+  g_slist_free (arena->text_buffers);
+  g_slist_free_full (arena->child_indexes,
+                     (GDestroyNotify) g_hash_table_destroy);
+  g_slist_free_full (arena->blocks, g_free);
+  g_string_chunk_free (arena->strings);
+  g_free (arena);
+}
+
+/**
+ * @brief Allocate memory from an entity arena.
+ *
+ * @param[in]  arena  The arena.
+ * @param[in]  size   Number of bytes.
+ *
+ * @return Zeroed memory, which is freed along with the arena.
+ */
+static gpointer
+entity_arena_alloc (entity_arena_t *arena, gsize size)
+{
+  gpointer memory;
+
+  /* Keep allocations aligned for any pointer sized member. */
+  size = (size + 2 * sizeof (gpointer) - 1) & ~(2 * sizeof (gpointer) - 1);
+
+  if (size > ENTITY_ARENA_BLOCK_SIZE / 4)
+    {
+      /* Large allocation, give it a block of its own behind the current. */
+      memory = g_malloc0 (size);
+      if (arena->blocks)
+        arena->blocks->next = g_slist_prepend (arena->blocks->next, memory);
+      else
+        {
+          arena->blocks = g_slist_prepend (NULL, memory);
+          arena->block_used = ENTITY_ARENA_BLOCK_SIZE;
+        }
+      return memory;
+    }
+
+  if (arena->block_used + size > ENTITY_ARENA_BLOCK_SIZE)
+    {
+      arena->blocks =
+        g_slist_prepend (arena->blocks, g_malloc0 (ENTITY_ARENA_BLOCK_SIZE));
+      arena->block_used = 0;
+    }
+  memory = (char *) arena->blocks->data + arena->block_used;
+  arena->block_used += size;
+  return memory;
+}
+
+/**
+ * @brief Create an entity in an arena.
+ *
+ * @param[in]  arena  The arena.
+ * @param[in]  name   Name of the entity.  Interned in the arena.
+ * @param[in]  text   Text of the entity.  Copied into the arena.
+ *
+ * @return A new entity, which is freed along with the arena.
+ */
+static entity_t
+entity_arena_make_entity (entity_arena_t *arena, const char *name,
+                          const char *text)
+{
+  entity_t entity;
+
+  entity = entity_arena_alloc (arena, sizeof (*entity));
+  entity->name = g_string_chunk_insert_const (arena->strings, name ? name : "");
+  if (text && *text)
+    entity->text = g_string_chunk_insert (arena->strings, text);
+  else
+    entity->text = g_string_chunk_insert_const (arena->strings, "");
+  entity->arena = arena;
+  return entity;
+}
+
 /**
  * @brief Create an entity.
  *
@@ -66,7 +188,13 @@ make_entity (const char *name, const char *text)
   entity->name = g_strdup (name ? name : "");
   entity->text = g_strdup (text ? text : "");
   entity->entities = NULL;
+  entity->last_entity = NULL;
   entity->attributes = NULL;
+  entity->arena = NULL;
+  entity->attribute_list = NULL;
+  entity->text_buffer = NULL;
+  entity->child_index = NULL;
+  entity->child_index_last = NULL;
   return entity;
 }
 
@@ -120,20 +248,82 @@ add_entity (entities_t *entities, const char *name, const char *text)
   return entity;
 }
 
+/**
+ * @brief Add a child to an XML entity.
+ *
+ * Unlike add_entity, which walks the whole list of children, this appends
+ * in constant time by remembering the last child of the parent.
+ *
+ * @param[in]  parent  The parent entity.
+ * @param[in]  name    Name of the entity.  Copied, copy is freed by
+ *                     free_entity.
+ * @param[in]  text    Text of the entity.  Copied, copy is freed by
+ *                     free_entity.
+ *
+ * @return The new entity.
+ */
+static entity_t
+add_child_entity (entity_t parent, const char *name, const char *text)
+{
+  entity_t entity;
+  GSList *link;
+
+  if (parent->arena)
+    {
+      entity = entity_arena_make_entity (parent->arena, name, text);
+      link = entity_arena_alloc (parent->arena, sizeof (*link));
+      link->data = entity;
+    }
+  else
+    {
+      entity = make_entity (name, text);
+      link = g_slist_prepend (NULL, entity);
+    }
+
+  if (parent->entities == NULL)
+    parent->last_entity = parent->entities = link;
+  else
+    {
+      /* Children may also have been added with add_entity. */
+      if (parent->last_entity == NULL || parent->last_entity->next)
+        parent->last_entity = g_slist_last (parent->entities);
+      parent->last_entity->next = link;
+      parent->last_entity = link;
+    }
+  return entity;
+}
+
 /**
  * @brief Free an entity, recursively.
  *
+ * Entities in an arena are only freed along with the whole tree, when the
+ * root is freed.  Freeing any other entity of an arena is ignored with a
+ * warning.
+ *
  * @param[in]  entity  The entity, can be NULL.
  */
 void
 free_entity (entity_t entity)
 {
-  if (entity)
+  if (entity && entity->arena)
+    {
+      if (entity->arena->root == entity)
+        entity_arena_free (entity->arena);
+      else
+        g_warning ("%s: Ignoring entity %s of an arena tree, only the root"
+                   " can be freed",
+                   __func__, entity->name);
+    }
+  else if (entity)
     {
       g_free (entity->name);
       g_free (entity->text);
+      if (entity->text_buffer)
+        g_string_free (entity->text_buffer, TRUE);
       if (entity->attributes)
         g_hash_table_destroy (entity->attributes);
+      if (entity->child_index)
+        g_hash_table_destroy (entity->child_index);
       if (entity->entities)
         {
           GSList *list = entity->entities;
@@ -195,9 +385,102 @@ compare_entity_with_name (gconstpointer entity, gconstpointer name)
   return strcmp (entity_name ((entity_t) entity), (char *) name);
 }
 
+/**
+ * @brief Drop the child index of an entity.
+ *
+ * @param[in]  entity  Entity.
+ */
+static void
+entity_drop_child_index (entity_t entity)
+{
+  if (entity->child_index == NULL)
+    return;
+
+  if (entity->arena)
+    entity->arena->child_indexes =
+      g_slist_remove (entity->arena->child_indexes, entity->child_index);
+  g_hash_table_destroy (entity->child_index);
+  entity->child_index = NULL;
+  entity->child_index_last = NULL;
+}
+
+/**
+ * @brief Tell an entity that its list of children was edited directly.
+ *
+ * Drops the child index and the last child remembered by the entity, which
+ * may point to removed children.  Must be called after removing, reordering
+ * or replacing children in entity->entities by hand.  Appending with
+ * add_entity needs no call.
+ *
+ * @param[in]  entity  Entity.
+ */
+void
+entity_children_changed (entity_t entity)
+{
+  if (!entity)
+    return;
+
+  entity_drop_child_index (entity);
+  entity->last_entity = NULL;
+}
+
+/**
+ * @brief Add children of an entity to its child index.
+ *
+ * @param[in]  entity    Entity.
+ * @param[in]  children  First child to add, the rest of the list follows.
+ */
+static void
+entity_index_add_children (entity_t entity, entities_t children)
+{
+  for (; children; children = children->next)
+    {
+      entity_t child = children->data;
+
+      /* Only the first child of each name is found by entity_child.  The
+       * names of arena entities live as long as the arena, other names are
+       * copied so that the keys never point into a freed child. */
+      if (!g_hash_table_contains (entity->child_index, child->name))
+        g_hash_table_insert (entity->child_index,
+                             entity->arena ? child->name
+                                           : g_strdup (child->name),
+                             child);
+      entity->child_index_last = children;
+    }
+}
+
+/**
+ * @brief Index the children of an entity by name.
+ *
+ * Afterwards entity_child on the entity takes constant time, which pays off
+ * for many lookups on a wide entity, like a report with many results.  The
+ * index follows children appended with add_entity, updating it on the next
+ * entity_child, so an indexed entity that is still appended to must not be
+ * read by several threads at once.  After editing the list of children
+ * directly, call entity_children_changed, or this function again.
+ *
+ * @param[in]  entity  Entity.
+ */
+void
+entity_index_children (entity_t entity)
+{
+  if (!entity)
+    return;
+
+  entity_drop_child_index (entity);
+  entity->child_index = g_hash_table_new_full (
+    g_str_hash, g_str_equal, entity->arena ? NULL : g_free, NULL);
+  entity_index_add_children (entity, entity->entities);
+  if (entity->arena)
+    entity->arena->child_indexes =
+      g_slist_prepend (entity->arena->child_indexes, entity->child_index);
+}
+
 /**
  * @brief Get a child of an entity.
  *
+ * Walks the children, unless they were indexed with entity_index_children.
+ *
  * @param[in]  entity  Entity.
  * @param[in]  name    Name of the child.
  *
@@ -206,15 +489,33 @@ compare_entity_with_name (gconstpointer entity, gconstpointer name)
 entity_t
 entity_child (entity_t entity, const char *name)
 {
+  entities_t list;
+
   if (!entity)
     return NULL;
 
-  if (entity->entities)
+  if (entity->child_index)
     {
-      entities_t match =
-        g_slist_find_custom (entity->entities, name, compare_entity_with_name);
-      return match ? (entity_t) match->data : NULL;
+      entity_t first;
+
+      /* A new first child means the list was replaced, so the index is
+       * stale.  Other direct edits must call entity_children_changed. */
+      first = entity->entities ? entity->entities->data : NULL;
+      if (first
+          && g_hash_table_lookup (entity->child_index, first->name) == first)
+        {
+          if (entity->child_index_last->next)
+            entity_index_add_children (entity,
+                                       entity->child_index_last->next);
+          return g_hash_table_lookup (entity->child_index, name);
+        }
+      entity_drop_child_index (entity);
     }
+
+  for (list = entity->entities; list; list = list->next)
+    if (strcmp (((entity_t) list->data)->name, name) == 0)
+      return (entity_t) list->data;
+
   return NULL;
 }
 
@@ -232,11 +533,61 @@ entity_attribute (entity_t entity, const char *name)
   if (!entity)
     return NULL;
 
+  if (entity->attribute_list)
+    {
+      char **pair;
+
+      for (pair = entity->attribute_list; *pair; pair += 2)
+        if (strcmp (pair[0], name) == 0)
+          return pair[1];
+      return NULL;
+    }
   if (entity->attributes)
     return (const char *) g_hash_table_lookup (entity->attributes, name);
   return NULL;
 }
 
+/**
+ * @brief Call a function for each attribute of an entity.
+ *
+ * @param[in]  entity     Entity.
+ * @param[in]  func       Function called with name, value and user_data.
+ * @param[in]  user_data  User data.
+ */
+static void
+foreach_entity_attribute (entity_t entity, GHFunc func, gpointer user_data)
+{
+  if (entity->attribute_list)
+    {
+      char **pair;
+
+      for (pair = entity->attribute_list; *pair; pair += 2)
+        func (pair[0], pair[1], user_data);
+    }
+  else if (entity->attributes)
+    g_hash_table_foreach (entity->attributes, func, user_data);
+}
+
+/**
+ * @brief Count the attributes of an entity.
+ *
+ * @param[in]  entity  Entity.
+ *
+ * @return Number of attributes.
+ */
+static guint
+entity_attribute_count (entity_t entity)
+{
+  guint count = 0;
+
+  if (entity->attribute_list)
+    while (entity->attribute_list[2 * count])
+      count++;
+  else if (entity->attributes)
+    count = g_hash_table_size (entity->attributes);
+  return count;
+}
+
 /**
  * @brief Add attributes from an XML callback to an entity.
  *
@@ -247,7 +598,25 @@ entity_attribute (entity_t entity, const char *name)
 void
 add_attributes (entity_t entity, const gchar **names, const gchar **values)
 {
-  if (names && values && *names && *values)
+  if (names && values && *names && *values && entity->arena)
+    {
+      GStringChunk *strings = entity->arena->strings;
+      int count, i;
+
+      for (count = 0; names[count] && values[count]; count++)
+        ;
+      entity->attribute_list =
+        entity_arena_alloc (entity->arena, (2 * count + 1) * sizeof (char *));
+      for (i = 0; i < count; i++)
+        {
+          entity->attribute_list[2 * i] =
+            g_string_chunk_insert_const (strings, names[i]);
+          entity->attribute_list[2 * i + 1] =
+            g_string_chunk_insert (strings, values[i]);
+        }
+      entity->attribute_list[2 * count] = NULL;
+    }
+  else if (names && values && *names && *values)
     {
       if (entity->attributes == NULL)
         entity->attributes =
@@ -312,10 +681,8 @@ handle_start_element (GMarkupParseContext *context, const gchar *element_name,
   (void) context;
   (void) error;
   if (data->current)
-    {
-      entity_t current = (entity_t) data->current->data;
-      entity = add_entity (&current->entities, element_name, NULL);
-    }
+    entity = add_child_entity ((entity_t) data->current->data, element_name,
+                               NULL);
   else
     entity = add_entity (NULL, element_name, NULL);
 
@@ -328,6 +695,44 @@ handle_start_element (GMarkupParseContext *context, const gchar *element_name,
     data->current = g_slist_prepend (data->current, entity);
 }
 
+/**
+ * @brief Handle the start of an XML element, building the tree in an arena.
+ *
+ * Only the root needs special handling, children are added to the arena of
+ * their parent.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  attribute_names   XML attribute name.
+ * @param[in]  attribute_values  XML attribute values.
+ * @param[in]  user_data         Dummy parameter.
+ * @param[in]  error             Error parameter.
+ */
+static void
+handle_start_element_arena (GMarkupParseContext *context,
+                            const gchar *element_name,
+                            const gchar **attribute_names,
+                            const gchar **attribute_values, gpointer user_data,
+                            GError **error)
+{
+  entity_arena_t *arena;
+  context_data_t *data = (context_data_t *) user_data;
+
+  if (data->current)
+    {
+      handle_start_element (context, element_name, attribute_names,
+                            attribute_values, user_data, error);
+      return;
+    }
+
+  arena = entity_arena_new ();
+  arena->root = entity_arena_make_entity (arena, element_name, NULL);
+  add_attributes (arena->root, attribute_names, attribute_values);
+
+  /* "Push" the element. */
+  data->current = data->first = g_slist_prepend (NULL, arena->root);
+}
+
 /**
  * @brief Handle the start of an OMP XML element.
  *
@@ -368,6 +773,35 @@ ignore_end_element (GMarkupParseContext *context, const gchar *element_name,
     data->done = TRUE;
 }
 
+/**
+ * @brief Move the text collected while parsing an element to its text.
+ *
+ * @param[in]  entity  The entity.
+ */
+static void
+finish_entity_text (entity_t entity)
+{
+  GString *buffer = entity->text_buffer;
+
+  if (buffer == NULL)
+    return;
+
+  entity->text_buffer = NULL;
+  if (entity->arena)
+    {
+      entity->text = g_string_chunk_insert_len (entity->arena->strings,
+                                                buffer->str, buffer->len);
+      entity->arena->text_buffers =
+        g_slist_remove (entity->arena->text_buffers, buffer);
+      g_string_free (buffer, TRUE);
+    }
+  else
+    {
+      g_free (entity->text);
+      entity->text = g_string_free (buffer, FALSE);
+    }
+}
+
 /**
  * @brief Handle the end of an XML element.
  *
@@ -386,6 +820,7 @@ handle_end_element (GMarkupParseContext *context, const gchar *element_name,
   (void) error;
   (void) element_name;
   assert (data->current && data->first);
+  finish_entity_text ((entity_t) data->current->data);
   if (data->current == data->first)
     {
       assert (strcmp (element_name,
@@ -454,17 +889,35 @@ handle_text (GMarkupParseContext *context, const gchar *text, gsize text_len,
   context_data_t *data = (context_data_t *) user_data;
 
   (void) context;
-  (void) text_len;
   (void) error;
   entity_t current = (entity_t) data->current->data;
-  if (current->text)
+
+  if (current->text_buffer)
+    g_string_append_len (current->text_buffer, text, text_len);
+  else if (current->text == NULL || *current->text == '\0')
     {
-      gchar *old = current->text;
-      current->text = g_strconcat (current->text, text, NULL);
-      g_free (old);
+      /* Most elements get their text in a single piece. */
+      if (current->arena)
+        current->text = g_string_chunk_insert_len (current->arena->strings,
+                                                   text, text_len);
+      else
+        {
+          g_free (current->text);
+          current->text = g_strndup (text, text_len);
+        }
     }
   else
-    current->text = g_strdup (text);
+    {
+      /* Collect further pieces in a buffer, which grows geometrically, until
+       * the end of the element. */
+      current->text_buffer = g_string_sized_new (2 * (strlen (current->text)
+                                                      + text_len));
+      g_string_append (current->text_buffer, current->text);
+      g_string_append_len (current->text_buffer, text, text_len);
+      if (current->arena)
+        current->arena->text_buffers =
+          g_slist_prepend (current->arena->text_buffers, current->text_buffer);
+    }
 }
 
 /**
@@ -480,6 +933,120 @@ xml_handle_text (context_data_t *context, const gchar *text, gsize text_len)
   handle_text (NULL, text, text_len, context, NULL);
 }
 
+/**
+ * @brief XML context for streaming entities.
+ */
+typedef struct
+{
+  context_data_t context;     ///< XML context.  Must be first.
+  int depth;                  ///< Depth of the next element, the root is 0.
+  int stream_depth;           ///< Depth of the streamed elements.
+  const char *name;           ///< Name of the streamed elements, NULL for all.
+  entity_callback_t callback; ///< Called with each streamed element.
+  gpointer user_data;         ///< User data for callback.
+  GSList *previous;           ///< Sibling before the current streamed element.
+} stream_data_t;
+
+/**
+ * @brief Handle the start of an XML element, streaming elements.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  attribute_names   XML attribute name.
+ * @param[in]  attribute_values  XML attribute values.
+ * @param[in]  user_data         Stream data.
+ * @param[in]  error             Error parameter.
+ */
+static void
+handle_start_element_stream (GMarkupParseContext *context,
+                             const gchar *element_name,
+                             const gchar **attribute_names,
+                             const gchar **attribute_values,
+                             gpointer user_data, GError **error)
+{
+  stream_data_t *stream = (stream_data_t *) user_data;
+
+  /* The element is appended to its parent, so remember where to cut it off
+   * again at its end. */
+  if (stream->depth++ == stream->stream_depth)
+    stream->previous = ((entity_t) stream->context.current->data)->last_entity;
+
+  handle_start_element (context, element_name, attribute_names,
+                        attribute_values, &stream->context, error);
+}
+
+/**
+ * @brief Handle the end of an XML element, streaming elements.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  element_name      XML element name.
+ * @param[in]  user_data         Stream data.
+ * @param[in]  error             Error parameter.
+ */
+static void
+handle_end_element_stream (GMarkupParseContext *context,
+                           const gchar *element_name, gpointer user_data,
+                           GError **error)
+{
+  stream_data_t *stream = (stream_data_t *) user_data;
+
+  handle_end_element (context, element_name, &stream->context, error);
+
+  if (--stream->depth == stream->stream_depth)
+    {
+      entity_t parent, entity;
+
+      parent = (entity_t) stream->context.current->data;
+      entity = (entity_t) parent->last_entity->data;
+      if (stream->name && strcmp (entity->name, stream->name))
+        return;
+
+      /* Cut the element off its parent. */
+      entity_drop_child_index (parent);
+      g_slist_free_1 (parent->last_entity);
+      if (stream->previous)
+        stream->previous->next = NULL;
+      else
+        parent->entities = NULL;
+      parent->last_entity = stream->previous;
+
+      stream->callback (entity, stream->user_data);
+      free_entity (entity);
+    }
+}
+
+/**
+ * @brief Handle text of an XML element, streaming elements.
+ *
+ * Whitespace between the streamed elements is dropped, so that it does not
+ * collect in the text of their parent while streaming.
+ *
+ * @param[in]  context           Parser context.
+ * @param[in]  text              The text.
+ * @param[in]  text_len          Length of the text.
+ * @param[in]  user_data         Stream data.
+ * @param[in]  error             Error parameter.
+ */
+static void
+handle_text_stream (GMarkupParseContext *context, const gchar *text,
+                    gsize text_len, gpointer user_data, GError **error)
+{
+  stream_data_t *stream = (stream_data_t *) user_data;
+
+  if (stream->depth == stream->stream_depth)
+    {
+      gsize index;
+
+      for (index = 0; index < text_len; index++)
+        if (!g_ascii_isspace (text[index]))
+          break;
+      if (index == text_len)
+        return;
+    }
+
+  handle_text (context, text, text_len, &stream->context, error);
+}
+
 /**
  * @brief Handle an OMP XML parsing error.
  *
@@ -495,6 +1062,148 @@ handle_error (GMarkupParseContext *context, GError *error, gpointer user_data)
   g_message ("   Error: %s\n", error->message);
 }
 
+/**
+ * @brief Buffer for reading from the manager, reused by the reads of a thread.
+ */
+struct read_buffer
+{
+  char *data;      ///< BUFFER_SIZE bytes.
+  gboolean in_use; ///< Whether a read of the thread is using the buffer.
+};
+
+/**
+ * @brief Free a read buffer.
+ *
+ * @param[in]  read_buffer  The buffer.
+ */
+static void
+read_buffer_free (gpointer read_buffer)
+{
+  g_free (((struct read_buffer *) read_buffer)->data);
+  g_free (read_buffer);
+}
+
+/**
+ * @brief Read buffer of the current thread.
+ */
+static GPrivate thread_read_buffer = G_PRIVATE_INIT (read_buffer_free);
+
+/**
+ * @brief Get a buffer for reading from the manager.
+ *
+ * The buffer of the current thread is reused across reads.  A nested read,
+ * e.g. from a callback of read_entity_stream, gets a buffer of its own.
+ *
+ * @return Buffer of BUFFER_SIZE bytes, to be released with
+ *         read_buffer_release.
+ */
+static char *
+read_buffer_acquire (void)
+{
+  struct read_buffer *read_buffer = g_private_get (&thread_read_buffer);
+
+  if (read_buffer == NULL)
+    {
+      read_buffer = g_malloc0 (sizeof (*read_buffer));
+      read_buffer->data = g_malloc (BUFFER_SIZE);
+      g_private_set (&thread_read_buffer, read_buffer);
+    }
+  if (read_buffer->in_use)
+    return g_malloc (BUFFER_SIZE);
+  read_buffer->in_use = TRUE;
+  return read_buffer->data;
+}
+
+/**
+ * @brief Release a buffer from read_buffer_acquire.
+ *
+ * @param[in]  buffer  The buffer.
+ */
+static void
+read_buffer_release (char *buffer)
+{
+  struct read_buffer *read_buffer = g_private_get (&thread_read_buffer);
+
+  if (read_buffer && read_buffer->data == buffer)
+    read_buffer->in_use = FALSE;
+  else
+    g_free (buffer);
+}
+
+/**
+ * @brief Wait until a socket is readable.
+ *
+ * @param[in]  socket    Socket.
+ * @param[in]  deadline  Monotonic time in microseconds to wait until.
+ *
+ * @return TRUE if the socket is readable or polling failed, FALSE if the
+ *         deadline passed.
+ */
+static gboolean
+wait_for_read (int socket, gint64 deadline)
+{
+  struct pollfd pollfd;
+
+  pollfd.fd = socket;
+  pollfd.events = POLLIN;
+  while (1)
+    {
+      gint64 remaining = deadline - g_get_monotonic_time ();
+      int ret;
+
+      if (remaining <= 0)
+        return FALSE;
+      ret = poll (&pollfd, 1, MIN ((remaining + 999) / 1000, G_MAXINT));
+      if (ret > 0)
+        return TRUE;
+      if (ret == 0)
+        continue;
+      if (errno != EINTR)
+        {
+          g_warning ("%s: poll: %s", __func__, strerror (errno));
+          return TRUE;
+        }
+    }
+}
+
+/**
+ * @brief Pass data read from the manager to the XML parser.
+ *
+ * @param[in]   xml_context  XML parser context.
+ * @param[in]   compression  Compression of the data, or NULL.
+ * @param[in]   buffer       Data read.
+ * @param[in]   count        Length of the data.
+ * @param[in]   string       String to append the uncompressed data to, or NULL.
+ * @param[out]  error        Return location for a parse error.
+ */
+static void
+parse_read_data (GMarkupParseContext *xml_context,
+                 gvm_compress_stream_t *compression, const char *buffer,
+                 gsize count, GString *string, GError **error)
+{
+  if (compression)
+    {
+      unsigned long length;
+
+      buffer =
+        gvm_compress_stream_inflate (compression, buffer, count, &length);
+      if (buffer == NULL)
+        {
+          g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE,
+                       "Failed to uncompress data");
+          return;
+        }
+      count = length;
+    }
+
+  g_debug ("<= %.*s\n", (int) count, buffer);
+
+  if (string)
+    g_string_append_len (string, buffer, count);
+
+  g_markup_parse_context_parse (xml_context, buffer, count, error);
+}
+
 /**
  * @brief Try read an XML entity tree from the manager.
  *
@@ -508,29 +1217,31 @@ handle_error (GMarkupParseContext *context, GError *error, gpointer user_data)
  * points to a freshly allocated GString on successful return. Otherwise it
  * points to an existing GString onto which the text is appended.
  *
+ * @param[in]   arena          Whether to build the tree in an arena.
+ * @param[in]   stream         Stream data if streaming elements, else NULL.
+ * @param[in]   compression    Compression of the data read, or NULL.
+ *
  * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
  */
-int
-try_read_entity_and_string (gnutls_session_t *session, int timeout,
-                            entity_t *entity, GString **string_return)
+static int
+try_read_entity_and_string_internal (gnutls_session_t *session, int timeout,
+                                     entity_t *entity, GString **string_return,
+                                     gboolean arena, stream_data_t *stream,
+                                     gvm_compress_stream_t *compression)
 {
   GMarkupParser xml_parser;
   GError *error = NULL;
   GMarkupParseContext *xml_context;
   GString *string;
   int socket;
-  time_t last_time;
+  gint64 last_time;
 
   // Buffer for reading from the manager.
   char *buffer;
 
   /* Record the start time. */
 
-  if (time (&last_time) == -1)
-    {
-      g_warning ("   failed to get current time: %s\n", strerror (errno));
-      return -1;
-    }
+  last_time = g_get_monotonic_time ();
 
   if (timeout > 0)
     {
@@ -544,7 +1255,7 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
     /* Quiet compiler. */
     socket = 0;
 
-  buffer = g_malloc0 (BUFFER_SIZE);
+  buffer = read_buffer_acquire ();
 
   /* Setup return arg. */
 
@@ -557,9 +1268,16 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
 
   /* Create the XML parser. */
 
-  if (entity)
+  if (stream)
+    {
+      xml_parser.start_element = handle_start_element_stream;
+      xml_parser.end_element = handle_end_element_stream;
+      xml_parser.text = handle_text_stream;
+    }
+  else if (entity)
     {
-      xml_parser.start_element = handle_start_element;
+      xml_parser.start_element =
+        arena ? handle_start_element_arena : handle_start_element;
       xml_parser.end_element = handle_end_element;
       xml_parser.text = handle_text;
     }
@@ -572,15 +1290,18 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
   xml_parser.passthrough = NULL;
   xml_parser.error = handle_error;
 
-  context_data_t context_data;
-  context_data.done = FALSE;
-  context_data.first = NULL;
-  context_data.current = NULL;
+  context_data_t local_context_data;
+  context_data_t *context_data;
+  /* The stream data starts with its context. */
+  context_data = stream ? &stream->context : &local_context_data;
+  context_data->done = FALSE;
+  context_data->first = NULL;
+  context_data->current = NULL;
 
   /* Setup the XML context. */
 
   xml_context =
-    g_markup_parse_context_new (&xml_parser, 0, &context_data, NULL);
+    g_markup_parse_context_new (&xml_parser, 0, context_data, NULL);
 
   /* Read and parse, until encountering end of file or error. */
 
@@ -600,14 +1321,15 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
               if ((timeout > 0) && (count == GNUTLS_E_AGAIN))
                 {
                   /* Server still busy, either timeout or try read again. */
-                  if ((timeout - (time (NULL) - last_time)) <= 0)
+                  if (!wait_for_read (socket,
+                                      last_time + timeout * G_USEC_PER_SEC))
                     {
                       g_warning ("   timeout\n");
                       if (fcntl (socket, F_SETFL, 0L) < 0)
                         g_warning ("%s :failed to set socket flag: %s",
                                    __func__, strerror (errno));
                       g_markup_parse_context_free (xml_context);
-                      g_free (buffer);
+                      read_buffer_release (buffer);
                       return -4;
                     }
                   continue;
@@ -628,10 +1350,10 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
               if (count == GNUTLS_E_REHANDSHAKE)
                 /* Try again. TODO Rehandshake. */
                 continue;
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (string && *string_return == NULL)
                 g_string_free (string, TRUE);
@@ -642,7 +1364,7 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
                                strerror (errno));
                 }
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -1;
             }
           if (count == 0)
@@ -654,10 +1376,10 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
                   g_warning ("   End error: %s\n", error->message);
                   g_error_free (error);
                 }
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (string && *string_return == NULL)
                 g_string_free (string, TRUE);
@@ -668,25 +1390,21 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
                                strerror (errno));
                 }
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -3;
             }
           break;
         }
 
-      g_debug ("<= %.*s\n", (int) count, buffer);
-
-      if (string)
-        g_string_append_len (string, buffer, count);
-
-      g_markup_parse_context_parse (xml_context, buffer, count, &error);
+      parse_read_data (xml_context, compression, buffer, count, string,
+                       &error);
       if (error)
         {
           g_error_free (error);
-          if (context_data.first && context_data.first->data)
+          if (context_data->first && context_data->first->data)
             {
-              free_entity (context_data.first->data);
-              g_slist_free_1 (context_data.first);
+              free_entity (context_data->first->data);
+              g_slist_free_1 (context_data->first);
             }
           if (string && *string_return == NULL)
             g_string_free (string, TRUE);
@@ -697,52 +1415,66 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
                            strerror (errno));
             }
           g_markup_parse_context_free (xml_context);
-          g_free (buffer);
+          read_buffer_release (buffer);
           return -2;
         }
-      if (context_data.done)
+      if (context_data->done)
         {
           g_markup_parse_context_end_parse (xml_context, &error);
           if (error)
             {
               g_warning ("   End error: %s\n", error->message);
               g_error_free (error);
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (timeout > 0)
                 fcntl (socket, F_SETFL, 0L);
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -2;
             }
           if (entity)
-            *entity = (entity_t) context_data.first->data;
+            *entity = (entity_t) context_data->first->data;
           if (string)
             *string_return = string;
           if (timeout > 0)
             fcntl (socket, F_SETFL, 0L);
           g_markup_parse_context_free (xml_context);
-          g_free (buffer);
-          return 0;
-        }
-
-      if ((timeout > 0) && (time (&last_time) == -1))
-        {
-          g_warning ("   failed to get current time (1): %s\n",
-                     strerror (errno));
-          if (fcntl (socket, F_SETFL, 0L) < 0)
-            g_warning ("%s :failed to set socket flag: %s", __func__,
-                       strerror (errno));
-          g_markup_parse_context_free (xml_context);
-          g_free (buffer);
-          return -1;
+          read_buffer_release (buffer);
+          return 0;
         }
+
+      if (timeout > 0)
+        last_time = g_get_monotonic_time ();
     }
 }
 
+/**
+ * @brief Try read an XML entity tree from the manager.
+ *
+ * @param[in]   session        Pointer to GNUTLS session.
+ * @param[in]   timeout        Server idle time before giving up, in seconds.  0
+ * to wait forever.
+ * @param[out]  entity         Pointer to an entity tree.
+ * @param[out]  string_return  An optional return location for the text read
+ *                             from the session.  If NULL then it simply
+ *                             remains NULL.  If a pointer to NULL then it
+ * points to a freshly allocated GString on successful return. Otherwise it
+ * points to an existing GString onto which the text is appended.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
+ */
+int
+try_read_entity_and_string (gnutls_session_t *session, int timeout,
+                            entity_t *entity, GString **string_return)
+{
+  return try_read_entity_and_string_internal (session, timeout, entity,
+                                              string_return, FALSE, NULL, NULL);
+}
+
 /**
  * @brief Try read an XML entity tree from the socket.
  *
@@ -756,27 +1488,30 @@ try_read_entity_and_string (gnutls_session_t *session, int timeout,
  * points to a freshly allocated GString on successful return. Otherwise it
  * points to an existing GString onto which the text is appended.
  *
+ * @param[in]   arena          Whether to build the tree in an arena.
+ * @param[in]   stream         Stream data if streaming elements, else NULL.
+ * @param[in]   compression    Compression of the data read, or NULL.
+ *
  * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
  */
-int
-try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
-                              GString **string_return)
+static int
+try_read_entity_and_string_s_internal (int socket, int timeout,
+                                       entity_t *entity,
+                                       GString **string_return, gboolean arena,
+                                       stream_data_t *stream,
+                                       gvm_compress_stream_t *compression)
 {
   GMarkupParser xml_parser;
   GError *error = NULL;
   GMarkupParseContext *xml_context;
   GString *string;
-  time_t last_time;
+  gint64 last_time;
   /* Buffer for reading from the socket. */
   char *buffer;
 
   /* Record the start time. */
 
-  if (time (&last_time) == -1)
-    {
-      g_warning ("   failed to get current time: %s\n", strerror (errno));
-      return -1;
-    }
+  last_time = g_get_monotonic_time ();
 
   if (timeout > 0)
     {
@@ -786,7 +1521,7 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
         return -1;
     }
 
-  buffer = g_malloc0 (BUFFER_SIZE);
+  buffer = read_buffer_acquire ();
 
   /* Setup return arg. */
 
@@ -799,9 +1534,16 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
 
   /* Create the XML parser. */
 
-  if (entity)
+  if (stream)
+    {
+      xml_parser.start_element = handle_start_element_stream;
+      xml_parser.end_element = handle_end_element_stream;
+      xml_parser.text = handle_text_stream;
+    }
+  else if (entity)
     {
-      xml_parser.start_element = handle_start_element;
+      xml_parser.start_element =
+        arena ? handle_start_element_arena : handle_start_element;
       xml_parser.end_element = handle_end_element;
       xml_parser.text = handle_text;
     }
@@ -814,15 +1556,18 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
   xml_parser.passthrough = NULL;
   xml_parser.error = handle_error;
 
-  context_data_t context_data;
-  context_data.done = FALSE;
-  context_data.first = NULL;
-  context_data.current = NULL;
+  context_data_t local_context_data;
+  context_data_t *context_data;
+  /* The stream data starts with its context. */
+  context_data = stream ? &stream->context : &local_context_data;
+  context_data->done = FALSE;
+  context_data->first = NULL;
+  context_data->current = NULL;
 
   /* Setup the XML context. */
 
   xml_context =
-    g_markup_parse_context_new (&xml_parser, 0, &context_data, NULL);
+    g_markup_parse_context_new (&xml_parser, 0, context_data, NULL);
 
   /* Read and parse, until encountering end of file or error. */
 
@@ -843,14 +1588,15 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
                   if (errno == EAGAIN)
                     {
                       /* Server still busy, either timeout or try read again. */
-                      if ((timeout - (time (NULL) - last_time)) <= 0)
+                      if (!wait_for_read (socket, last_time
+                                                    + timeout * G_USEC_PER_SEC))
                         {
                           g_warning ("   timeout\n");
                           if (fcntl (socket, F_SETFL, 0L) < 0)
                             g_warning ("%s :failed to set socket flag: %s",
                                        __func__, strerror (errno));
                           g_markup_parse_context_free (xml_context);
-                          g_free (buffer);
+                          read_buffer_release (buffer);
                           if (string && *string_return == NULL)
                             g_string_free (string, TRUE);
                           return -4;
@@ -858,17 +1604,17 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
                     }
                   continue;
                 }
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (string && *string_return == NULL)
                 g_string_free (string, TRUE);
               if (timeout > 0)
                 fcntl (socket, F_SETFL, 0L);
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -1;
             }
           if (count == 0)
@@ -880,10 +1626,10 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
                   g_warning ("   End error: %s\n", error->message);
                   g_error_free (error);
                 }
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (string && *string_return == NULL)
                 g_string_free (string, TRUE);
@@ -894,26 +1640,22 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
                                strerror (errno));
                 }
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               return -3;
             }
           break;
         }
 
-      g_debug ("<= %.*s\n", (int) count, buffer);
-
-      if (string)
-        g_string_append_len (string, buffer, count);
-
-      g_markup_parse_context_parse (xml_context, buffer, count, &error);
+      parse_read_data (xml_context, compression, buffer, count, string,
+                       &error);
       if (error)
         {
           g_error_free (error);
           // FIX there may be multiple entries in list
-          if (context_data.first && context_data.first->data)
+          if (context_data->first && context_data->first->data)
             {
-              free_entity (context_data.first->data);
-              g_slist_free_1 (context_data.first);
+              free_entity (context_data->first->data);
+              g_slist_free_1 (context_data->first);
             }
           if (string && *string_return == NULL)
             g_string_free (string, TRUE);
@@ -924,57 +1666,102 @@ try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
                            strerror (errno));
             }
           g_markup_parse_context_free (xml_context);
-          g_free (buffer);
+          read_buffer_release (buffer);
           return -2;
         }
-      if (context_data.done)
+      if (context_data->done)
         {
           g_markup_parse_context_end_parse (xml_context, &error);
           if (error)
             {
               g_warning ("   End error: %s\n", error->message);
               g_error_free (error);
-              if (context_data.first && context_data.first->data)
+              if (context_data->first && context_data->first->data)
                 {
-                  free_entity (context_data.first->data);
-                  g_slist_free_1 (context_data.first);
+                  free_entity (context_data->first->data);
+                  g_slist_free_1 (context_data->first);
                 }
               if (timeout > 0)
                 fcntl (socket, F_SETFL, 0L);
               g_markup_parse_context_free (xml_context);
-              g_free (buffer);
+              read_buffer_release (buffer);
               if (string && *string_return == NULL)
                 g_string_free (string, TRUE);
               return -2;
             }
           if (entity)
-            *entity = (entity_t) context_data.first->data;
+            *entity = (entity_t) context_data->first->data;
           if (string)
             *string_return = string;
           if (timeout > 0)
             fcntl (socket, F_SETFL, 0L);
-          g_slist_free (context_data.first);
+          g_slist_free (context_data->first);
           g_markup_parse_context_free (xml_context);
-          g_free (buffer);
+          read_buffer_release (buffer);
           return 0;
         }
 
-      if ((timeout > 0) && (time (&last_time) == -1))
-        {
-          g_warning ("   failed to get current time (1): %s\n",
-                     strerror (errno));
-          if (fcntl (socket, F_SETFL, 0L) < 0)
-            g_warning ("%s :failed to set server socket flag: %s", __func__,
-                       strerror (errno));
-          g_markup_parse_context_free (xml_context);
-          g_free (buffer);
-          if (string && *string_return == NULL)
-            g_string_free (string, TRUE);
-          return -1;
-        }
+      if (timeout > 0)
+        last_time = g_get_monotonic_time ();
     }
 }
 
+/**
+ * @brief Try read an XML entity tree from the socket.
+ *
+ * @param[in]   socket         Socket to read from.
+ * @param[in]   timeout        Server idle time before giving up, in seconds.  0
+ * to wait forever.
+ * @param[out]  entity         Pointer to an entity tree.
+ * @param[out]  string_return  An optional return location for the text read
+ *                             from the session.  If NULL then it simply
+ *                             remains NULL.  If a pointer to NULL then it
+ * points to a freshly allocated GString on successful return. Otherwise it
+ * points to an existing GString onto which the text is appended.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
+ */
+int
+try_read_entity_and_string_s (int socket, int timeout, entity_t *entity,
+                              GString **string_return)
+{
+  return try_read_entity_and_string_s_internal (
+    socket, timeout, entity, string_return, FALSE, NULL, NULL);
+}
+
+/**
+ * @brief Try read an XML entity tree from a connection.
+ *
+ * @param[in]   connection     Connection.
+ * @param[in]   timeout        Server idle time before giving up, in seconds.
+ *                             0 to wait forever.
+ * @param[out]  entity         Pointer to an entity tree.
+ * @param[out]  string_return  An optional return location for the text read
+ *                             from the connection, see
+ *                             try_read_entity_and_string.
+ * @param[in]   arena          Whether to build the tree in an arena.
+ * @param[in]   stream         Stream data if streaming elements, else NULL.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file, -4 timeout.
+ */
+static int
+try_read_entity_and_string_c_internal (gvm_connection_t *connection,
+                                       int timeout, entity_t *entity,
+                                       GString **string_return, gboolean arena,
+                                       stream_data_t *stream)
+{
+  gvm_compress_stream_t *compression;
+
+  compression = gvm_connection_compression (connection);
+  if (connection->tls)
+    return try_read_entity_and_string_internal (
+      &connection->session, timeout, entity, string_return, arena, stream,
+      compression);
+  return try_read_entity_and_string_s_internal (
+    connection->socket, timeout, entity, string_return, arena, stream,
+    compression);
+}
+
 /**
  * @brief Try read an XML entity tree from the manager.
  *
@@ -1012,11 +1799,8 @@ int
 read_entity_and_string_c (gvm_connection_t *connection, entity_t *entity,
                           GString **string_return)
 {
-  if (connection->tls)
-    return try_read_entity_and_string (&connection->session, 0, entity,
-                                       string_return);
-  return try_read_entity_and_string_s (connection->socket, 0, entity,
-                                       string_return);
+  return try_read_entity_and_string_c_internal (connection, 0, entity,
+                                                string_return, FALSE, NULL);
 }
 
 /**
@@ -1145,10 +1929,8 @@ try_read_entity (gnutls_session_t *session, int timeout, entity_t *entity)
 int
 try_read_entity_c (gvm_connection_t *connection, int timeout, entity_t *entity)
 {
-  if (connection->tls)
-    return try_read_entity_and_string (&connection->session, 0, entity, NULL);
-  return try_read_entity_and_string_s (connection->socket, timeout, entity,
-                                       NULL);
+  return try_read_entity_and_string_c_internal (
+    connection, connection->tls ? 0 : timeout, entity, NULL, FALSE, NULL);
 }
 
 /**
@@ -1193,16 +1975,230 @@ read_entity_c (gvm_connection_t *connection, entity_t *entity)
   return try_read_entity_c (connection, 0, entity);
 }
 
+/**
+ * @brief Read an XML entity tree from the manager, building it in an arena.
+ *
+ * See parse_entity_arena for the restrictions on the tree.
+ *
+ * @param[in]   connection Connection.
+ * @param[out]  entity     Pointer to an entity tree.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file.
+ */
+int
+read_entity_arena_c (gvm_connection_t *connection, entity_t *entity)
+{
+  return try_read_entity_and_string_c_internal (connection, 0, entity, NULL,
+                                                TRUE, NULL);
+}
+
+/**
+ * @brief Read an XML entity tree from the manager, streaming its elements.
+ *
+ * Each element at the given depth is passed to the callback as soon as it
+ * is complete, and freed afterwards.  These elements are not added to the
+ * tree, so memory stays bounded by the size of a single element, e.g. a
+ * single VT of a get_vts response with depth 2.
+ *
+ * @param[in]   connection  Connection.
+ * @param[in]   depth       Depth of the streamed elements, at least 1.  The
+ *                          root element has depth 0.
+ * @param[in]   callback    Called with each streamed element.  The element
+ *                          is freed when the callback returns.
+ * @param[in]   user_data   User data for callback.
+ * @param[out]  entity      Return location for the tree without the
+ *                          streamed elements, or NULL.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file.
+ */
+int
+read_entity_stream (gvm_connection_t *connection, int depth,
+                    entity_callback_t callback, gpointer user_data,
+                    entity_t *entity)
+{
+  return read_entity_stream_named (connection, depth, NULL, callback,
+                                   user_data, entity);
+}
+
+/**
+ * @brief Read an XML entity tree from the manager, streaming named elements.
+ *
+ * Like read_entity_stream, but only elements with the given name are
+ * streamed.  Other elements at the depth stay in the tree, e.g. the
+ * result_count of a get_reports response streaming its results at depth 4.
+ *
+ * @param[in]   connection  Connection.
+ * @param[in]   depth       Depth of the streamed elements, at least 1.
+ * @param[in]   name        Name of the streamed elements, NULL for all.
+ * @param[in]   callback    Called with each streamed element.  The element
+ *                          is freed when the callback returns.
+ * @param[in]   user_data   User data for callback.
+ * @param[out]  entity      Return location for the tree without the
+ *                          streamed elements, or NULL.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 end of file.
+ */
+int
+read_entity_stream_named (gvm_connection_t *connection, int depth,
+                          const char *name, entity_callback_t callback,
+                          gpointer user_data, entity_t *entity)
+{
+  stream_data_t stream;
+  entity_t tree;
+  int ret;
+
+  if (depth < 1 || callback == NULL)
+    return -1;
+
+  stream.depth = 0;
+  stream.stream_depth = depth;
+  stream.name = name;
+  stream.callback = callback;
+  stream.user_data = user_data;
+
+  ret = try_read_entity_and_string_c_internal (connection, 0, &tree, NULL,
+                                               FALSE, &stream);
+  if (ret == 0)
+    {
+      if (entity)
+        *entity = tree;
+      else
+        free_entity (tree);
+    }
+  return ret;
+}
+
+/**
+ * @brief Incremental parser of XML entity trees.
+ */
+struct entity_parser
+{
+  context_data_t context;             ///< XML context.
+  GMarkupParseContext *xml_context;   ///< Parser of the current tree.
+  gvm_compress_stream_t *compression; ///< Compression of the data, or NULL.
+};
+
+/**
+ * @brief Start parsing a new tree with an incremental parser.
+ *
+ * @param[in]  parser  Parser.
+ */
+static void
+entity_parser_reset (entity_parser_t *parser)
+{
+  static GMarkupParser xml_parser = {handle_start_element, handle_end_element,
+                                     handle_text, NULL, handle_error};
+
+  if (parser->xml_context)
+    g_markup_parse_context_free (parser->xml_context);
+  while (parser->context.current
+         && parser->context.current != parser->context.first)
+    parser->context.current = g_slist_delete_link (parser->context.current,
+                                                   parser->context.current);
+  if (parser->context.first)
+    {
+      if (parser->context.first->data)
+        free_entity (parser->context.first->data);
+      g_slist_free_1 (parser->context.first);
+    }
+
+  parser->context.done = FALSE;
+  parser->context.first = NULL;
+  parser->context.current = NULL;
+  parser->xml_context =
+    g_markup_parse_context_new (&xml_parser, 0, &parser->context, NULL);
+}
+
+/**
+ * @brief Create an incremental parser of XML entity trees.
+ *
+ * The parser is fed data as it arrives, e.g. from a non-blocking socket,
+ * and returns each tree once it is complete.
+ *
+ * @param[in]  compression  Compression of the data, or NULL.  Not owned by
+ *                          the parser.
+ *
+ * @return Parser, to be freed with entity_parser_free.
+ */
+entity_parser_t *
+entity_parser_new (gvm_compress_stream_t *compression)
+{
+  entity_parser_t *parser;
+
+  parser = g_malloc0 (sizeof (*parser));
+  parser->compression = compression;
+  entity_parser_reset (parser);
+  return parser;
+}
+
+/**
+ * @brief Free an incremental parser, including any partial tree.
+ *
+ * @param[in]  parser  Parser.
+ */
+void
+entity_parser_free (entity_parser_t *parser)
+{
+  if (parser == NULL)
+    return;
+
+  entity_parser_reset (parser);
+  g_markup_parse_context_free (parser->xml_context);
+  g_free (parser);
+}
+
+/**
+ * @brief Feed data to an incremental parser.
+ *
+ * The data must not extend past the end of the tree, which holds for the
+ * response to a single GMP or OSP command.
+ *
+ * @param[in]   parser  Parser.
+ * @param[in]   data    Data.
+ * @param[in]   length  Length of data.
+ * @param[out]  entity  Return location for the tree, when complete.
+ *
+ * @return 1 if the tree is complete, 0 if more data is needed, -2 parse
+ *         error.  The parser is ready for the next tree after 1 and -2.
+ */
+int
+entity_parser_feed (entity_parser_t *parser, const char *data, gsize length,
+                    entity_t *entity)
+{
+  GError *error = NULL;
+
+  parse_read_data (parser->xml_context, parser->compression, data, length,
+                   NULL, &error);
+  if (error == NULL && parser->context.done)
+    g_markup_parse_context_end_parse (parser->xml_context, &error);
+  if (error)
+    {
+      g_warning ("%s: %s", __func__, error->message);
+      g_error_free (error);
+      entity_parser_reset (parser);
+      return -2;
+    }
+  if (parser->context.done == FALSE)
+    return 0;
+
+  *entity = (entity_t) parser->context.first->data;
+  parser->context.first->data = NULL;
+  entity_parser_reset (parser);
+  return 1;
+}
+
 /**
  * @brief Read an XML entity tree from a string.
  *
  * @param[in]   string  Input string.
  * @param[out]  entity  Pointer to an entity tree.
  *
+ * @param[in]   arena   Whether to build the tree in an arena.
+ *
  * @return 0 success, -1 read error, -2 parse error, -3 XML ended prematurely.
  */
-int
-parse_entity (const char *string, entity_t *entity)
+static int
+parse_entity_internal (const char *string, entity_t *entity, gboolean arena)
 {
   GMarkupParser xml_parser;
   GError *error = NULL;
@@ -1211,7 +2207,8 @@ parse_entity (const char *string, entity_t *entity)
 
   /* Create the XML parser. */
 
-  xml_parser.start_element = handle_start_element;
+  xml_parser.start_element =
+    arena ? handle_start_element_arena : handle_start_element;
   xml_parser.end_element = handle_end_element;
   xml_parser.text = handle_text;
   xml_parser.passthrough = NULL;
@@ -1265,6 +2262,39 @@ parse_entity (const char *string, entity_t *entity)
   return -3;
 }
 
+/**
+ * @brief Read an XML entity tree from a string.
+ *
+ * @param[in]   string  Input string.
+ * @param[out]  entity  Pointer to an entity tree.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 XML ended prematurely.
+ */
+int
+parse_entity (const char *string, entity_t *entity)
+{
+  return parse_entity_internal (string, entity, FALSE);
+}
+
+/**
+ * @brief Read an XML entity tree from a string, building it in an arena.
+ *
+ * The whole tree is allocated in a few large blocks and released at once by
+ * free_entity on the root.  Freeing any other entity of the tree does
+ * nothing, and the tree must not be modified.  Attributes are kept in
+ * attribute_list instead of attributes.
+ *
+ * @param[in]   string  Input string.
+ * @param[out]  entity  Pointer to an entity tree.
+ *
+ * @return 0 success, -1 read error, -2 parse error, -3 XML ended prematurely.
+ */
+int
+parse_entity_arena (const char *string, entity_t *entity)
+{
+  return parse_entity_internal (string, entity, TRUE);
+}
+
 /**
  * @brief Print an XML entity for g_slist_foreach to a GString.
  *
@@ -1288,11 +2318,11 @@ static void
 foreach_print_attribute_to_string (gpointer name, gpointer value,
                                    gpointer string)
 {
-  gchar *text_escaped;
-  text_escaped = g_markup_escape_text ((gchar *) value, -1);
-  g_string_append_printf ((GString *) string, " %s=\"%s\"", (char *) name,
-                          text_escaped);
-  g_free (text_escaped);
+  g_string_append_c ((GString *) string, ' ');
+  g_string_append ((GString *) string, (char *) name);
+  g_string_append ((GString *) string, "=\"");
+  xml_string_append_text ((GString *) string, (char *) value, -1);
+  g_string_append_c ((GString *) string, '"');
 }
 
 /**
@@ -1305,17 +2335,15 @@ foreach_print_attribute_to_string (gpointer name, gpointer value,
 void
 print_entity_to_string (entity_t entity, GString *string)
 {
-  gchar *text_escaped = NULL;
-  g_string_append_printf (string, "<%s", entity->name);
-  if (entity->attributes && g_hash_table_size (entity->attributes))
-    g_hash_table_foreach (entity->attributes, foreach_print_attribute_to_string,
-                          string);
-  g_string_append_printf (string, ">");
-  text_escaped = g_markup_escape_text (entity->text, -1);
-  g_string_append_printf (string, "%s", text_escaped);
-  g_free (text_escaped);
+  g_string_append_c (string, '<');
+  g_string_append (string, entity->name);
+  foreach_entity_attribute (entity, foreach_print_attribute_to_string, string);
+  g_string_append_c (string, '>');
+  xml_string_append_text (string, entity->text, -1);
   g_slist_foreach (entity->entities, foreach_print_entity_to_string, string);
-  g_string_append_printf (string, "</%s>", entity->name);
+  g_string_append (string, "</");
+  g_string_append (string, entity->name);
+  g_string_append_c (string, '>');
 }
 
 /**
@@ -1354,8 +2382,7 @@ print_entity (FILE *stream, entity_t entity)
 {
   gchar *text_escaped = NULL;
   fprintf (stream, "<%s", entity->name);
-  if (entity->attributes && g_hash_table_size (entity->attributes))
-    g_hash_table_foreach (entity->attributes, foreach_print_attribute, stream);
+  foreach_entity_attribute (entity, foreach_print_attribute, stream);
   fprintf (stream, ">");
   text_escaped = g_markup_escape_text (entity->text, -1);
   fprintf (stream, "%s", text_escaped);
@@ -1403,9 +2430,7 @@ print_entity_format (entity_t entity, gpointer indent)
     printf ("  ");
 
   printf ("<%s", entity->name);
-  if (entity->attributes && g_hash_table_size (entity->attributes))
-    g_hash_table_foreach (entity->attributes, foreach_print_attribute_format,
-                          indent);
+  foreach_entity_attribute (entity, foreach_print_attribute_format, indent);
   printf (">");
 
   text_escaped = g_markup_escape_text (entity->text, -1);
@@ -1443,6 +2468,37 @@ compare_find_attribute (gpointer key, gpointer value, gpointer attributes2)
   return TRUE;
 }
 
+/**
+ * @brief Data for comparing the attributes of two entities.
+ */
+typedef struct
+{
+  entity_t entity2; ///< Entity to look for the attributes in.
+  int differ;       ///< Whether an attribute differs.
+} compare_attributes_data_t;
+
+/**
+ * @brief Look for a name-value pair in the attributes of an entity.
+ *
+ * @param[in]  name   Attribute name.
+ * @param[in]  value  Attribute value.
+ * @param[in]  data   Comparison data.
+ */
+static void
+foreach_compare_attribute (gpointer name, gpointer value, gpointer data)
+{
+  compare_attributes_data_t *compare = data;
+  const char *value2;
+
+  if (compare->differ)
+    return;
+  value2 = entity_attribute (compare->entity2, name);
+  if (value2 && strcmp (value, value2) == 0)
+    return;
+  g_debug ("  compare failed attribute: %s\n", (char *) value);
+  compare->differ = 1;
+}
+
 /**
  * @brief Compare two XML entity.
  *
@@ -1472,17 +2528,23 @@ compare_entities (entity_t entity1, entity_t entity2)
       return 1;
     }
 
-  if (entity1->attributes == NULL)
+  if (entity_attribute_count (entity1) != entity_attribute_count (entity2))
+    return 1;
+  if (entity1->attributes && entity2->attributes)
     {
-      if (entity2->attributes)
-        return 1;
+      if (g_hash_table_find (entity1->attributes, compare_find_attribute,
+                             (gpointer) entity2->attributes))
+        {
+          g_debug ("  compare failed attributes\n");
+          return 1;
+        }
     }
   else
     {
-      if (entity2->attributes == NULL)
-        return 1;
-      if (g_hash_table_find (entity1->attributes, compare_find_attribute,
-                             (gpointer) entity2->attributes))
+      compare_attributes_data_t compare = {entity2, 0};
+
+      foreach_entity_attribute (entity1, foreach_compare_attribute, &compare);
+      if (compare.differ)
         {
           g_debug ("  compare failed attributes\n");
           return 1;
@@ -1550,6 +2612,90 @@ xml_string_append (GString *xml, const char *format, ...)
   g_free (piece);
 }
 
+/**
+ * @brief Append text to a string, escaping it for XML.
+ *
+ * Produces the same output as appending the result of g_markup_escape_text,
+ * but without allocating a copy of the text.
+ *
+ * @param[in]  xml     XML string.
+ * @param[in]  text    Text to escape.  NULL is treated as empty.
+ * @param[in]  length  Length of text, or -1 if NULL terminated.
+ */
+void
+xml_string_append_text (GString *xml, const char *text, gssize length)
+{
+  const char *end, *run;
+
+  if (text == NULL)
+    return;
+
+  end = text + (length < 0 ? (gssize) strlen (text) : length);
+  run = text;
+  while (text < end)
+    {
+      const char *escaped;
+      unsigned char byte;
+      unsigned int code;
+      int skip;
+
+      byte = (unsigned char) *text;
+      skip = 1;
+      switch (byte)
+        {
+        case '&':
+          escaped = "&amp;";
+          break;
+        case '<':
+          escaped = "&lt;";
+          break;
+        case '>':
+          escaped = "&gt;";
+          break;
+        case '\'':
+          escaped = "&apos;";
+          break;
+        case '"':
+          escaped = "&quot;";
+          break;
+        default:
+          escaped = NULL;
+          break;
+        }
+
+      if (escaped)
+        {
+          g_string_append_len (xml, run, text - run);
+          g_string_append (xml, escaped);
+        }
+      else
+        {
+          /* Control characters, including U+0080 to U+009F except U+0085. */
+          if ((byte >= 0x1 && byte <= 0x8) || byte == 0xb || byte == 0xc
+              || (byte >= 0xe && byte <= 0x1f) || byte == 0x7f)
+            code = byte;
+          else if (byte == 0xc2 && text + 1 < end
+                   && (unsigned char) text[1] >= 0x80
+                   && (unsigned char) text[1] <= 0x9f
+                   && (unsigned char) text[1] != 0x85)
+            {
+              code = (unsigned char) text[1];
+              skip = 2;
+            }
+          else
+            {
+              text++;
+              continue;
+            }
+          g_string_append_len (xml, run, text - run);
+          g_string_append_printf (xml, "&#x%x;", code);
+        }
+      text += skip;
+      run = text;
+    }
+  g_string_append_len (xml, run, text - run);
+}
+
 /* XML file utilities */
 
 /**
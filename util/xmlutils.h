@@ -59,8 +59,21 @@ xml_handle_text (context_data_t *, const gchar *, gsize);
  */
 typedef GSList *entities_t;
 
+/**
+ * @brief Arena holding all memory of an entity tree.
+ *
+ * A tree in an arena is freed as a whole by calling free_entity on its root.
+ * Its other entities can not be freed on their own, free_entity ignores them
+ * with a warning.
+ */
+typedef struct entity_arena entity_arena_t;
+
 /**
  * @brief XML element.
+ *
+ * Code that edits the list of children directly, instead of going through
+ * add_entity, must call entity_children_changed afterwards, because
+ * last_entity and child_index point into the list.
  */
 struct entity_s
 {
@@ -68,9 +81,23 @@ struct entity_s
   char *text;             ///< Text.
   GHashTable *attributes; ///< Attributes.
   entities_t entities;    ///< Children.
+  entities_t last_entity; ///< Last child, for appending in constant time.
+  entity_arena_t *arena;  ///< Arena of the tree, NULL if not in an arena.
+  char **attribute_list;  ///< Attribute names and values in turn, NULL
+                          ///< terminated.  Replaces attributes in arenas.
+  GString *text_buffer;   ///< Text collected while parsing, moved to text
+                          ///< at the end of the element.
+  GHashTable *child_index;     ///< First child of each name, built by
+                               ///< entity_index_children, or NULL.
+  entities_t child_index_last; ///< Last child in child_index.
 };
 typedef struct entity_s *entity_t;
 
+/**
+ * @brief Callback for streamed entities.
+ */
+typedef void (*entity_callback_t) (entity_t, gpointer);
+
 /**
  * @brief Data for xml search functions.
  */
@@ -94,6 +121,12 @@ int compare_entities (entity_t, entity_t);
 entity_t
 entity_child (entity_t, const char *);
 
+void
+entity_index_children (entity_t);
+
+void
+entity_children_changed (entity_t);
+
 const char *
 entity_attribute (entity_t, const char *);
 
@@ -147,9 +180,37 @@ read_string (gnutls_session_t *, GString **);
 int
 read_string_c (gvm_connection_t *, GString **);
 
+int
+read_entity_arena_c (gvm_connection_t *, entity_t *);
+
+int
+read_entity_stream (gvm_connection_t *, int, entity_callback_t, gpointer,
+                    entity_t *);
+
+int
+read_entity_stream_named (gvm_connection_t *, int, const char *,
+                          entity_callback_t, gpointer, entity_t *);
+
+/**
+ * @brief Incremental parser of XML entity trees.
+ */
+typedef struct entity_parser entity_parser_t;
+
+entity_parser_t *
+entity_parser_new (gvm_compress_stream_t *);
+
+int
+entity_parser_feed (entity_parser_t *, const char *, gsize, entity_t *);
+
+void
+entity_parser_free (entity_parser_t *);
+
 int
 parse_entity (const char *, entity_t *);
 
+int
+parse_entity_arena (const char *, entity_t *);
+
 void
 print_entity_to_string (entity_t entity, GString *string);
 
@@ -158,6 +219,9 @@ int xml_count_entities (entities_t);
 void
 xml_string_append (GString *, const char *, ...);
 
+void
+xml_string_append_text (GString *, const char *, gssize);
+
 /* XML file utilities */
 
 int
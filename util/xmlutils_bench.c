@@ -0,0 +1,191 @@
+/* Copyright (C) 2021 Greenbone Networks GmbH
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * @file
+ * @brief Stand-alone benchmark of the entity XML parser.
+ *
+ * A synthetic OSP get_vts response of the given size is generated and parsed
+ * with parse_entity, or parse_entity_arena with --arena, e.g.:
+ *
+ *   ./xmlutils-bench --size 50 --arena
+ */
+
+#include "xmlutils.c"
+
+#include <stdio.h>
+
+/**
+ * @brief Append a synthetic VT to an OSP get_vts response.
+ *
+ * @param[in]  xml    The response.
+ * @param[in]  index  Index of the VT.
+ */
+static void
+append_vt (GString *xml, int index)
+{
+  g_string_append_printf (
+    xml,
+    "<vt id=\"1.3.6.1.4.1.25623.1.0.%d\">"
+    "<name>Synthetic Vulnerability Test %d</name>"
+    "<creation_time>1602115200</creation_time>"
+    "<modification_time>1618790400</modification_time>"
+    "<summary>The remote host is missing an update for the package %d"
+    " announced via the advisory.</summary>"
+    "<affected>All versions of the package before %d.1.</affected>"
+    "<insight>Multiple vulnerabilities have been found in the package,"
+    " allowing remote attackers to execute arbitrary code.</insight>"
+    "<detection>Checks if a vulnerable package version is present on the"
+    " target host.</detection>"
+    "<solution type=\"VendorFix\" method=\"\">Please install the updated"
+    " package(s).</solution>"
+    "<refs>"
+    "<ref type=\"cve\" id=\"CVE-2021-%d\"/>"
+    "<ref type=\"cve\" id=\"CVE-2021-%d\"/>"
+    "<ref type=\"url\" id=\"https://example.com/advisory/%d\"/>"
+    "</refs>"
+    "<severities>"
+    "<severity type=\"cvss_base_v2\">"
+    "<value>AV:N/AC:L/Au:N/C:C/I:C/A:C</value>"
+    "<origin/>"
+    "<date>1618790400</date>"
+    "</severity>"
+    "</severities>"
+    "<custom>"
+    "<family>Synthetic Local Security Checks</family>"
+    "<category>3</category>"
+    "<required_keys>ssh/login/packages</required_keys>"
+    "<filename>synthetic/vt_%d.nasl</filename>"
+    "</custom>"
+    "<params>"
+    "<param id=\"1\" type=\"checkbox\"><name>Enable</name>"
+    "<default>no</default></param>"
+    "</params>"
+    "</vt>",
+    index, index, index, index, index, index + 1, index, index);
+}
+
+/**
+ * @brief Generate a synthetic OSP get_vts response.
+ *
+ * @param[in]   size   Minimum size of the response in bytes.
+ * @param[out]  count  Number of VTs in the response.
+ *
+ * @return The response.
+ */
+static GString *
+make_get_vts_response (gsize size, int *count)
+{
+  GString *xml;
+
+  xml = g_string_sized_new (size + 4096);
+  g_string_append (xml, "<get_vts_response status=\"200\" status_text=\"OK\">"
+                        "<vts vts_version=\"202104190000\">");
+  for (*count = 0; xml->len < size; (*count)++)
+    append_vt (xml, *count);
+  g_string_append (xml, "</vts></get_vts_response>");
+
+  return xml;
+}
+
+int
+main (int argc, char **argv)
+{
+  static gint size = 50;
+  static gint rounds = 3;
+  static gboolean arena = FALSE;
+  static GOptionEntry entries[] = {
+    {"size", 's', 0, G_OPTION_ARG_INT, &size,
+     "Size of the get_vts response in MB (default 50)", "<MB>"},
+    {"rounds", 'r', 0, G_OPTION_ARG_INT, &rounds,
+     "Number of times the response is parsed (default 3)", "<N>"},
+    {"arena", 'a', 0, G_OPTION_ARG_NONE, &arena,
+     "Build the entity trees in an arena", NULL},
+    {NULL, 0, 0, 0, NULL, NULL, NULL}};
+  GOptionContext *option_context;
+  GError *error = NULL;
+  GString *xml;
+  int count;
+  gint64 best;
+
+  option_context =
+    g_option_context_new ("- benchmark parsing a large OSP get_vts response");
+  g_option_context_add_main_entries (option_context, entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return 1;
+    }
+  g_option_context_free (option_context);
+
+  if (size <= 0 || rounds <= 0)
+    {
+      fprintf (stderr, "Size and rounds must be positive.\n");
+      return 1;
+    }
+
+  xml = make_get_vts_response ((gsize) size * 1024 * 1024, &count);
+
+  best = G_MAXINT64;
+  for (int round = 0; round < rounds; round++)
+    {
+      entity_t entity;
+      entities_t vts;
+      gint64 start, parsed, walked;
+      int found;
+
+      start = g_get_monotonic_time ();
+      if ((arena ? parse_entity_arena : parse_entity) (xml->str, &entity))
+        {
+          fprintf (stderr, "Error while parsing the response.\n");
+          return 1;
+        }
+      parsed = g_get_monotonic_time ();
+
+      found = 0;
+      for (vts = entity_child (entity, "vts")->entities; vts;
+           vts = next_entities (vts))
+        if (entity_child (first_entity (vts), "custom"))
+          found++;
+      walked = g_get_monotonic_time ();
+      free_entity (entity);
+
+      if (found != count)
+        {
+          fprintf (stderr, "Found %d of %d VTs.\n", found, count);
+          return 1;
+        }
+
+      printf ("Round %d: parse %.3f s, walk %.3f s, free %.3f s\n", round + 1,
+              (parsed - start) / 1000000.0, (walked - parsed) / 1000000.0,
+              (g_get_monotonic_time () - walked) / 1000000.0);
+      best = MIN (best, parsed - start);
+    }
+
+  printf ("Response size:           %.1f MB\n", xml->len / (1024.0 * 1024.0));
+  printf ("VTs:                     %d\n", count);
+  printf ("Arena:                   %s\n", arena ? "yes" : "no");
+  printf ("Best parse time:         %.3f s\n", best / 1000000.0);
+  printf ("Parse throughput:        %.1f MB/s\n",
+          (xml->len / (1024.0 * 1024.0)) / MAX (best / 1000000.0, 1e-6));
+
+  g_string_free (xml, TRUE);
+
+  return 0;
+}
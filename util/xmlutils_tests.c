@@ -21,6 +21,7 @@
 
 #include <cgreen/cgreen.h>
 #include <cgreen/mocks.h>
+#include <sys/socket.h>
 
 Describe (xmlutils);
 BeforeEach (xmlutils)
@@ -176,6 +177,515 @@ Ensure (xmlutils, next_entities_handles_multiple_children)
   children = next_entities (children);
 }
 
+Ensure (xmlutils, parse_entity_keeps_order_of_many_children)
+{
+  entity_t entity;
+  entities_t children;
+  GString *xml;
+  int count;
+
+  xml = g_string_new ("<vts>");
+  for (int i = 0; i < 10000; i++)
+    g_string_append_printf (xml, "<vt id='%d'/>", i);
+  g_string_append (xml, "</vts>");
+
+  assert_that (parse_entity (xml->str, &entity), is_equal_to (0));
+  g_string_free (xml, TRUE);
+
+  count = 0;
+  for (children = entity->entities; children;
+       children = next_entities (children))
+    {
+      gchar *id = g_strdup_printf ("%d", count++);
+      assert_that (entity_attribute (first_entity (children), "id"),
+                   is_equal_to_string (id));
+      g_free (id);
+    }
+  assert_that (count, is_equal_to (10000));
+  assert_that (xml_count_entities (entity->entities), is_equal_to (10000));
+
+  free_entity (entity);
+}
+
+/* entity_child */
+
+Ensure (xmlutils, entity_child_finds_children_of_wide_entity)
+{
+  entity_t entity;
+  GString *xml;
+
+  xml = g_string_new ("<report>");
+  for (int index = 0; index < 100; index++)
+    g_string_append_printf (xml, "<result_%d>%d</result_%d>", index % 50,
+                            index, index % 50);
+  g_string_append (xml, "<last/></report>");
+
+  for (int arena = 0; arena < 2; arena++)
+    {
+      assert_that ((arena ? parse_entity_arena : parse_entity) (xml->str,
+                                                                &entity),
+                   is_equal_to (0));
+
+      entity_index_children (entity);
+      assert_that (entity->child_index, is_not_null);
+      assert_that (entity_child (entity, "last"), is_not_null);
+
+      /* The first child of each name is found. */
+      assert_that (entity_text (entity_child (entity, "result_0")),
+                   is_equal_to_string ("0"));
+      assert_that (entity_text (entity_child (entity, "result_49")),
+                   is_equal_to_string ("49"));
+      assert_that (entity_child (entity, "missing"), is_null);
+
+      /* Appended children are found too. */
+      if (arena == 0)
+        {
+          add_entity (&entity->entities, "appended", "1");
+          assert_that (entity_text (entity_child (entity, "appended")),
+                       is_equal_to_string ("1"));
+        }
+
+      free_entity (entity);
+    }
+
+  g_string_free (xml, TRUE);
+}
+
+Ensure (xmlutils, entity_child_does_not_index_by_itself)
+{
+  entity_t entity;
+  GString *xml;
+
+  xml = g_string_new ("<report>");
+  for (int index = 0; index < 100; index++)
+    g_string_append_printf (xml, "<result>%d</result>", index);
+  g_string_append (xml, "<last/></report>");
+  assert_that (parse_entity (xml->str, &entity), is_equal_to (0));
+  g_string_free (xml, TRUE);
+
+  assert_that (entity_child (entity, "last"), is_not_null);
+  assert_that (entity_child (entity, "missing"), is_null);
+  assert_that (entity->child_index, is_null);
+  free_entity (entity);
+}
+
+Ensure (xmlutils, entity_children_changed_drops_stale_child_index)
+{
+  entity_t entity, removed;
+  GString *xml;
+  GSList *link;
+
+  xml = g_string_new ("<report>");
+  for (int index = 0; index < 40; index++)
+    g_string_append_printf (xml, "<result_%d>%d</result_%d>", index, index,
+                            index);
+  g_string_append (xml, "</report>");
+  assert_that (parse_entity (xml->str, &entity), is_equal_to (0));
+  g_string_free (xml, TRUE);
+
+  entity_index_children (entity);
+  assert_that (entity_child (entity, "result_39"), is_not_null);
+  assert_that (entity->child_index, is_not_null);
+
+  /* Remove a child in the middle and the last child by hand. */
+  removed = entity_child (entity, "result_20");
+  entity->entities = g_slist_remove (entity->entities, removed);
+  free_entity (removed);
+  link = g_slist_last (entity->entities);
+  free_entity (link->data);
+  entity->entities = g_slist_delete_link (entity->entities, link);
+  entity_children_changed (entity);
+
+  assert_that (entity->child_index, is_null);
+  assert_that (entity_child (entity, "result_20"), is_null);
+  assert_that (entity_child (entity, "result_39"), is_null);
+  assert_that (entity_text (entity_child (entity, "result_38")),
+               is_equal_to_string ("38"));
+
+  /* Appending still works after the last child was removed. */
+  add_child_entity (entity, "appended", "1");
+  assert_that (entity_text (entity_child (entity, "appended")),
+               is_equal_to_string ("1"));
+  assert_that (xml_count_entities (entity->entities), is_equal_to (39));
+
+  free_entity (entity);
+}
+
+/* xml_handle_text */
+
+Ensure (xmlutils, xml_handle_text_collects_large_text_in_linear_time)
+{
+  context_data_t context_data = {NULL, NULL, FALSE};
+  const gchar *no_attributes[] = {NULL};
+  entity_t entity;
+  gchar chunk[1025];
+  gint64 start;
+  int chunks = 20 * 1024;
+
+  /* 20 MB text in 1 KB pieces would take minutes with quadratic
+   * concatenation. */
+  memset (chunk, 'x', sizeof (chunk) - 1);
+  chunk[sizeof (chunk) - 1] = '\0';
+
+  start = g_get_monotonic_time ();
+  xml_handle_start_element (&context_data, "report", no_attributes,
+                            no_attributes);
+  for (int i = 0; i < chunks; i++)
+    xml_handle_text (&context_data, chunk, sizeof (chunk) - 1);
+  xml_handle_end_element (&context_data, "report");
+  assert_that (g_get_monotonic_time () - start,
+               is_less_than (10 * G_USEC_PER_SEC));
+
+  assert_that (context_data.done, is_true);
+  entity = (entity_t) context_data.first->data;
+  assert_that (strlen (entity_text (entity)),
+               is_equal_to (chunks * (sizeof (chunk) - 1)));
+  assert_that (entity->text_buffer, is_null);
+  g_slist_free_1 (context_data.first);
+  free_entity (entity);
+}
+
+Ensure (xmlutils, parse_entity_joins_text_around_children)
+{
+  entity_t entity;
+
+  assert_that (parse_entity ("<a>x<b>y</b>z</a>", &entity), is_equal_to (0));
+  assert_that (entity_text (entity), is_equal_to_string ("xz"));
+  assert_that (entity_text (entity_child (entity, "b")),
+               is_equal_to_string ("y"));
+  free_entity (entity);
+
+  assert_that (parse_entity_arena ("<a>x<b>y</b>z</a>", &entity),
+               is_equal_to (0));
+  assert_that (entity_text (entity), is_equal_to_string ("xz"));
+  free_entity (entity);
+}
+
+/* parse_entity_arena */
+
+Ensure (xmlutils, parse_entity_arena_matches_parse_entity)
+{
+  entity_t entity, arena_entity, b;
+  const gchar *xml;
+  GString *string, *arena_string;
+
+  /* At most one attribute per element, as the order of attributes printed
+   * from a hash table is undefined. */
+  xml = "<a x='1'>text<b ba1='test'>1</b><c/><b>&lt;2&gt;</b></a>";
+
+  assert_that (parse_entity (xml, &entity), is_equal_to (0));
+  assert_that (parse_entity_arena (xml, &arena_entity), is_equal_to (0));
+
+  assert_that (entity_name (arena_entity), is_equal_to_string ("a"));
+  assert_that (entity_text (arena_entity), is_equal_to_string ("text"));
+  assert_that (entity_attribute (arena_entity, "x"), is_equal_to_string ("1"));
+  assert_that (entity_attribute (arena_entity, "z"), is_null);
+
+  b = entity_child (arena_entity, "b");
+  assert_that (entity_text (b), is_equal_to_string ("1"));
+  assert_that (entity_attribute (b, "ba1"), is_equal_to_string ("test"));
+  assert_that (entity_text (entity_child (arena_entity, "c")),
+               is_equal_to_string (""));
+  assert_that (xml_count_entities (arena_entity->entities), is_equal_to (3));
+
+  assert_that (compare_entities (entity, arena_entity), is_equal_to (0));
+  assert_that (compare_entities (arena_entity, entity), is_equal_to (0));
+
+  string = g_string_new ("");
+  arena_string = g_string_new ("");
+  print_entity_to_string (entity, string);
+  print_entity_to_string (arena_entity, arena_string);
+  assert_that (arena_string->str, is_equal_to_string (string->str));
+  g_string_free (string, TRUE);
+  g_string_free (arena_string, TRUE);
+
+  /* Freeing a child of an arena tree does nothing. */
+  free_entity (b);
+  free_entity (arena_entity);
+  free_entity (entity);
+}
+
+/* read_entity_stream */
+
+static void
+collect_vt_id (entity_t vt, gpointer ids)
+{
+  g_ptr_array_add ((GPtrArray *) ids,
+                   g_strdup (entity_attribute (vt, "id")));
+}
+
+Ensure (xmlutils, read_entity_stream_passes_elements_at_depth)
+{
+  gvm_connection_t connection = {0};
+  entity_t entity;
+  GPtrArray *ids;
+  int sockets[2];
+  const gchar *xml;
+
+  xml = "<get_vts_response status='200'><vts vts_version='1'>"
+        "<vt id='1'><name>One</name></vt>"
+        "<vt id='2'><name>Two</name></vt>"
+        "<vt id='3'/></vts><end/></get_vts_response>";
+
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  assert_that (write (sockets[1], xml, strlen (xml)),
+               is_equal_to (strlen (xml)));
+  close (sockets[1]);
+
+  connection.socket = sockets[0];
+  ids = g_ptr_array_new_with_free_func (g_free);
+  assert_that (read_entity_stream (&connection, 2, collect_vt_id, ids,
+                                   &entity),
+               is_equal_to (0));
+  close (sockets[0]);
+
+  assert_that (ids->len, is_equal_to (3));
+  assert_that (g_ptr_array_index (ids, 0), is_equal_to_string ("1"));
+  assert_that (g_ptr_array_index (ids, 2), is_equal_to_string ("3"));
+  g_ptr_array_free (ids, TRUE);
+
+  /* The streamed elements are not in the tree, the rest is. */
+  assert_that (entity_attribute (entity, "status"), is_equal_to_string ("200"));
+  assert_that (entity_child (entity, "vts"), is_not_null);
+  assert_that (entity_child (entity_child (entity, "vts"), "vt"), is_null);
+  assert_that (entity_child (entity, "end"), is_not_null);
+  free_entity (entity);
+}
+
+Ensure (xmlutils, read_entity_stream_named_passes_only_named_elements)
+{
+  gvm_connection_t connection = {0};
+  entity_t entity, results;
+  GPtrArray *ids;
+  int sockets[2];
+  const gchar *xml;
+
+  xml = "<get_reports_response status='200'><report><report>"
+        "<results start='1' max='2'>"
+        "<result id='1'/><result id='2'/>"
+        "</results>"
+        "<result_count><filtered>5</filtered></result_count>"
+        "</report></report></get_reports_response>";
+
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  assert_that (write (sockets[1], xml, strlen (xml)),
+               is_equal_to (strlen (xml)));
+  close (sockets[1]);
+
+  connection.socket = sockets[0];
+  ids = g_ptr_array_new_with_free_func (g_free);
+  assert_that (read_entity_stream_named (&connection, 4, "result",
+                                         collect_vt_id, ids, &entity),
+               is_equal_to (0));
+  close (sockets[0]);
+
+  assert_that (ids->len, is_equal_to (2));
+  assert_that (g_ptr_array_index (ids, 1), is_equal_to_string ("2"));
+  g_ptr_array_free (ids, TRUE);
+
+  /* Elements at the depth with other names stay in the tree. */
+  results = entity_child (entity_child (entity, "report"), "report");
+  assert_that (entity_child (entity_child (results, "results"), "result"),
+               is_null);
+  assert_that (entity_text (entity_child (entity_child (results,
+                                                        "result_count"),
+                                          "filtered")),
+               is_equal_to_string ("5"));
+  free_entity (entity);
+}
+
+Ensure (xmlutils, read_entity_stream_drops_whitespace_between_elements)
+{
+  gvm_connection_t connection = {0};
+  entity_t entity;
+  GPtrArray *ids;
+  int sockets[2];
+  const gchar *xml;
+
+  xml = "<get_vts_response status='200'>\n <vts>\n"
+        "  <vt id='1'>\n   <name> One </name>\n  </vt>\n"
+        "  <vt id='2'/>\n"
+        " </vts>\n</get_vts_response>";
+
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  assert_that (write (sockets[1], xml, strlen (xml)),
+               is_equal_to (strlen (xml)));
+  close (sockets[1]);
+
+  connection.socket = sockets[0];
+  ids = g_ptr_array_new_with_free_func (g_free);
+  assert_that (read_entity_stream (&connection, 2, collect_vt_id, ids,
+                                   &entity),
+               is_equal_to (0));
+  close (sockets[0]);
+
+  assert_that (ids->len, is_equal_to (2));
+  g_ptr_array_free (ids, TRUE);
+
+  /* The parent of the streamed elements keeps no whitespace. */
+  assert_that (entity_text (entity_child (entity, "vts")),
+               is_equal_to_string (""));
+  free_entity (entity);
+}
+
+/* entity_parser_feed */
+
+Ensure (xmlutils, entity_parser_feed_returns_trees_split_across_chunks)
+{
+  entity_parser_t *parser;
+  entity_t entity;
+  const gchar *xml;
+  gsize length;
+
+  xml = "<get_version_response status='200'>"
+        "<version>21.4</version></get_version_response>";
+  length = strlen (xml);
+
+  parser = entity_parser_new (NULL);
+
+  /* Feed the response byte by byte, twice. */
+  for (int round = 0; round < 2; round++)
+    {
+      entity = NULL;
+      for (gsize index = 0; index < length - 1; index++)
+        assert_that (entity_parser_feed (parser, xml + index, 1, &entity),
+                     is_equal_to (0));
+      assert_that (entity_parser_feed (parser, xml + length - 1, 1, &entity),
+                   is_equal_to (1));
+      assert_that (entity_text (entity_child (entity, "version")),
+                   is_equal_to_string ("21.4"));
+      free_entity (entity);
+    }
+
+  /* A parse error leaves the parser ready for the next tree. */
+  assert_that (entity_parser_feed (parser, "<a><b></a>", 10, &entity),
+               is_equal_to (-2));
+  assert_that (entity_parser_feed (parser, xml, length, &entity),
+               is_equal_to (1));
+  free_entity (entity);
+
+  entity_parser_free (parser);
+}
+
+/* read_entity_and_string_c */
+
+Ensure (xmlutils, read_entity_and_string_c_uncompresses_data)
+{
+  gvm_connection_t connection = {0};
+  gvm_compress_stream_t *peer;
+  entity_t entity;
+  GString *xml, *string;
+  const void *compressed;
+  unsigned long length;
+  int sockets[2];
+
+  xml = g_string_new ("<get_reports_response status='200'>");
+  for (int index = 0; index < 2000; index++)
+    g_string_append_printf (xml, "<result id='%d'>Repetitive result</result>",
+                            index);
+  g_string_append (xml, "</get_reports_response>");
+
+  /* Send the response in two compressed chunks. */
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+  peer = gvm_compress_stream_new (-1);
+  compressed = gvm_compress_stream_deflate (peer, xml->str, 100, &length);
+  assert_that (write (sockets[1], compressed, length), is_equal_to (length));
+  compressed = gvm_compress_stream_deflate (peer, xml->str + 100,
+                                            xml->len - 100, &length);
+  assert_that (length, is_less_than (xml->len / 4));
+  assert_that (write (sockets[1], compressed, length), is_equal_to (length));
+  gvm_compress_stream_free (peer);
+  close (sockets[1]);
+
+  connection.socket = sockets[0];
+  assert_that (gvm_connection_enable_compression (&connection, -1),
+               is_equal_to (0));
+  string = NULL;
+  assert_that (read_entity_and_string_c (&connection, &entity, &string),
+               is_equal_to (0));
+  gvm_connection_free (&connection);
+
+  assert_that (string->str, is_equal_to_string (xml->str));
+  assert_that (entity_attribute (entity, "status"), is_equal_to_string ("200"));
+  assert_that (xml_count_entities (entity->entities), is_equal_to (2000));
+  free_entity (entity);
+  g_string_free (string, TRUE);
+  g_string_free (xml, TRUE);
+}
+
+/* try_read_entity_and_string_s */
+
+Ensure (xmlutils, try_read_entity_and_string_s_times_out)
+{
+  entity_t entity = NULL;
+  int sockets[2];
+  gint64 start;
+
+  assert_that (socketpair (AF_UNIX, SOCK_STREAM, 0, sockets), is_equal_to (0));
+
+  start = g_get_monotonic_time ();
+  assert_that (try_read_entity_and_string_s (sockets[0], 1, &entity, NULL),
+               is_equal_to (-4));
+  assert_that (g_get_monotonic_time () - start,
+               is_greater_than (G_USEC_PER_SEC - 1));
+  assert_that (entity, is_null);
+
+  /* The reusable buffer is released again after the timeout. */
+  assert_that (write (sockets[1], "<a>1</a>", 8), is_equal_to (8));
+  assert_that (try_read_entity_and_string_s (sockets[0], 1, &entity, NULL),
+               is_equal_to (0));
+  assert_that (entity_text (entity), is_equal_to_string ("1"));
+  free_entity (entity);
+
+  close (sockets[0]);
+  close (sockets[1]);
+}
+
+/* xml_string_append_text */
+
+Ensure (xmlutils, xml_string_append_text_matches_g_markup_escape_text)
+{
+  GString *string;
+  gchar *escaped;
+  const gchar *text;
+
+  text = "a<b>&'\"c\x01\x1f\x7f "
+         "\xc2\x80\xc2\x85\xc2\x9f\xc2\xa0 \xe2\x82\xac";
+  escaped = g_markup_escape_text (text, -1);
+
+  string = g_string_new ("x");
+  xml_string_append_text (string, text, -1);
+  assert_that (string->str + 1, is_equal_to_string (escaped));
+
+  g_string_truncate (string, 0);
+  xml_string_append_text (string, text, 4);
+  assert_that (string->str, is_equal_to_string ("a&lt;b&gt;"));
+
+  g_string_truncate (string, 0);
+  xml_string_append_text (string, NULL, -1);
+  assert_that (string->len, is_equal_to (0));
+
+  g_string_free (string, TRUE);
+  g_free (escaped);
+}
+
+Ensure (xmlutils, print_entity_to_string_escapes_text_and_attributes)
+{
+  entity_t entity;
+  GString *string;
+
+  assert_that (parse_entity ("<a id=\"&quot;1&amp;\">x &lt; y<b>&apos;</b></a>",
+                             &entity),
+               is_equal_to (0));
+  string = g_string_new ("");
+  print_entity_to_string (entity, string);
+  assert_that (string->str,
+               is_equal_to_string (
+                 "<a id=\"&quot;1&amp;\">x &lt; y<b>&apos;</b></a>"));
+  g_string_free (string, TRUE);
+  free_entity (entity);
+}
+
 /* parse_element */
 
 Ensure (xmlutils, parse_element_parses_simple_xml)
@@ -518,6 +1028,36 @@ main (int argc, char **argv)
   add_test_with_context (suite, xmlutils,
                          next_entities_handles_multiple_children);
 
+  add_test_with_context (suite, xmlutils,
+                         parse_entity_keeps_order_of_many_children);
+  add_test_with_context (suite, xmlutils,
+                         entity_child_finds_children_of_wide_entity);
+  add_test_with_context (suite, xmlutils,
+                         entity_child_does_not_index_by_itself);
+  add_test_with_context (suite, xmlutils,
+                         entity_children_changed_drops_stale_child_index);
+  add_test_with_context (suite, xmlutils,
+                         xml_handle_text_collects_large_text_in_linear_time);
+  add_test_with_context (suite, xmlutils,
+                         parse_entity_joins_text_around_children);
+  add_test_with_context (suite, xmlutils,
+                         parse_entity_arena_matches_parse_entity);
+  add_test_with_context (suite, xmlutils,
+                         read_entity_stream_passes_elements_at_depth);
+  add_test_with_context (suite, xmlutils,
+                         read_entity_stream_named_passes_only_named_elements);
+  add_test_with_context (suite, xmlutils,
+                         read_entity_stream_drops_whitespace_between_elements);
+  add_test_with_context (suite, xmlutils,
+                         entity_parser_feed_returns_trees_split_across_chunks);
+  add_test_with_context (suite, xmlutils,
+                         read_entity_and_string_c_uncompresses_data);
+  add_test_with_context (suite, xmlutils,
+                         try_read_entity_and_string_s_times_out);
+  add_test_with_context (suite, xmlutils,
+                         xml_string_append_text_matches_g_markup_escape_text);
+  add_test_with_context (suite, xmlutils,
+                         print_entity_to_string_escapes_text_and_attributes);
   add_test_with_context (suite, xmlutils, parse_element_parses_simple_xml);
   add_test_with_context (suite, xmlutils,
                          parse_element_parses_xml_with_attributes);